@@ -1,27 +1,373 @@
-import tkinter as tk
-from src.python.stream.camera import CameraStream
-from src.python.stream.display import StreamDisplay
+import argparse
+import logging
+import os
+import signal
+import time
+
+from src.python.ai.cache import ModelCache
+from src.python.ai.classes import ClassConfig
+from src.python.ai.detections import DetectionIndex, DetectionRecorder
+from src.python.ai.models import ModelError, ModelRegistry, ModelSpec
 from src.python.ai.processor import Processor
+from src.python.ai.resolution import ResolutionPolicy
+from src.python.ai.scheduler import DetectionScheduler
+from src.python.ai.tracker import IouTracker
+from src.python.ai.twopass import TwoPassDetector
+from src.python.pipeline.pipeline import Pipeline, Rendition, open_source
+from src.python.pipeline.renditions import load_renditions
 
 
-def main():
+def parse_args():
+    parser = argparse.ArgumentParser(description='AI Enhanced Video Stream')
+    parser.add_argument('--source', default='0', help='摄像头编号、视频文件或 rtsp:// 地址（默认 0）')
+    parser.add_argument('--streams', default=None,
+                        help='多路配置文件（.json）：每路独立收流、编码、推流，检测共用；文件修改后自动增删各路')
+    parser.add_argument('--max-batch', type=int, default=4, help='多路共享推理时每批最多的帧数')
+    parser.add_argument('--batch-wait-ms', type=float, default=20.0, help='多路共享推理时凑批的最长等待')
+    parser.add_argument('--rtmp', default=None, help='推流地址 rtmp://...，不指定时只做本地预览')
+    parser.add_argument('--renditions', default=None,
+                        help='多码率输出配置（.json）：同一路解码和检测供给多个编码器和推流地址，'
+                             '各路可以有自己的尺寸、编码格式、码率和 QP 偏移；给出时代替 --rtmp')
+    parser.add_argument('--codec', default='h264', choices=('h264', 'h265'))
+    parser.add_argument('--bitrate', type=int, default=2000, help='编码码率 kbps')
+    parser.add_argument('--fps', type=int, default=25)
+    parser.add_argument('--encode-depth', type=int, default=8, help='编码队列深度（不丢帧，满时背压）')
+    parser.add_argument('--publish-depth', type=int, default=32, help='推流队列深度（不丢包）')
+    parser.add_argument('--models', default='model/models.json', help='模型注册表')
+    parser.add_argument('--model', default=None,
+                        help='注册表中的检测模型名或规模（full / tiny），默认取注册表的 default')
+    parser.add_argument('--model-cache', default=None,
+                        help='模型缓存目录（默认 ~/.cache/roi-pipeline/models），off 关闭')
+    parser.add_argument('--no-warmup', action='store_true', help='启动时不做预热 forward')
+    parser.add_argument('--classes', default=None,
+                        help='类别配置：每类的 ROI 优先级和 QP 偏移（.json），也可以给 .names 文件；默认取注册表中的配置')
+    parser.add_argument('--roi-qp', type=int, default=-8, help='ROI 的 QP 偏移（类别配置没有给出时）')
+    parser.add_argument('--background-qp', type=int, default=6, help='ROI 之外的 QP 偏移')
+    parser.add_argument('--max-rois', type=int, default=0, help='每帧 ROI 个数上限，按类别优先级保留（0 不限）')
+    parser.add_argument('--no-roi-smoothing', action='store_true', help='检测框直接驱动 QP 图，不做时域平滑')
+    parser.add_argument('--roi-hold', type=int, default=5, help='目标消失后 ROI 保持的检测次数')
+    parser.add_argument('--roi-dilate', type=float, default=0.15, help='ROI 每边按框尺寸外扩的比例')
+    parser.add_argument('--static-background', action='store_true',
+                        help='ROI 之外长时间静止的宏块改用更高的 QP（适合固定机位）')
+    parser.add_argument('--static-qp', type=int, default=12, help='静止块的 QP 偏移')
+    parser.add_argument('--static-seconds', type=float, default=2.0, help='块连续静止多久后按静止背景编码')
+    parser.add_argument('--passthrough', action='store_true',
+                        help='没有 ROI 目标且源码率不超过 --bitrate 时直接转发 RTSP 码流，不重编码（需要原生库）')
+    parser.add_argument('--passthrough-idle', type=float, default=2.0, help='连续多少秒没有目标后切到直通')
+    parser.add_argument('--latency-target', type=int, default=0,
+                        help='推流排队时延目标（毫秒）：超过时依次抬高背景 QP、ROI QP，最后给背景降帧（0 关闭）')
+    parser.add_argument('--max-background-qp', type=int, default=24, help='码控抬高背景 QP 偏移的上限')
+    parser.add_argument('--inference-depth', type=int, default=1, help='推理队列深度（latest-wins）')
+    parser.add_argument('--backend', default='auto', choices=('auto', 'sail', 'opencv'),
+                        help='推理后端：auto 在给了 --bmodel 且有 sophon.sail 时用 TPU，否则 cv2.dnn')
+    parser.add_argument('--bmodel', default=None, help='bmnetd 编译的 INT8/FP16 bmodel 路径')
+    parser.add_argument('--tpu', type=int, default=0, help='TPU 设备号')
+    parser.add_argument('--dnn-target', default='cpu', choices=('cpu', 'opencl', 'opencl_fp16'),
+                        help='cv2.dnn 后端的计算目标')
+    parser.add_argument('--letterbox', action='store_true', help='检测输入保持宽高比并填充（需要原生库）')
+    parser.add_argument('--input-sizes', default='416',
+                        help='检测器输入边长，逗号分隔；给出多个（如 320,416,608）时每个尺寸的网络预先建好')
+    parser.add_argument('--adaptive-input', action='store_true',
+                        help='按场景和负载在 --input-sizes 之间切换：空场景或过载时降档，小目标时升档')
+    parser.add_argument('--inference-budget', type=float, default=0.0,
+                        help='自适应输入尺寸的单次检测耗时预算（毫秒），超过时降档；0 为按 --fps 推算')
+    parser.add_argument('--coarse-model', default=None,
+                        help='两遍检测：第一遍找行人/车辆的模型（注册表中的名字），人脸模型只在这些目标周围的原图裁剪上运行')
+    parser.add_argument('--coarse-cfg', default=None, help='不在注册表中的第一遍模型：Darknet cfg')
+    parser.add_argument('--coarse-weights', default=None, help='第一遍模型的权重')
+    parser.add_argument('--coarse-bmodel', default=None, help='第一遍模型在 TPU 上的 bmodel（可用 {size} 占位）')
+    parser.add_argument('--coarse-classes', default=None, help='第一遍模型的类别配置（.json 或 .names）')
+    parser.add_argument('--fine-sizes', default='416',
+                        help='两遍检测时人脸模型的输入边长，逗号分隔；每个裁剪取放得下它的最小尺寸')
+    parser.add_argument('--detect-interval', type=int, default=1,
+                        help='每 N 帧运行一次检测器，中间的帧由跟踪器外推（1 为每帧检测）')
+    parser.add_argument('--detect-adaptive', action='store_true',
+                        help='按画面运动自适应决定检测时机，--detect-interval 作为最小间隔')
+    parser.add_argument('--detect-max-interval', type=int, default=30, help='自适应模式下两次检测的最大间隔')
+    parser.add_argument('--headless', action='store_true',
+                        help='不创建任何 GUI，用于 SE5 等没有显示器的设备；没有 DISPLAY 时自动开启')
+    parser.add_argument('--preview-fps', type=float, default=10.0, help='预览刷新上限（帧/秒）')
+    parser.add_argument('--preview-scale', type=float, default=0.5, help='预览缩放比例，越小转换开销越低')
+    parser.add_argument('--affinity', default=None,
+                        help='原生线程绑核，预设 se5 或 "workers=3-7;rtsp=0;rtmp=0;decode=1;infer=2[;threads=N][;io=N]"'
+                             '（需要原生库）')
+    parser.add_argument('--stats-interval', type=float, default=10.0, help='无界面运行时打印统计的间隔（秒），0 关闭')
+    parser.add_argument('--metrics-port', type=int, default=0,
+                        help='在这个端口提供 Prometheus 的 /metrics（各阶段耗时直方图、帧年龄、队列和帧池），0 关闭')
+    parser.add_argument('--trace', default=None,
+                        help='记录 Chrome trace，退出时写到这个文件（chrome://tracing 或 Perfetto 打开）；'
+                             '同时开了 --metrics-port 时 /trace 返回当前内容')
+    parser.add_argument('--trace-events', type=int, default=200000, help='trace 最多保留的事件数，超过后丢弃最旧的')
+    parser.add_argument('--roi-log', default=None,
+                        help='单路推流时把每次变化的检测框按 pts 写成 JSONL，供 src.python.bench.e2e 计算 ROI 画质')
+    parser.add_argument('--record-detections', default=None,
+                        help='单路模式下把检测（含跟踪外推）结果按帧的 pts 录成二进制索引，供 --replay-detections 使用')
+    parser.add_argument('--replay-detections', default=None,
+                        help='不加载检测器，按帧的 pts 从录好的索引取 ROI 编码；同一份索引可以用不同的 '
+                             '--background-qp / --bitrate 输出多个码流')
+    return parser.parse_args()
+
+
+def start_metrics(args, collect):
+    """按 --trace / --metrics-port 开启打点导出；collect() 返回 {路名: Pipeline}"""
+    from src.python.pipeline import metrics
+
+    if args.trace:
+        metrics.enable_trace(args.trace_events)
+    if args.metrics_port <= 0:
+        return None
+    return metrics.MetricsServer(collect, args.metrics_port).start()
+
+
+def stop_metrics(args, server):
+    from src.python.pipeline import metrics
+
+    if server is not None:
+        server.stop()
+    if metrics.tracer() is not None:
+        metrics.tracer().dump(args.trace)
+
+
+def run_headless(pipeline, stats_interval):
+    """没有 GUI 时在主线程等待流水线（或 StreamManager）结束，SIGINT/SIGTERM 时退出"""
+    stopping = []
+    signal.signal(signal.SIGTERM, lambda *_: stopping.append(True))
+    last = time.monotonic()
+    try:
+        while pipeline.running and not stopping:
+            time.sleep(0.5)
+            if stats_interval > 0 and time.monotonic() - last >= stats_interval:
+                last = time.monotonic()
+                logging.info('pipeline stats: %s', pipeline.stats())
+    except KeyboardInterrupt:
+        pass
+    if pipeline.error:
+        logging.error('pipeline stopped: %s', pipeline.error)
+
+
+def run_preview(pipeline, ai_processor, preview_fps, preview_scale):
+    # tkinter / PIL 只在需要预览时才导入，无界面部署不依赖它们
+    import tkinter as tk
+    from src.python.stream.display import StreamDisplay
+
     root = tk.Tk()
     root.title("AI Enhanced Video Stream")
+    display = StreamDisplay(root, pipeline.preview, ai_processor, max_fps=preview_fps, scale=preview_scale,
+                            timer=pipeline.preview_timer)
+    display.start_stream()
+    try:
+        root.mainloop()
+    finally:
+        display.stop_stream()
+
 
-    # 初始化模块
-    camera_stream = CameraStream(0)
+def run_streams(args, ai_processor, make_encoder, make_streamer, make_detection):
+    """多路模式：StreamManager 按 --streams 管理各路，检测共用一个 BatchInference，始终无界面运行"""
+    from src.python.ai.batching import BatchInference
+    from src.python.pipeline.manager import StreamManager
 
-    # 提供正确的模型权重文件、配置文件和类名文件路径
-    model_weights = 'model/yolov3.weights'
-    model_cfg = 'model/yolov3-face.cfg'
-    class_names = 'model/face.names'
-    ai_processor = Processor(model_weights, model_cfg, class_names)
+    batcher = BatchInference(ai_processor, max_batch=args.max_batch, max_wait_ms=args.batch_wait_ms).start()
+    manager = StreamManager(
+        batcher,
+        encoder_factory=lambda cfg, w, h: make_encoder(w, h, cfg.codec, cfg.fps, cfg.bitrate),
+        streamer_factory=lambda cfg, encoder: make_streamer(cfg.rtmp, encoder, cfg.codec, cfg.fps, cfg.bitrate),
+        detection_factory=lambda cfg: make_detection(cfg.fps, cfg.bitrate))
+    server = start_metrics(args, manager.pipelines)
+    manager.start()
+    try:
+        manager.watch(args.streams)
+        run_headless(manager, args.stats_interval)
+    finally:
+        manager.stop()
+        batcher.stop()
+        stop_metrics(args, server)
+        logging.info('stream stats: %s', manager.stats())
 
-    display = StreamDisplay(root, camera_stream, ai_processor)
+
+def load_detector(args, registry, spec, class_names):
+    """按命令行加载检测器，给了 --coarse-model / --coarse-cfg 时组成两遍检测"""
+    input_sizes = [int(v) for v in args.input_sizes.split(',') if v.strip()]
+    cache = None if args.model_cache == 'off' else ModelCache(args.model_cache)
+    common = dict(backend=args.backend, device_index=args.tpu, dnn_target=args.dnn_target,
+                  letterbox=args.letterbox, cache=cache)
+    if args.coarse_model or args.coarse_cfg:
+        # 两遍检测：--input-sizes 作用于第一遍，人脸模型按 --fine-sizes 在裁剪上运行
+        fine_sizes = [int(v) for v in args.fine_sizes.split(',') if v.strip()]
+        fine = Processor.from_spec(spec, class_names, bmodel=args.bmodel,
+                                   input_sizes=fine_sizes if len(fine_sizes) > 1 else None, **common)
+        coarse_spec = registry.get(args.coarse_model) if args.coarse_model else ModelSpec(
+            'coarse', args.coarse_cfg, args.coarse_weights, args.coarse_bmodel, args.coarse_classes)
+        coarse = Processor.from_spec(coarse_spec, args.coarse_classes, bmodel=args.coarse_bmodel,
+                                     input_sizes=input_sizes if len(input_sizes) > 1 else None, **common)
+        return TwoPassDetector(coarse, fine)
+    return Processor.from_spec(spec, class_names, bmodel=args.bmodel,
+                               input_sizes=input_sizes if len(input_sizes) > 1 else None, **common)
+
+
+def open_replay(path, class_names):
+    """打开 --replay-detections 的索引，返回 (索引, 类别配置)；类别数按录制时的对齐"""
+    try:
+        index = DetectionIndex(path)
+    except (OSError, ValueError) as e:
+        raise SystemExit('--replay-detections: %s' % e)
+    class_config = ClassConfig.load(class_names)
+    if index.class_names and index.class_names != class_config.names[:len(index.class_names)]:
+        logging.warning('%s was recorded with classes %s, replaying with %s', path, index.class_names,
+                        class_config.names)
+    if index.class_names:
+        class_config.fit(len(index.class_names), class_names)
+    logging.info('replaying %d detection updates from %s (%dx%d)', len(index), path, index.width, index.height)
+    return index, class_config
+
+
+def main():
+    args = parse_args()
+    logging.basicConfig(level=logging.INFO, format='%(asctime)s %(levelname)s %(name)s: %(message)s')
+    headless = args.headless or (os.name == 'posix' and not os.environ.get('DISPLAY'))
+    if args.affinity:
+        # 须在打开任何收流 / 解码 / 推流句柄之前配置，各原生线程启动时按角色绑核
+        from src.python.native import lib as native
+        try:
+            native.configure_scheduler(native.parse_affinity(args.affinity))
+        except (RuntimeError, ValueError) as e:
+            raise SystemExit('--affinity: %s' % e)
+
+    if args.streams and (args.record_detections or args.replay_detections):
+        raise SystemExit('--record-detections / --replay-detections only work with a single --source')
+    if args.streams and args.renditions:
+        raise SystemExit('--renditions only works with a single --source')
+    renditions = None
+    if args.renditions:
+        try:
+            renditions = load_renditions(args.renditions)
+        except (OSError, ValueError, TypeError) as e:
+            raise SystemExit('--renditions: %s' % e)
+    if args.replay_detections and not (args.rtmp or renditions):
+        raise SystemExit('--replay-detections needs --rtmp or --renditions')
+    if args.replay_detections and not headless:
+        # 预览的画框依赖检测器，回放时只编码推流
+        logging.info('no preview while replaying detections')
+        headless = True
+
+    # 检测模型从注册表选取，加载前核对 cfg 与权重（或 bmodel）是否匹配
+    registry = ModelRegistry.load(args.models)
+    ai_processor = None
+    replay = None
+    try:
+        spec = registry.get(args.model)
+        class_names = args.classes or (spec.classes if spec.classes and os.path.exists(spec.classes)
+                                       else 'model/face.names')
+        if args.replay_detections:
+            replay, class_config = open_replay(args.replay_detections, class_names)
+        else:
+            ai_processor = load_detector(args, registry, spec, class_names)
+            class_config = ai_processor.class_config
+    except ModelError as e:
+        raise SystemExit('cannot load detector: %s' % e)
+    if ai_processor is not None:
+        if not args.no_warmup:
+            ai_processor.warmup()
+        logging.info('detector %s (%s), inference backend: %s', spec.name, spec.variant, ai_processor.backend.name)
+
+    def make_encoder(width, height, codec, fps, bitrate, roi_qp=None, background_qp=None):
+        from src.python.stream.encoder import RoiEncoder
+
+        smoothing = False if args.no_roi_smoothing else {'hold_updates': args.roi_hold, 'dilate': args.roi_dilate}
+        static = args.static_background and {'qp_delta': args.static_qp, 'static_seconds': args.static_seconds}
+        return RoiEncoder(width, height, codec=codec, fps=fps, bitrate_kbps=bitrate,
+                          roi_qp_delta=args.roi_qp if roi_qp is None else roi_qp,
+                          background_qp_delta=args.background_qp if background_qp is None else background_qp,
+                          smoothing=smoothing, classes=class_config, max_rois=args.max_rois or None, static_background=static)
+
+    def make_streamer(url, encoder, codec, fps, bitrate):
+        from src.python.stream.streamer import RtmpStreamer
+
+        return RtmpStreamer(url, codec=codec, width=encoder.width, height=encoder.height, fps=fps,
+                            bitrate_kbps=bitrate)
+
+    def make_detection(fps, bitrate):
+        """每路各自的检测调度、跟踪、输入尺寸、直通策略和码控（它们都有按路的状态）"""
+        extras = {'inference_depth': args.inference_depth, 'encode_depth': args.encode_depth,
+                  'publish_depth': args.publish_depth}
+        if args.detect_interval > 1 or args.detect_adaptive:
+            extras['scheduler'] = DetectionScheduler(args.detect_interval, adaptive=args.detect_adaptive,
+                                                     min_interval=args.detect_interval,
+                                                     max_interval=args.detect_max_interval)
+            extras['tracker'] = IouTracker()
+        if args.adaptive_input and ai_processor is not None and len(ai_processor.input_sizes) > 1:
+            # 不设预算时按检测间隔内的帧时长推算：检测跟不上时推理队列开始丢帧
+            budget = args.inference_budget or 1000.0 * max(1, args.detect_interval) / fps
+            extras['resolution'] = ResolutionPolicy(ai_processor.input_sizes, budget_ms=budget)
+        if args.passthrough:
+            from src.python.stream.passthrough import PassthroughPolicy
+            extras['passthrough'] = PassthroughPolicy(bitrate, idle_seconds=args.passthrough_idle,
+                                                      classes=class_config)
+        if args.latency_target > 0:
+            extras['rate_control'] = make_rate_control()
+        return extras
+
+    def make_rate_control():
+        from src.python.stream.ratecontrol import RateController
+
+        return RateController(args.latency_target, max_background=args.max_background_qp, classes=class_config)
+
+    def make_renditions(configs):
+        """--renditions 的每一项成为一个 Rendition，没有给出的编码参数取命令行的值；每路有自己的码控"""
+        out = []
+        for cfg in configs:
+            codec = cfg.codec or args.codec
+            bitrate = cfg.bitrate or args.bitrate
+
+            def encoder_factory(width, height, cfg=cfg, codec=codec, bitrate=bitrate):
+                return make_encoder(width, height, codec, args.fps, bitrate, cfg.roi_qp, cfg.background_qp)
+
+            def streamer_factory(encoder, cfg=cfg, codec=codec, bitrate=bitrate):
+                return make_streamer(cfg.rtmp, encoder, codec, args.fps, bitrate)
+
+            out.append(Rendition(cfg.name, encoder_factory, streamer_factory,
+                                 size=cfg.size_for if cfg.width or cfg.height else None,
+                                 rate_control=make_rate_control() if args.latency_target > 0 else None))
+        return out
+
+    if args.streams:
+        run_streams(args, ai_processor, make_encoder, make_streamer, make_detection)
+        return
+
+    encoder_factory = None
+    streamer_factory = None
+    if renditions is None and args.rtmp:
+        def encoder_factory(width, height):
+            return make_encoder(width, height, args.codec, args.fps, args.bitrate)
+
+        def streamer_factory(encoder):
+            return make_streamer(args.rtmp, encoder, args.codec, args.fps, args.bitrate)
+
+    roi_log = open(args.roi_log, 'w', buffering=1) if args.roi_log else None
+    recorder = DetectionRecorder(args.record_detections, class_config.names) if args.record_detections else None
+    detection = make_detection(args.fps, renditions[0].bitrate or args.bitrate if renditions else args.bitrate)
+    if renditions is not None:
+        detection.pop('rate_control', None)
+        detection['renditions'] = make_renditions(renditions)
+    pipeline = Pipeline(open_source(args.source), ai_processor, encoder_factory, streamer_factory,
+                        preview=not headless, roi_log=roi_log, record_detections=recorder,
+                        replay_detections=replay, **detection)
 
     # 开始视频流处理
-    display.start_stream()
-    root.mainloop()
+    server = start_metrics(args, lambda: {pipeline.name: pipeline})
+    pipeline.start()
+    try:
+        if headless:
+            run_headless(pipeline, args.stats_interval)
+        else:
+            run_preview(pipeline, ai_processor, args.preview_fps, args.preview_scale)
+    finally:
+        pipeline.stop()
+        stop_metrics(args, server)
+        if roi_log is not None:
+            roi_log.close()
+        if recorder is not None:
+            recorder.close()
+        logging.info('pipeline stats: %s', pipeline.stats())
 
 
 if __name__ == "__main__":
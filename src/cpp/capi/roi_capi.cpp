@@ -0,0 +1,698 @@
+#include "roi_capi.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../common/io_loop.h"
+#include "../common/scheduler.h"
+#include "../decode/decode_session.h"
+#include "../decode/surface_scaler.h"
+#include "../encode/activity_map.h"
+#include "../encode/qp_map.h"
+#include "../encode/roi_encoder.h"
+#include "../encode/roi_smoother.h"
+#include "../infer/preprocess.h"
+#include "../infer/yolo_decode.h"
+#include "../rtmp/passthrough.h"
+#include "../rtmp/rtmp_streamer.h"
+#include "../rtsp/rtsp_client.h"
+
+namespace {
+
+thread_local std::string g_last_error;
+
+void set_error(const std::string& msg) { g_last_error = msg; }
+
+}  // namespace
+
+struct roi_rtsp {
+    explicit roi_rtsp(roi::RtspConfig cfg) : client(std::move(cfg)) {}
+    roi::RtspClient client;
+    std::string error;  // roi_rtsp_error 返回值的存放处
+};
+
+struct roi_decoder {
+    roi_decoder(roi::AuRing* ring, roi::DecodeSessionConfig cfg) : session(ring, cfg) {}
+    roi::DecodeSession session;
+};
+
+struct roi_scaler {
+    roi_scaler(int width, int height, int pool_frames) : scaler(width, height, pool_frames) {}
+    std::mutex mutex;  // 多个编码线程共用一个输出尺寸时串行缩放
+    roi::SurfaceScaler scaler;
+};
+
+struct roi_encoder {
+    std::unique_ptr<roi::RoiEncoder> encoder;
+    std::unique_ptr<roi::QpMap> map;
+    std::unique_ptr<roi::RoiSmoother> smoother;
+    std::unique_ptr<roi::ActivityMap> activity;
+    int static_qp_delta = 0;
+    std::vector<roi::RoiBox> boxes;
+};
+
+struct roi_rtmp {
+    explicit roi_rtmp(roi::RtmpConfig cfg) : streamer(std::move(cfg)) {}
+    roi::RtmpStreamer streamer;
+    std::string error;
+};
+
+struct roi_passthrough {
+    roi_passthrough(roi_rtsp* r, roi_rtmp* m, roi::PassthroughConfig cfg)
+        : rtmp(m), pass(&r->client.ring(), &m->streamer, cfg) {}
+    roi_rtmp* rtmp;
+    roi::Passthrough pass;
+};
+
+struct roi_preprocess {
+    explicit roi_preprocess(roi::PreprocessConfig cfg) : pre(cfg) {}
+    roi::Preprocessor pre;
+};
+
+namespace {
+
+int encode_input(roi_encoder_t* enc, const roi::EncoderInput& in) {
+    if (enc->activity && in.plane[0] && enc->activity->update(in.plane[0], in.pitch[0])) {
+        enc->map->set_static(enc->activity->mask(), enc->static_qp_delta);
+    }
+    if (!enc->encoder->encode(in, *enc->map)) {
+        set_error(std::string(enc->encoder->name()) + ": encode failed");
+        return -1;
+    }
+    return 1;
+}
+
+void to_c(const roi::LetterboxInfo& info, roi_letterbox_t* out) {
+    if (out) *out = roi_letterbox_t{info.scale_x, info.scale_y, info.pad_x, info.pad_y};
+}
+
+void to_c(const roi::PoolStats& st, roi_pool_stats_t* out) {
+    *out = roi_pool_stats_t{st.capacity, st.in_use, st.high_water, 0, st.acquired, st.misses};
+}
+
+void to_c(roi::SurfacePtr s, roi_surface_t* out) {
+    out->width = s->width;
+    out->height = s->height;
+    out->pts = s->pts;
+    out->seq = s->seq;
+    out->memory = static_cast<int32_t>(s->memory);
+    out->device_index = s->device_index;
+    out->y = s->data[0];
+    out->uv = s->data[1];
+    out->pitch_y = s->pitch[0];
+    out->pitch_uv = s->pitch[1];
+    out->device_y = s->device[0];
+    out->device_uv = s->device[1];
+    out->arrival_us = s->arrival_us;
+    out->handle = new roi::SurfacePtr(std::move(s));
+}
+
+bool valid_slot(roi_preprocess_t* pp, int slot) {
+    if (slot >= 0 && slot < pp->pre.config().batch) return true;
+    set_error("preprocess slot out of range");
+    return false;
+}
+
+bool parse_cpus(const char* text, roi::CpuSet* out) {
+    std::string err;
+    if (roi::CpuSet::parse(text ? text : "", out, &err)) return true;
+    set_error(err);
+    return false;
+}
+
+}  // namespace
+
+extern "C" {
+
+const char* roi_last_error(void) { return g_last_error.c_str(); }
+
+// ---------------- RTSP 收流 ----------------
+
+roi_rtsp_t* roi_rtsp_open(const char* url, int transport, int timeout_ms, uint64_t ring_bytes) {
+    if (!url) {
+        set_error("url is null");
+        return nullptr;
+    }
+    roi::RtspConfig cfg;
+    cfg.url = url;
+    cfg.transport = transport == ROI_TRANSPORT_UDP ? roi::RtspTransport::kUdp : roi::RtspTransport::kTcp;
+    if (timeout_ms > 0) cfg.timeout_ms = timeout_ms;
+    if (ring_bytes > 0) cfg.ring_bytes = static_cast<size_t>(ring_bytes);
+
+    auto* h = new roi_rtsp(std::move(cfg));
+    if (!h->client.start()) {
+        set_error(h->client.last_error());
+        delete h;
+        return nullptr;
+    }
+    return h;
+}
+
+void roi_rtsp_close(roi_rtsp_t* rtsp) { delete rtsp; }
+
+int roi_rtsp_state(roi_rtsp_t* rtsp) { return static_cast<int>(rtsp->client.state()); }
+
+const char* roi_rtsp_error(roi_rtsp_t* rtsp) {
+    rtsp->error = rtsp->client.last_error();
+    return rtsp->error.c_str();
+}
+
+int roi_rtsp_codec(roi_rtsp_t* rtsp) { return static_cast<int>(rtsp->client.codec()); }
+
+int roi_rtsp_add_consumer(roi_rtsp_t* rtsp) {
+    const int id = rtsp->client.ring().add_consumer();
+    if (id < 0) set_error("too many consumers on rtsp ring");
+    return id;
+}
+
+void roi_rtsp_remove_consumer(roi_rtsp_t* rtsp, int consumer) { rtsp->client.ring().remove_consumer(consumer); }
+
+int roi_rtsp_read(roi_rtsp_t* rtsp, int consumer, roi_au_t* out, int timeout_ms) {
+    roi::AccessUnitView v;
+    if (!rtsp->client.ring().wait(consumer, &v, std::chrono::milliseconds(timeout_ms))) {
+        if (rtsp->client.state() == roi::RtspClient::State::kError) {
+            set_error(rtsp->client.last_error());
+            return -1;
+        }
+        return 0;
+    }
+    out->data = v.data;
+    out->size = v.size;
+    out->flags = v.flags;
+    out->pts = v.pts;
+    out->seq = v.seq;
+    out->codec = static_cast<int32_t>(v.codec);
+    out->arrival_us = v.arrival_us;
+    return 1;
+}
+
+void roi_rtsp_release(roi_rtsp_t* rtsp, int consumer) { rtsp->client.ring().release(consumer); }
+
+void roi_rtsp_get_stats(roi_rtsp_t* rtsp, roi_rtsp_stats_t* out) {
+    const roi::RtspStats st = rtsp->client.stats();
+    out->packets = st.packets;
+    out->lost = st.lost;
+    out->bytes = st.bytes;
+    out->au_committed = st.ring.committed;
+    out->au_dropped = st.ring.dropped;
+    out->ring_slots_used = st.ring.slots_used;
+    out->reads = st.reads;
+}
+
+// ---------------- 解码 ----------------
+
+roi_decoder_t* roi_decoder_open(roi_rtsp_t* rtsp, int backend, int device_index, int keep_on_device,
+                                int queue_depth) {
+    roi::DecodeSessionConfig cfg;
+    cfg.decoder.codec = rtsp->client.codec();
+    cfg.decoder.backend = static_cast<roi::DecoderBackend>(backend);
+    cfg.decoder.device_index = device_index;
+    cfg.decoder.keep_on_device = keep_on_device != 0;
+    if (queue_depth > 0) cfg.queue_depth = static_cast<size_t>(queue_depth);
+
+    auto* h = new roi_decoder(&rtsp->client.ring(), cfg);
+    std::string err;
+    if (!h->session.start(&err)) {
+        set_error(err);
+        delete h;
+        return nullptr;
+    }
+    return h;
+}
+
+void roi_decoder_close(roi_decoder_t* dec) { delete dec; }
+
+const char* roi_decoder_backend(roi_decoder_t* dec) { return dec->session.backend_name(); }
+
+int roi_decoder_read(roi_decoder_t* dec, roi_surface_t* out, int timeout_ms) {
+    roi::SurfacePtr s;
+    if (!dec->session.read(&s, std::chrono::milliseconds(timeout_ms))) return 0;
+    to_c(std::move(s), out);
+    return 1;
+}
+
+void roi_decoder_get_stats(roi_decoder_t* dec, roi_decoder_stats_t* out) {
+    const roi::DecodeStats st = dec->session.stats();
+    out->decoded = st.decoded;
+    out->dropped = st.dropped;
+    out->errors = st.errors;
+    out->queued = st.queued;
+}
+
+void roi_decoder_get_pool_stats(roi_decoder_t* dec, roi_pool_stats_t* out) { to_c(dec->session.stats().pool, out); }
+
+void roi_surface_release(void* handle) { delete static_cast<roi::SurfacePtr*>(handle); }
+
+void* roi_surface_retain(void* handle) { return new roi::SurfacePtr(*static_cast<roi::SurfacePtr*>(handle)); }
+
+// ---------------- 缩放 ----------------
+
+roi_scaler_t* roi_scaler_open(int width, int height, int pool_frames) {
+    if (width < 2 || height < 2) {
+        set_error("invalid scaler size");
+        return nullptr;
+    }
+    return new roi_scaler(width, height, pool_frames);
+}
+
+void roi_scaler_close(roi_scaler_t* sc) { delete sc; }
+
+int roi_scaler_scale(roi_scaler_t* sc, void* surface_handle, roi_surface_t* out) {
+    const roi::SurfacePtr& src = *static_cast<roi::SurfacePtr*>(surface_handle);
+    roi::SurfacePtr scaled;
+    std::string err;
+    {
+        std::lock_guard<std::mutex> lk(sc->mutex);
+        if (!sc->scaler.scale(*src, &scaled, &err)) {
+            set_error(err);
+            return -1;
+        }
+    }
+    to_c(std::move(scaled), out);
+    return 1;
+}
+
+void roi_scaler_get_pool_stats(roi_scaler_t* sc, roi_pool_stats_t* out) { to_c(sc->scaler.pool_stats(), out); }
+
+// ---------------- ROI 编码 ----------------
+
+roi_encoder_t* roi_encoder_open(const roi_encoder_config_t* c) {
+    roi::EncoderConfig cfg;
+    cfg.codec = c->codec == ROI_CODEC_H265 ? roi::Codec::kH265 : roi::Codec::kH264;
+    cfg.backend = static_cast<roi::EncoderBackend>(c->backend);
+    cfg.width = c->width;
+    cfg.height = c->height;
+    if (c->fps > 0) cfg.fps = c->fps;
+    if (c->bitrate_kbps > 0) cfg.bitrate_kbps = c->bitrate_kbps;
+    if (c->gop > 0) cfg.gop = c->gop;
+    cfg.device_index = c->device_index;
+    cfg.roi_qp_delta = c->roi_qp_delta;
+    cfg.background_qp_delta = c->background_qp_delta;
+    if (c->base_qp > 0) cfg.base_qp = c->base_qp;
+
+    std::string err;
+    auto encoder = roi::RoiEncoder::create(cfg, &err);
+    if (!encoder) {
+        set_error(err);
+        return nullptr;
+    }
+    auto* h = new roi_encoder();
+    h->map.reset(new roi::QpMap(cfg.width, cfg.height, encoder->block_size(), cfg.background_qp_delta));
+    h->encoder = std::move(encoder);
+    return h;
+}
+
+void roi_encoder_close(roi_encoder_t* enc) { delete enc; }
+
+const char* roi_encoder_backend(roi_encoder_t* enc) { return enc->encoder->name(); }
+
+int roi_encoder_block_size(roi_encoder_t* enc) { return enc->map->block_size(); }
+
+int roi_encoder_set_rois(roi_encoder_t* enc, const roi_box_t* boxes, int count) {
+    enc->boxes.resize(size_t(count > 0 ? count : 0));
+    for (int i = 0; i < count; ++i) {
+        enc->boxes[i] = roi::RoiBox{boxes[i].x, boxes[i].y, boxes[i].w, boxes[i].h, boxes[i].qp_delta};
+    }
+    if (enc->smoother) {
+        const std::vector<roi::RoiBox>& stable = enc->smoother->update(enc->boxes.data(), count);
+        return enc->map->update(stable.data(), static_cast<int>(stable.size()));
+    }
+    return enc->map->update(enc->boxes.data(), count);
+}
+
+int roi_encoder_set_smoothing(roi_encoder_t* enc, const roi_smoothing_t* c) {
+    if (!c) {
+        enc->smoother.reset();
+        return 1;
+    }
+    roi::RoiSmootherConfig cfg;
+    cfg.alpha = c->alpha;
+    cfg.dilate = c->dilate;
+    cfg.pad_pixels = c->pad_pixels;
+    cfg.hold_updates = c->hold_updates;
+    cfg.match_iou = c->match_iou;
+    cfg.shrink_margin = c->shrink_margin;
+    const roi::EncoderConfig& ec = enc->encoder->config();
+    enc->smoother.reset(new roi::RoiSmoother(ec.width, ec.height, enc->map->block_size(), cfg));
+    return 1;
+}
+
+int roi_encoder_set_static(roi_encoder_t* enc, const roi_static_config_t* c) {
+    if (!c) {
+        enc->activity.reset();
+        enc->map->set_static(nullptr, 0);
+        return 1;
+    }
+    roi::ActivityConfig cfg;
+    cfg.threshold = c->threshold;
+    cfg.static_frames = c->static_frames;
+    cfg.sample_step = c->sample_step;
+    const roi::EncoderConfig& ec = enc->encoder->config();
+    enc->activity.reset(new roi::ActivityMap(ec.width, ec.height, enc->map->block_size(), cfg));
+    enc->static_qp_delta = c->qp_delta;
+    enc->map->set_static(nullptr, 0);
+    return 1;
+}
+
+int roi_encoder_static_blocks(roi_encoder_t* enc) { return enc->map->static_blocks(); }
+
+int roi_encoder_set_qp_offsets(roi_encoder_t* enc, int background_qp_delta, int roi_qp_bias) {
+    // 先改背景，ROI 的上限按新的背景偏移计算
+    enc->map->set_background(background_qp_delta);
+    enc->map->set_roi_bias(roi_qp_bias);
+    return 1;
+}
+
+const int8_t* roi_encoder_qp_map(roi_encoder_t* enc, int* cols, int* rows) {
+    *cols = enc->map->cols();
+    *rows = enc->map->rows();
+    return enc->map->data();
+}
+
+int roi_encoder_encode_surface(roi_encoder_t* enc, void* surface_handle, int force_key) {
+    const roi::SurfacePtr& s = *static_cast<roi::SurfacePtr*>(surface_handle);
+    roi::EncoderInput in = roi::EncoderInput::from_surface(*s);
+    in.force_key = force_key != 0;
+    return encode_input(enc, in);
+}
+
+int roi_encoder_encode_nv12(roi_encoder_t* enc, const uint8_t* y, const uint8_t* uv, int pitch_y, int pitch_uv,
+                            int64_t pts, int force_key) {
+    roi::EncoderInput in;
+    in.format = roi::EncoderInput::Format::kNV12;
+    in.plane[0] = y;
+    in.plane[1] = uv;
+    in.pitch[0] = pitch_y;
+    in.pitch[1] = pitch_uv;
+    in.pts = pts;
+    in.force_key = force_key != 0;
+    return encode_input(enc, in);
+}
+
+int roi_encoder_encode_i420(roi_encoder_t* enc, const uint8_t* y, const uint8_t* u, const uint8_t* v, int pitch_y,
+                            int pitch_uv, int64_t pts, int force_key) {
+    roi::EncoderInput in;
+    in.format = roi::EncoderInput::Format::kI420;
+    in.plane[0] = y;
+    in.plane[1] = u;
+    in.plane[2] = v;
+    in.pitch[0] = pitch_y;
+    in.pitch[1] = in.pitch[2] = pitch_uv;
+    in.pts = pts;
+    in.force_key = force_key != 0;
+    return encode_input(enc, in);
+}
+
+int roi_encoder_receive(roi_encoder_t* enc, roi_packet_t* out) {
+    roi::EncodedPacket pkt;
+    if (!enc->encoder->receive(&pkt)) return 0;
+    out->data = pkt.data;
+    out->size = pkt.size;
+    out->pts = pkt.pts;
+    out->dts = pkt.dts;
+    out->key = pkt.key ? 1 : 0;
+    out->reference = pkt.reference ? 1 : 0;
+    out->codec = static_cast<int32_t>(pkt.codec);
+    out->handle = new roi::EncodedPacket(std::move(pkt));
+    return 1;
+}
+
+void roi_encoder_get_pool_stats(roi_encoder_t* enc, roi_pool_stats_t* out) { to_c(enc->encoder->pool_stats(), out); }
+
+void roi_packet_release(void* handle) { delete static_cast<roi::EncodedPacket*>(handle); }
+
+// ---------------- RTMP 推流 ----------------
+
+roi_rtmp_t* roi_rtmp_open(const roi_rtmp_config_t* c) {
+    if (!c || !c->url) {
+        set_error("url is null");
+        return nullptr;
+    }
+    roi::RtmpConfig cfg;
+    cfg.url = c->url;
+    cfg.codec = c->codec == ROI_CODEC_H265 ? roi::Codec::kH265 : roi::Codec::kH264;
+    cfg.hevc_mode = c->hevc_mode == ROI_HEVC_FLV_LEGACY ? roi::HevcFlvMode::kLegacy : roi::HevcFlvMode::kEnhanced;
+    if (c->timeout_ms > 0) cfg.timeout_ms = c->timeout_ms;
+    if (c->queue_bytes > 0) cfg.queue_bytes = static_cast<size_t>(c->queue_bytes);
+    if (c->queue_packets > 0) cfg.queue_packets = static_cast<size_t>(c->queue_packets);
+    if (c->chunk_size > 0) cfg.chunk_size = c->chunk_size;
+    cfg.width = c->width;
+    cfg.height = c->height;
+    cfg.fps = c->fps;
+    cfg.bitrate_kbps = c->bitrate_kbps;
+
+    auto* h = new roi_rtmp(std::move(cfg));
+    if (!h->streamer.start()) {
+        set_error(h->streamer.last_error());
+        delete h;
+        return nullptr;
+    }
+    return h;
+}
+
+void roi_rtmp_close(roi_rtmp_t* rtmp) { delete rtmp; }
+
+int roi_rtmp_state(roi_rtmp_t* rtmp) { return static_cast<int>(rtmp->streamer.state()); }
+
+const char* roi_rtmp_error(roi_rtmp_t* rtmp) {
+    rtmp->error = rtmp->streamer.last_error();
+    return rtmp->error.c_str();
+}
+
+void roi_rtmp_attach_encoder(roi_rtmp_t* rtmp, roi_encoder_t* enc) {
+    if (!enc) {
+        rtmp->streamer.set_key_frame_callback(nullptr);
+        return;
+    }
+    roi::RoiEncoder* encoder = enc->encoder.get();
+    rtmp->streamer.set_key_frame_callback([encoder] { encoder->request_key_frame(); });
+}
+
+int roi_rtmp_send_packet(roi_rtmp_t* rtmp, void* packet_handle) {
+    if (rtmp->streamer.state() != roi::RtmpStreamer::State::kPublishing) {
+        set_error(rtmp->streamer.last_error());
+        return -1;
+    }
+    return rtmp->streamer.send(*static_cast<roi::EncodedPacket*>(packet_handle)) ? 1 : 0;
+}
+
+int roi_rtmp_send_from_encoder(roi_rtmp_t* rtmp, roi_encoder_t* enc) {
+    if (rtmp->streamer.state() != roi::RtmpStreamer::State::kPublishing) {
+        set_error(rtmp->streamer.last_error());
+        return -1;
+    }
+    int queued = 0;
+    roi::EncodedPacket pkt;
+    while (enc->encoder->receive(&pkt)) {
+        if (rtmp->streamer.send(pkt)) ++queued;
+    }
+    return queued;
+}
+
+void roi_rtmp_get_stats(roi_rtmp_t* rtmp, roi_rtmp_stats_t* out) {
+    const roi::RtmpStats st = rtmp->streamer.stats();
+    out->sent_frames = st.sent_frames;
+    out->sent_bytes = st.sent_bytes;
+    out->acked_bytes = st.acked_bytes;
+    out->dropped_nonref = st.dropped_nonref;
+    out->dropped_ref = st.dropped_ref;
+    out->queued_frames = st.queued_frames;
+    out->queued_bytes = st.queued_bytes;
+    out->socket_bytes = st.socket_bytes;
+    out->queued_ms = st.queued_ms;
+    out->rtt_us = st.rtt_us;
+    out->ack_delay_ms = st.ack_delay_ms;
+    out->reserved = 0;
+}
+
+// ---------------- 直通转封装 ----------------
+
+roi_passthrough_t* roi_passthrough_open(roi_rtsp_t* rtsp, roi_rtmp_t* rtmp) {
+    if (!rtsp || !rtmp) {
+        set_error("rtsp and rtmp handles are required");
+        return nullptr;
+    }
+    roi::PassthroughConfig cfg;
+    cfg.codec = rtmp->streamer.config().codec;
+    auto* h = new roi_passthrough(rtsp, rtmp, cfg);
+    std::string err;
+    if (!h->pass.start(&err)) {
+        set_error(err);
+        delete h;
+        return nullptr;
+    }
+    return h;
+}
+
+void roi_passthrough_close(roi_passthrough_t* pt) { delete pt; }
+
+void roi_passthrough_set_mode(roi_passthrough_t* pt, int mode) {
+    pt->pass.set_mode(mode == ROI_MODE_PASSTHROUGH ? roi::Passthrough::Mode::kPassthrough
+                                                   : roi::Passthrough::Mode::kEncode);
+}
+
+int roi_passthrough_active(roi_passthrough_t* pt) { return static_cast<int>(pt->pass.active()); }
+
+int64_t roi_passthrough_last_dts(roi_passthrough_t* pt) { return pt->pass.last_dts(); }
+
+int roi_passthrough_send_packet(roi_passthrough_t* pt, void* packet_handle) {
+    if (pt->rtmp->streamer.state() != roi::RtmpStreamer::State::kPublishing) {
+        set_error(pt->rtmp->streamer.last_error());
+        return -1;
+    }
+    return pt->pass.send_encoded(*static_cast<roi::EncodedPacket*>(packet_handle)) ? 1 : 0;
+}
+
+void roi_passthrough_get_stats(roi_passthrough_t* pt, roi_passthrough_stats_t* out) {
+    const roi::PassthroughStats st = pt->pass.stats();
+    *out = roi_passthrough_stats_t{st.forwarded_frames, st.forwarded_bytes, st.encoded_frames, st.skipped_source,
+                                   st.skipped_encoded, st.switches, st.codec_mismatch, st.source_kbps};
+}
+
+// ---------------- 检测后处理 ----------------
+
+int roi_yolo_decode(const roi_yolo_head_t* heads, int num_heads, int width, int height, float conf_threshold,
+                    float nms_threshold, int per_class, roi_detection_t* out, int max_out) {
+    thread_local std::vector<roi::YoloHead> views;
+    thread_local std::vector<roi::Detection> dets;
+    views.resize(size_t(num_heads > 0 ? num_heads : 0));
+    for (int i = 0; i < num_heads; ++i) views[i] = roi::YoloHead{heads[i].data, heads[i].rows, heads[i].stride};
+    roi::YoloDecodeParams params;
+    params.width = width;
+    params.height = height;
+    params.conf_threshold = conf_threshold;
+    params.nms_threshold = nms_threshold;
+    params.per_class = per_class != 0;
+    roi::yolo_decode(views.data(), num_heads, params, &dets);
+    const int n = std::min(int(dets.size()), max_out);
+    for (int i = 0; i < n; ++i) {
+        const roi::Detection& d = dets[i];
+        out[i] = roi_detection_t{d.x, d.y, d.w, d.h, d.confidence, d.class_id};
+    }
+    return int(dets.size());
+}
+
+// ---------------- 检测预处理 ----------------
+
+roi_preprocess_t* roi_preprocess_open(const roi_preprocess_config_t* config) {
+    roi::PreprocessConfig cfg;
+    cfg.width = config->width;
+    cfg.height = config->height;
+    cfg.batch = config->batch;
+    cfg.letterbox = config->letterbox != 0;
+    cfg.pad_value = uint8_t(std::max(0, std::min(255, int(config->pad_value))));
+    cfg.int8 = config->int8 != 0;
+    if (config->int8_scale > 0) cfg.int8_scale = config->int8_scale;
+    if (cfg.width <= 0 || cfg.height <= 0) {
+        set_error("invalid preprocess size");
+        return nullptr;
+    }
+    return new roi_preprocess(cfg);
+}
+
+void roi_preprocess_close(roi_preprocess_t* pp) { delete pp; }
+
+const void* roi_preprocess_tensor(roi_preprocess_t* pp, uint64_t* bytes) {
+    if (bytes) *bytes = pp->pre.bytes();
+    return pp->pre.data();
+}
+
+int roi_preprocess_nv12(roi_preprocess_t* pp, int slot, const uint8_t* y, const uint8_t* uv, int width, int height,
+                        int pitch_y, int pitch_uv, roi_letterbox_t* out) {
+    if (!valid_slot(pp, slot)) return -1;
+    to_c(pp->pre.run_nv12(slot, y, uv, width, height, pitch_y, pitch_uv), out);
+    return 1;
+}
+
+int roi_preprocess_bgr(roi_preprocess_t* pp, int slot, const uint8_t* bgr, int width, int height, int pitch,
+                       roi_letterbox_t* out) {
+    if (!valid_slot(pp, slot)) return -1;
+    to_c(pp->pre.run_bgr(slot, bgr, width, height, pitch), out);
+    return 1;
+}
+
+int roi_preprocess_surface(roi_preprocess_t* pp, int slot, void* surface_handle, roi_letterbox_t* out) {
+    if (!valid_slot(pp, slot)) return -1;
+    const roi::SurfacePtr& s = *static_cast<roi::SurfacePtr*>(surface_handle);
+    roi::LetterboxInfo info;
+    if (!pp->pre.run_surface(slot, *s, &info)) {
+        set_error("surface has no host mapping, open the decoder with keep_on_device=0");
+        return -1;
+    }
+    to_c(info, out);
+    return 1;
+}
+
+int roi_preprocess_surface_crop(roi_preprocess_t* pp, int slot, void* surface_handle, int x, int y, int width,
+                                int height, roi_letterbox_t* out) {
+    if (!valid_slot(pp, slot)) return -1;
+    const roi::SurfacePtr& s = *static_cast<roi::SurfacePtr*>(surface_handle);
+    if (!s->has_host()) {
+        set_error("surface has no host mapping, open the decoder with keep_on_device=0");
+        return -1;
+    }
+    roi::LetterboxInfo info;
+    if (!pp->pre.run_surface(slot, *s, x, y, width, height, &info)) {
+        set_error("crop is outside the frame or not 2-pixel aligned");
+        return -1;
+    }
+    to_c(info, out);
+    return 1;
+}
+
+// ---------------- 线程布局 ----------------
+
+int roi_scheduler_configure(const roi_scheduler_config_t* config) {
+    if (!config) {
+        set_error("config is null");
+        return -1;
+    }
+    roi::SchedulerConfig cfg;
+    cfg.workers = std::max(0, config->workers);
+    cfg.io_threads = std::max(1, config->io_threads);
+    auto cpus = [&cfg](roi::ThreadRole role) { return &cfg.cpus[static_cast<int>(role)]; };
+    if (!parse_cpus(config->worker_cpus, cpus(roi::ThreadRole::kWorker)) ||
+        !parse_cpus(config->rtsp_cpus, cpus(roi::ThreadRole::kRtsp)) ||
+        !parse_cpus(config->decode_cpus, cpus(roi::ThreadRole::kDecode)) ||
+        !parse_cpus(config->infer_cpus, cpus(roi::ThreadRole::kInfer)) ||
+        !parse_cpus(config->rtmp_cpus, cpus(roi::ThreadRole::kRtmp))) {
+        return -1;
+    }
+    std::string err;
+    if (!roi::Scheduler::instance().configure(cfg, &err)) {
+        set_error(err);
+        return -1;
+    }
+    return 1;
+}
+
+int roi_scheduler_enter(int role, const char* name) {
+    if (role < 0 || role >= static_cast<int>(roi::ThreadRole::kWorker)) {
+        set_error("unknown thread role");
+        return -1;
+    }
+    const roi::SchedulerConfig cfg = roi::Scheduler::instance().config();
+    std::string err;
+    if (!roi::pin_current_thread(cfg.cpus[role], name, &err)) {
+        set_error(err);
+        return -1;
+    }
+    return 1;
+}
+
+int roi_scheduler_get_stats(roi_scheduler_stats_t* out) {
+    if (!out) {
+        set_error("out is null");
+        return -1;
+    }
+    const std::shared_ptr<roi::WorkerPool> pool = roi::Scheduler::instance().pool();
+    const roi::WorkerPoolStats st = pool ? pool->stats() : roi::WorkerPoolStats{};
+    *out = roi_scheduler_stats_t{st.threads, roi::IoLoop::started(), st.executed, st.stolen, st.parked};
+    return 1;
+}
+
+}  // extern "C"
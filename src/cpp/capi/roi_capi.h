@@ -0,0 +1,383 @@
+#pragma once
+
+// Python（ctypes）调用的 C 接口。所有句柄都是不透明指针，
+// 返回值约定：1 成功 / 0 超时或暂无数据 / -1 出错，出错信息用 roi_last_error() 取。
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ROI_API __attribute__((visibility("default")))
+
+// 最近一次失败调用的错误信息（线程局部）
+ROI_API const char* roi_last_error(void);
+
+// 解码帧池、编码包池的占用，in_use 长期接近 capacity 说明下游在积压
+typedef struct roi_pool_stats {
+    uint32_t capacity;
+    uint32_t in_use;
+    uint32_t high_water;
+    uint32_t reserved;
+    uint64_t acquired;
+    uint64_t misses;  // 池空或超过块大小而退回堆分配的次数
+} roi_pool_stats_t;
+
+// ---------------- RTSP 收流 ----------------
+
+typedef struct roi_rtsp roi_rtsp_t;
+
+typedef struct roi_au {
+    const uint8_t* data;  // 指向环形缓冲区内部，release 之前有效
+    uint32_t size;
+    uint32_t flags;       // ROI_AU_* 标志
+    int64_t pts;          // 90kHz
+    uint64_t seq;
+    int32_t codec;        // ROI_CODEC_*
+    int64_t arrival_us;   // 收齐的时刻，CLOCK_MONOTONIC 微秒
+} roi_au_t;
+
+typedef struct roi_rtsp_stats {
+    uint64_t packets;
+    uint64_t lost;
+    uint64_t bytes;
+    uint64_t au_committed;
+    uint64_t au_dropped;
+    uint32_t ring_slots_used;
+    uint64_t reads;  // recv / recvmmsg 调用次数
+} roi_rtsp_stats_t;
+
+enum { ROI_CODEC_UNKNOWN = 0, ROI_CODEC_H264 = 1, ROI_CODEC_H265 = 2 };
+enum { ROI_AU_KEY = 1, ROI_AU_DISCONTINUITY = 2, ROI_AU_PARAM_SETS = 4 };
+enum { ROI_TRANSPORT_TCP = 0, ROI_TRANSPORT_UDP = 1 };
+
+// 完成握手并开始收流，失败返回 NULL
+ROI_API roi_rtsp_t* roi_rtsp_open(const char* url, int transport, int timeout_ms, uint64_t ring_bytes);
+ROI_API void roi_rtsp_close(roi_rtsp_t* rtsp);
+// 0 空闲 / 1 播放中 / 2 出错 / 3 已停止
+ROI_API int roi_rtsp_state(roi_rtsp_t* rtsp);
+ROI_API const char* roi_rtsp_error(roi_rtsp_t* rtsp);
+ROI_API int roi_rtsp_codec(roi_rtsp_t* rtsp);
+ROI_API int roi_rtsp_add_consumer(roi_rtsp_t* rtsp);
+ROI_API void roi_rtsp_remove_consumer(roi_rtsp_t* rtsp, int consumer);
+ROI_API int roi_rtsp_read(roi_rtsp_t* rtsp, int consumer, roi_au_t* out, int timeout_ms);
+ROI_API void roi_rtsp_release(roi_rtsp_t* rtsp, int consumer);
+ROI_API void roi_rtsp_get_stats(roi_rtsp_t* rtsp, roi_rtsp_stats_t* out);
+
+// ---------------- 解码 ----------------
+
+typedef struct roi_decoder roi_decoder_t;
+
+typedef struct roi_surface {
+    int32_t width;
+    int32_t height;
+    int64_t pts;
+    uint64_t seq;
+    int32_t memory;      // ROI_MEMORY_*
+    int32_t device_index;
+    const uint8_t* y;    // 主机地址，仅设备内存且 zero-copy 时为 NULL
+    const uint8_t* uv;
+    int32_t pitch_y;
+    int32_t pitch_uv;
+    uint64_t device_y;   // 设备物理地址
+    uint64_t device_uv;
+    void* handle;        // 用 roi_surface_release 归还
+    int64_t arrival_us;  // 来源 AU 收齐的时刻，CLOCK_MONOTONIC 微秒（与 Python 的 time.perf_counter 同一时钟）
+} roi_surface_t;
+
+typedef struct roi_decoder_stats {
+    uint64_t decoded;
+    uint64_t dropped;
+    uint64_t errors;
+    uint32_t queued;
+} roi_decoder_stats_t;
+
+enum { ROI_DECODER_AUTO = 0, ROI_DECODER_SOPHON = 1, ROI_DECODER_SOFTWARE = 2 };
+enum { ROI_MEMORY_HOST = 0, ROI_MEMORY_DEVICE = 1 };
+
+// 从 rtsp 的环形缓冲区取 AU 解码，rtsp 必须比解码器活得更久
+ROI_API roi_decoder_t* roi_decoder_open(roi_rtsp_t* rtsp, int backend, int device_index, int keep_on_device,
+                                        int queue_depth);
+ROI_API void roi_decoder_close(roi_decoder_t* dec);
+ROI_API const char* roi_decoder_backend(roi_decoder_t* dec);
+ROI_API int roi_decoder_read(roi_decoder_t* dec, roi_surface_t* out, int timeout_ms);
+ROI_API void roi_decoder_get_stats(roi_decoder_t* dec, roi_decoder_stats_t* out);
+ROI_API void roi_decoder_get_pool_stats(roi_decoder_t* dec, roi_pool_stats_t* out);
+ROI_API void roi_surface_release(void* handle);
+// 为同一帧再取一个句柄（共享底层解码缓冲），两个句柄各自 release，最后一个归还时帧才回到解码器的池里
+ROI_API void* roi_surface_retain(void* handle);
+
+// ---------------- 缩放 ----------------
+
+// 把解码帧缩放成 width x height 的 NV12（见 decode/surface_scaler.h），输出帧来自缩放器自己的帧池，
+// 与源帧互不牵连；多路输出里同一尺寸的码流共用一个缩放器，可以跨线程调用
+typedef struct roi_scaler roi_scaler_t;
+
+ROI_API roi_scaler_t* roi_scaler_open(int width, int height, int pool_frames);
+ROI_API void roi_scaler_close(roi_scaler_t* sc);
+// 成功时 out 与 roi_decoder_read 的输出一样用 roi_surface_release 归还；源帧只在设备内存里时返回 -1
+ROI_API int roi_scaler_scale(roi_scaler_t* sc, void* surface_handle, roi_surface_t* out);
+ROI_API void roi_scaler_get_pool_stats(roi_scaler_t* sc, roi_pool_stats_t* out);
+
+// ---------------- ROI 编码 ----------------
+
+typedef struct roi_encoder roi_encoder_t;
+
+typedef struct roi_encoder_config {
+    int32_t codec;    // ROI_CODEC_*
+    int32_t backend;  // ROI_ENCODER_*
+    int32_t width;
+    int32_t height;
+    int32_t fps;
+    int32_t bitrate_kbps;
+    int32_t gop;
+    int32_t device_index;
+    int32_t roi_qp_delta;
+    int32_t background_qp_delta;
+    int32_t base_qp;
+} roi_encoder_config_t;
+
+typedef struct roi_box {
+    float x;
+    float y;
+    float w;
+    float h;
+    int32_t qp_delta;
+} roi_box_t;
+
+typedef struct roi_packet {
+    const uint8_t* data;  // Annex-B，roi_packet_release 之前有效
+    uint64_t size;
+    int64_t pts;
+    int64_t dts;
+    int32_t key;
+    int32_t reference;
+    int32_t codec;
+    void* handle;
+} roi_packet_t;
+
+// ROI 时域平滑（见 encode/roi_smoother.h），各字段的含义与默认值同 RoiSmootherConfig
+typedef struct roi_smoothing {
+    float alpha;
+    float dilate;
+    int32_t pad_pixels;
+    int32_t hold_updates;
+    float match_iou;
+    float shrink_margin;
+} roi_smoothing_t;
+
+// 静止背景模式（见 encode/activity_map.h）：ROI 之外长时间静止的块改用 qp_delta
+typedef struct roi_static_config {
+    float threshold;        // 块内平均帧差阈值（亮度 0..255）
+    int32_t static_frames;  // 连续静止多少帧后生效
+    int32_t sample_step;    // 帧差的抽样间隔（像素）
+    int32_t qp_delta;       // 静止块的 QP 偏移，通常比背景更高
+} roi_static_config_t;
+
+enum { ROI_ENCODER_AUTO = 0, ROI_ENCODER_SOPHON = 1, ROI_ENCODER_X264 = 2, ROI_ENCODER_X265 = 3 };
+
+ROI_API roi_encoder_t* roi_encoder_open(const roi_encoder_config_t* config);
+ROI_API void roi_encoder_close(roi_encoder_t* enc);
+ROI_API const char* roi_encoder_backend(roi_encoder_t* enc);
+ROI_API int roi_encoder_block_size(roi_encoder_t* enc);
+// 更新 ROI 并增量改写 QP 图，返回变化的块数；开启平滑时先经过平滑层
+ROI_API int roi_encoder_set_rois(roi_encoder_t* enc, const roi_box_t* boxes, int count);
+// 开启（或重新配置）ROI 平滑，config 为 NULL 时关闭；返回 1
+ROI_API int roi_encoder_set_smoothing(roi_encoder_t* enc, const roi_smoothing_t* config);
+// 开启静止背景模式，config 为 NULL 时关闭并恢复普通背景；之后每帧编码前用主机亮度平面更新活动图
+// （只在设备内存、没有主机映射的帧上不更新）。返回 1
+ROI_API int roi_encoder_set_static(roi_encoder_t* enc, const roi_static_config_t* config);
+// 当前按静止背景编码的块数
+ROI_API int roi_encoder_static_blocks(roi_encoder_t* enc);
+// 码控调整：背景 QP 偏移，以及加到每个 ROI 偏移上的 roi_qp_bias（不会让 ROI 比背景更差），立即生效
+ROI_API int roi_encoder_set_qp_offsets(roi_encoder_t* enc, int background_qp_delta, int roi_qp_bias);
+ROI_API const int8_t* roi_encoder_qp_map(roi_encoder_t* enc, int* cols, int* rows);
+ROI_API int roi_encoder_encode_surface(roi_encoder_t* enc, void* surface_handle, int force_key);
+ROI_API int roi_encoder_encode_nv12(roi_encoder_t* enc, const uint8_t* y, const uint8_t* uv, int pitch_y,
+                                    int pitch_uv, int64_t pts, int force_key);
+ROI_API int roi_encoder_encode_i420(roi_encoder_t* enc, const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                                    int pitch_y, int pitch_uv, int64_t pts, int force_key);
+ROI_API int roi_encoder_receive(roi_encoder_t* enc, roi_packet_t* out);
+ROI_API void roi_encoder_get_pool_stats(roi_encoder_t* enc, roi_pool_stats_t* out);
+ROI_API void roi_packet_release(void* handle);
+
+// ---------------- RTMP 推流 ----------------
+
+typedef struct roi_rtmp roi_rtmp_t;
+
+typedef struct roi_rtmp_config {
+    const char* url;        // rtmp://host[:port]/app/stream
+    int32_t codec;          // ROI_CODEC_*
+    int32_t hevc_mode;      // ROI_HEVC_FLV_*
+    int32_t timeout_ms;
+    uint64_t queue_bytes;   // 发送队列上限，0 使用默认值
+    int32_t queue_packets;
+    int32_t chunk_size;
+    int32_t width;          // 以下仅写入 onMetaData
+    int32_t height;
+    int32_t fps;
+    int32_t bitrate_kbps;
+} roi_rtmp_config_t;
+
+typedef struct roi_rtmp_stats {
+    uint64_t sent_frames;
+    uint64_t sent_bytes;
+    uint64_t acked_bytes;
+    uint64_t dropped_nonref;
+    uint64_t dropped_ref;
+    uint64_t queued_frames;
+    uint64_t queued_bytes;
+    uint64_t socket_bytes;   // 内核发送缓冲里对端还没确认的字节
+    uint32_t queued_ms;      // 发送队列里首尾两帧的 dts 跨度
+    uint32_t rtt_us;         // TCP 平滑 RTT
+    uint32_t ack_delay_ms;   // RTMP Acknowledgement 的确认时延，服务器不发确认时为 0
+    uint32_t reserved;
+} roi_rtmp_stats_t;
+
+enum { ROI_HEVC_FLV_ENHANCED = 0, ROI_HEVC_FLV_LEGACY = 1 };
+
+// 完成握手与 publish 后返回，失败返回 NULL
+ROI_API roi_rtmp_t* roi_rtmp_open(const roi_rtmp_config_t* config);
+ROI_API void roi_rtmp_close(roi_rtmp_t* rtmp);
+// 0 空闲 / 1 推流中 / 2 出错 / 3 已停止
+ROI_API int roi_rtmp_state(roi_rtmp_t* rtmp);
+ROI_API const char* roi_rtmp_error(roi_rtmp_t* rtmp);
+// 拥塞丢掉参考帧后让 enc 出关键帧；之后的 send 必须与 enc 的编码在同一线程
+ROI_API void roi_rtmp_attach_encoder(roi_rtmp_t* rtmp, roi_encoder_t* enc);
+// 发送 roi_encoder_receive 得到的包，推流端持有自己的引用，调用方照常 release。
+// 返回 1 入队 / 0 拥塞丢弃 / -1 连接出错
+ROI_API int roi_rtmp_send_packet(roi_rtmp_t* rtmp, void* packet_handle);
+// 取出 enc 的全部输出直接入队，不经过 Python；返回入队的包数，连接出错返回 -1
+ROI_API int roi_rtmp_send_from_encoder(roi_rtmp_t* rtmp, roi_encoder_t* enc);
+ROI_API void roi_rtmp_get_stats(roi_rtmp_t* rtmp, roi_rtmp_stats_t* out);
+
+// ---------------- 直通转封装 ----------------
+
+// 不需要 ROI 时把 RTSP 的压缩 AU 直接转封装推流，与编码器输出在关键帧处切换
+typedef struct roi_passthrough roi_passthrough_t;
+
+typedef struct roi_passthrough_stats {
+    uint64_t forwarded_frames;
+    uint64_t forwarded_bytes;
+    uint64_t encoded_frames;
+    uint64_t skipped_source;
+    uint64_t skipped_encoded;
+    uint32_t switches;
+    uint32_t codec_mismatch;
+    double source_kbps;
+} roi_passthrough_stats_t;
+
+enum { ROI_MODE_ENCODE = 0, ROI_MODE_PASSTHROUGH = 1 };
+
+// 在 rtsp 上登记一个消费者、向 rtmp 发送；必须先于 rtsp 和 rtmp 关闭
+ROI_API roi_passthrough_t* roi_passthrough_open(roi_rtsp_t* rtsp, roi_rtmp_t* rtmp);
+ROI_API void roi_passthrough_close(roi_passthrough_t* pt);
+// 请求 ROI_MODE_*，在对应一路的下一个关键帧处生效
+ROI_API void roi_passthrough_set_mode(roi_passthrough_t* pt, int mode);
+// 当前在推流的一路 ROI_MODE_*
+ROI_API int roi_passthrough_active(roi_passthrough_t* pt);
+// 最近发出的一帧的 dts（90kHz），恢复编码时跳过不晚于它的帧；还没有发出过帧时为 -1
+ROI_API int64_t roi_passthrough_last_dts(roi_passthrough_t* pt);
+// 代替 roi_rtmp_send_packet 发送编码器的包，返回值相同；直通期间的包被跳过时返回 0
+ROI_API int roi_passthrough_send_packet(roi_passthrough_t* pt, void* packet_handle);
+ROI_API void roi_passthrough_get_stats(roi_passthrough_t* pt, roi_passthrough_stats_t* out);
+
+// ---------------- 检测后处理 ----------------
+
+typedef struct roi_yolo_head {
+    const float* data;  // rows x stride：cx, cy, w, h（归一化）、目标置信度、各类得分
+    int32_t rows;
+    int32_t stride;
+} roi_yolo_head_t;
+
+typedef struct roi_detection {
+    float x;  // 原图像素坐标
+    float y;
+    float w;
+    float h;
+    float confidence;
+    int32_t class_id;
+} roi_detection_t;
+
+// 阈值筛选 + 框解码 + NMS，按置信度降序把前 max_out 个写入 out。
+// 返回截断前的检测框总数：大于 max_out 时调用方可以换更大的 out 重新调用
+ROI_API int roi_yolo_decode(const roi_yolo_head_t* heads, int num_heads, int width, int height,
+                            float conf_threshold, float nms_threshold, int per_class, roi_detection_t* out,
+                            int max_out);
+
+// ---------------- 检测预处理 ----------------
+
+typedef struct roi_preprocess roi_preprocess_t;
+
+typedef struct roi_preprocess_config {
+    int32_t width;       // 网络输入尺寸
+    int32_t height;
+    int32_t batch;
+    int32_t letterbox;   // 1 保持宽高比并填充，0 直接拉伸
+    int32_t pad_value;
+    int32_t int8;        // 1 输出 int8（TPU 量化输入），0 输出 float32
+    float int8_scale;
+} roi_preprocess_config_t;
+
+typedef struct roi_letterbox {
+    float scale_x;  // 网络输入坐标 = 原图坐标 * scale + pad
+    float scale_y;
+    int32_t pad_x;
+    int32_t pad_y;
+} roi_letterbox_t;
+
+ROI_API roi_preprocess_t* roi_preprocess_open(const roi_preprocess_config_t* config);
+ROI_API void roi_preprocess_close(roi_preprocess_t* pp);
+// 预先分配的 NCHW 输入张量，地址在 close 之前不变
+ROI_API const void* roi_preprocess_tensor(roi_preprocess_t* pp, uint64_t* bytes);
+// 把一帧缩放、转 RGB、归一化后写进批中第 slot 个位置
+ROI_API int roi_preprocess_nv12(roi_preprocess_t* pp, int slot, const uint8_t* y, const uint8_t* uv, int width,
+                                int height, int pitch_y, int pitch_uv, roi_letterbox_t* out);
+ROI_API int roi_preprocess_bgr(roi_preprocess_t* pp, int slot, const uint8_t* bgr, int width, int height,
+                               int pitch, roi_letterbox_t* out);
+// 解码帧需要有主机映射（keep_on_device=0 或软件解码），否则返回 -1
+ROI_API int roi_preprocess_surface(roi_preprocess_t* pp, int slot, void* surface_handle, roi_letterbox_t* out);
+// 只预处理帧中的一块区域（两遍检测的裁剪），x、y 须为偶数，out 相对于区域左上角
+ROI_API int roi_preprocess_surface_crop(roi_preprocess_t* pp, int slot, void* surface_handle, int x, int y,
+                                        int width, int height, roi_letterbox_t* out);
+
+// ---------------- 线程布局 ----------------
+
+// CPU 列表形如 "0-3,6"，NULL 或空串表示该角色不绑核；workers 为 0 时不建 CPU 线程池。
+// 收流和推流会话共用 io_threads 个 I/O 线程（不大于 0 时为 1），按 rtsp_cpus 与 rtmp_cpus 的并集绑核
+typedef struct roi_scheduler_config {
+    int32_t workers;
+    const char* worker_cpus;
+    const char* rtsp_cpus;
+    const char* decode_cpus;
+    const char* infer_cpus;
+    const char* rtmp_cpus;
+    int32_t io_threads;
+} roi_scheduler_config_t;
+
+// 角色编号，与 roi_scheduler_config_t 中的顺序对应
+enum {
+    ROI_THREAD_RTSP = 0,
+    ROI_THREAD_DECODE = 1,
+    ROI_THREAD_INFER = 2,
+    ROI_THREAD_RTMP = 3,
+};
+
+typedef struct roi_scheduler_stats {
+    uint32_t threads;
+    uint32_t io_threads;  // 已经启动的 I/O 线程
+    uint64_t executed;
+    uint64_t stolen;
+    uint64_t parked;
+} roi_scheduler_stats_t;
+
+// 在打开任何收流 / 解码 / 推流句柄之前调用；之后启动的原生线程按角色绑核
+ROI_API int roi_scheduler_configure(const roi_scheduler_config_t* config);
+// 由调用线程（如 Python 的推理线程）按角色绑核并设置线程名，name 可为 NULL
+ROI_API int roi_scheduler_enter(int role, const char* name);
+ROI_API int roi_scheduler_get_stats(roi_scheduler_stats_t* out);
+
+#ifdef __cplusplus
+}
+#endif
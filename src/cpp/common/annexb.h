@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "au_ring.h"
+
+namespace roi {
+
+// 从 NAL 头取 NAL 类型
+inline int nal_type(Codec codec, uint8_t first_byte) {
+    return codec == Codec::kH265 ? (first_byte >> 1) & 0x3f : first_byte & 0x1f;
+}
+
+// 在 Annex-B 码流中查找下一个起始码（00 00 01 或 00 00 00 01），
+// 返回起始码后第一个字节的偏移，找不到返回 size；*sc_len 为起始码长度
+inline size_t find_start_code(const uint8_t* p, size_t size, size_t from, size_t* sc_len) {
+    for (size_t i = from; i + 3 <= size; ++i) {
+        if (p[i] != 0 || p[i + 1] != 0) continue;
+        if (p[i + 2] == 1) {
+            *sc_len = 3;
+            return i + 3;
+        }
+        if (i + 4 <= size && p[i + 2] == 0 && p[i + 3] == 1) {
+            *sc_len = 4;
+            return i + 4;
+        }
+    }
+    *sc_len = 0;
+    return size;
+}
+
+// 依次回调码流中每个 NAL（不含起始码），fn(const uint8_t* nal, size_t len)
+template <typename Fn>
+void for_each_nal(const uint8_t* p, size_t size, Fn&& fn) {
+    size_t sc = 0;
+    size_t begin = find_start_code(p, size, 0, &sc);
+    while (begin < size) {
+        size_t next_sc = 0;
+        const size_t next = find_start_code(p, size, begin, &next_sc);
+        size_t end = next < size ? next - next_sc : size;
+        // 四字节起始码的前导 0 属于上一个 NAL 的尾部填充
+        while (end > begin && p[end - 1] == 0 && next < size) --end;
+        if (end > begin) fn(p + begin, end - begin);
+        begin = next;
+    }
+}
+
+}  // namespace roi
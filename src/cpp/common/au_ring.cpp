@@ -0,0 +1,227 @@
+#include "au_ring.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace roi {
+
+namespace {
+constexpr uint64_t kAlign = 64;  // 每个 AU 起始地址按缓存行对齐
+
+uint64_t align_up(uint64_t v) { return (v + kAlign - 1) & ~(kAlign - 1); }
+}  // namespace
+
+AuRing::AuRing(size_t arena_bytes, uint32_t slot_count)
+    : capacity_(align_up(std::max<size_t>(arena_bytes, 1 << 16))),
+      slot_count_(std::max<uint32_t>(slot_count, 4)),
+      arena_(new uint8_t[capacity_]),
+      slots_(new Slot[slot_count_]) {
+    for (auto& c : cursors_) c.store(kInactive, std::memory_order_relaxed);
+}
+
+// ---------------- 生产者 ----------------
+
+void AuRing::begin(Codec codec) {
+    cur_begin_ = write_pos_;
+    cur_size_ = 0;
+    cur_codec_ = codec;
+    cur_open_ = true;
+    cur_failed_ = false;
+}
+
+bool AuRing::append(const uint8_t* data, size_t size) {
+    if (!cur_open_ || cur_failed_) return false;
+    const size_t need = cur_size_ + size;
+    if (need > capacity_ / 2) {
+        // 单个 AU 超过半个环，配置显然不合理，直接丢弃
+        cur_failed_ = true;
+        return false;
+    }
+    uint64_t phys = cur_begin_ % capacity_;
+    if (phys + need > capacity_) {
+        // AU 跨越了字节区末尾：把已写入的部分搬到开头，保证 AU 在内存中连续。
+        // need <= capacity_/2 保证了 phys > cur_size_，源和目标不会重叠。
+        const uint64_t new_begin = cur_begin_ + (capacity_ - phys);
+        if (!ensure_space(new_begin + need)) {
+            cur_failed_ = true;
+            return false;
+        }
+        if (cur_size_ > 0) std::memcpy(arena_.get(), arena_.get() + phys, cur_size_);
+        cur_begin_ = new_begin;
+        phys = 0;
+    } else if (!ensure_space(cur_begin_ + need)) {
+        cur_failed_ = true;
+        return false;
+    }
+    std::memcpy(arena_.get() + phys + cur_size_, data, size);
+    cur_size_ = need;
+    return true;
+}
+
+bool AuRing::commit(int64_t pts, uint32_t flags) {
+    if (!cur_open_) return false;
+    cur_open_ = false;
+    if (cur_failed_ || cur_size_ == 0) {
+        drop_current();
+        return false;
+    }
+    if (wait_key_ && !(flags & kAuKeyFrame)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    const uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head - min_cursor(head) >= slot_count_) {
+        drop_current();
+        return false;
+    }
+
+    Slot& s = slots_[head % slot_count_];
+    s.begin_pos = cur_begin_;
+    s.size = static_cast<uint32_t>(cur_size_);
+    s.flags = flags | (pending_discontinuity_ ? kAuDiscontinuity : 0u);
+    s.pts = pts;
+    s.codec = cur_codec_;
+    s.arrival_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                       .count();
+    pending_discontinuity_ = false;
+    if (flags & kAuKeyFrame) wait_key_ = false;
+    write_pos_ = align_up(cur_begin_ + cur_size_);
+
+    head_.store(head + 1, std::memory_order_seq_cst);
+    if (flags & kAuKeyFrame) last_key_.store(head, std::memory_order_release);
+    committed_.fetch_add(1, std::memory_order_relaxed);
+    bytes_in_.fetch_add(cur_size_, std::memory_order_relaxed);
+
+    if (waiters_.load(std::memory_order_seq_cst) > 0) {
+        std::lock_guard<std::mutex> lk(wait_mutex_);
+        wait_cv_.notify_all();
+    }
+    return true;
+}
+
+void AuRing::abort() {
+    cur_open_ = false;
+    cur_size_ = 0;
+}
+
+void AuRing::mark_loss() {
+    if (cur_open_) cur_failed_ = true;
+    wait_key_ = true;
+    pending_discontinuity_ = true;
+}
+
+void AuRing::drop_current() {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    wait_key_ = true;
+    pending_discontinuity_ = true;
+    cur_failed_ = false;
+    cur_size_ = 0;
+}
+
+uint64_t AuRing::min_cursor(uint64_t head) const {
+    uint64_t m = head;
+    for (const auto& c : cursors_) {
+        const uint64_t v = c.load(std::memory_order_acquire);
+        if (v != kInactive && v < m) m = v;
+    }
+    return m;
+}
+
+uint64_t AuRing::tail_pos(uint64_t head) const {
+    const uint64_t m = min_cursor(head);
+    if (m >= head) return cur_begin_;
+    return slots_[m % slot_count_].begin_pos;
+}
+
+bool AuRing::ensure_space(uint64_t end_pos) {
+    if (end_pos - tail_cache_ <= capacity_) return true;
+    // 缓存的尾部过期了才重新扫描消费者游标
+    tail_cache_ = tail_pos(head_.load(std::memory_order_relaxed));
+    return end_pos - tail_cache_ <= capacity_;
+}
+
+// ---------------- 消费者 ----------------
+
+int AuRing::add_consumer() {
+    for (int i = 0; i < kMaxConsumers; ++i) {
+        uint64_t expected = kInactive;
+        uint64_t h = head_.load(std::memory_order_seq_cst);
+        if (!cursors_[i].compare_exchange_strong(expected, h, std::memory_order_seq_cst)) continue;
+        // 生产者可能在登记期间又提交了 AU，把游标推到最新位置，
+        // 确保不会指向已被判定为可回收的槽位
+        for (uint64_t now = head_.load(std::memory_order_seq_cst); now != h;
+             now = head_.load(std::memory_order_seq_cst)) {
+            h = now;
+            cursors_[i].store(h, std::memory_order_seq_cst);
+        }
+        return i;
+    }
+    return -1;
+}
+
+void AuRing::remove_consumer(int id) {
+    if (id < 0 || id >= kMaxConsumers) return;
+    cursors_[id].store(kInactive, std::memory_order_release);
+}
+
+bool AuRing::peek(int id, AccessUnitView* out) {
+    const uint64_t c = cursors_[id].load(std::memory_order_relaxed);
+    if (c == kInactive || c >= head_.load(std::memory_order_acquire)) return false;
+    const Slot& s = slots_[c % slot_count_];
+    out->data = arena_.get() + s.begin_pos % capacity_;
+    out->size = s.size;
+    out->flags = s.flags;
+    out->pts = s.pts;
+    out->seq = c;
+    out->codec = s.codec;
+    out->arrival_us = s.arrival_us;
+    return true;
+}
+
+bool AuRing::wait(int id, AccessUnitView* out, std::chrono::milliseconds timeout) {
+    if (peek(id, out)) return true;
+    waiters_.fetch_add(1, std::memory_order_seq_cst);
+    bool ok;
+    {
+        std::unique_lock<std::mutex> lk(wait_mutex_);
+        const uint32_t gen = wake_gen_;
+        wait_cv_.wait_for(lk, timeout, [&] { return peek(id, out) || wake_gen_ != gen; });
+        ok = peek(id, out);
+    }
+    waiters_.fetch_sub(1, std::memory_order_seq_cst);
+    return ok;
+}
+
+void AuRing::release(int id) {
+    const uint64_t c = cursors_[id].load(std::memory_order_relaxed);
+    if (c == kInactive || c >= head_.load(std::memory_order_acquire)) return;
+    cursors_[id].store(c + 1, std::memory_order_release);
+}
+
+bool AuRing::skip_to_latest_key(int id) {
+    const uint64_t k = last_key_.load(std::memory_order_acquire);
+    const uint64_t c = cursors_[id].load(std::memory_order_relaxed);
+    if (k == kInactive || c == kInactive || k <= c) return false;
+    // [c, head) 区间受本消费者游标保护，k 落在其中，槽位仍然有效
+    cursors_[id].store(k, std::memory_order_release);
+    return true;
+}
+
+void AuRing::wake_all() {
+    std::lock_guard<std::mutex> lk(wait_mutex_);
+    ++wake_gen_;
+    wait_cv_.notify_all();
+}
+
+AuRingStats AuRing::stats() const {
+    AuRingStats st;
+    st.committed = committed_.load(std::memory_order_relaxed);
+    st.dropped = dropped_.load(std::memory_order_relaxed);
+    st.bytes_in = bytes_in_.load(std::memory_order_relaxed);
+    const uint64_t head = head_.load(std::memory_order_acquire);
+    st.slots_used = static_cast<uint32_t>(head - std::min(min_cursor(head), head));
+    return st;
+}
+
+}  // namespace roi
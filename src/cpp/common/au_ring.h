@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace roi {
+
+enum class Codec : uint8_t {
+    kUnknown = 0,
+    kH264 = 1,
+    kH265 = 2,
+};
+
+// 访问单元（AU）标志位
+enum AccessUnitFlags : uint32_t {
+    kAuKeyFrame = 1u << 0,       // 含 IDR / IRAP
+    kAuDiscontinuity = 1u << 1,  // 此前发生过丢包或丢帧
+    kAuParamSets = 1u << 2,      // 含 SPS/PPS（H.265 还包括 VPS）
+};
+
+// 指向环形缓冲区内部的只读视图；在 release() 之前一直有效
+struct AccessUnitView {
+    const uint8_t* data = nullptr;  // Annex-B 码流
+    uint32_t size = 0;
+    uint32_t flags = 0;
+    int64_t pts = 0;   // 90kHz，已展开的 RTP 时间戳
+    uint64_t seq = 0;  // 单调递增的 AU 序号
+    Codec codec = Codec::kUnknown;
+    int64_t arrival_us = 0;  // 收齐这个 AU 的时刻，steady_clock（CLOCK_MONOTONIC）微秒
+};
+
+struct AuRingStats {
+    uint64_t committed = 0;
+    uint64_t dropped = 0;
+    uint64_t bytes_in = 0;
+    uint32_t slots_used = 0;  // 最慢消费者尚未释放的 AU 数
+};
+
+// 单生产者 / 多消费者的无锁 AU 环形缓冲区。
+//
+// 字节区与槽位在构造时一次性分配，运行期不再分配内存。生产者（RTSP
+// 接收线程）按 begin()/append()/commit() 把一个 AU 连续写入字节区；
+// 每个消费者持有独立游标，peek() 得到的是指向字节区的视图，release()
+// 之后该区域才可能被复用。生产者从不覆盖任何消费者未释放的数据：
+// 空间不足时直接丢弃新 AU，并在下一个关键帧之前持续丢弃，保证消费者
+// 看到的码流总能从关键帧重新开始解码。
+class AuRing {
+public:
+    static constexpr int kMaxConsumers = 8;
+
+    AuRing(size_t arena_bytes, uint32_t slot_count);
+    AuRing(const AuRing&) = delete;
+    AuRing& operator=(const AuRing&) = delete;
+
+    // ---- 生产者接口（仅限单线程调用） ----
+    void begin(Codec codec);
+    bool append(const uint8_t* data, size_t size);
+    bool commit(int64_t pts, uint32_t flags);
+    void abort();
+    // 标记上游丢包：丢弃当前 AU，直到下一个关键帧
+    void mark_loss();
+
+    // ---- 消费者接口（每个 id 仅限单线程调用） ----
+    int add_consumer();
+    void remove_consumer(int id);
+    bool peek(int id, AccessUnitView* out);
+    bool wait(int id, AccessUnitView* out, std::chrono::milliseconds timeout);
+    void release(int id);
+    // 释放到最新的关键帧之前，落后太多的消费者用来追帧
+    bool skip_to_latest_key(int id);
+
+    // 唤醒所有等待中的消费者（关闭时使用）
+    void wake_all();
+
+    AuRingStats stats() const;
+    size_t capacity() const { return capacity_; }
+
+private:
+    struct Slot {
+        uint64_t begin_pos = 0;  // 字节区中的虚拟偏移（单调递增）
+        uint32_t size = 0;
+        uint32_t flags = 0;
+        int64_t pts = 0;
+        Codec codec = Codec::kUnknown;
+        int64_t arrival_us = 0;
+    };
+
+    static constexpr uint64_t kInactive = ~0ull;
+
+    uint64_t min_cursor(uint64_t head) const;
+    uint64_t tail_pos(uint64_t head) const;
+    bool ensure_space(uint64_t end_pos);
+    void drop_current();
+
+    const size_t capacity_;
+    const uint32_t slot_count_;
+    std::unique_ptr<uint8_t[]> arena_;
+    std::unique_ptr<Slot[]> slots_;
+
+    // 生产者私有状态
+    uint64_t write_pos_ = 0;  // 下一个 AU 的起始虚拟偏移
+    uint64_t cur_begin_ = 0;
+    size_t cur_size_ = 0;
+    Codec cur_codec_ = Codec::kUnknown;
+    bool cur_open_ = false;
+    bool cur_failed_ = false;
+    bool wait_key_ = true;
+    bool pending_discontinuity_ = false;
+    uint64_t tail_cache_ = 0;
+
+    alignas(64) std::atomic<uint64_t> head_{0};  // 已提交 AU 数
+    alignas(64) std::atomic<uint64_t> last_key_{kInactive};
+    alignas(64) std::atomic<uint64_t> cursors_[kMaxConsumers];
+    std::atomic<uint64_t> committed_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> bytes_in_{0};
+
+    // 只在消费者需要休眠时使用，热路径上只读一次 waiters_
+    std::atomic<int> waiters_{0};
+    std::mutex wait_mutex_;
+    std::condition_variable wait_cv_;
+    uint32_t wake_gen_ = 0;  // 受 wait_mutex_ 保护
+};
+
+}  // namespace roi
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace roi {
+
+// 检测预处理（infer/preprocess.cpp）和解码帧缩放（decode/surface_scaler.cpp）共用的定点双线性插值
+
+constexpr int kBilinearBits = 11;
+constexpr int kBilinearOne = 1 << kBilinearBits;
+
+// 一个输出维度的双线性系数：src 下标和 11 位定点权重
+struct BilinearTap {
+    int i0;
+    int i1;
+    int w1;
+};
+
+// 像素中心对齐（与 cv2.INTER_LINEAR 相同）：src = (dst + 0.5) * S / D - 0.5，越界的一侧取边缘像素
+inline void build_bilinear_taps(int dst, int src, std::vector<BilinearTap>* taps) {
+    taps->resize(size_t(dst));
+    const double ratio = double(src) / dst;
+    for (int d = 0; d < dst; ++d) {
+        double s = (d + 0.5) * ratio - 0.5;
+        if (s < 0) s = 0;
+        int i0 = int(s);
+        if (i0 > src - 1) i0 = src - 1;
+        const int i1 = std::min(i0 + 1, src - 1);
+        (*taps)[size_t(d)] = BilinearTap{i0, i1, int(std::lround((s - i0) * kBilinearOne))};
+    }
+}
+
+// 先水平后垂直的定点双线性插值，a..d 为左上、右上、左下、右下
+inline int bilinear(int a, int b, int c, int d, int wx, int wy) {
+    const int top = a * (kBilinearOne - wx) + b * wx;
+    const int bottom = c * (kBilinearOne - wx) + d * wx;
+    return (top * (kBilinearOne - wy) + bottom * wy + (1 << (2 * kBilinearBits - 1))) >> (2 * kBilinearBits);
+}
+
+}  // namespace roi
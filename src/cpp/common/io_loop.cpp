@@ -0,0 +1,284 @@
+#include "io_loop.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "net.h"
+#include "scheduler.h"
+
+namespace roi {
+
+namespace {
+
+constexpr int kMaxEvents = 64;
+constexpr int kMaxWaitMs = 1000;
+constexpr uint64_t kWakeId = 0;  // eventfd 的注册序号，会话的序号从 1 开始
+
+struct SharedLoops {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<IoLoop>> loops;
+};
+
+SharedLoops& shared_loops() {
+    static SharedLoops shared;
+    return shared;
+}
+
+}  // namespace
+
+IoLoop::IoLoop(std::string name) : name_(std::move(name)) {}
+
+IoLoop::~IoLoop() {
+    stop();
+    close_fd(&wake_fd_);
+    close_fd(&epfd_);
+}
+
+std::shared_ptr<IoLoop> IoLoop::acquire() {
+    SharedLoops& shared = shared_loops();
+    std::vector<std::shared_ptr<IoLoop>>& loops = shared.loops;
+    std::lock_guard<std::mutex> lk(shared.mutex);
+    // 只增不减：已经在线程上的会话不迁移
+    const size_t want = size_t(std::max(1, Scheduler::instance().config().io_threads));
+    while (loops.size() < want) {
+        auto loop = std::make_shared<IoLoop>("roi-io-" + std::to_string(loops.size()));
+        if (!loop->start(nullptr)) break;
+        loops.push_back(std::move(loop));
+    }
+    if (loops.empty()) return nullptr;
+    return *std::min_element(loops.begin(), loops.end(), [](const auto& a, const auto& b) {
+        return a->fd_count_.load(std::memory_order_relaxed) < b->fd_count_.load(std::memory_order_relaxed);
+    });
+}
+
+uint32_t IoLoop::started() {
+    SharedLoops& shared = shared_loops();
+    std::lock_guard<std::mutex> lk(shared.mutex);
+    return uint32_t(shared.loops.size());
+}
+
+bool IoLoop::start(std::string* err) {
+    if (running_.load()) return true;
+    epfd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = kWakeId;
+    if (epfd_ < 0 || wake_fd_ < 0 || ::epoll_ctl(epfd_, EPOLL_CTL_ADD, wake_fd_, &ev) < 0) {
+        if (err) *err = "io loop: " + errno_string();
+        close_fd(&wake_fd_);
+        close_fd(&epfd_);
+        return false;
+    }
+    running_.store(true);
+    thread_ = std::thread(&IoLoop::run, this);
+    return true;
+}
+
+void IoLoop::stop() {
+    {
+        std::lock_guard<std::mutex> lk(post_mutex_);
+        if (!running_.exchange(false)) return;
+    }
+    wake();
+    if (thread_.joinable()) thread_.join();
+    loop_id_.store(std::thread::id(), std::memory_order_release);
+    // 停止前已经排队的任务在这里执行完，run_sync() 的调用方不会一直等下去
+    run_posted();
+}
+
+bool IoLoop::add(int fd, uint32_t events, Handler handler, std::string* err) {
+    bool ok = false;
+    int error = 0;  // errno 是线程局部的，从循环线程带回来
+    run_sync([&] {
+        if (fds_.count(fd)) {
+            error = EEXIST;
+            return;
+        }
+        auto entry = std::make_shared<Entry>();
+        entry->fd = fd;
+        entry->events = events;
+        entry->handler = std::move(handler);
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = next_id_;
+        if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            error = errno;
+            return;
+        }
+        entries_[next_id_] = std::move(entry);
+        fds_[fd] = next_id_++;
+        fd_count_.fetch_add(1, std::memory_order_relaxed);
+        ok = true;
+    });
+    if (!ok && err) {
+        errno = error;
+        *err = "epoll_ctl(add): " + errno_string();
+    }
+    return ok;
+}
+
+bool IoLoop::modify(int fd, uint32_t events) {
+    bool ok = false;
+    run_sync([&] {
+        auto it = fds_.find(fd);
+        if (it == fds_.end()) return;
+        Entry& entry = *entries_[it->second];
+        if (entry.events == events) {
+            ok = true;
+            return;
+        }
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = it->second;
+        ok = ::epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &ev) == 0;
+        if (ok) entry.events = events;
+    });
+    return ok;
+}
+
+void IoLoop::remove(int fd) {
+    run_sync([&] {
+        auto it = fds_.find(fd);
+        if (it == fds_.end()) return;
+        ::epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+        // 正在执行的回调持有 Entry 的引用，自己移除自己也是安全的
+        entries_.erase(it->second);
+        fds_.erase(it);
+        fd_count_.fetch_sub(1, std::memory_order_relaxed);
+    });
+}
+
+uint64_t IoLoop::add_timer(int interval_ms, Task task) {
+    uint64_t id = 0;
+    run_sync([&] {
+        auto timer = std::make_shared<Timer>();
+        timer->interval = std::chrono::milliseconds(std::max(1, interval_ms));
+        timer->next = std::chrono::steady_clock::now() + timer->interval;
+        timer->task = std::move(task);
+        id = next_id_++;
+        timers_[id] = std::move(timer);
+        timer_count_.fetch_add(1, std::memory_order_relaxed);
+    });
+    return id;
+}
+
+void IoLoop::cancel_timer(uint64_t id) {
+    run_sync([&] {
+        if (timers_.erase(id)) timer_count_.fetch_sub(1, std::memory_order_relaxed);
+    });
+}
+
+void IoLoop::post(Task task) {
+    {
+        std::lock_guard<std::mutex> lk(post_mutex_);
+        if (running_.load()) {
+            posted_.push_back(std::move(task));
+            task = nullptr;
+        }
+    }
+    if (task) {
+        task();
+    } else {
+        wake();
+    }
+}
+
+void IoLoop::run_sync(const Task& task) {
+    if (in_loop() || !running_.load()) {
+        task();
+        return;
+    }
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
+    post([&] {
+        task();
+        std::lock_guard<std::mutex> lk(mutex);
+        done = true;
+        cv.notify_one();
+    });
+    std::unique_lock<std::mutex> lk(mutex);
+    cv.wait(lk, [&] { return done; });
+}
+
+IoLoopStats IoLoop::stats() const {
+    IoLoopStats st;
+    st.fds = fd_count_.load(std::memory_order_relaxed);
+    st.timers = timer_count_.load(std::memory_order_relaxed);
+    st.wakeups = wakeups_.load(std::memory_order_relaxed);
+    st.events = events_.load(std::memory_order_relaxed);
+    return st;
+}
+
+void IoLoop::wake() {
+    const uint64_t one = 1;
+    (void)!::write(wake_fd_, &one, sizeof(one));
+}
+
+void IoLoop::run_posted() {
+    std::vector<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lk(post_mutex_);
+        tasks.swap(posted_);
+    }
+    for (Task& t : tasks) t();
+}
+
+int IoLoop::run_timers() {
+    if (timers_.empty()) return kMaxWaitMs;
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<std::pair<uint64_t, std::shared_ptr<Timer>>> due;
+    for (const auto& kv : timers_) {
+        if (kv.second->next <= now) due.push_back(kv);
+    }
+    for (auto& [id, timer] : due) {
+        // 前面的定时器可能取消了后面的
+        if (!timers_.count(id)) continue;
+        timer->next += timer->interval;
+        if (timer->next <= now) timer->next = now + timer->interval;
+        timer->task();
+    }
+    auto next = now + std::chrono::milliseconds(kMaxWaitMs);
+    for (const auto& kv : timers_) next = std::min(next, kv.second->next);
+    const auto wait = std::chrono::ceil<std::chrono::milliseconds>(next - std::chrono::steady_clock::now());
+    return int(std::max<int64_t>(0, wait.count()));
+}
+
+void IoLoop::run() {
+    loop_id_.store(std::this_thread::get_id(), std::memory_order_release);
+    // 收流和推流都在这里：按两个角色的核的并集绑核
+    const SchedulerConfig cfg = Scheduler::instance().config();
+    CpuSet cpus = cfg.cpus[int(ThreadRole::kRtsp)];
+    const CpuSet& rtmp = cfg.cpus[int(ThreadRole::kRtmp)];
+    cpus.cpus.insert(cpus.cpus.end(), rtmp.cpus.begin(), rtmp.cpus.end());
+    std::sort(cpus.cpus.begin(), cpus.cpus.end());
+    cpus.cpus.erase(std::unique(cpus.cpus.begin(), cpus.cpus.end()), cpus.cpus.end());
+    pin_current_thread(cpus, name_.c_str(), nullptr);
+
+    epoll_event events[kMaxEvents];
+    while (running_.load(std::memory_order_relaxed)) {
+        const int n = ::epoll_wait(epfd_, events, kMaxEvents, run_timers());
+        if (n < 0) continue;  // EINTR
+        wakeups_.fetch_add(1, std::memory_order_relaxed);
+        for (int i = 0; i < n; ++i) {
+            const uint64_t id = events[i].data.u64;
+            if (id == kWakeId) {
+                uint64_t v;
+                (void)!::read(wake_fd_, &v, sizeof(v));
+                continue;
+            }
+            auto it = entries_.find(id);
+            if (it == entries_.end()) continue;  // 同一批里前面的回调已经移除了它
+            const std::shared_ptr<Entry> entry = it->second;
+            events_.fetch_add(1, std::memory_order_relaxed);
+            entry->handler(events[i].events);
+        }
+        run_posted();
+    }
+}
+
+}  // namespace roi
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace roi {
+
+struct IoLoopStats {
+    uint32_t fds = 0;      // 当前注册的 fd
+    uint32_t timers = 0;
+    uint64_t wakeups = 0;  // epoll_wait 返回次数
+    uint64_t events = 0;   // 分发的就绪事件
+};
+
+// epoll 事件循环：一个线程复用多路 RTSP / RTMP 会话的 socket、保活和超时定时器。
+//
+// 回调都在循环线程里执行，不能阻塞；会话握手之后的收发状态只在这个线程里访问，不需要加锁。
+// 注册、修改、移除和定时器可以在任意线程调用，remove() / cancel_timer() 返回后对应的回调
+// 不会再执行（正在执行的会先执行完），会话 stop() 后即可安全释放。
+class IoLoop {
+public:
+    // events 为就绪的 EPOLLIN / EPOLLOUT / EPOLLERR / EPOLLHUP
+    using Handler = std::function<void(uint32_t events)>;
+    using Task = std::function<void()>;
+
+    explicit IoLoop(std::string name);
+    ~IoLoop();
+    IoLoop(const IoLoop&) = delete;
+    IoLoop& operator=(const IoLoop&) = delete;
+
+    // 进程内共享的 I/O 线程（个数见 SchedulerConfig::io_threads），返回注册 fd 最少的一个
+    static std::shared_ptr<IoLoop> acquire();
+    // 已经启动的共享 I/O 线程数
+    static uint32_t started();
+
+    bool start(std::string* err);
+    void stop();
+
+    // 水平触发；fd 须为非阻塞
+    bool add(int fd, uint32_t events, Handler handler, std::string* err);
+    bool modify(int fd, uint32_t events);
+    void remove(int fd);
+
+    // 每 interval_ms 在循环线程里执行一次
+    uint64_t add_timer(int interval_ms, Task task);
+    void cancel_timer(uint64_t id);
+
+    // 在循环线程里执行；run_sync() 等执行完再返回，在循环线程里或循环未运行时直接执行
+    void post(Task task);
+    void run_sync(const Task& task);
+    bool in_loop() const { return std::this_thread::get_id() == loop_id_.load(std::memory_order_acquire); }
+
+    IoLoopStats stats() const;
+
+private:
+    struct Entry {
+        int fd = -1;
+        uint32_t events = 0;
+        Handler handler;
+    };
+    struct Timer {
+        std::chrono::milliseconds interval{0};
+        std::chrono::steady_clock::time_point next;
+        Task task;
+    };
+
+    void run();
+    void wake();
+    void run_posted();
+    int run_timers();  // 到下一个定时器的毫秒数
+
+    std::string name_;
+    int epfd_ = -1;
+    int wake_fd_ = -1;
+
+    // 以下只在循环线程（或循环未运行时由 run_sync 的调用线程）访问。
+    // epoll 的 data 是注册序号而不是 fd：同一批事件里 fd 被关闭后复用时，旧事件不会落到新的回调上
+    std::map<uint64_t, std::shared_ptr<Entry>> entries_;
+    std::map<int, uint64_t> fds_;
+    std::map<uint64_t, std::shared_ptr<Timer>> timers_;
+    uint64_t next_id_ = 1;
+
+    std::mutex post_mutex_;
+    std::vector<Task> posted_;
+
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<std::thread::id> loop_id_{};
+    std::atomic<uint32_t> fd_count_{0};
+    std::atomic<uint32_t> timer_count_{0};
+    std::atomic<uint64_t> wakeups_{0};
+    std::atomic<uint64_t> events_{0};
+};
+
+}  // namespace roi
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace roi {
+
+// RTSP Digest 认证用的最小 MD5 实现，返回 32 位小写十六进制串
+std::string md5_hex(const std::string& input);
+
+}  // namespace roi
@@ -0,0 +1,161 @@
+#include "net.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace roi {
+
+std::string errno_string() { return std::strerror(errno); }
+
+bool set_nonblocking(int fd, bool enable) {
+    const int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) return false;
+    const int next = enable ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    return fcntl(fd, F_SETFL, next) == 0;
+}
+
+bool set_tcp_nodelay(int fd) {
+    int one = 1;
+    return setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) == 0;
+}
+
+bool set_recv_buffer(int fd, int bytes) {
+    return setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes)) == 0;
+}
+
+void close_fd(int* fd) {
+    if (*fd >= 0) {
+        ::close(*fd);
+        *fd = -1;
+    }
+}
+
+int wait_readable(int fd, int timeout_ms) {
+    pollfd p{fd, POLLIN, 0};
+    int r;
+    do {
+        r = ::poll(&p, 1, timeout_ms);
+    } while (r < 0 && errno == EINTR);
+    if (r > 0 && (p.revents & (POLLERR | POLLNVAL))) return -1;
+    return r;
+}
+
+int tcp_connect(const std::string& host, int port, int timeout_ms, bool nonblocking, std::string* err) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    const std::string service = std::to_string(port);
+    const int gai = getaddrinfo(host.c_str(), service.c_str(), &hints, &res);
+    if (gai != 0) {
+        if (err) *err = "resolve " + host + ": " + gai_strerror(gai);
+        return -1;
+    }
+
+    int fd = -1;
+    for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+        fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) continue;
+        set_nonblocking(fd, true);
+        int r = ::connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if (r < 0 && errno == EINPROGRESS) {
+            pollfd p{fd, POLLOUT, 0};
+            r = ::poll(&p, 1, timeout_ms);
+            int so_err = 0;
+            socklen_t len = sizeof(so_err);
+            if (r == 1 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &so_err, &len) == 0 && so_err == 0) {
+                r = 0;
+            } else {
+                errno = r == 0 ? ETIMEDOUT : (so_err ? so_err : errno);
+                r = -1;
+            }
+        }
+        if (r == 0) break;
+        if (err) *err = "connect " + host + ":" + service + ": " + errno_string();
+        close_fd(&fd);
+    }
+    freeaddrinfo(res);
+    if (fd < 0) return -1;
+
+    if (!nonblocking) set_nonblocking(fd, false);
+    set_tcp_nodelay(fd);
+    return fd;
+}
+
+int udp_bind(int port, std::string* err) {
+    int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        if (err) *err = "socket: " + errno_string();
+        return -1;
+    }
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        if (err) *err = "bind udp " + std::to_string(port) + ": " + errno_string();
+        close_fd(&fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool udp_bind_pair(int* rtp_fd, int* rtcp_fd, int* rtp_port, std::string* err) {
+    // 先让内核挑一个端口，再尝试凑成偶数/奇数相邻的一对
+    for (int attempt = 0; attempt < 16; ++attempt) {
+        int probe = udp_bind(0, err);
+        if (probe < 0) return false;
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        getsockname(probe, reinterpret_cast<sockaddr*>(&addr), &len);
+        int port = ntohs(addr.sin_port);
+        close_fd(&probe);
+        port &= ~1;
+        if (port < 1024) continue;
+
+        int a = udp_bind(port, err);
+        if (a < 0) continue;
+        int b = udp_bind(port + 1, err);
+        if (b < 0) {
+            close_fd(&a);
+            continue;
+        }
+        set_recv_buffer(a, 4 << 20);
+        *rtp_fd = a;
+        *rtcp_fd = b;
+        *rtp_port = port;
+        return true;
+    }
+    if (err) *err = "no free udp port pair";
+    return false;
+}
+
+bool send_all(int fd, const void* data, size_t size, int timeout_ms) {
+    const auto* p = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        const ssize_t n = ::send(fd, p, size, MSG_NOSIGNAL);
+        if (n > 0) {
+            p += n;
+            size -= static_cast<size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            pollfd pfd{fd, POLLOUT, 0};
+            if (::poll(&pfd, 1, timeout_ms) <= 0) return false;
+            continue;
+        }
+        return false;
+    }
+    return true;
+}
+
+}  // namespace roi
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace roi {
+
+// RTSP / RTMP 共用的最小 socket 工具函数，出错时返回 -1 / false 并写入 err
+
+// 建立 TCP 连接；nonblocking 为 false 时连接成功后恢复为阻塞模式
+int tcp_connect(const std::string& host, int port, int timeout_ms, bool nonblocking, std::string* err);
+
+// 在指定端口（0 表示任意）绑定 UDP socket，返回 fd
+int udp_bind(int port, std::string* err);
+
+// 绑定一对相邻的 RTP/RTCP 端口（RTP 为偶数端口）
+bool udp_bind_pair(int* rtp_fd, int* rtcp_fd, int* rtp_port, std::string* err);
+
+bool set_nonblocking(int fd, bool enable);
+bool set_tcp_nodelay(int fd);
+bool set_recv_buffer(int fd, int bytes);
+
+// 阻塞 socket 上发送完整数据，超时返回 false
+bool send_all(int fd, const void* data, size_t size, int timeout_ms);
+
+// 等待 fd 可读，返回 1 可读、0 超时、-1 出错
+int wait_readable(int fd, int timeout_ms);
+
+void close_fd(int* fd);
+
+std::string errno_string();
+
+}  // namespace roi
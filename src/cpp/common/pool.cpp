@@ -0,0 +1,43 @@
+#include "pool.h"
+
+namespace roi {
+
+namespace {
+
+constexpr size_t kBlockAlign = 64;
+
+}  // namespace
+
+BufferPool::BufferPool(size_t block_bytes, uint32_t count)
+    : block_bytes_((block_bytes + kBlockAlign - 1) / kBlockAlign * kBlockAlign),
+      pool_(count, [](PoolBuffer& b) { b.size = 0; }) {
+    std::shared_ptr<uint8_t> arena(new uint8_t[block_bytes_ * count + kBlockAlign],
+                                   std::default_delete<uint8_t[]>());
+    uint8_t* base = arena.get();
+    base += (kBlockAlign - reinterpret_cast<uintptr_t>(base) % kBlockAlign) % kBlockAlign;
+    size_t i = 0;
+    pool_.for_each([&](PoolBuffer& b) {
+        b.data = base + block_bytes_ * i++;
+        b.capacity = block_bytes_;
+        b.storage = arena;
+    });
+}
+
+PoolBufferPtr BufferPool::acquire(size_t size) {
+    if (size <= block_bytes_) {
+        if (PoolBufferPtr b = pool_.acquire()) {
+            b->size = size;
+            return b;
+        }
+    } else {
+        pool_.note_miss();
+    }
+    auto b = std::make_shared<PoolBuffer>();
+    b->storage.reset(new uint8_t[size ? size : 1], std::default_delete<uint8_t[]>());
+    b->data = b->storage.get();
+    b->capacity = size;
+    b->size = size;
+    return b;
+}
+
+}  // namespace roi
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace roi {
+
+struct PoolStats {
+    uint32_t capacity = 0;    // 池中对象总数
+    uint32_t in_use = 0;      // 正被下游持有的对象数，长期接近 capacity 说明下游在积压
+    uint32_t high_water = 0;  // in_use 的历史最大值
+    uint64_t acquired = 0;    // 从池中取出的次数
+    uint64_t misses = 0;      // 池空（或请求超过块大小）而退回堆分配的次数
+};
+
+// 定长对象池：对象在构造时一次分配好，acquire() 返回的 shared_ptr 最后一个引用释放时，
+// 对象先经 recycle 清理，再回到空闲表。shared_ptr 的控制块也放在每个槽位里（定制分配器），
+// 稳态下取用和归还都不触碰堆。池可以先于取出的对象析构，内存在最后一个对象归还后才释放。
+template <typename T>
+class ObjectPool {
+public:
+    using Recycle = std::function<void(T&)>;
+
+    explicit ObjectPool(uint32_t count, Recycle recycle = nullptr) : state_(std::make_shared<State>()) {
+        state_->recycle = std::move(recycle);
+        state_->slots.reserve(count);
+        state_->free.reserve(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            state_->slots.emplace_back(new Slot());
+            state_->free.push_back(state_->slots.back().get());
+        }
+        state_->stats.capacity = count;
+    }
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    // 初始化每个对象（例如分配缓冲），只在还没有对象被取出时调用
+    template <typename F>
+    void for_each(F f) {
+        for (auto& slot : state_->slots) f(slot->value);
+    }
+
+    // 池空返回空指针并计入 misses，调用方自行决定退回堆分配还是等待
+    std::shared_ptr<T> acquire() {
+        Slot* slot = state_->pop();
+        if (!slot) return nullptr;
+        return std::shared_ptr<T>(&slot->value, Deleter{state_.get()}, Allocator<T>(state_, slot));
+    }
+
+    // 池外分配的对象计入 misses，让 stats() 反映全部取用
+    void note_miss() {
+        std::lock_guard<std::mutex> lk(state_->mutex);
+        ++state_->stats.misses;
+    }
+
+    PoolStats stats() const {
+        std::lock_guard<std::mutex> lk(state_->mutex);
+        return state_->stats;
+    }
+
+private:
+    // libstdc++ / libc++ 的 _Sp_counted_deleter 约 56 字节，留出余量
+    static constexpr size_t kControlBytes = 96;
+
+    struct Slot {
+        T value{};
+        alignas(std::max_align_t) unsigned char control[kControlBytes];
+    };
+
+    struct State {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Slot>> slots;
+        std::vector<Slot*> free;
+        Recycle recycle;
+        PoolStats stats;
+
+        State() = default;
+
+        Slot* pop() {
+            std::lock_guard<std::mutex> lk(mutex);
+            if (free.empty()) {
+                ++stats.misses;
+                return nullptr;
+            }
+            Slot* slot = free.back();
+            free.pop_back();
+            ++stats.acquired;
+            stats.in_use = static_cast<uint32_t>(slots.size() - free.size());
+            if (stats.in_use > stats.high_water) stats.high_water = stats.in_use;
+            return slot;
+        }
+
+        void push(Slot* slot) {
+            std::lock_guard<std::mutex> lk(mutex);
+            free.push_back(slot);
+            stats.in_use = static_cast<uint32_t>(slots.size() - free.size());
+        }
+    };
+
+    struct Deleter {
+        State* state;  // 控制块里的分配器持有 State，删除器执行时它一定还在
+        void operator()(T* p) const {
+            if (state->recycle) state->recycle(*p);
+        }
+    };
+
+    // 把控制块放进槽位；控制块释放（在删除器之后）时槽位才回到空闲表
+    template <typename U>
+    struct Allocator {
+        using value_type = U;
+        template <typename V>
+        struct rebind {
+            using other = Allocator<V>;
+        };
+
+        Allocator(std::shared_ptr<State> s, Slot* sl) : state(std::move(s)), slot(sl) {}
+        template <typename V>
+        Allocator(const Allocator<V>& other) : state(other.state), slot(other.slot) {}
+
+        U* allocate(size_t) {
+            static_assert(sizeof(U) <= kControlBytes, "shared_ptr control block does not fit the pool slot");
+            static_assert(alignof(U) <= alignof(std::max_align_t), "shared_ptr control block over-aligned");
+            return reinterpret_cast<U*>(slot->control);
+        }
+        void deallocate(U*, size_t) { state->push(slot); }
+
+        template <typename V>
+        bool operator==(const Allocator<V>& other) const {
+            return slot == other.slot;
+        }
+        template <typename V>
+        bool operator!=(const Allocator<V>& other) const {
+            return slot != other.slot;
+        }
+
+        std::shared_ptr<State> state;
+        Slot* slot;
+    };
+
+    std::shared_ptr<State> state_;
+};
+
+// 一块字节缓冲：data 指向 capacity 字节，size 是写入的长度
+struct PoolBuffer {
+    uint8_t* data = nullptr;
+    size_t capacity = 0;
+    size_t size = 0;
+    std::shared_ptr<uint8_t> storage;  // 池内是整块 arena，池外是单独的堆分配
+};
+
+using PoolBufferPtr = std::shared_ptr<PoolBuffer>;
+
+// 定长字节块池：一整块 arena 在构造时分配并切成 count 块，运行期不再分配。
+// 池空或请求超过块大小时退回堆分配（计入 misses），调用方不必处理失败。
+class BufferPool {
+public:
+    BufferPool(size_t block_bytes, uint32_t count);
+
+    PoolBufferPtr acquire(size_t size);
+    PoolStats stats() const { return pool_.stats(); }
+    size_t block_bytes() const { return block_bytes_; }
+
+private:
+    size_t block_bytes_;
+    ObjectPool<PoolBuffer> pool_;
+};
+
+}  // namespace roi
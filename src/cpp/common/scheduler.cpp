@@ -0,0 +1,292 @@
+#include "scheduler.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace roi {
+
+namespace {
+
+// 当前线程所属的线程池和工作线程下标，外部线程为 nullptr / -1
+thread_local WorkerPool* t_pool = nullptr;
+thread_local int t_index = -1;
+
+constexpr int kSpinRounds = 64;  // 睡眠前让出 CPU 的次数
+
+}  // namespace
+
+bool CpuSet::parse(const std::string& text, CpuSet* out, std::string* err) {
+    out->cpus.clear();
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t comma = text.find(',', pos);
+        if (comma == std::string::npos) comma = text.size();
+        const std::string item = text.substr(pos, comma - pos);
+        pos = comma + 1;
+        if (item.empty()) continue;
+        int lo = 0, hi = 0;
+        char* end = nullptr;
+        lo = static_cast<int>(std::strtol(item.c_str(), &end, 10));
+        hi = lo;
+        if (*end == '-') hi = static_cast<int>(std::strtol(end + 1, &end, 10));
+        if (*end != '\0' || lo < 0 || hi < lo || hi >= CPU_SETSIZE) {
+            if (err) *err = "bad cpu list '" + text + "'";
+            return false;
+        }
+        for (int c = lo; c <= hi; ++c) out->cpus.push_back(c);
+    }
+    std::sort(out->cpus.begin(), out->cpus.end());
+    out->cpus.erase(std::unique(out->cpus.begin(), out->cpus.end()), out->cpus.end());
+    return true;
+}
+
+std::string CpuSet::to_string() const {
+    std::string s;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) ++j;
+        if (!s.empty()) s += ',';
+        s += std::to_string(cpus[i]);
+        if (j > i) s += '-' + std::to_string(cpus[j]);
+        i = j + 1;
+    }
+    return s;
+}
+
+bool pin_current_thread(const CpuSet& cpus, const char* name, std::string* err) {
+    if (name && *name) {
+        char buf[16];
+        std::strncpy(buf, name, sizeof(buf) - 1);
+        buf[sizeof(buf) - 1] = '\0';
+        pthread_setname_np(pthread_self(), buf);
+    }
+    if (cpus.empty()) return true;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c : cpus.cpus) CPU_SET(c, &set);
+    const int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc != 0) {
+        if (err) *err = "pthread_setaffinity_np(" + cpus.to_string() + "): " + std::strerror(rc);
+        return false;
+    }
+    return true;
+}
+
+// ---------------- WorkerPool ----------------
+
+WorkerPool::WorkerPool(int threads, CpuSet cpus, std::string name) : name_(std::move(name)), cpus_(std::move(cpus)) {
+    threads = std::max(1, threads);
+    workers_.reserve(size_t(threads));
+    for (int i = 0; i < threads; ++i) workers_.emplace_back(new Worker());
+    for (int i = 0; i < threads; ++i) workers_[size_t(i)]->thread = std::thread(&WorkerPool::run, this, i);
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lk(park_mutex_);
+        stop_.store(true);
+    }
+    park_cv_.notify_all();
+    for (auto& w : workers_) {
+        if (w->thread.joinable()) w->thread.join();
+    }
+}
+
+void WorkerPool::submit(Task task) {
+    const int n = threads();
+    const int target = t_pool == this ? t_index : static_cast<int>(next_.fetch_add(1) % uint32_t(n));
+    {
+        std::lock_guard<std::mutex> lk(workers_[size_t(target)]->mutex);
+        workers_[size_t(target)]->queue.push_back(std::move(task));
+    }
+    // pending_ 先于 sleepers_ 读取：睡眠方在锁内先加 sleepers_ 再检查 pending_，两者不会同时错过
+    pending_.fetch_add(1);
+    if (sleepers_.load() > 0) {
+        std::lock_guard<std::mutex> lk(park_mutex_);
+        park_cv_.notify_one();
+    }
+}
+
+bool WorkerPool::pop(int self, Task* task) {
+    const int n = threads();
+    if (self >= 0) {
+        Worker& own = *workers_[size_t(self)];
+        std::lock_guard<std::mutex> lk(own.mutex);
+        if (!own.queue.empty()) {
+            *task = std::move(own.queue.back());
+            own.queue.pop_back();
+            pending_.fetch_sub(1);
+            return true;
+        }
+    }
+    const int start = self >= 0 ? self + 1 : static_cast<int>(next_.load() % uint32_t(n));
+    for (int k = 0; k < n; ++k) {
+        const int victim = (start + k) % n;
+        if (victim == self) continue;
+        Worker& w = *workers_[size_t(victim)];
+        std::lock_guard<std::mutex> lk(w.mutex);
+        if (!w.queue.empty()) {
+            *task = std::move(w.queue.front());
+            w.queue.pop_front();
+            pending_.fetch_sub(1);
+            if (self >= 0) stolen_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WorkerPool::run_one() {
+    Task task;
+    if (!pop(t_pool == this ? t_index : -1, &task)) return false;
+    task();
+    executed_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void WorkerPool::run(int index) {
+    t_pool = this;
+    t_index = index;
+    pin_current_thread(cpus_, (name_ + "-" + std::to_string(index)).c_str(), nullptr);
+    int idle = 0;
+    while (!stop_.load(std::memory_order_relaxed)) {
+        if (run_one()) {
+            idle = 0;
+            continue;
+        }
+        if (++idle < kSpinRounds) {
+            std::this_thread::yield();
+            continue;
+        }
+        idle = 0;
+        std::unique_lock<std::mutex> lk(park_mutex_);
+        sleepers_.fetch_add(1);
+        if (pending_.load() == 0 && !stop_.load()) {
+            parked_.fetch_add(1, std::memory_order_relaxed);
+            park_cv_.wait(lk, [this] { return pending_.load() > 0 || stop_.load(); });
+        }
+        sleepers_.fetch_sub(1);
+    }
+    t_pool = nullptr;
+    t_index = -1;
+}
+
+void WorkerPool::parallel_for(int begin, int end, int grain, const std::function<void(int, int)>& fn) {
+    if (end <= begin) return;
+    grain = std::max(1, grain);
+    const int chunks = std::min(threads() + 1, (end - begin + grain - 1) / grain);
+    if (chunks <= 1) {
+        fn(begin, end);
+        return;
+    }
+    const int step = (end - begin + chunks - 1) / chunks;
+    TaskGroup group(this);
+    for (int b = begin + step; b < end; b += step) {
+        const int e = std::min(end, b + step);
+        group.run([&fn, b, e] { fn(b, e); });
+    }
+    // 第一段在调用线程上执行
+    fn(begin, std::min(end, begin + step));
+    group.wait();
+}
+
+WorkerPoolStats WorkerPool::stats() const {
+    WorkerPoolStats st;
+    st.threads = uint32_t(workers_.size());
+    st.executed = executed_.load(std::memory_order_relaxed);
+    st.stolen = stolen_.load(std::memory_order_relaxed);
+    st.parked = parked_.load(std::memory_order_relaxed);
+    return st;
+}
+
+// ---------------- TaskGroup ----------------
+
+void TaskGroup::run(WorkerPool::Task task) {
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        ++remaining_;
+    }
+    pool_->submit([this, task = std::move(task)] {
+        task();
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (--remaining_ == 0) cv_.notify_all();
+    });
+}
+
+void TaskGroup::wait() {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            if (remaining_ == 0) return;
+        }
+        // 先帮着执行排队的任务（可能正是本组的任务）；队列都空了说明剩下的正在别的线程上运行
+        if (!pool_->run_one()) break;
+    }
+    std::unique_lock<std::mutex> lk(mutex_);
+    cv_.wait(lk, [this] { return remaining_ == 0; });
+}
+
+// ---------------- Scheduler ----------------
+
+Scheduler& Scheduler::instance() {
+    static Scheduler scheduler;
+    return scheduler;
+}
+
+bool Scheduler::configure(const SchedulerConfig& config, std::string* err) {
+    for (const CpuSet& set : config.cpus) {
+        for (int c : set.cpus) {
+            if (c >= CPU_SETSIZE) {
+                if (err) *err = "cpu " + std::to_string(c) + " out of range";
+                return false;
+            }
+        }
+    }
+    std::shared_ptr<WorkerPool> pool;
+    if (config.workers > 0) {
+        pool = std::make_shared<WorkerPool>(config.workers, config.cpus[int(ThreadRole::kWorker)], "roi-cpu");
+    }
+    std::shared_ptr<WorkerPool> old;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        config_ = config;
+        old = std::move(pool_);
+        pool_ = std::move(pool);
+    }
+    // 旧的线程池在最后一个使用者放手后才停止
+    return true;
+}
+
+void Scheduler::enter(ThreadRole role, const char* name) {
+    CpuSet cpus;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        cpus = config_.cpus[int(role)];
+    }
+    pin_current_thread(cpus, name, nullptr);
+}
+
+std::shared_ptr<WorkerPool> Scheduler::pool() const {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return pool_;
+}
+
+void Scheduler::parallel_for(int begin, int end, int grain, const std::function<void(int, int)>& fn) {
+    std::shared_ptr<WorkerPool> pool = this->pool();
+    if (pool) {
+        pool->parallel_for(begin, end, grain, fn);
+    } else if (end > begin) {
+        fn(begin, end);
+    }
+}
+
+SchedulerConfig Scheduler::config() const {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return config_;
+}
+
+}  // namespace roi
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace roi {
+
+// CPU 编号集合，按 "0-3,6" 这样的列表解析；为空表示不限制
+struct CpuSet {
+    std::vector<int> cpus;
+
+    static bool parse(const std::string& text, CpuSet* out, std::string* err);
+    bool empty() const { return cpus.empty(); }
+    std::string to_string() const;
+};
+
+// 把调用线程绑定到 cpus（为空时不改动），name 非空时设置线程名（最多 15 个字符，显示在 top -H 里）
+bool pin_current_thread(const CpuSet& cpus, const char* name, std::string* err);
+
+struct WorkerPoolStats {
+    uint32_t threads = 0;
+    uint64_t executed = 0;  // 完成的任务数
+    uint64_t stolen = 0;    // 其中从别的线程队列偷来的
+    uint64_t parked = 0;    // 工作线程因没有任务而睡眠的次数
+};
+
+// CPU 阶段的工作窃取线程池。
+//
+// 每个工作线程有自己的双端队列：在工作线程里提交的任务进本线程队列（LIFO，缓存里还是热的），
+// 外部线程提交的任务轮流放进各队列；线程自己的队列空了就从别的队列头部偷（FIFO，偷最老的）。
+// 都空时先让出几次 CPU，再在条件变量上睡眠，不会空转占核。等待子任务的一方（parallel_for、
+// TaskGroup::wait）先帮着执行排队的任务，没有可执行的才阻塞，嵌套提交不会死锁。
+class WorkerPool {
+public:
+    using Task = std::function<void()>;
+
+    WorkerPool(int threads, CpuSet cpus, std::string name);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void submit(Task task);
+    // 在调用线程上执行一个排队的任务，没有任务时返回 false
+    bool run_one();
+    // 把 [begin, end) 切成至少 grain 个一段并行执行 fn(b, e)，返回时全部完成
+    void parallel_for(int begin, int end, int grain, const std::function<void(int, int)>& fn);
+
+    int threads() const { return static_cast<int>(workers_.size()); }
+    WorkerPoolStats stats() const;
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> queue;
+        std::thread thread;
+    };
+
+    bool pop(int self, Task* task);
+    void run(int index);
+
+    std::string name_;
+    CpuSet cpus_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::mutex park_mutex_;
+    std::condition_variable park_cv_;
+    std::atomic<int> pending_{0};
+    std::atomic<int> sleepers_{0};
+    std::atomic<bool> stop_{false};
+    std::atomic<uint32_t> next_{0};
+    std::atomic<uint64_t> executed_{0};
+    std::atomic<uint64_t> stolen_{0};
+    std::atomic<uint64_t> parked_{0};
+};
+
+// 一组任务的完成计数：wait() 先帮线程池执行任务，没有可执行的再阻塞到全部完成
+class TaskGroup {
+public:
+    explicit TaskGroup(WorkerPool* pool) : pool_(pool) {}
+    ~TaskGroup() { wait(); }
+
+    void run(WorkerPool::Task task);
+    void wait();
+
+private:
+    WorkerPool* pool_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    int remaining_ = 0;
+};
+
+// 原生线程的角色，每种角色可以单独指定 CPU
+enum class ThreadRole : int {
+    kRtsp = 0,  // RTSP 收流（共享 I/O 线程按 kRtsp 与 kRtmp 的并集绑核）
+    kDecode,    // 解码会话（向 VPU 提交码流、取回帧）
+    kInfer,     // 推理提交（TPU），由 Python 的推理线程调用 enter()
+    kRtmp,      // RTMP 推流
+    kWorker,    // WorkerPool 的 CPU 阶段
+    kCount,
+};
+
+struct SchedulerConfig {
+    int workers = 0;     // WorkerPool 线程数，0 时不建线程池，CPU 阶段在调用线程上串行执行
+    int io_threads = 1;  // 所有 RTSP / RTMP 会话共用的 IoLoop 线程数
+    CpuSet cpus[static_cast<int>(ThreadRole::kCount)];
+};
+
+// 进程内的线程布局：各角色的 CPU 绑定和共享的 WorkerPool。
+//
+// SE5 上 8 个 A53 核，典型布局是收流和推流共用 0 核、解码 1 核、推理提交 2 核、
+// 线程池 3-7 核，编码和推理不再落到同一个核上互相抢占。没有调用 configure() 时
+// 不绑核、没有线程池，行为与之前相同。
+class Scheduler {
+public:
+    static Scheduler& instance();
+
+    // 重新配置；已经在运行的专用线程在下次启动时才按新配置绑核
+    bool configure(const SchedulerConfig& config, std::string* err);
+    // 专用线程启动时调用：按角色绑核并设置线程名
+    void enter(ThreadRole role, const char* name);
+
+    // 没有配置线程池时返回空指针
+    std::shared_ptr<WorkerPool> pool() const;
+    // 有线程池时并行执行，否则在调用线程上一次执行完
+    void parallel_for(int begin, int end, int grain, const std::function<void(int, int)>& fn);
+    SchedulerConfig config() const;
+
+private:
+    Scheduler() = default;
+
+    mutable std::mutex mutex_;
+    SchedulerConfig config_;
+    std::shared_ptr<WorkerPool> pool_;
+};
+
+}  // namespace roi
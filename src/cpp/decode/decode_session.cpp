@@ -0,0 +1,124 @@
+#include "decode_session.h"
+
+#include "../common/scheduler.h"
+
+namespace roi {
+
+namespace {
+
+constexpr size_t kMaxArrivals = 64;  // 远大于解码器的重排序深度，找不到的条目是解码失败的 AU
+
+}  // namespace
+
+DecodeSession::DecodeSession(AuRing* ring, DecodeSessionConfig config) : ring_(ring), config_(config) {
+    if (config_.queue_depth == 0) config_.queue_depth = 1;
+    // 队列之外，推理、编码、预览各自可能还压着一两帧
+    if (config_.decoder.pool_frames <= 0) config_.decoder.pool_frames = static_cast<int>(config_.queue_depth) + 6;
+}
+
+DecodeSession::~DecodeSession() { stop(); }
+
+bool DecodeSession::start(std::string* err) {
+    if (running_.load()) return true;
+    decoder_ = VideoDecoder::create(config_.decoder, err);
+    if (!decoder_) return false;
+    consumer_ = ring_->add_consumer();
+    if (consumer_ < 0) {
+        if (err) *err = "too many consumers on rtsp ring";
+        decoder_.reset();
+        return false;
+    }
+    running_.store(true);
+    thread_ = std::thread(&DecodeSession::run, this);
+    return true;
+}
+
+void DecodeSession::stop() {
+    if (!running_.exchange(false)) return;
+    ring_->wake_all();
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        not_full_.notify_all();
+    }
+    if (thread_.joinable()) thread_.join();
+    ring_->remove_consumer(consumer_);
+    consumer_ = -1;
+    std::lock_guard<std::mutex> lk(mutex_);
+    queue_.clear();
+    not_empty_.notify_all();
+}
+
+void DecodeSession::run() {
+    Scheduler::instance().enter(ThreadRole::kDecode, "roi-decode");
+    AccessUnitView au;
+    SurfacePtr surface;
+    while (running_.load(std::memory_order_relaxed)) {
+        if (!ring_->wait(consumer_, &au, std::chrono::milliseconds(100))) continue;
+        if (au.flags & kAuDiscontinuity) {
+            decoder_->flush();
+            arrivals_.clear();
+        }
+        arrivals_.emplace_back(au.pts, au.arrival_us);
+        if (arrivals_.size() > kMaxArrivals) arrivals_.pop_front();
+        const int64_t arrival_us = au.arrival_us;
+        const bool ok = decoder_->send(au);
+        ring_->release(consumer_);
+        if (!ok) {
+            errors_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        while (decoder_->receive(&surface)) {
+            decoded_.fetch_add(1, std::memory_order_relaxed);
+            surface->arrival_us = take_arrival(surface->pts, arrival_us);
+            push(std::move(surface));
+        }
+    }
+}
+
+int64_t DecodeSession::take_arrival(int64_t pts, int64_t fallback) {
+    for (auto it = arrivals_.begin(); it != arrivals_.end(); ++it) {
+        if (it->first != pts) continue;
+        const int64_t arrival_us = it->second;
+        arrivals_.erase(it);
+        return arrival_us;
+    }
+    return fallback;
+}
+
+void DecodeSession::push(SurfacePtr s) {
+    std::unique_lock<std::mutex> lk(mutex_);
+    if (queue_.size() >= config_.queue_depth) {
+        if (config_.drop_oldest) {
+            queue_.pop_front();
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            not_full_.wait(lk, [&] { return queue_.size() < config_.queue_depth || !running_.load(); });
+            if (!running_.load()) return;
+        }
+    }
+    queue_.push_back(std::move(s));
+    not_empty_.notify_one();
+}
+
+bool DecodeSession::read(SurfacePtr* out, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lk(mutex_);
+    if (!not_empty_.wait_for(lk, timeout, [&] { return !queue_.empty() || !running_.load(); })) return false;
+    if (queue_.empty()) return false;
+    *out = std::move(queue_.front());
+    queue_.pop_front();
+    not_full_.notify_one();
+    return true;
+}
+
+DecodeStats DecodeSession::stats() const {
+    DecodeStats st;
+    st.decoded = decoded_.load(std::memory_order_relaxed);
+    st.dropped = dropped_.load(std::memory_order_relaxed);
+    st.errors = errors_.load(std::memory_order_relaxed);
+    if (decoder_) st.pool = decoder_->pool_stats();
+    std::lock_guard<std::mutex> lk(mutex_);
+    st.queued = static_cast<uint32_t>(queue_.size());
+    return st;
+}
+
+}  // namespace roi
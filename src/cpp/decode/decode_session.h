@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "../common/au_ring.h"
+#include "video_decoder.h"
+
+namespace roi {
+
+struct DecodeSessionConfig {
+    DecoderConfig decoder;
+    size_t queue_depth = 4;   // 输出队列长度
+    bool drop_oldest = true;  // 队列满时丢最旧的帧；false 则阻塞解码线程
+};
+
+struct DecodeStats {
+    uint64_t decoded = 0;
+    uint64_t dropped = 0;  // 输出队列溢出丢弃的帧
+    uint64_t errors = 0;
+    uint32_t queued = 0;
+    PoolStats pool;  // 解码输出帧池
+};
+
+// 一个解码线程：作为 AuRing 的消费者取 AU，解码后放入有界输出队列
+class DecodeSession {
+public:
+    DecodeSession(AuRing* ring, DecodeSessionConfig config);
+    ~DecodeSession();
+    DecodeSession(const DecodeSession&) = delete;
+    DecodeSession& operator=(const DecodeSession&) = delete;
+
+    bool start(std::string* err);
+    void stop();
+
+    bool read(SurfacePtr* out, std::chrono::milliseconds timeout);
+
+    const char* backend_name() const { return decoder_ ? decoder_->name() : ""; }
+    bool hardware() const { return decoder_ && decoder_->hardware(); }
+    DecodeStats stats() const;
+
+private:
+    void run();
+    void push(SurfacePtr s);
+    // 按 pts 找回解码输出对应的 AU 的到达时刻（解码器会重排序、攒帧）
+    int64_t take_arrival(int64_t pts, int64_t fallback);
+
+    AuRing* ring_;
+    DecodeSessionConfig config_;
+    std::unique_ptr<VideoDecoder> decoder_;
+    int consumer_ = -1;
+    std::deque<std::pair<int64_t, int64_t>> arrivals_;  // (pts, arrival_us)，只在解码线程访问
+
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+
+    mutable std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<SurfacePtr> queue_;
+
+    std::atomic<uint64_t> decoded_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> errors_{0};
+};
+
+}  // namespace roi
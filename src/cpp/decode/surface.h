@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+namespace roi {
+
+enum class MemoryKind : uint8_t {
+    kHost = 0,    // 普通主机内存（软件解码）
+    kDevice = 1,  // VPU/TPU 可直接访问的设备内存（SE5 硬件解码）
+};
+
+// 解码输出的一帧 NV12 图像。
+// 设备内存的帧在 zero-copy 模式下可能没有主机映射（data[] 为空），
+// 这时下游（预处理、编码）应直接使用 device[] 中的物理地址。
+struct Surface {
+    int width = 0;
+    int height = 0;
+    int64_t pts = 0;   // 90kHz
+    uint64_t seq = 0;  // 来源 AU 的序号
+    int64_t arrival_us = 0;  // 来源 AU 收齐的时刻，见 AccessUnitView::arrival_us
+    MemoryKind memory = MemoryKind::kHost;
+    int device_index = 0;
+
+    uint8_t* data[2] = {nullptr, nullptr};  // Y、交错 UV 平面的主机地址
+    int pitch[2] = {0, 0};
+    uint64_t device[2] = {0, 0};  // Y、UV 平面的设备物理地址
+
+    std::shared_ptr<void> owner;  // 持有底层解码缓冲（AVFrame 等）
+
+    bool has_host() const { return data[0] != nullptr; }
+};
+
+using SurfacePtr = std::shared_ptr<Surface>;
+
+}  // namespace roi
@@ -0,0 +1,116 @@
+#include "surface_scaler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../common/bilinear.h"
+#include "../common/scheduler.h"
+
+namespace roi {
+
+namespace {
+
+constexpr int kRowGrain = 32;  // 每个并行任务至少处理的输出行数
+constexpr int kPitchAlign = 64;
+
+}  // namespace
+
+SurfaceScaler::SurfaceScaler(int width, int height, int pool_frames)
+    : width_(std::max(2, width & ~1)),
+      height_(std::max(2, height & ~1)),
+      pitch_((width_ + kPitchAlign - 1) / kPitchAlign * kPitchAlign),
+      pool_(uint32_t(pool_frames > 0 ? pool_frames : 1), [](Slot& slot) {
+          // 只清掉帧信息，缓冲留给下一帧
+          uint8_t* data = slot.surface.data[0];
+          const int pitch = slot.surface.pitch[0];
+          slot.surface = Surface();
+          slot.surface.data[0] = data;
+          slot.surface.pitch[0] = pitch;
+      }) {
+    pool_.for_each([this](Slot& slot) { allocate(slot); });
+}
+
+void SurfaceScaler::allocate(Slot& slot) const {
+    const size_t luma = size_t(pitch_) * height_;
+    slot.data.reset(new uint8_t[luma + luma / 2]);
+    slot.surface.data[0] = slot.data.get();
+    slot.surface.pitch[0] = pitch_;
+}
+
+void SurfaceScaler::prepare(int src_w, int src_h) {
+    if (src_w == src_w_ && src_h == src_h_) return;
+    src_w_ = src_w;
+    src_h_ = src_h;
+    build_bilinear_taps(width_, src_w, &xs_);
+    build_bilinear_taps(height_, src_h, &ys_);
+    build_bilinear_taps(width_ / 2, (src_w + 1) / 2, &uv_xs_);
+    build_bilinear_taps(height_ / 2, (src_h + 1) / 2, &uv_ys_);
+}
+
+bool SurfaceScaler::scale(const Surface& src, SurfacePtr* out, std::string* err) {
+    if (!src.has_host() || !src.data[1]) {
+        if (err) *err = "surface has no host mapping";
+        return false;
+    }
+    if (src.width <= 0 || src.height <= 0) {
+        if (err) *err = "empty surface";
+        return false;
+    }
+    std::shared_ptr<Slot> slot = pool_.acquire();
+    if (!slot) {
+        // 下游压着的帧超过了池的大小，临时分配一个槽位，归还时直接释放
+        slot = std::make_shared<Slot>();
+        allocate(*slot);
+    }
+    prepare(src.width, src.height);
+
+    Surface* s = &slot->surface;
+    s->width = width_;
+    s->height = height_;
+    s->pts = src.pts;
+    s->seq = src.seq;
+    s->arrival_us = src.arrival_us;
+    s->memory = MemoryKind::kHost;
+    s->device_index = src.device_index;
+    s->data[1] = s->data[0] + size_t(pitch_) * height_;
+    s->pitch[1] = pitch_;
+
+    const uint8_t* y = src.data[0];
+    const uint8_t* uv = src.data[1];
+    const int pitch_y = src.pitch[0];
+    const int pitch_uv = src.pitch[1];
+    const int uv_rows = height_ / 2;
+    // Y 和 UV 的输出行一起按行段分给 CPU 线程池：前 height_ 行是亮度，之后是色度
+    Scheduler::instance().parallel_for(0, height_ + uv_rows, kRowGrain, [&](int row_begin, int row_end) {
+        for (int row = row_begin; row < row_end; ++row) {
+            if (row < height_) {
+                const Tap& ty = ys_[size_t(row)];
+                const uint8_t* r0 = y + size_t(ty.i0) * pitch_y;
+                const uint8_t* r1 = y + size_t(ty.i1) * pitch_y;
+                uint8_t* dst = s->data[0] + size_t(row) * pitch_;
+                for (int x = 0; x < width_; ++x) {
+                    const Tap& tx = xs_[size_t(x)];
+                    dst[x] = uint8_t(bilinear(r0[tx.i0], r0[tx.i1], r1[tx.i0], r1[tx.i1], tx.w1, ty.w1));
+                }
+            } else {
+                const int cy = row - height_;
+                const Tap& ty = uv_ys_[size_t(cy)];
+                const uint8_t* r0 = uv + size_t(ty.i0) * pitch_uv;
+                const uint8_t* r1 = uv + size_t(ty.i1) * pitch_uv;
+                uint8_t* dst = s->data[1] + size_t(cy) * pitch_;
+                for (int x = 0; x < width_ / 2; ++x) {
+                    const Tap& tx = uv_xs_[size_t(x)];
+                    const int a = 2 * tx.i0;
+                    const int b = 2 * tx.i1;
+                    dst[2 * x] = uint8_t(bilinear(r0[a], r0[b], r1[a], r1[b], tx.w1, ty.w1));
+                    dst[2 * x + 1] = uint8_t(bilinear(r0[a + 1], r0[b + 1], r1[a + 1], r1[b + 1], tx.w1, ty.w1));
+                }
+            }
+        }
+    });
+    // 别名指针：Surface 与槽位共用一个控制块
+    *out = SurfacePtr(std::move(slot), s);
+    return true;
+}
+
+}  // namespace roi
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../common/bilinear.h"
+#include "../common/pool.h"
+#include "surface.h"
+
+namespace roi {
+
+// 把解码帧缩放到固定的输出尺寸（NV12 → NV12，双线性），供多码率输出中较小的码流使用。
+// 输出帧来自自己的帧池，稳态下不分配；输出与源帧无关联，源帧可以先归还。
+// 同一个 SurfaceScaler 的 scale() 不能并发调用（插值系数表按源尺寸缓存）。
+// 只接受有主机映射的帧：只在设备内存里的帧（SE5 zero-copy 解码）返回 false。
+class SurfaceScaler {
+public:
+    // pool_frames 为输出帧池的大小，池满时退回堆分配并计入 misses
+    SurfaceScaler(int width, int height, int pool_frames);
+
+    bool scale(const Surface& src, SurfacePtr* out, std::string* err);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    PoolStats pool_stats() const { return pool_.stats(); }
+
+private:
+    using Tap = BilinearTap;
+
+    struct Slot {
+        Surface surface;
+        std::unique_ptr<uint8_t[]> data;  // Y 平面之后紧跟交错的 UV 平面
+    };
+
+    void prepare(int src_w, int src_h);
+    void allocate(Slot& slot) const;
+
+    int width_;
+    int height_;
+    int pitch_;
+    int src_w_ = 0;
+    int src_h_ = 0;
+    std::vector<Tap> xs_;
+    std::vector<Tap> ys_;
+    std::vector<Tap> uv_xs_;
+    std::vector<Tap> uv_ys_;
+    ObjectPool<Slot> pool_;
+};
+
+}  // namespace roi
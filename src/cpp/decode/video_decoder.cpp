@@ -0,0 +1,216 @@
+#include "video_decoder.h"
+
+#include <cstring>
+
+#ifdef HAVE_FFMPEG
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/dict.h>
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+}
+#endif
+
+namespace roi {
+
+#ifdef HAVE_FFMPEG
+
+namespace {
+
+// 输出帧池的一个槽位：Surface 本身、持有解码缓冲引用的 AVFrame，
+// 以及软件解码时交错后的 UV 平面（按分辨率分配一次，之后复用）
+struct DecodedSlot {
+    Surface surface;
+    AVFrame* frame = nullptr;
+    std::unique_ptr<uint8_t[]> uv;
+    size_t uv_bytes = 0;
+    ~DecodedSlot() { av_frame_free(&frame); }
+};
+
+// 归还时只解除对解码缓冲的引用，AVFrame 结构和 UV 平面留给下一帧
+void recycle_slot(DecodedSlot& slot) {
+    av_frame_unref(slot.frame);
+    slot.surface = Surface();
+}
+
+// 同一套 FFmpeg 接口承载两种后端：Sophon 版 FFmpeg 的 *_bm 解码器跑在 VPU 上，
+// 输出的 NV12 留在设备内存；标准解码器跑在 CPU 上，输出 I420 后转成 NV12。
+class FfmpegDecoder : public VideoDecoder {
+public:
+    explicit FfmpegDecoder(int pool_frames) : pool_(uint32_t(pool_frames > 0 ? pool_frames : 1), recycle_slot) {
+        pool_.for_each([](DecodedSlot& slot) { slot.frame = av_frame_alloc(); });
+    }
+
+    ~FfmpegDecoder() override {
+        av_packet_free(&packet_);
+        av_frame_free(&frame_);
+        avcodec_free_context(&ctx_);
+    }
+
+    bool open(const DecoderConfig& config, bool hardware, std::string* err) {
+        hardware_ = hardware;
+        device_index_ = config.device_index;
+        const bool hevc = config.codec == Codec::kH265;
+        const char* name = hardware ? (hevc ? "hevc_bm" : "h264_bm") : (hevc ? "hevc" : "h264");
+        const AVCodec* codec = avcodec_find_decoder_by_name(name);
+        if (!codec) {
+            if (err) *err = std::string("decoder not available: ") + name;
+            return false;
+        }
+        ctx_ = avcodec_alloc_context3(codec);
+        if (!ctx_) return false;
+        ctx_->flags |= AV_CODEC_FLAG_LOW_DELAY;
+
+        AVDictionary* opts = nullptr;
+        if (hardware) {
+            av_dict_set_int(&opts, "sophon_idx", config.device_index, 0);
+            av_dict_set_int(&opts, "zero_copy", config.keep_on_device ? 1 : 0, 0);
+            av_dict_set_int(&opts, "output_format", 0, 0);  // 非压缩 NV12
+            av_dict_set_int(&opts, "cbcr_interleave", 1, 0);
+            av_dict_set_int(&opts, "extra_frame_buffer_num", 2, 0);
+        } else {
+            ctx_->thread_count = config.threads;
+            ctx_->thread_type = FF_THREAD_SLICE;  // 帧级多线程会多出若干帧延迟
+        }
+        const int r = avcodec_open2(ctx_, codec, &opts);
+        av_dict_free(&opts);
+        if (r < 0) {
+            if (err) *err = std::string("avcodec_open2 failed for ") + name;
+            return false;
+        }
+        name_ = name;
+        packet_ = av_packet_alloc();
+        frame_ = av_frame_alloc();
+        return packet_ && frame_;
+    }
+
+    bool send(const AccessUnitView& au) override {
+        // packet 不带引用计数，FFmpeg 会在 send 内部拷贝一份，
+        // 所以调用方可以在返回后立即释放环形缓冲区中的 AU
+        packet_->data = const_cast<uint8_t*>(au.data);
+        packet_->size = static_cast<int>(au.size);
+        packet_->pts = au.pts;
+        packet_->dts = au.pts;
+        packet_->flags = (au.flags & kAuKeyFrame) ? AV_PKT_FLAG_KEY : 0;
+        last_seq_ = au.seq;
+        const int r = avcodec_send_packet(ctx_, packet_);
+        packet_->data = nullptr;
+        packet_->size = 0;
+        return r >= 0 || r == AVERROR(EAGAIN);
+    }
+
+    bool receive(SurfacePtr* out) override {
+        if (avcodec_receive_frame(ctx_, frame_) < 0) return false;
+
+        std::shared_ptr<DecodedSlot> slot = pool_.acquire();
+        if (!slot || !slot->frame) {
+            // 下游压着的帧超过了池的大小，临时分配一个槽位，归还时直接释放
+            slot = std::make_shared<DecodedSlot>();
+            slot->frame = av_frame_alloc();
+            if (!slot->frame) {
+                av_frame_unref(frame_);
+                return false;
+            }
+        }
+        av_frame_move_ref(slot->frame, frame_);
+        AVFrame* f = slot->frame;
+
+        Surface* s = &slot->surface;
+        s->width = f->width;
+        s->height = f->height;
+        s->pts = f->best_effort_timestamp != AV_NOPTS_VALUE ? f->best_effort_timestamp : f->pts;
+        s->seq = last_seq_;
+        s->device_index = device_index_;
+
+        if (hardware_) {
+            // Sophon 解码器：data[4]/data[5] 是 Y/UV 的设备物理地址，
+            // 非 zero-copy 模式下 data[0]/data[1] 额外提供主机映射
+            s->memory = MemoryKind::kDevice;
+            s->device[0] = reinterpret_cast<uint64_t>(f->data[4]);
+            s->device[1] = reinterpret_cast<uint64_t>(f->data[5]);
+            s->data[0] = f->data[0];
+            s->data[1] = f->data[1];
+            s->pitch[0] = f->linesize[4] ? f->linesize[4] : f->linesize[0];
+            s->pitch[1] = f->linesize[5] ? f->linesize[5] : f->linesize[1];
+        } else if (f->format == AV_PIX_FMT_NV12) {
+            s->data[0] = f->data[0];
+            s->data[1] = f->data[1];
+            s->pitch[0] = f->linesize[0];
+            s->pitch[1] = f->linesize[1];
+        } else if (f->format == AV_PIX_FMT_YUV420P || f->format == AV_PIX_FMT_YUVJ420P) {
+            // Y 平面直接引用解码缓冲，只交错 U/V
+            const int cw = (f->width + 1) / 2;
+            const int ch = (f->height + 1) / 2;
+            const int pitch = cw * 2;
+            const size_t bytes = size_t(pitch) * ch;
+            if (slot->uv_bytes < bytes) {
+                slot->uv.reset(new uint8_t[bytes]);
+                slot->uv_bytes = bytes;
+            }
+            for (int y = 0; y < ch; ++y) {
+                const uint8_t* u = f->data[1] + size_t(y) * f->linesize[1];
+                const uint8_t* v = f->data[2] + size_t(y) * f->linesize[2];
+                uint8_t* dst = slot->uv.get() + size_t(y) * pitch;
+                for (int x = 0; x < cw; ++x) {
+                    dst[2 * x] = u[x];
+                    dst[2 * x + 1] = v[x];
+                }
+            }
+            s->data[0] = f->data[0];
+            s->pitch[0] = f->linesize[0];
+            s->data[1] = slot->uv.get();
+            s->pitch[1] = pitch;
+        } else {
+            return false;  // 10bit 等格式暂不支持（slot 析构时归还）
+        }
+        // 别名指针：Surface 与槽位共用一个控制块，交给下游时不再分配
+        *out = SurfacePtr(std::move(slot), s);
+        return true;
+    }
+
+    void flush() override { avcodec_flush_buffers(ctx_); }
+    const char* name() const override { return name_; }
+    bool hardware() const override { return hardware_; }
+    PoolStats pool_stats() const override { return pool_.stats(); }
+
+private:
+    ObjectPool<DecodedSlot> pool_;
+    AVCodecContext* ctx_ = nullptr;
+    AVPacket* packet_ = nullptr;
+    AVFrame* frame_ = nullptr;
+    const char* name_ = "";
+    bool hardware_ = false;
+    int device_index_ = 0;
+    uint64_t last_seq_ = 0;
+};
+
+}  // namespace
+
+std::unique_ptr<VideoDecoder> VideoDecoder::create(const DecoderConfig& config, std::string* err) {
+#ifdef USE_SOPHON
+    if (config.backend != DecoderBackend::kSoftware) {
+        std::unique_ptr<FfmpegDecoder> hw(new FfmpegDecoder(config.pool_frames));
+        if (hw->open(config, true, err)) return hw;
+        if (config.backend == DecoderBackend::kSophon) return nullptr;
+    }
+#else
+    if (config.backend == DecoderBackend::kSophon) {
+        if (err) *err = "built without USE_SOPHON";
+        return nullptr;
+    }
+#endif
+    std::unique_ptr<FfmpegDecoder> sw(new FfmpegDecoder(config.pool_frames));
+    if (sw->open(config, false, err)) return sw;
+    return nullptr;
+}
+
+#else  // !HAVE_FFMPEG
+
+std::unique_ptr<VideoDecoder> VideoDecoder::create(const DecoderConfig&, std::string* err) {
+    if (err) *err = "built without FFmpeg, no decoder backend available";
+    return nullptr;
+}
+
+#endif
+
+}  // namespace roi
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "../common/au_ring.h"
+#include "../common/pool.h"
+#include "surface.h"
+
+namespace roi {
+
+enum class DecoderBackend : int {
+    kAuto = 0,      // 优先 SE5 VPU，不可用时退回软件解码
+    kSophon = 1,    // Sophon FFmpeg 的 h264_bm / hevc_bm（VPU）
+    kSoftware = 2,  // FFmpeg CPU 解码
+};
+
+struct DecoderConfig {
+    Codec codec = Codec::kH264;
+    DecoderBackend backend = DecoderBackend::kAuto;
+    int device_index = 0;
+    bool keep_on_device = true;  // 硬件解码时不把帧拷回主机
+    int threads = 2;             // 软件解码线程数
+    // 输出帧池的大小：解码队列里的帧加上下游（推理、编码、预览）同时持有的帧。
+    // 池满时退回堆分配并计入 misses，0 表示由 DecodeSession 按队列深度推算
+    int pool_frames = 0;
+};
+
+class VideoDecoder {
+public:
+    // 按配置创建解码器，失败返回空指针并写入 err
+    static std::unique_ptr<VideoDecoder> create(const DecoderConfig& config, std::string* err);
+
+    virtual ~VideoDecoder() = default;
+
+    // 送入一个 Annex-B 访问单元；返回后 au 的内存即可释放
+    virtual bool send(const AccessUnitView& au) = 0;
+    // 取出一帧，暂无输出时返回 false
+    virtual bool receive(SurfacePtr* out) = 0;
+    // 丢弃内部缓存的参考帧（码流不连续时调用）
+    virtual void flush() = 0;
+    virtual const char* name() const = 0;
+    virtual bool hardware() const = 0;
+    // 输出帧池的占用；in_use 长期接近 capacity 说明下游没有及时归还帧
+    virtual PoolStats pool_stats() const { return PoolStats(); }
+};
+
+}  // namespace roi
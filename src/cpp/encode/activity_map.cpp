@@ -0,0 +1,84 @@
+#include "activity_map.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace roi {
+
+ActivityMap::ActivityMap(int width, int height, int block_size, ActivityConfig config)
+    : width_(width),
+      height_(height),
+      block_(block_size > 0 ? block_size : 16),
+      cols_((width + block_ - 1) / block_),
+      rows_((height + block_ - 1) / block_),
+      config_(config) {
+    config_.sample_step = std::max(1, std::min(config_.sample_step, block_));
+    config_.static_frames = std::max(1, std::min(config_.static_frames, 65535));
+    const int step = config_.sample_step;
+    sample_cols_ = (width_ + step - 1) / step;
+    sample_rows_ = (height_ + step - 1) / step;
+    prev_.assign(size_t(sample_cols_) * sample_rows_, 0);
+    sad_.assign(size_t(cols_) * rows_, 0);
+    samples_.assign(size_t(cols_) * rows_, 0);
+    still_frames_.assign(size_t(cols_) * rows_, 0);
+    mask_.assign(size_t(cols_) * rows_, 0);
+    sample_block_col_.resize(size_t(sample_cols_));
+    for (int sx = 0; sx < sample_cols_; ++sx) {
+        sample_block_col_[size_t(sx)] = std::min(cols_ - 1, sx * step / block_);
+    }
+    for (int sy = 0; sy < sample_rows_; ++sy) {
+        const size_t row = size_t(std::min(rows_ - 1, sy * step / block_)) * cols_;
+        for (int sx = 0; sx < sample_cols_; ++sx) ++samples_[row + sample_block_col_[size_t(sx)]];
+    }
+}
+
+bool ActivityMap::update(const uint8_t* y, int pitch) {
+    const int step = config_.sample_step;
+    const int offset = step / 2;  // 取样点在抽样格的中心，避开块边界上的振铃
+    std::fill(sad_.begin(), sad_.end(), 0);
+    for (int sy = 0; sy < sample_rows_; ++sy) {
+        const int py = std::min(height_ - 1, sy * step + offset);
+        const uint8_t* src = y + size_t(py) * pitch;
+        uint8_t* prev = prev_.data() + size_t(sy) * sample_cols_;
+        uint32_t* sad = sad_.data() + size_t(std::min(rows_ - 1, sy * step / block_)) * cols_;
+        for (int sx = 0; sx < sample_cols_; ++sx) {
+            const uint8_t v = src[std::min(width_ - 1, sx * step + offset)];
+            sad[sample_block_col_[size_t(sx)]] += uint32_t(std::abs(int(v) - int(prev[sx])));
+            prev[sx] = v;
+        }
+    }
+    if (!primed_) {
+        // 第一帧只记下样点
+        primed_ = true;
+        return false;
+    }
+
+    bool changed = false;
+    int count = 0;
+    for (size_t i = 0; i < mask_.size(); ++i) {
+        const bool active = float(sad_[i]) > config_.threshold * float(samples_[i]);
+        uint16_t& still = still_frames_[i];
+        if (active) {
+            still = 0;
+        } else if (still < config_.static_frames) {
+            ++still;
+        }
+        const uint8_t m = still >= config_.static_frames ? 1 : 0;
+        if (m != mask_[i]) {
+            mask_[i] = m;
+            changed = true;
+        }
+        count += m;
+    }
+    static_blocks_ = count;
+    return changed;
+}
+
+void ActivityMap::reset() {
+    primed_ = false;
+    std::fill(still_frames_.begin(), still_frames_.end(), 0);
+    std::fill(mask_.begin(), mask_.end(), 0);
+    static_blocks_ = 0;
+}
+
+}  // namespace roi
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace roi {
+
+struct ActivityConfig {
+    float threshold = 3.0f;  // 块内样点与上一帧亮度差的均值超过它就算有变化（0..255，留出传感器噪声）
+    int static_frames = 50;  // 连续这么多帧没有变化的块标为静止
+    int sample_step = 4;     // 每隔几个像素取一个样点，4 时只读 1/16 的亮度
+};
+
+// 按编码块统计的帧差活动图，用来找出长时间静止的背景块。
+//
+// 只对亮度平面做稀疏抽样（默认每 4x4 像素取一点），与上一帧的样点比较后
+// 按块累计平均绝对差；开销远小于编码本身，可以在编码线程里逐帧运行。
+// 静止块交给 QpMap::set_static 改用更高的 QP，固定机位下背景几乎不再占用码率。
+class ActivityMap {
+public:
+    ActivityMap(int width, int height, int block_size, ActivityConfig config);
+
+    // 送入一帧亮度平面，返回静止标记是否有块发生变化
+    bool update(const uint8_t* y, int pitch);
+    void reset();
+
+    // 每块一个字节，非 0 为静止；行优先，cols x rows 与 QpMap 一致
+    const uint8_t* mask() const { return mask_.data(); }
+    int static_blocks() const { return static_blocks_; }
+    const ActivityConfig& config() const { return config_; }
+
+private:
+    int width_;
+    int height_;
+    int block_;
+    int cols_;
+    int rows_;
+    int sample_cols_;
+    int sample_rows_;
+    ActivityConfig config_;
+    bool primed_ = false;
+    std::vector<uint8_t> prev_;          // 上一帧的样点
+    std::vector<uint32_t> sad_;          // 本帧每块的绝对差之和
+    std::vector<uint32_t> samples_;      // 每块的样点数
+    std::vector<uint16_t> still_frames_;  // 每块连续静止的帧数
+    std::vector<uint8_t> mask_;
+    std::vector<int> sample_block_col_;  // 每列样点所在的块列
+    int static_blocks_ = 0;
+};
+
+}  // namespace roi
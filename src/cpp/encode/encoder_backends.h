@@ -0,0 +1,21 @@
+#pragma once
+
+// 各编码后端的工厂函数，只供 roi_encoder.cpp 使用。
+// 后端未编译进来时返回空指针并写入 err。
+
+#include <memory>
+#include <string>
+
+#include "roi_encoder.h"
+
+namespace roi {
+
+std::unique_ptr<RoiEncoder> create_sophon_encoder(const EncoderConfig& config, std::string* err);
+std::unique_ptr<RoiEncoder> create_x264_encoder(const EncoderConfig& config, std::string* err);
+std::unique_ptr<RoiEncoder> create_x265_encoder(const EncoderConfig& config, std::string* err);
+
+// 软件编码器输出包池的块大小：按码率估计的平均帧长留 4 倍余量，
+// 更大的关键帧退回堆分配（计入池的 misses）
+size_t packet_block_bytes(const EncoderConfig& config);
+
+}  // namespace roi
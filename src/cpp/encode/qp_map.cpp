@@ -0,0 +1,222 @@
+#include "qp_map.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace roi {
+
+namespace {
+constexpr int8_t kNoRoi = INT8_MAX;  // 大于任何合法偏移，兼作取最小值的初值
+
+int8_t clamp_delta(int d) { return static_cast<int8_t>(std::max(-51, std::min(51, d))); }
+}  // namespace
+
+QpMap::QpMap(int width, int height, int block_size, int background_delta)
+    : width_(width),
+      height_(height),
+      block_(block_size > 0 ? block_size : 16),
+      cols_((width + block_ - 1) / block_),
+      rows_((height + block_ - 1) / block_),
+      background_(clamp_delta(background_delta)),
+      map_(size_t(cols_) * rows_, clamp_delta(background_delta)),
+      base_(size_t(cols_) * rows_, clamp_delta(background_delta)),
+      still_(size_t(cols_) * rows_, 0),
+      roi_(size_t(cols_) * rows_, kNoRoi),
+      next_(size_t(cols_) * rows_, kNoRoi),
+      stamp_(size_t(cols_) * rows_, 0) {}
+
+QpMap::BlockRect QpMap::to_blocks(const RoiBox& box) const {
+    // 部分覆盖的边缘块也算进 ROI，避免目标轮廓落在高 QP 区
+    const float x0 = std::max(0.0f, box.x);
+    const float y0 = std::max(0.0f, box.y);
+    const float x1 = std::min(float(width_), box.x + box.w);
+    const float y1 = std::min(float(height_), box.y + box.h);
+    BlockRect r;
+    // 抬高后的 ROI 不会比背景更差
+    r.delta = clamp_delta(std::min(box.qp_delta + roi_bias_, std::max(box.qp_delta, background_)));
+    if (x1 <= x0 || y1 <= y0) {
+        r.c0 = r.c1 = r.r0 = r.r1 = 0;
+        return r;
+    }
+    r.c0 = int(x0) / block_;
+    r.r0 = int(y0) / block_;
+    r.c1 = std::min(cols_, int(std::ceil(x1 / block_)));
+    r.r1 = std::min(rows_, int(std::ceil(y1 / block_)));
+    return r;
+}
+
+void QpMap::add_difference(const BlockRect& a, const BlockRect& b) {
+    const int c0 = std::max(a.c0, b.c0);
+    const int c1 = std::min(a.c1, b.c1);
+    const int r0 = std::max(a.r0, b.r0);
+    const int r1 = std::min(a.r1, b.r1);
+    if (c0 >= c1 || r0 >= r1) {
+        dirty_.push_back(a);
+        return;
+    }
+    // 上下两条整行，中间两段左右
+    if (a.r0 < r0) dirty_.push_back(BlockRect{a.c0, a.r0, a.c1, r0, a.delta});
+    if (r1 < a.r1) dirty_.push_back(BlockRect{a.c0, r1, a.c1, a.r1, a.delta});
+    if (a.c0 < c0) dirty_.push_back(BlockRect{a.c0, r0, c0, r1, a.delta});
+    if (c1 < a.c1) dirty_.push_back(BlockRect{c1, r0, a.c1, r1, a.delta});
+}
+
+int QpMap::update(const RoiBox* boxes, int count) {
+    if (boxes != boxes_.data()) boxes_.assign(boxes, boxes + count);
+    cur_.clear();
+    for (int i = 0; i < count; ++i) {
+        const BlockRect r = to_blocks(boxes[i]);
+        if (r.c1 > r.c0 && r.r1 > r.r0) cur_.push_back(r);
+    }
+
+    // 1. 与上一帧逐个配对，完全相同的矩形不用处理；ROI 数量很少，平方复杂度无所谓
+    added_.clear();
+    removed_.clear();
+    matched_.assign(prev_.size(), 0);
+    for (const BlockRect& r : cur_) {
+        size_t j = 0;
+        while (j < prev_.size() && (matched_[j] || !(prev_[j] == r))) ++j;
+        if (j < prev_.size()) {
+            matched_[j] = 1;
+        } else {
+            added_.push_back(r);
+        }
+    }
+    for (size_t j = 0; j < prev_.size(); ++j) {
+        if (!matched_[j]) removed_.push_back(prev_[j]);
+    }
+    prev_.swap(cur_);
+    if (added_.empty() && removed_.empty()) return 0;
+
+    // 2. 新矩形与重叠最多的同偏移旧矩形配成一对（同一目标平移），交集内的块取值不变，
+    //    只需重算两者的对称差；配不上的矩形整块重算
+    dirty_.clear();
+    matched_.assign(removed_.size(), 0);
+    for (const BlockRect& a : added_) {
+        size_t best = removed_.size();
+        long best_area = 0;
+        for (size_t j = 0; j < removed_.size(); ++j) {
+            const BlockRect& o = removed_[j];
+            if (matched_[j] || o.delta != a.delta) continue;
+            const long w = std::min(a.c1, o.c1) - std::max(a.c0, o.c0);
+            const long h = std::min(a.r1, o.r1) - std::max(a.r0, o.r0);
+            if (w > 0 && h > 0 && w * h > best_area) {
+                best_area = w * h;
+                best = j;
+            }
+        }
+        if (best == removed_.size()) {
+            dirty_.push_back(a);
+            continue;
+        }
+        matched_[best] = 1;
+        add_difference(a, removed_[best]);
+        add_difference(removed_[best], a);
+    }
+    for (size_t j = 0; j < removed_.size(); ++j) {
+        if (!matched_[j]) dirty_.push_back(removed_[j]);
+    }
+
+    // 3. 收集待重算的块（脏区域之间可能重叠，用 stamp_ 去重）
+    if (++frame_ == 0) {
+        // 计数回绕时清零，避免误判旧的标记
+        std::fill(stamp_.begin(), stamp_.end(), 0);
+        frame_ = 1;
+    }
+    touched_.clear();
+    for (const BlockRect& d : dirty_) {
+        for (int row = d.r0; row < d.r1; ++row) {
+            const size_t base = size_t(row) * cols_;
+            for (int col = d.c0; col < d.c1; ++col) {
+                const size_t i = base + col;
+                if (stamp_[i] == frame_) continue;
+                stamp_[i] = frame_;
+                next_[i] = kNoRoi;
+                touched_.push_back(uint32_t(i));
+            }
+        }
+    }
+    // 4. 只在脏区域与本帧矩形的交集内光栅化，重叠处取最小偏移
+    for (const BlockRect& r : prev_) {
+        for (const BlockRect& d : dirty_) {
+            const int c0 = std::max(r.c0, d.c0);
+            const int c1 = std::min(r.c1, d.c1);
+            const int r0 = std::max(r.r0, d.r0);
+            const int r1 = std::min(r.r1, d.r1);
+            for (int row = r0; row < r1; ++row) {
+                const size_t base = size_t(row) * cols_;
+                for (int col = c0; col < c1; ++col) {
+                    int8_t& v = next_[base + col];
+                    if (r.delta < v) v = int8_t(r.delta);
+                }
+            }
+        }
+    }
+    // 5. 写回：值不同才写，不再被覆盖的块恢复成背景（或静止背景）
+    int changed = 0;
+    for (const uint32_t i : touched_) {
+        const int8_t v = next_[i];
+        roi_blocks_ += int(v != kNoRoi) - int(roi_[i] != kNoRoi);
+        roi_[i] = v;
+        const int8_t target = v != kNoRoi ? v : base_[i];
+        if (map_[i] != target) {
+            map_[i] = target;
+            ++changed;
+        }
+    }
+    if (changed) ++version_;
+    return changed;
+}
+
+void QpMap::set_background(int delta) {
+    const int8_t bg = clamp_delta(delta);
+    if (bg == background_) return;
+    // 背景偏移变化需要改写整图，但只在码控调整时发生；静止块保持自己的偏移，除非背景被压得比它还高
+    for (size_t i = 0; i < map_.size(); ++i) {
+        const int8_t b = still_[i] ? std::max(static_delta_, bg) : bg;
+        base_[i] = b;
+        if (roi_[i] == kNoRoi) map_[i] = b;
+    }
+    background_ = bg;
+    ++version_;
+}
+
+int QpMap::set_roi_bias(int bias) {
+    if (bias == roi_bias_) return 0;
+    roi_bias_ = bias;
+    return update(boxes_.data(), int(boxes_.size()));
+}
+
+int QpMap::set_static(const uint8_t* mask, int delta) {
+    const int8_t sd = clamp_delta(delta);
+    int changed = 0;
+    int count = 0;
+    for (size_t i = 0; i < map_.size(); ++i) {
+        const bool still = mask && mask[i];
+        const int8_t b = still ? std::max(sd, int8_t(background_)) : int8_t(background_);
+        still_[i] = still;
+        count += still;
+        if (base_[i] == b) continue;
+        base_[i] = b;
+        if (roi_[i] == kNoRoi) {
+            map_[i] = b;
+            ++changed;
+        }
+    }
+    static_blocks_ = count;
+    static_delta_ = sd;
+    if (changed) ++version_;
+    return changed;
+}
+
+void QpMap::reset() {
+    std::copy(base_.begin(), base_.end(), map_.begin());
+    prev_.clear();
+    boxes_.clear();
+    std::fill(roi_.begin(), roi_.end(), kNoRoi);
+    roi_blocks_ = 0;
+    ++version_;
+}
+
+}  // namespace roi
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace roi {
+
+// 像素坐标下的一个 ROI 及其 QP 偏移（负值表示给更多码率）
+struct RoiBox {
+    float x = 0;
+    float y = 0;
+    float w = 0;
+    float h = 0;
+    int qp_delta = -8;
+};
+
+// 按宏块（H.264 为 16x16）或 CTU 划分的 QP 偏移图。
+//
+// update() 是增量的：与上一帧完全相同的 ROI 矩形直接跳过，只重算新旧矩形的对称差
+// （同一偏移的矩形平移时只有边缘的条带）以及这些块上仍然重叠的其他矩形，
+// 开销与 ROI 的变化量成正比；ROI 不动时只比较矩形列表。
+// 多个 ROI 重叠时取最小（最优先）的 QP 偏移。
+// ROI 之外的块取各自的基准值：背景偏移，或 set_static() 标出的长时间静止块的偏移。
+class QpMap {
+public:
+    QpMap(int width, int height, int block_size, int background_delta);
+
+    // 返回本次改写的块数；0 表示编码器无需重新下发 ROI 配置
+    int update(const RoiBox* boxes, int count);
+    void set_background(int delta);
+    // 所有 ROI 的 QP 偏移统一加上 bias（码控在背景已经压到上限后才抬高 ROI 的 QP），
+    // 立即按最近一次 update() 的 ROI 重写，返回改写的块数
+    int set_roi_bias(int bias);
+    // mask 为每块一个字节（非 0 表示静止），ROI 之外的静止块改用 delta，NULL 清除全部静止标记。
+    // 返回改写的块数
+    int set_static(const uint8_t* mask, int delta);
+    void reset();
+
+    const int8_t* data() const { return map_.data(); }
+    int cols() const { return cols_; }
+    int rows() const { return rows_; }
+    int block_size() const { return block_; }
+    int background() const { return background_; }
+    int roi_bias() const { return roi_bias_; }
+    // 每次有块改变时递增，后端据此判断是否需要重新生成 ROI 参数
+    uint32_t version() const { return version_; }
+    // 当前处于 ROI 内的块数
+    int roi_blocks() const { return roi_blocks_; }
+    // 标为静止的块数（含被 ROI 覆盖的）
+    int static_blocks() const { return static_blocks_; }
+
+private:
+    struct BlockRect {
+        int c0, r0, c1, r1;  // [c0, c1) x [r0, r1)
+        int delta;
+
+        bool operator==(const BlockRect& o) const {
+            return c0 == o.c0 && r0 == o.r0 && c1 == o.c1 && r1 == o.r1 && delta == o.delta;
+        }
+    };
+
+    BlockRect to_blocks(const RoiBox& box) const;
+    // 把 a 中不属于 b 的部分（至多 4 个矩形）加入 dirty_
+    void add_difference(const BlockRect& a, const BlockRect& b);
+
+    int width_;
+    int height_;
+    int block_;
+    int cols_;
+    int rows_;
+    int background_;
+    int roi_bias_ = 0;
+    int8_t static_delta_ = 0;
+    std::vector<int8_t> map_;
+    std::vector<int8_t> base_;  // ROI 之外每块的取值
+    std::vector<uint8_t> still_;
+    std::vector<int8_t> roi_;      // 每块当前的 ROI 偏移，kNoRoi 表示不在任何 ROI 内
+    std::vector<int8_t> next_;     // 待重算块的新 ROI 偏移
+    std::vector<uint32_t> stamp_;  // 本次 update() 是否已把该块放进 touched_
+    uint32_t frame_ = 0;
+    uint32_t version_ = 0;
+    int roi_blocks_ = 0;
+    int static_blocks_ = 0;
+    std::vector<BlockRect> prev_;
+    std::vector<BlockRect> cur_;
+    std::vector<BlockRect> added_;    // 本帧新出现的矩形
+    std::vector<BlockRect> removed_;  // 上一帧有、本帧没有的矩形
+    std::vector<BlockRect> dirty_;    // 需要重算的块区域
+    std::vector<uint8_t> matched_;
+    std::vector<uint32_t> touched_;
+    std::vector<RoiBox> boxes_;  // 最近一次 update() 的输入，set_roi_bias() 用
+};
+
+}  // namespace roi
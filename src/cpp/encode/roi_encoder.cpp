@@ -0,0 +1,52 @@
+#include "roi_encoder.h"
+
+#include "encoder_backends.h"
+
+#include <algorithm>
+
+namespace roi {
+
+size_t packet_block_bytes(const EncoderConfig& config) {
+    const size_t average = size_t(std::max(config.bitrate_kbps, 1)) * 1000 / 8 / size_t(std::max(config.fps, 1));
+    return std::max<size_t>(average * 4, 32 * 1024);
+}
+
+EncoderInput EncoderInput::from_surface(const Surface& s) {
+    EncoderInput in;
+    in.format = Format::kNV12;
+    in.memory = s.memory;
+    in.plane[0] = s.data[0];
+    in.plane[1] = s.data[1];
+    in.pitch[0] = s.pitch[0];
+    in.pitch[1] = s.pitch[1];
+    in.device[0] = s.device[0];
+    in.device[1] = s.device[1];
+    in.pts = s.pts;
+    return in;
+}
+
+std::unique_ptr<RoiEncoder> RoiEncoder::create(const EncoderConfig& config, std::string* err) {
+    if (config.width <= 0 || config.height <= 0) {
+        if (err) *err = "encoder size not set";
+        return nullptr;
+    }
+    const bool hevc = config.codec == Codec::kH265;
+    switch (config.backend) {
+        case EncoderBackend::kSophon:
+            return create_sophon_encoder(config, err);
+        case EncoderBackend::kX264:
+            return create_x264_encoder(config, err);
+        case EncoderBackend::kX265:
+            return create_x265_encoder(config, err);
+        case EncoderBackend::kAuto:
+            break;
+    }
+    // 自动：先试 VPU，再按编码格式退回软件编码器
+    std::string hw_err;
+    if (auto enc = create_sophon_encoder(config, &hw_err)) return enc;
+    auto enc = hevc ? create_x265_encoder(config, err) : create_x264_encoder(config, err);
+    if (!enc && err) *err = hw_err + "; " + *err;
+    return enc;
+}
+
+}  // namespace roi
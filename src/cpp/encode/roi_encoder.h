@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "../common/au_ring.h"
+#include "../common/pool.h"
+#include "../decode/surface.h"
+#include "qp_map.h"
+
+namespace roi {
+
+enum class EncoderBackend : int {
+    kAuto = 0,    // 优先 SE5 VPU，不可用时退回 x264/x265
+    kSophon = 1,  // Sophon FFmpeg 的 h264_bm / h265_bm，ROI 走硬件 QP 图
+    kX264 = 2,    // libx264，ROI 走 quant_offsets（需开启 AQ）
+    kX265 = 3,    // libx265，ROI 走 quantOffsets
+};
+
+struct EncoderConfig {
+    Codec codec = Codec::kH264;
+    EncoderBackend backend = EncoderBackend::kAuto;
+    int width = 0;
+    int height = 0;
+    int fps = 25;
+    int bitrate_kbps = 2000;
+    int gop = 50;
+    int device_index = 0;
+    int roi_qp_delta = -8;       // ROI 默认 QP 偏移
+    int background_qp_delta = 6;  // 背景 QP 偏移
+    int base_qp = 30;             // VPU 的 ROI 图使用绝对 QP，以此为基准换算偏移
+    std::string preset = "veryfast";  // 仅软件编码器使用
+    int packet_pool = 48;             // 软件编码器输出包池的块数，覆盖推流队列里积压的包
+};
+
+// 一个编码输出的访问单元（Annex-B），owner 保证 data 在其生命周期内有效，
+// 发送端可以直接引用这块内存而不必再拷贝
+struct EncodedPacket {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    int64_t pts = 0;  // 90kHz
+    int64_t dts = 0;
+    bool key = false;
+    bool reference = true;  // 非参考帧在网络拥塞时可以优先丢弃
+    Codec codec = Codec::kH264;
+    std::shared_ptr<void> owner;
+};
+
+// 输入图像描述：NV12 或 I420，主机内存或设备内存
+struct EncoderInput {
+    enum class Format { kNV12, kI420 } format = Format::kNV12;
+    MemoryKind memory = MemoryKind::kHost;
+    const uint8_t* plane[3] = {nullptr, nullptr, nullptr};
+    int pitch[3] = {0, 0, 0};
+    uint64_t device[2] = {0, 0};
+    int64_t pts = 0;  // 90kHz
+    bool force_key = false;
+
+    static EncoderInput from_surface(const Surface& s);
+};
+
+class RoiEncoder {
+public:
+    static std::unique_ptr<RoiEncoder> create(const EncoderConfig& config, std::string* err);
+
+    virtual ~RoiEncoder() = default;
+
+    // 用当前 QP 图编码一帧；编码器可能延迟输出
+    virtual bool encode(const EncoderInput& in, const QpMap& map) = 0;
+    virtual bool receive(EncodedPacket* out) = 0;
+    virtual void request_key_frame() = 0;
+    virtual const char* name() const = 0;
+    virtual bool hardware() const = 0;
+
+    // ROI 粒度：x264/x265 与 VPU 的 H.264 为 16x16，VPU 的 H.265 为 32x32
+    virtual int block_size() const = 0;
+
+    // 输出包池的占用；推流端积压时 in_use 上升。VPU 编码器的包由 FFmpeg 管理，这里为空
+    virtual PoolStats pool_stats() const { return PoolStats(); }
+
+    const EncoderConfig& config() const { return config_; }
+
+protected:
+    explicit RoiEncoder(const EncoderConfig& config) : config_(config) {}
+    EncoderConfig config_;
+};
+
+}  // namespace roi
@@ -0,0 +1,157 @@
+#include "roi_smoother.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace roi {
+
+namespace {
+
+template <typename E>
+float iou(const E& a, const E& b) {  // E 为 x0/y0/x1/y1 边缘
+    const float iw = std::min(a.x1, b.x1) - std::max(a.x0, b.x0);
+    const float ih = std::min(a.y1, b.y1) - std::max(a.y0, b.y0);
+    if (iw <= 0 || ih <= 0) return 0.0f;
+    const float inter = iw * ih;
+    const float uni = (a.x1 - a.x0) * (a.y1 - a.y0) + (b.x1 - b.x0) * (b.y1 - b.y0) - inter;
+    return uni > 0 ? inter / uni : 0.0f;
+}
+
+}  // namespace
+
+RoiSmoother::RoiSmoother(int width, int height, int block_size, RoiSmootherConfig config)
+    : width_(width),
+      height_(height),
+      block_(block_size > 0 ? block_size : 16),
+      cols_((width + block_ - 1) / block_),
+      rows_((height + block_ - 1) / block_),
+      config_(config) {
+    config_.alpha = std::min(1.0f, std::max(0.0f, config_.alpha));
+    config_.hold_updates = std::max(0, config_.hold_updates);
+}
+
+RoiSmoother::Edges RoiSmoother::dilate(const RoiBox& box) const {
+    const float dx = box.w * config_.dilate + config_.pad_pixels;
+    const float dy = box.h * config_.dilate + config_.pad_pixels;
+    Edges e;
+    e.x0 = std::max(0.0f, box.x - dx);
+    e.y0 = std::max(0.0f, box.y - dy);
+    e.x1 = std::min(float(width_), box.x + box.w + dx);
+    e.y1 = std::min(float(height_), box.y + box.h + dy);
+    return e;
+}
+
+void RoiSmoother::smooth(Track* t, const Edges& target) const {
+    // 向外立即跟上，避免目标移出 ROI；向内按 alpha 慢慢收
+    const float a = config_.alpha;
+    Edges& e = t->edges;
+    e.x0 = target.x0 < e.x0 ? target.x0 : e.x0 + a * (target.x0 - e.x0);
+    e.y0 = target.y0 < e.y0 ? target.y0 : e.y0 + a * (target.y0 - e.y0);
+    e.x1 = target.x1 > e.x1 ? target.x1 : e.x1 + a * (target.x1 - e.x1);
+    e.y1 = target.y1 > e.y1 ? target.y1 : e.y1 + a * (target.y1 - e.y1);
+}
+
+void RoiSmoother::align(Track* t, bool snap) const {
+    const float b = float(block_);
+    const Edges& e = t->edges;
+    // 部分覆盖的块算进 ROI
+    const int c0 = int(e.x0 / b);
+    const int r0 = int(e.y0 / b);
+    const int c1 = std::min(cols_, int(std::ceil(e.x1 / b)));
+    const int r1 = std::min(rows_, int(std::ceil(e.y1 / b)));
+    if (snap) {
+        t->c0 = c0;
+        t->r0 = r0;
+        t->c1 = c1;
+        t->r1 = r1;
+        return;
+    }
+    // 外扩立即生效；收缩要等边缘越过块边界 shrink_margin 个块宽，边缘停在边界附近时不来回跳
+    const float m = config_.shrink_margin * b;
+    if (c0 < t->c0) {
+        t->c0 = c0;
+    } else if (c0 > t->c0 && e.x0 >= t->c0 * b + b + m) {
+        t->c0 = std::min(c0, int((e.x0 - m) / b));
+    }
+    if (r0 < t->r0) {
+        t->r0 = r0;
+    } else if (r0 > t->r0 && e.y0 >= t->r0 * b + b + m) {
+        t->r0 = std::min(r0, int((e.y0 - m) / b));
+    }
+    if (c1 > t->c1) {
+        t->c1 = c1;
+    } else if (c1 < t->c1 && e.x1 <= t->c1 * b - b - m) {
+        t->c1 = std::max(c1, int(std::ceil((e.x1 + m) / b)));
+    }
+    if (r1 > t->r1) {
+        t->r1 = r1;
+    } else if (r1 < t->r1 && e.y1 <= t->r1 * b - b - m) {
+        t->r1 = std::max(r1, int(std::ceil((e.y1 + m) / b)));
+    }
+}
+
+const std::vector<RoiBox>& RoiSmoother::update(const RoiBox* boxes, int count) {
+    inputs_.clear();
+    for (int i = 0; i < count; ++i) {
+        if (boxes[i].w <= 0 || boxes[i].h <= 0) continue;
+        const Edges e = dilate(boxes[i]);
+        if (e.x1 > e.x0 && e.y1 > e.y0) inputs_.push_back(Input{e, boxes[i].qp_delta});
+    }
+    const int n = static_cast<int>(inputs_.size());
+    used_.assign(size_t(n), 0);
+
+    // 贪心匹配：每个已有 ROI 取 IoU 最大的未用检测框。目标数一般只有个位数，O(N*M) 足够
+    for (Track& t : tracks_) {
+        int best = -1;
+        float best_iou = config_.match_iou;
+        for (int i = 0; i < n; ++i) {
+            if (used_[size_t(i)]) continue;
+            const float v = iou(t.edges, inputs_[size_t(i)].edges);
+            if (v > best_iou) {
+                best_iou = v;
+                best = i;
+            }
+        }
+        if (best < 0) {
+            ++t.misses;
+            continue;
+        }
+        used_[size_t(best)] = 1;
+        t.misses = 0;
+        t.qp_delta = inputs_[size_t(best)].qp_delta;
+        smooth(&t, inputs_[size_t(best)].edges);
+        align(&t, false);
+    }
+    tracks_.erase(std::remove_if(tracks_.begin(), tracks_.end(),
+                                 [&](const Track& t) { return t.misses > config_.hold_updates; }),
+                  tracks_.end());
+    for (int i = 0; i < n; ++i) {
+        if (used_[size_t(i)]) continue;
+        Track t;
+        t.edges = inputs_[size_t(i)].edges;
+        t.qp_delta = inputs_[size_t(i)].qp_delta;
+        t.misses = 0;
+        align(&t, true);
+        tracks_.push_back(t);
+    }
+
+    out_.clear();
+    for (const Track& t : tracks_) {
+        if (t.c1 <= t.c0 || t.r1 <= t.r0) continue;
+        RoiBox box;
+        box.x = float(t.c0 * block_);
+        box.y = float(t.r0 * block_);
+        box.w = float(std::min(width_, t.c1 * block_) - t.c0 * block_);
+        box.h = float(std::min(height_, t.r1 * block_) - t.r0 * block_);
+        box.qp_delta = t.qp_delta;
+        out_.push_back(box);
+    }
+    return out_;
+}
+
+void RoiSmoother::reset() {
+    tracks_.clear();
+    out_.clear();
+}
+
+}  // namespace roi
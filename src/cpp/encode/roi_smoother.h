@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+
+#include "qp_map.h"
+
+namespace roi {
+
+struct RoiSmootherConfig {
+    float alpha = 0.4f;        // 边缘收缩时的指数平滑系数，越小越稳；外扩总是立即跟上
+    float dilate = 0.15f;      // 每边按框宽高的比例外扩，给目标的运动和检测误差留余量
+    int pad_pixels = 8;        // 每边再外扩的像素
+    int hold_updates = 5;      // 目标消失后 ROI 继续保持的更新次数
+    float match_iou = 0.2f;    // 检测框与已有 ROI 的 IoU 超过它视为同一目标
+    float shrink_margin = 0.25f;  // 平滑后的边缘越过块边界这么多块宽之后才收缩一块
+};
+
+// 检测与 QP 图之间的 ROI 状态层。
+//
+// 检测框逐帧抖动（置信度在阈值附近时忽有忽无，NMS 输出漂移几个像素），直接驱动 QP 图
+// 会让码控在 ROI 与背景之间来回搬运码率，I/P 帧大小随之振荡。这里对每个目标维护一个
+// 平滑后的 ROI：外扩并对齐到编码块，边缘外扩立即生效、收缩经过指数平滑和半块的滞回，
+// 目标消失后再保持 hold_updates 次更新。输出的块矩形只在确有需要时才变化，
+// QpMap::update 因此大多返回 0，编码器也就不必重新下发 ROI 配置。
+class RoiSmoother {
+public:
+    RoiSmoother(int width, int height, int block_size, RoiSmootherConfig config);
+
+    // 输入一次检测结果，返回稳定后的 ROI（像素坐标，落在块边界上），在下次调用前有效
+    const std::vector<RoiBox>& update(const RoiBox* boxes, int count);
+    void reset();
+
+    const RoiSmootherConfig& config() const { return config_; }
+    int tracks() const { return static_cast<int>(tracks_.size()); }
+
+private:
+    struct Edges {
+        float x0, y0, x1, y1;
+    };
+
+    struct Input {
+        Edges edges;  // 外扩后的检测框
+        int qp_delta;
+    };
+
+    struct Track {
+        Edges edges;         // 平滑后的像素边缘
+        int c0, r0, c1, r1;  // 输出的块矩形 [c0, c1) x [r0, r1)
+        int qp_delta;
+        int misses;
+    };
+
+    Edges dilate(const RoiBox& box) const;
+    void smooth(Track* t, const Edges& target) const;
+    void align(Track* t, bool snap) const;
+
+    int width_;
+    int height_;
+    int block_;
+    int cols_;
+    int rows_;
+    RoiSmootherConfig config_;
+    std::vector<Track> tracks_;
+    std::vector<Input> inputs_;
+    std::vector<char> used_;
+    std::vector<RoiBox> out_;
+};
+
+}  // namespace roi
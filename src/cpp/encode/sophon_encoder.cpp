@@ -0,0 +1,192 @@
+#include "encoder_backends.h"
+
+#if defined(USE_SOPHON) && defined(HAVE_FFMPEG)
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/dict.h>
+#include <libavutil/frame.h>
+}
+
+namespace roi {
+
+namespace {
+
+// SE5 VPU 编码器（Sophon FFmpeg 的 h264_bm / h265_bm）。
+// ROI 通过帧附带的 AV_FRAME_DATA_BM_ROI_INFO（AVBMRoiInfo，定义见 Sophon FFmpeg 的
+// libavutil/frame.h）下发：H.264 每个 16x16 宏块一个 QP，H.265 每个 64x64 CTU
+// 包含 4 个 32x32 子块 QP。硬件 ROI 使用绝对 QP，这里以 base_qp 加上 QP 图偏移换算。
+class SophonEncoder : public RoiEncoder {
+public:
+    explicit SophonEncoder(const EncoderConfig& config) : RoiEncoder(config) {}
+
+    ~SophonEncoder() override {
+        av_frame_free(&frame_);
+        avcodec_free_context(&ctx_);
+    }
+
+    bool open(std::string* err) {
+        hevc_ = config_.codec == Codec::kH265;
+        const char* name = hevc_ ? "h265_bm" : "h264_bm";
+        const AVCodec* codec = avcodec_find_encoder_by_name(name);
+        if (!codec) {
+            if (err) *err = std::string("encoder not available: ") + name;
+            return false;
+        }
+        ctx_ = avcodec_alloc_context3(codec);
+        ctx_->width = config_.width;
+        ctx_->height = config_.height;
+        ctx_->pix_fmt = AV_PIX_FMT_NV12;
+        ctx_->time_base.num = 1;
+        ctx_->time_base.den = 90000;
+        ctx_->framerate.num = config_.fps;
+        ctx_->framerate.den = 1;
+        ctx_->bit_rate = int64_t(config_.bitrate_kbps) * 1000;
+        ctx_->gop_size = config_.gop;
+        ctx_->max_b_frames = 0;
+
+        AVDictionary* opts = nullptr;
+        av_dict_set_int(&opts, "sophon_idx", config_.device_index, 0);
+        av_dict_set_int(&opts, "gop_preset", 2, 0);  // IPPP，全部为参考帧
+        av_dict_set_int(&opts, "is_dma_buffer", 1, 0);
+        av_dict_set_int(&opts, "roi_enable", 1, 0);
+        const int r = avcodec_open2(ctx_, codec, &opts);
+        av_dict_free(&opts);
+        if (r < 0) {
+            if (err) *err = std::string("avcodec_open2 failed for ") + name;
+            return false;
+        }
+        frame_ = av_frame_alloc();
+        return frame_ != nullptr;
+    }
+
+    bool encode(const EncoderInput& in, const QpMap& map) override {
+        if (in.format != EncoderInput::Format::kNV12) return false;
+        av_frame_unref(frame_);
+        frame_->format = AV_PIX_FMT_NV12;
+        frame_->width = config_.width;
+        frame_->height = config_.height;
+        frame_->data[0] = const_cast<uint8_t*>(in.plane[0]);
+        frame_->data[1] = const_cast<uint8_t*>(in.plane[1]);
+        frame_->linesize[0] = in.pitch[0];
+        frame_->linesize[1] = in.pitch[1];
+        // 设备内存帧把物理地址放进 data[4]/data[5]，VPU 直接读取，不经过主机
+        frame_->data[4] = reinterpret_cast<uint8_t*>(in.device[0]);
+        frame_->data[5] = reinterpret_cast<uint8_t*>(in.device[1]);
+        frame_->linesize[4] = in.pitch[0];
+        frame_->linesize[5] = in.pitch[1];
+        frame_->pts = in.pts;
+        frame_->pict_type = (in.force_key || force_key_) ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+        force_key_ = false;
+
+        attach_roi(map);
+        if (avcodec_send_frame(ctx_, frame_) < 0) return false;
+        for (;;) {
+            AVPacket* pkt = av_packet_alloc();
+            if (avcodec_receive_packet(ctx_, pkt) < 0) {
+                av_packet_free(&pkt);
+                break;
+            }
+            // 直接持有 FFmpeg 的引用计数缓冲，不再拷贝码流
+            EncodedPacket out;
+            out.data = pkt->data;
+            out.size = size_t(pkt->size);
+            out.pts = pkt->pts;
+            out.dts = pkt->dts;
+            out.key = (pkt->flags & AV_PKT_FLAG_KEY) != 0;
+            out.reference = true;
+            out.codec = config_.codec;
+            out.owner = std::shared_ptr<AVPacket>(pkt, [](AVPacket* p) { av_packet_free(&p); });
+            pending_.push_back(std::move(out));
+        }
+        return true;
+    }
+
+    bool receive(EncodedPacket* out) override {
+        if (pending_.empty()) return false;
+        *out = std::move(pending_.front());
+        pending_.pop_front();
+        return true;
+    }
+
+    void request_key_frame() override { force_key_ = true; }
+    const char* name() const override { return hevc_ ? "h265_bm" : "h264_bm"; }
+    bool hardware() const override { return true; }
+    int block_size() const override { return hevc_ ? 32 : 16; }
+
+private:
+    int qp_at(const QpMap& map, int col, int row) const {
+        col = std::min(col, map.cols() - 1);
+        row = std::min(row, map.rows() - 1);
+        const int qp = config_.base_qp + map.data()[size_t(row) * map.cols() + col];
+        return std::max(0, std::min(51, qp));
+    }
+
+    void attach_roi(const QpMap& map) {
+        if (map.block_size() != block_size()) return;
+        AVFrameSideData* sd = av_frame_new_side_data(frame_, AV_FRAME_DATA_BM_ROI_INFO, sizeof(AVBMRoiInfo));
+        if (!sd) return;
+        // QP 图没变化时 VPU 仍需每帧一份 ROI 信息，但换算开销只在版本变化时付出
+        if (map.version() != roi_version_) {
+            std::memset(&roi_, 0, sizeof(roi_));
+            roi_.customRoiMapEnable = 1;
+            roi_.customModeMapEnable = 0;
+            if (hevc_) {
+                const int ctu_cols = (config_.width + 63) / 64;
+                const int ctu_rows = (config_.height + 63) / 64;
+                roi_.numbers = ctu_cols * ctu_rows;
+                for (int r = 0; r < ctu_rows; ++r) {
+                    for (int c = 0; c < ctu_cols; ++c) {
+                        auto& f = roi_.field[r * ctu_cols + c].HEVC;
+                        f.sub_ctu_qp_0 = qp_at(map, c * 2, r * 2);
+                        f.sub_ctu_qp_1 = qp_at(map, c * 2 + 1, r * 2);
+                        f.sub_ctu_qp_2 = qp_at(map, c * 2, r * 2 + 1);
+                        f.sub_ctu_qp_3 = qp_at(map, c * 2 + 1, r * 2 + 1);
+                    }
+                }
+            } else {
+                roi_.numbers = map.cols() * map.rows();
+                for (int i = 0; i < roi_.numbers; ++i) {
+                    roi_.field[i].H264.mb_qp = qp_at(map, i % map.cols(), i / map.cols());
+                }
+            }
+            roi_version_ = map.version();
+        }
+        std::memcpy(sd->data, &roi_, sizeof(roi_));
+    }
+
+    AVCodecContext* ctx_ = nullptr;
+    AVFrame* frame_ = nullptr;
+    AVBMRoiInfo roi_;
+    uint32_t roi_version_ = ~0u;
+    bool hevc_ = false;
+    bool force_key_ = false;
+    std::deque<EncodedPacket> pending_;
+};
+
+}  // namespace
+
+std::unique_ptr<RoiEncoder> create_sophon_encoder(const EncoderConfig& config, std::string* err) {
+    std::unique_ptr<SophonEncoder> enc(new SophonEncoder(config));
+    if (!enc->open(err)) return nullptr;
+    return enc;
+}
+
+}  // namespace roi
+
+#else
+
+namespace roi {
+
+std::unique_ptr<RoiEncoder> create_sophon_encoder(const EncoderConfig&, std::string* err) {
+    if (err) *err = "built without USE_SOPHON";
+    return nullptr;
+}
+
+}  // namespace roi
+
+#endif
@@ -0,0 +1,209 @@
+#include "encoder_backends.h"
+
+#ifdef HAVE_X264
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <new>
+#include <vector>
+
+extern "C" {
+#include <x264.h>
+}
+
+namespace roi {
+
+namespace {
+
+// x264 在编码完成后通过 quant_offsets_free 归还偏移表；同一张表会被多帧共用，
+// 所以加一个引用计数头，只有 ROI 变化时才分配新表
+struct OffsetTable {
+    std::atomic<int> refs;
+    float values[1];
+
+    static OffsetTable* allocate(size_t count) {
+        void* mem = std::malloc(sizeof(OffsetTable) + sizeof(float) * count);
+        auto* t = static_cast<OffsetTable*>(mem);
+        new (&t->refs) std::atomic<int>(1);
+        return t;
+    }
+    static OffsetTable* from_values(void* p) {
+        return reinterpret_cast<OffsetTable*>(static_cast<char*>(p) - offsetof(OffsetTable, values));
+    }
+    float* acquire() {
+        refs.fetch_add(1, std::memory_order_relaxed);
+        return values;
+    }
+    void release() {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) std::free(this);
+    }
+};
+
+void release_offsets(void* p) { OffsetTable::from_values(p)->release(); }
+
+class X264Encoder : public RoiEncoder {
+public:
+    explicit X264Encoder(const EncoderConfig& config)
+        : RoiEncoder(config), packets_(packet_block_bytes(config), uint32_t(std::max(config.packet_pool, 1))) {}
+
+    ~X264Encoder() override {
+        if (enc_) x264_encoder_close(enc_);
+        if (offsets_) offsets_->release();
+    }
+
+    bool open(std::string* err) {
+        x264_param_t p;
+        if (x264_param_default_preset(&p, config_.preset.c_str(), "zerolatency") < 0) {
+            if (err) *err = "x264: bad preset " + config_.preset;
+            return false;
+        }
+        p.i_width = config_.width;
+        p.i_height = config_.height;
+        p.i_csp = X264_CSP_NV12;
+        p.i_fps_num = config_.fps;
+        p.i_fps_den = 1;
+        p.i_timebase_num = 1;
+        p.i_timebase_den = 90000;
+        p.b_vfr_input = 1;
+        p.i_keyint_max = config_.gop;
+        p.b_repeat_headers = 1;  // 关键帧前重复 SPS/PPS，推流端可以从任意关键帧起播
+        p.b_annexb = 1;
+        p.rc.i_rc_method = X264_RC_ABR;
+        p.rc.i_bitrate = config_.bitrate_kbps;
+        p.rc.i_vbv_max_bitrate = config_.bitrate_kbps;
+        p.rc.i_vbv_buffer_size = config_.bitrate_kbps;
+        // quant_offsets 只在开启 AQ 时生效
+        p.rc.i_aq_mode = X264_AQ_VARIANCE;
+        if (x264_param_apply_profile(&p, "high") < 0) {
+            if (err) *err = "x264: apply profile failed";
+            return false;
+        }
+        enc_ = x264_encoder_open(&p);
+        if (!enc_) {
+            if (err) *err = "x264_encoder_open failed";
+            return false;
+        }
+        x264_picture_init(&pic_);
+        mb_cols_ = (config_.width + 15) / 16;
+        mb_rows_ = (config_.height + 15) / 16;
+        return true;
+    }
+
+    bool encode(const EncoderInput& in, const QpMap& map) override {
+        if (!in.plane[0]) return false;  // x264 只能读主机内存
+        if (in.format == EncoderInput::Format::kNV12) {
+            pic_.img.i_csp = X264_CSP_NV12;
+            pic_.img.i_plane = 2;
+        } else {
+            pic_.img.i_csp = X264_CSP_I420;
+            pic_.img.i_plane = 3;
+        }
+        for (int i = 0; i < pic_.img.i_plane; ++i) {
+            pic_.img.plane[i] = const_cast<uint8_t*>(in.plane[i]);
+            pic_.img.i_stride[i] = in.pitch[i];
+        }
+        pic_.i_pts = in.pts;
+        pic_.i_type = (in.force_key || force_key_) ? X264_TYPE_IDR : X264_TYPE_AUTO;
+        force_key_ = false;
+
+        refresh_offsets(map);
+        if (offsets_) {
+            pic_.prop.quant_offsets = offsets_->acquire();
+            pic_.prop.quant_offsets_free = release_offsets;
+        } else {
+            pic_.prop.quant_offsets = nullptr;
+            pic_.prop.quant_offsets_free = nullptr;
+        }
+
+        x264_nal_t* nals = nullptr;
+        int count = 0;
+        x264_picture_t out;
+        const int size = x264_encoder_encode(enc_, &nals, &count, &pic_, &out);
+        if (size < 0) return false;
+        if (size > 0) emit(nals, size, out);
+        return true;
+    }
+
+    bool receive(EncodedPacket* out) override {
+        if (pending_.empty()) return false;
+        *out = std::move(pending_.front());
+        pending_.pop_front();
+        return true;
+    }
+
+    void request_key_frame() override { force_key_ = true; }
+    const char* name() const override { return "x264"; }
+    bool hardware() const override { return false; }
+    int block_size() const override { return 16; }
+    PoolStats pool_stats() const override { return packets_.stats(); }
+
+private:
+    // QP 图版本没变时沿用上一张偏移表
+    void refresh_offsets(const QpMap& map) {
+        if (offsets_ && map.version() == offsets_version_) return;
+        if (map.block_size() != 16 || map.cols() != mb_cols_ || map.rows() != mb_rows_) return;
+        if (offsets_) offsets_->release();
+        const size_t n = size_t(mb_cols_) * mb_rows_;
+        offsets_ = OffsetTable::allocate(n);
+        const int8_t* src = map.data();
+        for (size_t i = 0; i < n; ++i) offsets_->values[i] = float(src[i]);
+        offsets_version_ = map.version();
+    }
+
+    void emit(const x264_nal_t* nals, int size, const x264_picture_t& pic) {
+        // x264 的 NAL 负载在内部缓冲中连续存放，下次编码前拷进池里的一块交给发送端持有
+        PoolBufferPtr buf = packets_.acquire(size_t(size));
+        std::memcpy(buf->data, nals[0].p_payload, size_t(size));
+        EncodedPacket pkt;
+        pkt.data = buf->data;
+        pkt.size = buf->size;
+        pkt.pts = pic.i_pts;
+        pkt.dts = pic.i_dts;
+        pkt.key = pic.b_keyframe != 0;
+        pkt.reference = pic.i_type != X264_TYPE_B;
+        pkt.codec = Codec::kH264;
+        pkt.owner = std::move(buf);
+        pending_.push_back(std::move(pkt));
+    }
+
+    x264_t* enc_ = nullptr;
+    x264_picture_t pic_;
+    int mb_cols_ = 0;
+    int mb_rows_ = 0;
+    OffsetTable* offsets_ = nullptr;
+    uint32_t offsets_version_ = 0;
+    bool force_key_ = false;
+    BufferPool packets_;
+    std::deque<EncodedPacket> pending_;
+};
+
+}  // namespace
+
+std::unique_ptr<RoiEncoder> create_x264_encoder(const EncoderConfig& config, std::string* err) {
+    if (config.codec != Codec::kH264) {
+        if (err) *err = "x264 only encodes H.264";
+        return nullptr;
+    }
+    std::unique_ptr<X264Encoder> enc(new X264Encoder(config));
+    if (!enc->open(err)) return nullptr;
+    return enc;
+}
+
+}  // namespace roi
+
+#else  // !HAVE_X264
+
+namespace roi {
+
+std::unique_ptr<RoiEncoder> create_x264_encoder(const EncoderConfig&, std::string* err) {
+    if (err) *err = "built without x264";
+    return nullptr;
+}
+
+}  // namespace roi
+
+#endif
@@ -0,0 +1,196 @@
+#include "encoder_backends.h"
+
+#ifdef HAVE_X265
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+extern "C" {
+#include <x265.h>
+}
+
+namespace roi {
+
+namespace {
+
+class X265Encoder : public RoiEncoder {
+public:
+    explicit X265Encoder(const EncoderConfig& config)
+        : RoiEncoder(config), packets_(packet_block_bytes(config), uint32_t(std::max(config.packet_pool, 1))) {}
+
+    ~X265Encoder() override {
+        if (enc_) x265_encoder_close(enc_);
+        if (pic_) x265_picture_free(pic_);
+        if (param_) x265_param_free(param_);
+    }
+
+    bool open(std::string* err) {
+        param_ = x265_param_alloc();
+        if (x265_param_default_preset(param_, config_.preset.c_str(), "zerolatency") < 0) {
+            if (err) *err = "x265: bad preset " + config_.preset;
+            return false;
+        }
+        param_->sourceWidth = config_.width;
+        param_->sourceHeight = config_.height;
+        param_->internalCsp = X265_CSP_I420;
+        param_->fpsNum = uint32_t(config_.fps);
+        param_->fpsDenom = 1;
+        param_->keyframeMax = config_.gop;
+        param_->bRepeatHeaders = 1;
+        param_->bAnnexB = 1;
+        param_->logLevel = X265_LOG_WARNING;
+        param_->rc.rateControlMode = X265_RC_ABR;
+        param_->rc.bitrate = config_.bitrate_kbps;
+        param_->rc.vbvMaxBitrate = config_.bitrate_kbps;
+        param_->rc.vbvBufferSize = config_.bitrate_kbps;
+        param_->rc.aqMode = X265_AQ_VARIANCE;  // quantOffsets 需要 AQ
+        enc_ = x265_encoder_open(param_);
+        if (!enc_) {
+            if (err) *err = "x265_encoder_open failed";
+            return false;
+        }
+        pic_ = x265_picture_alloc();
+        x265_picture_init(param_, pic_);
+        cols_ = (config_.width + 15) / 16;
+        rows_ = (config_.height + 15) / 16;
+        offsets_.assign(size_t(cols_) * rows_, 0.0f);
+        return true;
+    }
+
+    bool encode(const EncoderInput& in, const QpMap& map) override {
+        if (!in.plane[0]) return false;
+        if (in.format == EncoderInput::Format::kNV12) {
+            // x265 不接受 NV12，把 UV 拆到预分配的平面里
+            deinterleave(in);
+            pic_->planes[0] = const_cast<uint8_t*>(in.plane[0]);
+            pic_->stride[0] = in.pitch[0];
+            pic_->planes[1] = u_.data();
+            pic_->planes[2] = v_.data();
+            pic_->stride[1] = pic_->stride[2] = (config_.width + 1) / 2;
+        } else {
+            for (int i = 0; i < 3; ++i) {
+                pic_->planes[i] = const_cast<uint8_t*>(in.plane[i]);
+                pic_->stride[i] = in.pitch[i];
+            }
+        }
+        pic_->bitDepth = 8;
+        pic_->pts = in.pts;
+        pic_->sliceType = (in.force_key || force_key_) ? X265_TYPE_IDR : X265_TYPE_AUTO;
+        force_key_ = false;
+
+        // x265 在 encode 内部拷贝 quantOffsets，偏移表可以复用
+        if (map.block_size() == 16 && map.cols() == cols_ && map.rows() == rows_) {
+            if (map.version() != offsets_version_) {
+                const int8_t* src = map.data();
+                for (size_t i = 0; i < offsets_.size(); ++i) offsets_[i] = float(src[i]);
+                offsets_version_ = map.version();
+            }
+            pic_->quantOffsets = offsets_.data();
+        } else {
+            pic_->quantOffsets = nullptr;
+        }
+
+        x265_nal* nals = nullptr;
+        uint32_t count = 0;
+        x265_picture out;
+        x265_picture_init(param_, &out);
+        const int r = x265_encoder_encode(enc_, &nals, &count, pic_, &out);
+        if (r < 0) return false;
+        if (count > 0) emit(nals, count, out);
+        return true;
+    }
+
+    bool receive(EncodedPacket* out) override {
+        if (pending_.empty()) return false;
+        *out = std::move(pending_.front());
+        pending_.pop_front();
+        return true;
+    }
+
+    void request_key_frame() override { force_key_ = true; }
+    const char* name() const override { return "x265"; }
+    bool hardware() const override { return false; }
+    int block_size() const override { return 16; }
+    PoolStats pool_stats() const override { return packets_.stats(); }
+
+private:
+    void deinterleave(const EncoderInput& in) {
+        const int cw = (config_.width + 1) / 2;
+        const int ch = (config_.height + 1) / 2;
+        u_.resize(size_t(cw) * ch);
+        v_.resize(size_t(cw) * ch);
+        for (int y = 0; y < ch; ++y) {
+            const uint8_t* src = in.plane[1] + size_t(y) * in.pitch[1];
+            uint8_t* u = u_.data() + size_t(y) * cw;
+            uint8_t* v = v_.data() + size_t(y) * cw;
+            for (int x = 0; x < cw; ++x) {
+                u[x] = src[2 * x];
+                v[x] = src[2 * x + 1];
+            }
+        }
+    }
+
+    void emit(const x265_nal* nals, uint32_t count, const x265_picture& pic) {
+        size_t total = 0;
+        for (uint32_t i = 0; i < count; ++i) total += nals[i].sizeBytes;
+        PoolBufferPtr buf = packets_.acquire(total);
+        size_t offset = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            std::memcpy(buf->data + offset, nals[i].payload, nals[i].sizeBytes);
+            offset += nals[i].sizeBytes;
+        }
+
+        EncodedPacket pkt;
+        pkt.data = buf->data;
+        pkt.size = buf->size;
+        pkt.pts = pic.pts;
+        pkt.dts = pic.dts;
+        pkt.key = pic.sliceType == X265_TYPE_IDR || pic.sliceType == X265_TYPE_I;
+        pkt.reference = pic.sliceType != X265_TYPE_B;
+        pkt.codec = Codec::kH265;
+        pkt.owner = std::move(buf);
+        pending_.push_back(std::move(pkt));
+    }
+
+    x265_param* param_ = nullptr;
+    x265_encoder* enc_ = nullptr;
+    x265_picture* pic_ = nullptr;
+    int cols_ = 0;
+    int rows_ = 0;
+    std::vector<float> offsets_;
+    uint32_t offsets_version_ = ~0u;
+    std::vector<uint8_t> u_;
+    std::vector<uint8_t> v_;
+    bool force_key_ = false;
+    BufferPool packets_;
+    std::deque<EncodedPacket> pending_;
+};
+
+}  // namespace
+
+std::unique_ptr<RoiEncoder> create_x265_encoder(const EncoderConfig& config, std::string* err) {
+    if (config.codec != Codec::kH265) {
+        if (err) *err = "x265 only encodes H.265";
+        return nullptr;
+    }
+    std::unique_ptr<X265Encoder> enc(new X265Encoder(config));
+    if (!enc->open(err)) return nullptr;
+    return enc;
+}
+
+}  // namespace roi
+
+#else  // !HAVE_X265
+
+namespace roi {
+
+std::unique_ptr<RoiEncoder> create_x265_encoder(const EncoderConfig&, std::string* err) {
+    if (err) *err = "built without x265";
+    return nullptr;
+}
+
+}  // namespace roi
+
+#endif
@@ -0,0 +1,181 @@
+#include "preprocess.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../common/bilinear.h"
+#include "../common/scheduler.h"
+
+namespace roi {
+
+namespace {
+
+constexpr int kRowGrain = 32;  // 每个并行任务至少处理的输出行数
+
+inline int clamp255(int v) { return v < 0 ? 0 : (v > 255 ? 255 : v); }
+
+// BT.601 limited range，与 cv2.COLOR_YUV2BGR_NV12 相同；系数为 16 位定点
+inline void yuv_to_rgb(int y, int u, int v, int* r, int* g, int* b) {
+    const int c = (y - 16) * 76284;
+    const int d = u - 128;
+    const int e = v - 128;
+    *r = clamp255((c + 104595 * e + 32768) >> 16);
+    *g = clamp255((c - 25625 * d - 53281 * e + 32768) >> 16);
+    *b = clamp255((c + 132252 * d + 32768) >> 16);
+}
+
+}  // namespace
+
+Preprocessor::Preprocessor(PreprocessConfig config) : config_(config) {
+    config_.width = std::max(1, config_.width);
+    config_.height = std::max(1, config_.height);
+    config_.batch = std::max(1, config_.batch);
+    plane_ = size_t(config_.width) * config_.height;
+    const size_t total = plane_ * 3 * config_.batch;
+    if (config_.int8) {
+        i8_.assign(total, 0);
+    } else {
+        f32_.assign(total, 0.0f);
+    }
+    geometry_.resize(size_t(config_.batch));
+    for (int v = 0; v < 256; ++v) {
+        lut_f32_[v] = float(v) / 255.0f;
+        const long q = std::lround(float(v) / 255.0f * config_.int8_scale);
+        lut_i8_[v] = int8_t(std::max(-128L, std::min(127L, q)));
+    }
+}
+
+const void* Preprocessor::data() const {
+    return config_.int8 ? static_cast<const void*>(i8_.data()) : static_cast<const void*>(f32_.data());
+}
+
+size_t Preprocessor::bytes() const { return config_.int8 ? i8_.size() : f32_.size() * sizeof(float); }
+
+Preprocessor::Geometry& Preprocessor::prepare(int slot, int width, int height) {
+    Geometry& g = geometry_[size_t(slot)];
+    if (g.src_w == width && g.src_h == height) return g;
+    g.src_w = width;
+    g.src_h = height;
+    if (config_.letterbox) {
+        const float s = std::min(float(config_.width) / width, float(config_.height) / height);
+        g.out_w = std::max(1, std::min(config_.width, int(std::lround(width * s))));
+        g.out_h = std::max(1, std::min(config_.height, int(std::lround(height * s))));
+    } else {
+        g.out_w = config_.width;
+        g.out_h = config_.height;
+    }
+    g.out_x = (config_.width - g.out_w) / 2;
+    g.out_y = (config_.height - g.out_h) / 2;
+
+    build_bilinear_taps(g.out_w, width, &g.xs);
+    build_bilinear_taps(g.out_h, height, &g.ys);
+    build_bilinear_taps(g.out_w, (width + 1) / 2, &g.uv_xs);
+    build_bilinear_taps(g.out_h, (height + 1) / 2, &g.uv_ys);
+    fill_padding(slot, g);
+    return g;
+}
+
+void Preprocessor::fill_padding(int slot, const Geometry& g) {
+    if (g.out_w == config_.width && g.out_h == config_.height) return;
+    const size_t begin = size_t(slot) * 3 * plane_;
+    if (config_.int8) {
+        std::fill(i8_.begin() + begin, i8_.begin() + begin + 3 * plane_, lut_i8_[config_.pad_value]);
+    } else {
+        std::fill(f32_.begin() + begin, f32_.begin() + begin + 3 * plane_, lut_f32_[config_.pad_value]);
+    }
+}
+
+LetterboxInfo Preprocessor::info_of(const Geometry& g) const {
+    LetterboxInfo info;
+    info.scale_x = float(g.out_w) / g.src_w;
+    info.scale_y = float(g.out_h) / g.src_h;
+    info.pad_x = g.out_x;
+    info.pad_y = g.out_y;
+    return info;
+}
+
+LetterboxInfo Preprocessor::run_nv12(int slot, const uint8_t* y, const uint8_t* uv, int width, int height,
+                                     int pitch_y, int pitch_uv) {
+    const Geometry& g = prepare(slot, width, height);
+    const size_t base = size_t(slot) * 3 * plane_ + size_t(g.out_y) * config_.width + g.out_x;
+    // 各输出行互不重叠，按行段分给 CPU 线程池（没有配置线程池时在当前线程上执行）
+    Scheduler::instance().parallel_for(0, g.out_h, kRowGrain, [&](int row_begin, int row_end) {
+        for (int oy = row_begin; oy < row_end; ++oy) {
+            const Tap& ty = g.ys[size_t(oy)];
+            const Tap& tc = g.uv_ys[size_t(oy)];
+            const uint8_t* y0 = y + size_t(ty.i0) * pitch_y;
+            const uint8_t* y1 = y + size_t(ty.i1) * pitch_y;
+            const uint8_t* c0 = uv + size_t(tc.i0) * pitch_uv;
+            const uint8_t* c1 = uv + size_t(tc.i1) * pitch_uv;
+            const size_t row = base + size_t(oy) * config_.width;
+            for (int ox = 0; ox < g.out_w; ++ox) {
+                const Tap& tx = g.xs[size_t(ox)];
+                const Tap& tu = g.uv_xs[size_t(ox)];
+                const int luma = bilinear(y0[tx.i0], y0[tx.i1], y1[tx.i0], y1[tx.i1], tx.w1, ty.w1);
+                const int u0 = 2 * tu.i0;
+                const int u1 = 2 * tu.i1;
+                const int cu = bilinear(c0[u0], c0[u1], c1[u0], c1[u1], tu.w1, tc.w1);
+                const int cv = bilinear(c0[u0 + 1], c0[u1 + 1], c1[u0 + 1], c1[u1 + 1], tu.w1, tc.w1);
+                int r, gr, b;
+                yuv_to_rgb(luma, cu, cv, &r, &gr, &b);
+                store(row + size_t(ox), r, gr, b);
+            }
+        }
+    });
+    return info_of(g);
+}
+
+LetterboxInfo Preprocessor::run_bgr(int slot, const uint8_t* bgr, int width, int height, int pitch) {
+    const Geometry& g = prepare(slot, width, height);
+    const size_t base = size_t(slot) * 3 * plane_ + size_t(g.out_y) * config_.width + g.out_x;
+    Scheduler::instance().parallel_for(0, g.out_h, kRowGrain, [&](int row_begin, int row_end) {
+        for (int oy = row_begin; oy < row_end; ++oy) {
+            const Tap& ty = g.ys[size_t(oy)];
+            const uint8_t* r0 = bgr + size_t(ty.i0) * pitch;
+            const uint8_t* r1 = bgr + size_t(ty.i1) * pitch;
+            const size_t row = base + size_t(oy) * config_.width;
+            for (int ox = 0; ox < g.out_w; ++ox) {
+                const Tap& tx = g.xs[size_t(ox)];
+                const int a = 3 * tx.i0;
+                const int c = 3 * tx.i1;
+                const int b = bilinear(r0[a], r0[c], r1[a], r1[c], tx.w1, ty.w1);
+                const int gr = bilinear(r0[a + 1], r0[c + 1], r1[a + 1], r1[c + 1], tx.w1, ty.w1);
+                const int r = bilinear(r0[a + 2], r0[c + 2], r1[a + 2], r1[c + 2], tx.w1, ty.w1);
+                store(row + size_t(ox), r, gr, b);
+            }
+        }
+    });
+    return info_of(g);
+}
+
+bool Preprocessor::run_surface(int slot, const Surface& s, LetterboxInfo* info) {
+    if (!s.has_host()) return false;
+    *info = run_nv12(slot, s.data[0], s.data[1], s.width, s.height, s.pitch[0], s.pitch[1]);
+    return true;
+}
+
+bool Preprocessor::run_surface(int slot, const Surface& s, int x, int y, int w, int h, LetterboxInfo* info) {
+    if (!s.has_host()) return false;
+    if ((x | y) & 1 || x < 0 || y < 0 || w <= 0 || h <= 0 || x + w > s.width || y + h > s.height) return false;
+    const uint8_t* py = s.data[0] + size_t(y) * s.pitch[0] + x;
+    const uint8_t* puv = s.data[1] + size_t(y / 2) * s.pitch[1] + x;
+    *info = run_nv12(slot, py, puv, w, h, s.pitch[0], s.pitch[1]);
+    return true;
+}
+
+void Preprocessor::store(size_t index, int r, int g, int b) {
+    // index 指向 R 平面中的位置，G、B 平面依次相隔一个 plane_
+    if (config_.int8) {
+        int8_t* p = i8_.data() + index;
+        p[0] = lut_i8_[r];
+        p[plane_] = lut_i8_[g];
+        p[2 * plane_] = lut_i8_[b];
+    } else {
+        float* p = f32_.data() + index;
+        p[0] = lut_f32_[r];
+        p[plane_] = lut_f32_[g];
+        p[2 * plane_] = lut_f32_[b];
+    }
+}
+
+}  // namespace roi
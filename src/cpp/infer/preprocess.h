@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "../common/bilinear.h"
+#include "../decode/surface.h"
+
+namespace roi {
+
+struct PreprocessConfig {
+    int width = 416;   // 网络输入尺寸
+    int height = 416;
+    int batch = 1;
+    bool letterbox = false;   // true 保持宽高比并在两侧填充 pad_value，false 直接拉伸（与 blobFromImage 相同）
+    uint8_t pad_value = 127;  // Darknet letterbox 的填充值 0.5
+    bool int8 = false;        // true 输出 int8，q = round(x / 255 * int8_scale)
+    float int8_scale = 127.0f;
+};
+
+// 原图到网络输入的映射：input = src * scale + pad
+struct LetterboxInfo {
+    float scale_x = 1;
+    float scale_y = 1;
+    int pad_x = 0;
+    int pad_y = 0;
+};
+
+// 融合的检测预处理：缩放（双线性）、NV12→RGB 或 BGR→RGB、归一化、HWC→CHW 一次完成，
+// 直接写进预先分配的 NCHW 输入张量（float32 或 int8），不产生中间 BGR 帧。
+// 插值系数表只在源尺寸变化时重算，letterbox 的填充区域也只在那时重写。
+class Preprocessor {
+public:
+    explicit Preprocessor(PreprocessConfig config);
+
+    // 把一帧写进批中的第 slot 个位置
+    LetterboxInfo run_nv12(int slot, const uint8_t* y, const uint8_t* uv, int width, int height, int pitch_y,
+                           int pitch_uv);
+    LetterboxInfo run_bgr(int slot, const uint8_t* bgr, int width, int height, int pitch);
+    // 只接受有主机映射的帧，返回 false 表示帧只在设备内存里
+    bool run_surface(int slot, const Surface& s, LetterboxInfo* info);
+    // 只处理帧中 [x, x + w) x [y, y + h) 的区域，info 相对于区域左上角；
+    // x、y 须为偶数（NV12 色度按 2x2 采样），区域越界时返回 false
+    bool run_surface(int slot, const Surface& s, int x, int y, int w, int h, LetterboxInfo* info);
+
+    const void* data() const;
+    size_t bytes() const;
+    const PreprocessConfig& config() const { return config_; }
+
+private:
+    using Tap = BilinearTap;
+
+    struct Geometry {
+        int src_w = 0;
+        int src_h = 0;
+        int out_x = 0;  // 图像在输入张量中的区域
+        int out_y = 0;
+        int out_w = 0;
+        int out_h = 0;
+        std::vector<Tap> xs;
+        std::vector<Tap> ys;
+        std::vector<Tap> uv_xs;  // NV12 色度平面（半分辨率）
+        std::vector<Tap> uv_ys;
+    };
+
+    Geometry& prepare(int slot, int width, int height);
+    void fill_padding(int slot, const Geometry& g);
+    void store(size_t index, int r, int g, int b);
+    LetterboxInfo info_of(const Geometry& g) const;
+
+    PreprocessConfig config_;
+    size_t plane_ = 0;
+    std::vector<float> f32_;
+    std::vector<int8_t> i8_;
+    std::vector<Geometry> geometry_;  // 每个 slot 一份
+    float lut_f32_[256];
+    int8_t lut_i8_[256];
+};
+
+}  // namespace roi
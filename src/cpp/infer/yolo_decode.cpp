@@ -0,0 +1,204 @@
+#include "yolo_decode.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ROI_YOLO_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define ROI_YOLO_NEON 1
+#endif
+
+namespace roi {
+
+namespace {
+
+constexpr int kObjectness = 4;
+constexpr int kFirstClass = 5;
+
+// 目标置信度大于阈值的行号追加到 out
+void scan_scalar(const float* data, int begin, int rows, int stride, float threshold, std::vector<int>* out) {
+    const float* p = data + size_t(begin) * stride + kObjectness;
+    for (int i = begin; i < rows; ++i, p += stride) {
+        if (*p > threshold) out->push_back(i);
+    }
+}
+
+// 类别得分的最大值及其下标（相同时取靠前的，与 np.argmax 一致）
+int argmax_scalar(const float* scores, int n, float* best) {
+    int idx = 0;
+    float m = scores[0];
+    for (int i = 1; i < n; ++i) {
+        if (scores[i] > m) {
+            m = scores[i];
+            idx = i;
+        }
+    }
+    *best = m;
+    return idx;
+}
+
+#if defined(ROI_YOLO_X86)
+
+__attribute__((target("avx2"))) void scan_avx2(const float* data, int rows, int stride, float threshold,
+                                               std::vector<int>* out) {
+    // 一次从 8 行里各取目标置信度那一列
+    const __m256i idx = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                                            _mm256_set1_epi32(stride)),
+                                         _mm256_set1_epi32(kObjectness));
+    const __m256 thr = _mm256_set1_ps(threshold);
+    int i = 0;
+    for (; i + 8 <= rows; i += 8) {
+        const __m256 v = _mm256_i32gather_ps(data + size_t(i) * stride, idx, 4);
+        unsigned mask = unsigned(_mm256_movemask_ps(_mm256_cmp_ps(v, thr, _CMP_GT_OQ)));
+        while (mask) {
+            out->push_back(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+    scan_scalar(data, i, rows, stride, threshold, out);
+}
+
+__attribute__((target("avx2"))) int argmax_avx2(const float* scores, int n, float* best) {
+    if (n < 16) return argmax_scalar(scores, n, best);
+    __m256 m = _mm256_loadu_ps(scores);
+    int i = 8;
+    for (; i + 8 <= n; i += 8) m = _mm256_max_ps(m, _mm256_loadu_ps(scores + i));
+    __m128 r = _mm_max_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1));
+    r = _mm_max_ps(r, _mm_movehl_ps(r, r));
+    r = _mm_max_ss(r, _mm_shuffle_ps(r, r, 1));
+    float mx = _mm_cvtss_f32(r);
+    for (; i < n; ++i) mx = std::max(mx, scores[i]);
+    *best = mx;
+    for (int k = 0; k < n; ++k) {
+        if (scores[k] == mx) return k;
+    }
+    return 0;
+}
+
+bool have_avx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+void scan(const float* data, int rows, int stride, float threshold, std::vector<int>* out) {
+    if (have_avx2()) {
+        scan_avx2(data, rows, stride, threshold, out);
+    } else {
+        scan_scalar(data, 0, rows, stride, threshold, out);
+    }
+}
+
+int argmax(const float* scores, int n, float* best) {
+    return have_avx2() ? argmax_avx2(scores, n, best) : argmax_scalar(scores, n, best);
+}
+
+#elif defined(ROI_YOLO_NEON)
+
+void scan(const float* data, int rows, int stride, float threshold, std::vector<int>* out) {
+    const float32x4_t thr = vdupq_n_f32(threshold);
+    const float* p = data + kObjectness;
+    const size_t s = size_t(stride);
+    int i = 0;
+    for (; i + 4 <= rows; i += 4, p += 4 * s) {
+        float32x4_t v = vdupq_n_f32(p[0]);
+        v = vsetq_lane_f32(p[s], v, 1);
+        v = vsetq_lane_f32(p[2 * s], v, 2);
+        v = vsetq_lane_f32(p[3 * s], v, 3);
+        const uint32x4_t gt = vcgtq_f32(v, thr);
+        // 绝大多数行都在阈值以下，整组为 0 时直接跳过
+        if (vmaxvq_u32(gt) == 0) continue;
+        if (vgetq_lane_u32(gt, 0)) out->push_back(i);
+        if (vgetq_lane_u32(gt, 1)) out->push_back(i + 1);
+        if (vgetq_lane_u32(gt, 2)) out->push_back(i + 2);
+        if (vgetq_lane_u32(gt, 3)) out->push_back(i + 3);
+    }
+    scan_scalar(data, i, rows, stride, threshold, out);
+}
+
+int argmax(const float* scores, int n, float* best) {
+    if (n < 8) return argmax_scalar(scores, n, best);
+    float32x4_t m = vld1q_f32(scores);
+    int i = 4;
+    for (; i + 4 <= n; i += 4) m = vmaxq_f32(m, vld1q_f32(scores + i));
+    float mx = vmaxvq_f32(m);
+    for (; i < n; ++i) mx = std::max(mx, scores[i]);
+    *best = mx;
+    for (int k = 0; k < n; ++k) {
+        if (scores[k] == mx) return k;
+    }
+    return 0;
+}
+
+#else
+
+void scan(const float* data, int rows, int stride, float threshold, std::vector<int>* out) {
+    scan_scalar(data, 0, rows, stride, threshold, out);
+}
+
+int argmax(const float* scores, int n, float* best) { return argmax_scalar(scores, n, best); }
+
+#endif
+
+}  // namespace
+
+float iou(const Detection& a, const Detection& b) {
+    const float iw = std::min(a.x + a.w, b.x + b.w) - std::max(a.x, b.x);
+    const float ih = std::min(a.y + a.h, b.y + b.h) - std::max(a.y, b.y);
+    if (iw <= 0 || ih <= 0) return 0.0f;
+    const float inter = iw * ih;
+    return inter / (a.w * a.h + b.w * b.h - inter);
+}
+
+void nms(std::vector<Detection>* dets, float threshold, bool per_class) {
+    std::stable_sort(dets->begin(), dets->end(),
+                     [](const Detection& a, const Detection& b) { return a.confidence > b.confidence; });
+    size_t kept = 0;
+    for (size_t i = 0; i < dets->size(); ++i) {
+        const Detection& d = (*dets)[i];
+        bool keep = true;
+        for (size_t k = 0; k < kept; ++k) {
+            const Detection& e = (*dets)[k];
+            if (per_class && e.class_id != d.class_id) continue;
+            if (iou(d, e) > threshold) {
+                keep = false;
+                break;
+            }
+        }
+        if (keep) (*dets)[kept++] = d;
+    }
+    dets->resize(kept);
+}
+
+void yolo_decode(const YoloHead* heads, int num_heads, const YoloDecodeParams& params, std::vector<Detection>* out) {
+    thread_local std::vector<int> candidates;
+    out->clear();
+    const float fw = float(params.width);
+    const float fh = float(params.height);
+    for (int h = 0; h < num_heads; ++h) {
+        const YoloHead& head = heads[h];
+        const int classes = head.stride - kFirstClass;
+        if (!head.data || head.rows <= 0 || classes <= 0) continue;
+        candidates.clear();
+        scan(head.data, head.rows, head.stride, params.conf_threshold, &candidates);
+        for (int row : candidates) {
+            const float* r = head.data + size_t(row) * head.stride;
+            float confidence = 0;
+            const int class_id = argmax(r + kFirstClass, classes, &confidence);
+            if (!(confidence > params.conf_threshold)) continue;
+            Detection d;
+            d.w = r[2] * fw;
+            d.h = r[3] * fh;
+            d.x = r[0] * fw - d.w / 2;
+            d.y = r[1] * fh - d.h / 2;
+            d.confidence = confidence;
+            d.class_id = class_id;
+            out->push_back(d);
+        }
+    }
+    nms(out, params.nms_threshold, params.per_class);
+}
+
+}  // namespace roi
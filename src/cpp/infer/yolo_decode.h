@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+namespace roi {
+
+// 原图像素坐标下的一个检测框
+struct Detection {
+    float x = 0;
+    float y = 0;
+    float w = 0;
+    float h = 0;
+    float confidence = 0;
+    int class_id = 0;
+};
+
+// 一个 YOLO 输出头：rows 行，每行 stride 个 float，依次是归一化的 cx, cy, w, h、
+// 目标置信度和各类得分。类别得分已乘上目标置信度（cv2.dnn 的 region 层和
+// Python 侧 SailBackend 都是这个格式），所以目标置信度不超过阈值的行可以整行跳过。
+struct YoloHead {
+    const float* data = nullptr;
+    int rows = 0;
+    int stride = 0;
+};
+
+struct YoloDecodeParams {
+    int width = 0;   // 原图尺寸，用于把归一化坐标换算成像素
+    int height = 0;
+    float conf_threshold = 0.5f;
+    float nms_threshold = 0.4f;
+    bool per_class = true;  // false 时不同类别之间也互相抑制（与 cv2.dnn.NMSBoxes 相同）
+};
+
+// 阈值筛选、框解码与 NMS，结果按置信度降序写入 out。
+// 目标置信度的筛选用 SIMD 一次比较多行（x86 上运行时检测 AVX2，aarch64 上用 NEON），
+// 只有通过的候选行才做类别 argmax；中间缓冲是线程局部的，稳定运行时不分配内存。
+void yolo_decode(const YoloHead* heads, int num_heads, const YoloDecodeParams& params, std::vector<Detection>* out);
+
+// 原地做贪心 NMS：按置信度降序，与已保留框的 IoU 大于 threshold 的框被去掉
+void nms(std::vector<Detection>* dets, float threshold, bool per_class);
+
+float iou(const Detection& a, const Detection& b);
+
+}  // namespace roi
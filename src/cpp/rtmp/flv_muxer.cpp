@@ -0,0 +1,152 @@
+#include "flv_muxer.h"
+
+#include <cstring>
+
+#include "../common/annexb.h"
+
+namespace roi {
+
+namespace {
+
+constexpr int kFlvCodecAvc = 7;
+constexpr int kFlvCodecHevcLegacy = 12;
+constexpr uint8_t kFourCcHvc1[4] = {'h', 'v', 'c', '1'};
+
+void put_be16(std::vector<uint8_t>& b, uint32_t v) {
+    b.push_back(uint8_t(v >> 8));
+    b.push_back(uint8_t(v));
+}
+
+void put_nal_array(std::vector<uint8_t>& b, int type, const std::string& nal) {
+    b.push_back(uint8_t(0x80 | (type & 0x3f)));  // array_completeness = 1
+    put_be16(b, 1);
+    put_be16(b, uint32_t(nal.size()));
+    b.insert(b.end(), nal.begin(), nal.end());
+}
+
+// 去掉防竞争字节（00 00 03），只取前 limit 个 RBSP 字节
+std::vector<uint8_t> rbsp_prefix(const std::string& nal, size_t skip, size_t limit) {
+    std::vector<uint8_t> out;
+    int zeros = 0;
+    for (size_t i = skip; i < nal.size() && out.size() < limit; ++i) {
+        const uint8_t c = uint8_t(nal[i]);
+        if (zeros >= 2 && c == 3) {
+            zeros = 0;
+            continue;
+        }
+        zeros = c == 0 ? zeros + 1 : 0;
+        out.push_back(c);
+    }
+    return out;
+}
+
+}  // namespace
+
+bool ParamSets::complete(Codec codec) const {
+    if (sps.empty() || pps.empty()) return false;
+    return codec != Codec::kH265 || !vps.empty();
+}
+
+bool flv_skip_nal(Codec codec, uint8_t first_byte) {
+    const int t = nal_type(codec, first_byte);
+    if (codec == Codec::kH265) return t >= 32 && t <= 35;
+    return t >= 7 && t <= 9;
+}
+
+bool collect_param_sets(Codec codec, const uint8_t* data, size_t size, ParamSets* out) {
+    bool found = false;
+    for_each_nal(data, size, [&](const uint8_t* nal, size_t len) {
+        const int t = nal_type(codec, nal[0]);
+        std::string* slot = nullptr;
+        if (codec == Codec::kH265) {
+            if (t == 32) slot = &out->vps;
+            if (t == 33) slot = &out->sps;
+            if (t == 34) slot = &out->pps;
+        } else {
+            if (t == 7) slot = &out->sps;
+            if (t == 8) slot = &out->pps;
+        }
+        if (slot) {
+            slot->assign(reinterpret_cast<const char*>(nal), len);
+            found = true;
+        }
+    });
+    return found;
+}
+
+std::vector<uint8_t> avc_decoder_config(const ParamSets& ps) {
+    std::vector<uint8_t> b;
+    if (ps.sps.size() < 4 || ps.pps.empty()) return b;
+    b.push_back(1);  // configurationVersion
+    b.push_back(uint8_t(ps.sps[1]));  // AVCProfileIndication
+    b.push_back(uint8_t(ps.sps[2]));  // profile_compatibility
+    b.push_back(uint8_t(ps.sps[3]));  // AVCLevelIndication
+    b.push_back(0xff);  // lengthSizeMinusOne = 3
+    b.push_back(0xe1);  // numOfSequenceParameterSets = 1
+    put_be16(b, uint32_t(ps.sps.size()));
+    b.insert(b.end(), ps.sps.begin(), ps.sps.end());
+    b.push_back(1);
+    put_be16(b, uint32_t(ps.pps.size()));
+    b.insert(b.end(), ps.pps.begin(), ps.pps.end());
+    return b;
+}
+
+std::vector<uint8_t> hevc_decoder_config(const ParamSets& ps) {
+    std::vector<uint8_t> b;
+    // SPS：2 字节 NAL 头后依次是 vps_id(4) max_sub_layers_minus1(3) temporal_id_nesting(1)
+    // 和 12 字节的 general profile_tier_level
+    const std::vector<uint8_t> sps = rbsp_prefix(ps.sps, 2, 13);
+    if (sps.size() < 13 || ps.vps.empty() || ps.pps.empty()) return b;
+    const int sub_layers = ((sps[0] >> 1) & 0x7) + 1;
+    const int nesting = sps[0] & 1;
+
+    b.push_back(1);  // configurationVersion
+    b.insert(b.end(), sps.begin() + 1, sps.begin() + 13);  // profile/tier/level 原样拷贝
+    put_be16(b, 0xf000);  // min_spatial_segmentation_idc = 0
+    b.push_back(0xfc);  // parallelismType = 0
+    // 本工程的编码器只输出 8bit 4:2:0，这里不再解析 SPS 的指数哥伦布字段
+    b.push_back(0xfc | 1);  // chromaFormat = 4:2:0
+    b.push_back(0xf8);  // bitDepthLumaMinus8 = 0
+    b.push_back(0xf8);  // bitDepthChromaMinus8 = 0
+    put_be16(b, 0);  // avgFrameRate
+    b.push_back(uint8_t((sub_layers << 3) | (nesting << 2) | 3));  // lengthSizeMinusOne = 3
+    b.push_back(3);  // numOfArrays
+    put_nal_array(b, 32, ps.vps);
+    put_nal_array(b, 33, ps.sps);
+    put_nal_array(b, 34, ps.pps);
+    return b;
+}
+
+size_t flv_video_header(Codec codec, HevcFlvMode mode, bool key, bool sequence_header, int32_t cts_ms, uint8_t* out) {
+    const int frame_type = key ? 1 : 2;
+    if (codec == Codec::kH265 && mode == HevcFlvMode::kEnhanced) {
+        // IsExHeader | FrameType | PacketType（0 = SequenceStart，1 = CodedFrames）
+        out[0] = uint8_t(0x80 | (frame_type << 4) | (sequence_header ? 0 : 1));
+        std::memcpy(out + 1, kFourCcHvc1, 4);
+        if (sequence_header) return 5;
+        out[5] = uint8_t(cts_ms >> 16);
+        out[6] = uint8_t(cts_ms >> 8);
+        out[7] = uint8_t(cts_ms);
+        return 8;
+    }
+    const int codec_id = codec == Codec::kH265 ? kFlvCodecHevcLegacy : kFlvCodecAvc;
+    out[0] = uint8_t((frame_type << 4) | codec_id);
+    out[1] = sequence_header ? 0 : 1;  // AVCPacketType
+    if (sequence_header) cts_ms = 0;
+    out[2] = uint8_t(cts_ms >> 16);
+    out[3] = uint8_t(cts_ms >> 8);
+    out[4] = uint8_t(cts_ms);
+    return 5;
+}
+
+std::vector<uint8_t> flv_sequence_header(Codec codec, HevcFlvMode mode, const ParamSets& ps) {
+    const std::vector<uint8_t> record = codec == Codec::kH265 ? hevc_decoder_config(ps) : avc_decoder_config(ps);
+    if (record.empty()) return record;
+    uint8_t header[kFlvVideoHeaderMax];
+    const size_t n = flv_video_header(codec, mode, true, true, 0, header);
+    std::vector<uint8_t> body(header, header + n);
+    body.insert(body.end(), record.begin(), record.end());
+    return body;
+}
+
+}  // namespace roi
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../common/au_ring.h"
+
+namespace roi {
+
+// H.265 在 FLV 中的封装方式
+enum class HevcFlvMode : int {
+    kEnhanced = 0,  // Enhanced RTMP：ExHeader + FourCC 'hvc1'（SRS 5+/nginx-rtmp 新版、FFmpeg 6.1+）
+    kLegacy = 1,    // 国内 CDN 常用的 CodecID=12 扩展
+};
+
+// 一个 AU 中的参数集（去掉起始码的 NAL）
+struct ParamSets {
+    std::string vps;  // 仅 H.265
+    std::string sps;
+    std::string pps;
+
+    bool complete(Codec codec) const;
+    bool operator==(const ParamSets& o) const { return vps == o.vps && sps == o.sps && pps == o.pps; }
+    bool operator!=(const ParamSets& o) const { return !(*this == o); }
+};
+
+// NAL 是否为参数集或 AUD：这些 NAL 在 FLV 中放进序列头，不随帧发送
+bool flv_skip_nal(Codec codec, uint8_t first_byte);
+
+// 从 Annex-B 访问单元中提取参数集，返回是否找到了至少一个
+bool collect_param_sets(Codec codec, const uint8_t* data, size_t size, ParamSets* out);
+
+// AVCDecoderConfigurationRecord / HEVCDecoderConfigurationRecord
+std::vector<uint8_t> avc_decoder_config(const ParamSets& ps);
+std::vector<uint8_t> hevc_decoder_config(const ParamSets& ps);
+
+// FLV 视频标签头的最大字节数
+constexpr size_t kFlvVideoHeaderMax = 8;
+
+// 写视频标签头（FrameType/CodecID/PacketType/CompositionTime），返回写入的字节数。
+// sequence_header 为 true 时写序列头，否则写编码帧
+size_t flv_video_header(Codec codec, HevcFlvMode mode, bool key, bool sequence_header, int32_t cts_ms, uint8_t* out);
+
+// 完整的序列头标签体：标签头 + DecoderConfigurationRecord
+std::vector<uint8_t> flv_sequence_header(Codec codec, HevcFlvMode mode, const ParamSets& ps);
+
+}  // namespace roi
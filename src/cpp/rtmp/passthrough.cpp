@@ -0,0 +1,154 @@
+#include "passthrough.h"
+
+#include <cstring>
+
+#include "../common/annexb.h"
+#include "../common/scheduler.h"
+
+namespace roi {
+
+namespace {
+
+constexpr int kWaitMs = 100;
+
+// AU 里有参考 slice 就算参考帧：H.264 看 nal_ref_idc，H.265 的 *_N 类型（0-14 的偶数）为子层非参考帧
+bool is_reference(Codec codec, const uint8_t* data, size_t size) {
+    bool vcl = false;
+    bool reference = false;
+    for_each_nal(data, size, [&](const uint8_t* nal, size_t) {
+        const int type = nal_type(codec, nal[0]);
+        if (codec == Codec::kH265) {
+            if (type > 31) return;
+            vcl = true;
+            if (type > 14 || type % 2 == 1) reference = true;
+        } else {
+            if (type != 1 && type != 5) return;
+            vcl = true;
+            if ((nal[0] >> 5) & 3) reference = true;
+        }
+    });
+    return reference || !vcl;
+}
+
+}  // namespace
+
+Passthrough::Passthrough(AuRing* ring, RtmpStreamer* streamer, PassthroughConfig config)
+    : ring_(ring), streamer_(streamer), config_(config), buffers_(config.block_bytes, config.blocks) {}
+
+Passthrough::~Passthrough() { stop(); }
+
+bool Passthrough::start(std::string* err) {
+    consumer_ = ring_->add_consumer();
+    if (consumer_ < 0) {
+        if (err) *err = "too many consumers on rtsp ring";
+        return false;
+    }
+    window_start_ = std::chrono::steady_clock::now();
+    running_.store(true);
+    thread_ = std::thread(&Passthrough::forward_loop, this);
+    return true;
+}
+
+void Passthrough::stop() {
+    if (!running_.exchange(false)) return;
+    ring_->wake_all();
+    if (thread_.joinable()) thread_.join();
+    ring_->remove_consumer(consumer_);
+    consumer_ = -1;
+}
+
+void Passthrough::set_mode(Mode mode) { requested_.store(mode, std::memory_order_relaxed); }
+
+bool Passthrough::send_encoded(const EncodedPacket& pkt) { return emit(Mode::kEncode, pkt); }
+
+int64_t Passthrough::last_dts() const {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return have_last_ ? last_dts_ : -1;
+}
+
+PassthroughStats Passthrough::stats() const {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return stats_;
+}
+
+void Passthrough::forward_loop() {
+    Scheduler::instance().enter(ThreadRole::kRtmp, "roi-passthru");
+    AccessUnitView au;
+    while (running_.load(std::memory_order_relaxed)) {
+        if (!ring_->wait(consumer_, &au, std::chrono::milliseconds(kWaitMs))) continue;
+        account(au);
+        forward_one(au);
+        ring_->release(consumer_);
+    }
+}
+
+void Passthrough::forward_one(const AccessUnitView& au) {
+    // 重编码期间只统计码率，不拷贝
+    if (requested_.load(std::memory_order_relaxed) != Mode::kPassthrough ||
+        (active() != Mode::kPassthrough && !(au.flags & kAuKeyFrame))) {
+        std::lock_guard<std::mutex> lk(mutex_);
+        ++stats_.skipped_source;
+        return;
+    }
+    if (au.codec != config_.codec) {
+        std::lock_guard<std::mutex> lk(mutex_);
+        ++stats_.codec_mismatch;
+        return;
+    }
+    // 环形缓冲区里的 AU 在 release() 后会被复用，而推流队列可能压着上百帧，所以拷进缓冲池
+    PoolBufferPtr buf = buffers_.acquire(au.size);
+    std::memcpy(buf->data, au.data, au.size);
+    EncodedPacket pkt;
+    pkt.data = buf->data;
+    pkt.size = au.size;
+    pkt.pts = au.pts;
+    pkt.dts = au.pts;  // 监控摄像头的码流不带 B 帧，解码顺序即显示顺序
+    pkt.key = (au.flags & kAuKeyFrame) != 0;
+    pkt.reference = pkt.key || is_reference(au.codec, au.data, au.size);
+    pkt.codec = au.codec;
+    pkt.owner = std::move(buf);
+    emit(Mode::kPassthrough, pkt);
+}
+
+bool Passthrough::emit(Mode from, const EncodedPacket& pkt) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    const Mode requested = requested_.load(std::memory_order_relaxed);
+    uint64_t& skipped = from == Mode::kPassthrough ? stats_.skipped_source : stats_.skipped_encoded;
+    if (active_.load(std::memory_order_relaxed) == from) {
+        // 请求重编码后源码流立即停发，编码器的关键帧到达之前画面停在最后一帧
+        if (from == Mode::kPassthrough && requested != Mode::kPassthrough) {
+            ++skipped;
+            return false;
+        }
+    } else {
+        if (requested != from || !pkt.key || (have_last_ && pkt.dts <= last_dts_)) {
+            ++skipped;
+            return false;
+        }
+        active_.store(from, std::memory_order_release);
+        ++stats_.switches;
+    }
+    last_dts_ = pkt.dts;
+    have_last_ = true;
+    if (from == Mode::kPassthrough) {
+        ++stats_.forwarded_frames;
+        stats_.forwarded_bytes += pkt.size;
+    } else {
+        ++stats_.encoded_frames;
+    }
+    return streamer_->send(pkt);
+}
+
+void Passthrough::account(const AccessUnitView& au) {
+    window_bytes_ += au.size;
+    const auto now = std::chrono::steady_clock::now();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - window_start_).count();
+    if (elapsed < config_.rate_window_ms) return;
+    const double kbps = 8.0 * double(window_bytes_) / double(elapsed);
+    window_bytes_ = 0;
+    window_start_ = now;
+    std::lock_guard<std::mutex> lk(mutex_);
+    stats_.source_kbps = kbps;
+}
+
+}  // namespace roi
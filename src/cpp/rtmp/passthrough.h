@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "../common/au_ring.h"
+#include "../common/pool.h"
+#include "rtmp_streamer.h"
+
+namespace roi {
+
+struct PassthroughConfig {
+    Codec codec = Codec::kH264;     // 须与推流端一致，编码格式不同的源 AU 不会直通
+    size_t block_bytes = 64 << 10;  // 直通 AU 的缓冲块，超过块大小的关键帧退回堆分配
+    uint32_t blocks = 64;
+    int rate_window_ms = 1000;      // 源码率的统计窗口
+};
+
+struct PassthroughStats {
+    uint64_t forwarded_frames = 0;  // 直通送往推流端的 AU
+    uint64_t forwarded_bytes = 0;
+    uint64_t encoded_frames = 0;    // 重编码送往推流端的包
+    uint64_t skipped_source = 0;    // 重编码期间丢弃的源 AU
+    uint64_t skipped_encoded = 0;   // 直通期间丢弃的编码包
+    uint32_t switches = 0;
+    uint32_t codec_mismatch = 0;    // 编码格式与推流端不同而无法直通的 AU
+    double source_kbps = 0;         // 最近一个统计窗口内的源码率
+};
+
+// 直通转封装：源码流不需要 ROI 重编码时（画面里没有目标、源码率也在预算内），
+// 把 RTSP 收到的 H.264/H.265 AU 原样交给 RtmpStreamer 转成 FLV，省掉 VPU 编码和编码器的
+// 一个 GOP 延迟；需要 ROI 时再切回编码器的输出。解码仍在进行，检测靠它发现目标。
+//
+// 两路输入在关键帧处切换，时间戳都是 RTSP 的 90kHz 时间、不做偏移，新的一路只能从 dts 晚于
+// 最后发出的一帧的关键帧接手，FLV 时间戳不会回退：
+// - 请求直通后编码器继续输出，直到源码流的下一个 IDR；源码流领先编码输出一个解码加编码的延迟，
+//   中间这段编码帧不再发出，画面向前跳过这段延迟；
+// - 请求重编码后源码流立即停发，调用方跳过 pts 不晚于 last_dts() 的帧，在恢复编码的第一帧上
+//   force_key，编码器的关键帧到达后接手，中间画面停顿一个延迟，不会重播已经发过的帧。
+// 序列头由 RtmpStreamer 在参数集变化的关键帧前自动重发。
+class Passthrough {
+public:
+    enum class Mode : int { kEncode = 0, kPassthrough = 1 };
+
+    Passthrough(AuRing* ring, RtmpStreamer* streamer, PassthroughConfig config);
+    ~Passthrough();
+    Passthrough(const Passthrough&) = delete;
+    Passthrough& operator=(const Passthrough&) = delete;
+
+    bool start(std::string* err);
+    void stop();
+
+    // 请求的模式，在对应一路的下一个关键帧处生效
+    void set_mode(Mode mode);
+    Mode requested() const { return requested_.load(std::memory_order_relaxed); }
+    // 当前在推流的一路；为 kPassthrough 时编码器可以暂停
+    Mode active() const { return active_.load(std::memory_order_acquire); }
+
+    // 编码器输出代替 RtmpStreamer::send() 从这里发送，返回 false 表示没有入队
+    bool send_encoded(const EncodedPacket& pkt);
+    // 最近发出的一帧的 dts（90kHz），还没有发出过任何帧时返回 -1
+    int64_t last_dts() const;
+
+    PassthroughStats stats() const;
+
+private:
+    void forward_loop();
+    void forward_one(const AccessUnitView& au);
+    // 从 from 这一路发出 pkt，需要时在这里切换
+    bool emit(Mode from, const EncodedPacket& pkt);
+    void account(const AccessUnitView& au);
+
+    AuRing* ring_;
+    RtmpStreamer* streamer_;
+    PassthroughConfig config_;
+    BufferPool buffers_;
+    int consumer_ = -1;
+
+    // 切换状态，收流转发线程与编码（推流）线程共用
+    mutable std::mutex mutex_;
+    int64_t last_dts_ = 0;  // 最近发出的一帧
+    bool have_last_ = false;
+    PassthroughStats stats_;
+
+    // 源码率统计，只在转发线程里访问
+    std::chrono::steady_clock::time_point window_start_;
+    uint64_t window_bytes_ = 0;
+
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<Mode> requested_{Mode::kEncode};
+    std::atomic<Mode> active_{Mode::kEncode};
+};
+
+}  // namespace roi
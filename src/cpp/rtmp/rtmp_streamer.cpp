@@ -0,0 +1,1086 @@
+#include "rtmp_streamer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <linux/sockios.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../common/annexb.h"
+#include "../common/net.h"
+
+namespace roi {
+
+namespace {
+
+constexpr size_t kRxBufferBytes = 64 * 1024;
+constexpr size_t kHandshakeBytes = 1536;
+constexpr int kStallCheckMs = 200;
+constexpr int kSendMarkMs = 10;        // 写出进度标记的最小间隔
+constexpr size_t kMaxSendMarks = 512;
+constexpr size_t kMaxIov = 1024;  // Linux 的 IOV_MAX
+
+// 块流 ID 与消息类型
+constexpr uint32_t kControlCsid = 2;
+constexpr uint32_t kCommandCsid = 3;
+constexpr uint32_t kDataCsid = 4;
+constexpr uint32_t kVideoCsid = 6;
+constexpr uint8_t kMsgSetChunkSize = 1;
+constexpr uint8_t kMsgAck = 3;
+constexpr uint8_t kMsgUserControl = 4;
+constexpr uint8_t kMsgWindowAckSize = 5;
+constexpr uint8_t kMsgSetPeerBandwidth = 6;
+constexpr uint8_t kMsgVideo = 9;
+constexpr uint8_t kMsgDataAmf0 = 18;
+constexpr uint8_t kMsgCommandAmf3 = 17;
+constexpr uint8_t kMsgCommandAmf0 = 20;
+constexpr uint16_t kUserPingRequest = 6;
+constexpr uint16_t kUserPingResponse = 7;
+
+// 块头最多 1 + 11 + 4（扩展时间戳）字节
+constexpr size_t kChunkHeaderMax = 16;
+
+uint32_t be16(const uint8_t* p) { return (uint32_t(p[0]) << 8) | p[1]; }
+uint32_t be24(const uint8_t* p) { return (uint32_t(p[0]) << 16) | (uint32_t(p[1]) << 8) | p[2]; }
+uint32_t be32(const uint8_t* p) { return (uint32_t(p[0]) << 24) | be24(p + 1); }
+
+void set_be24(uint8_t* p, uint32_t v) {
+    p[0] = uint8_t(v >> 16);
+    p[1] = uint8_t(v >> 8);
+    p[2] = uint8_t(v);
+}
+
+void set_be32(uint8_t* p, uint32_t v) {
+    p[0] = uint8_t(v >> 24);
+    set_be24(p + 1, v);
+}
+
+// 写 fmt 0 的完整块头，返回字节数
+size_t chunk_header(uint8_t* p, uint32_t csid, uint32_t timestamp, uint32_t length, uint8_t type,
+                    uint32_t stream_id) {
+    const bool extended = timestamp >= 0xffffff;
+    p[0] = uint8_t(csid & 0x3f);
+    set_be24(p + 1, extended ? 0xffffff : timestamp);
+    set_be24(p + 4, length);
+    p[7] = type;
+    // 消息流 ID 是协议中唯一的小端字段
+    p[8] = uint8_t(stream_id);
+    p[9] = uint8_t(stream_id >> 8);
+    p[10] = uint8_t(stream_id >> 16);
+    p[11] = uint8_t(stream_id >> 24);
+    if (!extended) return 12;
+    set_be32(p + 12, timestamp);
+    return 16;
+}
+
+// fmt 3 的续块头
+size_t continuation_header(uint8_t* p, uint32_t csid, uint32_t timestamp) {
+    p[0] = uint8_t(0xc0 | (csid & 0x3f));
+    if (timestamp < 0xffffff) return 1;
+    set_be32(p + 1, timestamp);
+    return 5;
+}
+
+class AmfWriter {
+public:
+    void number(double v) {
+        b_.push_back(0x00);
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        for (int i = 7; i >= 0; --i) b_.push_back(uint8_t(bits >> (i * 8)));
+    }
+    void boolean(bool v) {
+        b_.push_back(0x01);
+        b_.push_back(v ? 1 : 0);
+    }
+    void string(const std::string& s) {
+        b_.push_back(0x02);
+        key(s);
+    }
+    void null() { b_.push_back(0x05); }
+    void begin_object() { b_.push_back(0x03); }
+    void begin_ecma_array(uint32_t count) {
+        b_.push_back(0x08);
+        uint8_t n[4];
+        set_be32(n, count);
+        b_.insert(b_.end(), n, n + 4);
+    }
+    void end_object() {
+        const uint8_t end[3] = {0, 0, 9};
+        b_.insert(b_.end(), end, end + 3);
+    }
+    void prop(const std::string& k, const std::string& v) {
+        key(k);
+        string(v);
+    }
+    void prop(const std::string& k, double v) {
+        key(k);
+        number(v);
+    }
+    void prop(const std::string& k, const std::vector<std::string>& list) {
+        key(k);
+        b_.push_back(0x0a);  // strict array
+        uint8_t n[4];
+        set_be32(n, uint32_t(list.size()));
+        b_.insert(b_.end(), n, n + 4);
+        for (const auto& s : list) string(s);
+    }
+    const std::vector<uint8_t>& bytes() const { return b_; }
+
+private:
+    void key(const std::string& s) {
+        b_.push_back(uint8_t(s.size() >> 8));
+        b_.push_back(uint8_t(s.size()));
+        b_.insert(b_.end(), s.begin(), s.end());
+    }
+    std::vector<uint8_t> b_;
+};
+
+// 只解析应答里用得到的部分：顶层数值/字符串，以及对象中的字符串属性
+struct AmfValue {
+    int type = -1;
+    double number = 0;
+    std::string str;
+    std::map<std::string, std::string> props;
+};
+
+bool amf_read(const uint8_t*& p, const uint8_t* end, AmfValue* v, int depth) {
+    if (p >= end || depth > 8) return false;
+    v->type = *p++;
+    switch (v->type) {
+        case 0x00: {  // number
+            if (end - p < 8) return false;
+            uint64_t bits = 0;
+            for (int i = 0; i < 8; ++i) bits = (bits << 8) | p[i];
+            std::memcpy(&v->number, &bits, sizeof(bits));
+            p += 8;
+            return true;
+        }
+        case 0x01:  // boolean
+            if (p >= end) return false;
+            v->number = *p++;
+            return true;
+        case 0x02:    // string
+        case 0x0c: {  // long string
+            const size_t hn = v->type == 0x02 ? 2 : 4;
+            if (size_t(end - p) < hn) return false;
+            const size_t len = hn == 2 ? be16(p) : be32(p);
+            p += hn;
+            if (size_t(end - p) < len) return false;
+            v->str.assign(reinterpret_cast<const char*>(p), len);
+            p += len;
+            v->type = 0x02;
+            return true;
+        }
+        case 0x03:    // object
+        case 0x08: {  // ECMA array
+            if (v->type == 0x08) {
+                if (end - p < 4) return false;
+                p += 4;
+            }
+            for (;;) {
+                if (end - p < 2) return false;
+                const size_t klen = be16(p);
+                p += 2;
+                if (klen == 0) {
+                    if (p < end && *p == 0x09) ++p;
+                    return true;
+                }
+                if (size_t(end - p) < klen) return false;
+                const std::string key(reinterpret_cast<const char*>(p), klen);
+                p += klen;
+                AmfValue child;
+                if (!amf_read(p, end, &child, depth + 1)) return false;
+                if (child.type == 0x02) v->props[key] = child.str;
+            }
+        }
+        case 0x05:  // null
+        case 0x06:  // undefined
+            return true;
+        case 0x0a: {  // strict array
+            if (end - p < 4) return false;
+            const uint32_t count = be32(p);
+            p += 4;
+            for (uint32_t i = 0; i < count; ++i) {
+                AmfValue child;
+                if (!amf_read(p, end, &child, depth + 1)) return false;
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool starts_with(const std::string& s, const char* prefix) { return s.compare(0, std::strlen(prefix), prefix) == 0; }
+
+}  // namespace
+
+RtmpStreamer::RtmpStreamer(RtmpConfig config) : config_(std::move(config)), rx_(kRxBufferBytes) {
+    config_.chunk_size = std::max(128, std::min(config_.chunk_size, 0xffffff));
+}
+
+RtmpStreamer::~RtmpStreamer() { stop(); }
+
+std::string RtmpStreamer::last_error() const {
+    std::lock_guard<std::mutex> lk(error_mutex_);
+    return error_;
+}
+
+void RtmpStreamer::fail(const std::string& msg) {
+    {
+        std::lock_guard<std::mutex> lk(error_mutex_);
+        error_ = msg;
+    }
+    state_.store(State::kError, std::memory_order_release);
+    // 在 I/O 线程里出错时立即注销，对端关闭的 socket 在水平触发下会一直可读
+    detach();
+}
+
+void RtmpStreamer::set_key_frame_callback(std::function<void()> cb) {
+    std::lock_guard<std::mutex> lk(queue_mutex_);
+    key_frame_cb_ = std::move(cb);
+}
+
+RtmpStats RtmpStreamer::stats() const {
+    RtmpStats st;
+    st.sent_frames = sent_frames_.load(std::memory_order_relaxed);
+    st.sent_bytes = sent_bytes_.load(std::memory_order_relaxed);
+    st.acked_bytes = acked_bytes_.load(std::memory_order_relaxed);
+    st.dropped_nonref = dropped_nonref_.load(std::memory_order_relaxed);
+    st.dropped_ref = dropped_ref_.load(std::memory_order_relaxed);
+    st.socket_bytes = socket_bytes_.load(std::memory_order_relaxed);
+    st.rtt_us = rtt_us_.load(std::memory_order_relaxed);
+    st.ack_delay_ms = ack_delay_ms_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lk(queue_mutex_);
+    st.queued_frames = queue_.size();
+    st.queued_bytes = queue_bytes_;
+    if (queue_.size() > 1) st.queued_ms = uint32_t(std::max<int64_t>(0, queue_.back().dts - queue_.front().dts) / 90);
+    return st;
+}
+
+bool RtmpStreamer::start() {
+    if (running_.load()) return true;
+    // 解析 rtmp://host[:port]/app[/instance]/stream：最后一段是流名，其余是 app
+    const std::string& url = config_.url;
+    std::string scheme;
+    for (size_t i = 0; i < url.size() && i < 7; ++i) scheme.push_back(char(std::tolower((unsigned char)url[i])));
+    if (!starts_with(scheme, "rtmp://")) {
+        fail("not an rtmp url: " + url);
+        return false;
+    }
+    const std::string rest = url.substr(7);
+    const size_t slash = rest.find('/');
+    const std::string path = slash == std::string::npos ? "" : rest.substr(slash + 1);
+    const size_t last = path.rfind('/');
+    if (last == std::string::npos || last == 0 || last + 1 >= path.size()) {
+        fail("rtmp url needs app and stream name: " + url);
+        return false;
+    }
+    const std::string authority = rest.substr(0, slash);
+    app_ = path.substr(0, last);
+    stream_name_ = path.substr(last + 1);
+    const size_t colon = authority.rfind(':');
+    if (colon != std::string::npos && authority.find(']', colon) == std::string::npos) {
+        host_ = authority.substr(0, colon);
+        port_ = std::atoi(authority.c_str() + colon + 1);
+    } else {
+        host_ = authority;
+    }
+    if (!host_.empty() && host_.front() == '[') host_ = host_.substr(1, host_.size() - 2);
+    tc_url_ = "rtmp://" + authority + "/" + app_;
+
+    std::string err;
+    fd_ = tcp_connect(host_, port_, config_.timeout_ms, false, &err);
+    if (fd_ < 0) {
+        fail(err);
+        return false;
+    }
+    wake_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wake_fd_ < 0 || !handshake() || !connect_app()) {
+        if (wake_fd_ < 0) fail("eventfd: " + errno_string());
+        close_fd(&fd_);
+        close_fd(&wake_fd_);
+        return false;
+    }
+    set_nonblocking(fd_, true);
+    state_.store(State::kPublishing, std::memory_order_release);
+    running_.store(true);
+    if (!attach(&err)) {
+        fail(err);
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void RtmpStreamer::stop() {
+    running_.store(false);
+    detach();
+    loop_.reset();
+    // 一帧写到一半时不能再插入命令，否则服务器会解析错块流
+    if (fd_ >= 0 && state() == State::kPublishing && (!out_.active || out_.written == 0)) {
+        AmfWriter a;
+        a.string("deleteStream");
+        a.number(next_transaction_++);
+        a.null();
+        a.number(stream_id_);
+        queue_message(kCommandCsid, kMsgCommandAmf0, 0, 0, a.bytes().data(), a.bytes().size());
+        flush_blocking();
+    }
+    close_fd(&fd_);
+    close_fd(&wake_fd_);
+    out_.active = false;
+    out_.packet = EncodedPacket();
+    control_tx_.clear();
+    control_off_ = 0;
+    send_marks_.clear();
+    {
+        std::lock_guard<std::mutex> lk(queue_mutex_);
+        queue_.clear();
+        queue_bytes_ = 0;
+    }
+    if (state() != State::kIdle) state_.store(State::kStopped, std::memory_order_release);
+}
+
+// ---------------- 握手与命令 ----------------
+
+bool RtmpStreamer::handshake() {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(config_.timeout_ms);
+    auto read_exact = [&](uint8_t* out, size_t n) {
+        while (n > 0) {
+            const int left = int(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                     deadline - std::chrono::steady_clock::now())
+                                     .count());
+            if (left <= 0 || wait_readable(fd_, left) <= 0) return false;
+            const ssize_t r = ::recv(fd_, out, n, 0);
+            if (r <= 0) {
+                if (r < 0 && errno == EINTR) continue;
+                return false;
+            }
+            out += r;
+            n -= size_t(r);
+        }
+        return true;
+    };
+
+    // 简单握手：C1 = 时间戳 + 4 个零字节 + 随机数，C2 原样回送 S1
+    std::vector<uint8_t> c0c1(1 + kHandshakeBytes);
+    c0c1[0] = 3;
+    set_be32(&c0c1[1], uint32_t(std::time(nullptr)));
+    std::minstd_rand rng(uint32_t(std::chrono::steady_clock::now().time_since_epoch().count()));
+    for (size_t i = 9; i < c0c1.size(); ++i) c0c1[i] = uint8_t(rng());
+    if (!send_all(fd_, c0c1.data(), c0c1.size(), config_.timeout_ms)) {
+        fail("rtmp handshake: send C0/C1 failed");
+        return false;
+    }
+    std::vector<uint8_t> s0s1(1 + kHandshakeBytes);
+    if (!read_exact(s0s1.data(), s0s1.size())) {
+        fail("rtmp handshake: no S0/S1 from " + host_);
+        return false;
+    }
+    if (s0s1[0] != 3) {
+        fail("rtmp handshake: unsupported version " + std::to_string(s0s1[0]));
+        return false;
+    }
+    if (!send_all(fd_, &s0s1[1], kHandshakeBytes, config_.timeout_ms)) {
+        fail("rtmp handshake: send C2 failed");
+        return false;
+    }
+    std::vector<uint8_t> s2(kHandshakeBytes);
+    if (!read_exact(s2.data(), s2.size())) {
+        fail("rtmp handshake: no S2 from " + host_);
+        return false;
+    }
+    return true;
+}
+
+bool RtmpStreamer::connect_app() {
+    queue_control(kMsgSetChunkSize, uint32_t(config_.chunk_size));
+
+    AmfWriter connect;
+    const double connect_txn = next_transaction_++;
+    connect.string("connect");
+    connect.number(connect_txn);
+    connect.begin_object();
+    connect.prop("app", app_);
+    connect.prop("type", std::string("nonprivate"));
+    connect.prop("flashVer", std::string("FMLE/3.0 (compatible; FMSc/1.0)"));
+    connect.prop("tcUrl", tc_url_);
+    if (config_.codec == Codec::kH265 && config_.hevc_mode == HevcFlvMode::kEnhanced) {
+        // Enhanced RTMP 通过 fourCcList 声明要使用的编码
+        connect.prop("fourCcList", std::vector<std::string>{"hvc1"});
+    }
+    connect.end_object();
+    queue_message(kCommandCsid, kMsgCommandAmf0, 0, 0, connect.bytes().data(), connect.bytes().size());
+    if (!flush_blocking()) {
+        fail("rtmp connect: send failed");
+        return false;
+    }
+    std::string code;
+    if (!wait_command(connect_txn, &code, nullptr)) {
+        if (state() != State::kError) fail("rtmp connect rejected: " + code);
+        return false;
+    }
+
+    for (const char* name : {"releaseStream", "FCPublish"}) {
+        AmfWriter a;
+        a.string(name);
+        a.number(next_transaction_++);
+        a.null();
+        a.string(stream_name_);
+        queue_message(kCommandCsid, kMsgCommandAmf0, 0, 0, a.bytes().data(), a.bytes().size());
+    }
+    AmfWriter create;
+    const double create_txn = next_transaction_++;
+    create.string("createStream");
+    create.number(create_txn);
+    create.null();
+    queue_message(kCommandCsid, kMsgCommandAmf0, 0, 0, create.bytes().data(), create.bytes().size());
+    double stream_id = 0;
+    if (!flush_blocking() || !wait_command(create_txn, &code, &stream_id)) {
+        if (state() != State::kError) fail("rtmp createStream failed: " + code);
+        return false;
+    }
+    stream_id_ = uint32_t(stream_id);
+
+    AmfWriter publish;
+    publish.string("publish");
+    publish.number(next_transaction_++);
+    publish.null();
+    publish.string(stream_name_);
+    publish.string("live");
+    queue_message(kCommandCsid, kMsgCommandAmf0, stream_id_, 0, publish.bytes().data(), publish.bytes().size());
+    // publish 的结果以 onStatus 返回，事务号为 0
+    if (!flush_blocking() || !wait_command(0, &code, nullptr) || code != "NetStream.Publish.Start") {
+        if (state() != State::kError) fail("rtmp publish " + stream_name_ + " failed: " + code);
+        return false;
+    }
+    queue_metadata();
+    return flush_blocking();
+}
+
+bool RtmpStreamer::wait_command(double transaction, std::string* code, double* number) {
+    pending_transaction_ = transaction;
+    command_done_ = false;
+    command_error_ = false;
+    command_code_.clear();
+    command_number_ = 0;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(config_.timeout_ms);
+    while (!command_done_) {
+        const int left = int(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                 deadline - std::chrono::steady_clock::now())
+                                 .count());
+        if (left <= 0) {
+            fail("rtmp: no response from " + host_);
+            return false;
+        }
+        if (!read_some(left)) {
+            fail("rtmp: connection to " + host_ + " closed");
+            return false;
+        }
+        if (!parse_chunks()) return false;
+        // 握手阶段的 Acknowledgement / Ping 应答
+        if (!flush_blocking()) {
+            fail("rtmp: send failed: " + errno_string());
+            return false;
+        }
+    }
+    pending_transaction_ = -1;
+    if (code) *code = command_code_;
+    if (number) *number = command_number_;
+    return !command_error_;
+}
+
+// ---------------- 接收 ----------------
+
+bool RtmpStreamer::read_some(int timeout_ms) {
+    if (rx_begin_ > 0) {
+        std::memmove(rx_.data(), rx_.data() + rx_begin_, rx_end_ - rx_begin_);
+        rx_end_ -= rx_begin_;
+        rx_begin_ = 0;
+    }
+    // 服务器可能把块大小设得比缓冲区还大
+    const size_t need = size_t(in_chunk_size_) + kChunkHeaderMax + 3;
+    if (rx_.size() - rx_end_ < need) rx_.resize(std::max(rx_.size() * 2, rx_end_ + need));
+
+    if (timeout_ms != 0) {
+        const int ready = wait_readable(fd_, timeout_ms);
+        if (ready < 0) return false;
+        if (ready == 0) return true;
+    }
+    const ssize_t n = ::recv(fd_, rx_.data() + rx_end_, rx_.size() - rx_end_, MSG_DONTWAIT);
+    if (n == 0) return false;
+    if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    rx_end_ += size_t(n);
+    rx_total_ += uint64_t(n);
+    if (ack_window_ > 0 && rx_total_ - rx_acked_ >= ack_window_) {
+        queue_control(kMsgAck, uint32_t(rx_total_));
+        rx_acked_ = rx_total_;
+    }
+    return true;
+}
+
+bool RtmpStreamer::parse_chunks() {
+    static const size_t kMessageHeaderBytes[4] = {11, 7, 3, 0};
+    while (rx_begin_ < rx_end_) {
+        const uint8_t* p = rx_.data() + rx_begin_;
+        const size_t avail = rx_end_ - rx_begin_;
+        const int fmt = p[0] >> 6;
+        uint32_t csid = p[0] & 0x3f;
+        size_t pos = 1;
+        if (csid == 0) {
+            if (avail < 2) return true;
+            csid = 64 + p[1];
+            pos = 2;
+        } else if (csid == 1) {
+            if (avail < 3) return true;
+            csid = 64 + p[1] + (uint32_t(p[2]) << 8);
+            pos = 3;
+        }
+        if (avail < pos + kMessageHeaderBytes[fmt]) return true;
+
+        // 块收全之前不修改块流状态，下次从块头重新解析
+        ChunkStream& cs = in_streams_[csid];
+        uint32_t ts_field = 0;
+        uint32_t length = cs.length;
+        uint8_t type = cs.type;
+        uint32_t stream_id = cs.stream_id;
+        if (fmt <= 2) ts_field = be24(p + pos);
+        if (fmt <= 1) {
+            length = be24(p + pos + 3);
+            type = p[pos + 6];
+        }
+        if (fmt == 0) stream_id = p[pos + 7] | (p[pos + 8] << 8) | (p[pos + 9] << 16) | (uint32_t(p[pos + 10]) << 24);
+        pos += kMessageHeaderBytes[fmt];
+        const bool extended = fmt == 3 ? cs.extended : ts_field == 0xffffff;
+        uint32_t ext = 0;
+        if (extended) {
+            if (avail < pos + 4) return true;
+            ext = be32(p + pos);
+            pos += 4;
+        }
+        if (length > (16u << 20)) {
+            fail("rtmp: oversized message from " + host_);
+            return false;
+        }
+        const bool fresh = fmt != 3 || cs.payload.empty();
+        const size_t have = fresh ? 0 : cs.payload.size();
+        const size_t take = std::min(size_t(length) - have, size_t(in_chunk_size_));
+        if (avail < pos + take) return true;
+
+        if (fmt == 0) {
+            cs.timestamp = extended ? ext : ts_field;
+            cs.delta = 0;
+        } else if (fmt <= 2) {
+            cs.delta = extended ? ext : ts_field;
+            cs.timestamp += cs.delta;
+        } else if (fresh) {
+            cs.timestamp += cs.delta;
+        }
+        if (fresh) cs.payload.clear();
+        cs.length = length;
+        cs.type = type;
+        cs.stream_id = stream_id;
+        cs.extended = extended;
+        cs.payload.insert(cs.payload.end(), p + pos, p + pos + take);
+        rx_begin_ += pos + take;
+        if (cs.payload.size() >= cs.length) {
+            on_message(cs);
+            cs.payload.clear();
+            if (state() == State::kError) return false;
+        }
+    }
+    return true;
+}
+
+void RtmpStreamer::on_message(const ChunkStream& cs) {
+    const uint8_t* p = cs.payload.data();
+    const size_t n = cs.payload.size();
+    switch (cs.type) {
+        case kMsgSetChunkSize:
+            if (n >= 4) in_chunk_size_ = std::max<uint32_t>(1, be32(p) & 0x7fffffff);
+            break;
+        case kMsgAck:
+            if (n >= 4) {
+                // 32 位计数会回绕，这里展开成 64 位
+                const uint64_t prev = acked_bytes_.load(std::memory_order_relaxed);
+                uint64_t acked = (prev & ~uint64_t(0xffffffff)) | be32(p);
+                if (acked < prev) acked += uint64_t(1) << 32;
+                acked_bytes_.store(acked, std::memory_order_relaxed);
+                on_ack(acked);
+            }
+            break;
+        case kMsgUserControl:
+            if (n >= 6 && be16(p) == kUserPingRequest) {
+                uint8_t pong[6] = {0, uint8_t(kUserPingResponse), p[2], p[3], p[4], p[5]};
+                queue_message(kControlCsid, kMsgUserControl, 0, 0, pong, sizeof(pong));
+            }
+            break;
+        case kMsgWindowAckSize:
+            if (n >= 4) ack_window_ = be32(p);
+            break;
+        case kMsgSetPeerBandwidth:
+            // 回应同样大小的确认窗口
+            if (n >= 4) queue_control(kMsgWindowAckSize, be32(p));
+            break;
+        case kMsgCommandAmf3:
+            if (n > 1) on_command(p + 1, n - 1);
+            break;
+        case kMsgCommandAmf0:
+            on_command(p, n);
+            break;
+        default:
+            break;
+    }
+}
+
+void RtmpStreamer::on_command(const uint8_t* p, size_t n) {
+    const uint8_t* end = p + n;
+    AmfValue name, transaction;
+    if (!amf_read(p, end, &name, 0) || name.type != 0x02) return;
+    if (!amf_read(p, end, &transaction, 0)) return;
+    // 其余参数：命令对象、信息对象或数值（createStream 返回的流 ID）
+    std::map<std::string, std::string> props;
+    double number = 0;
+    bool have_number = false;
+    while (p < end) {
+        AmfValue v;
+        if (!amf_read(p, end, &v, 0)) break;
+        if (v.type == 0x00 && !have_number) {
+            number = v.number;
+            have_number = true;
+        }
+        for (auto& kv : v.props) props[kv.first] = kv.second;
+    }
+    const bool error = props["level"] == "error";
+    std::string code = props["code"];
+    if (error && !props["description"].empty()) code += " (" + props["description"] + ")";
+
+    if (name.str == "_result" || name.str == "_error") {
+        if (transaction.number != pending_transaction_) return;
+        command_done_ = true;
+        command_error_ = name.str == "_error";
+        command_code_ = code.empty() ? name.str : code;
+        command_number_ = number;
+    } else if (name.str == "onStatus") {
+        if (pending_transaction_ == 0) {
+            command_done_ = true;
+            command_error_ = error;
+            command_code_ = props["code"];
+        } else if (error && state() == State::kPublishing) {
+            fail("rtmp server error: " + code);
+        }
+    }
+}
+
+// ---------------- 发送 ----------------
+
+void RtmpStreamer::queue_message(uint32_t csid, uint8_t type, uint32_t stream_id, uint32_t timestamp,
+                                 const uint8_t* body, size_t size) {
+    uint8_t header[kChunkHeaderMax];
+    size_t n = chunk_header(header, csid, timestamp, uint32_t(size), type, stream_id);
+    control_tx_.insert(control_tx_.end(), header, header + n);
+    const size_t chunk = size_t(config_.chunk_size);
+    for (size_t off = 0; off < size; off += chunk) {
+        if (off > 0) {
+            n = continuation_header(header, csid, timestamp);
+            control_tx_.insert(control_tx_.end(), header, header + n);
+        }
+        const size_t take = std::min(chunk, size - off);
+        control_tx_.insert(control_tx_.end(), body + off, body + off + take);
+    }
+}
+
+void RtmpStreamer::queue_control(uint8_t type, uint32_t value) {
+    uint8_t body[4];
+    set_be32(body, value);
+    queue_message(kControlCsid, type, 0, 0, body, sizeof(body));
+}
+
+void RtmpStreamer::queue_metadata() {
+    double codec_id = config_.codec == Codec::kH265 ? 12 : 7;
+    if (config_.codec == Codec::kH265 && config_.hevc_mode == HevcFlvMode::kEnhanced) codec_id = 0x68766331;  // 'hvc1'
+    AmfWriter a;
+    a.string("@setDataFrame");
+    a.string("onMetaData");
+    a.begin_ecma_array(6);
+    a.prop("width", double(config_.width));
+    a.prop("height", double(config_.height));
+    a.prop("framerate", double(config_.fps));
+    a.prop("videodatarate", double(config_.bitrate_kbps));
+    a.prop("videocodecid", codec_id);
+    a.prop("encoder", std::string("ROI-Video-Transmission"));
+    a.end_object();
+    queue_message(kDataCsid, kMsgDataAmf0, stream_id_, 0, a.bytes().data(), a.bytes().size());
+}
+
+bool RtmpStreamer::flush_blocking() {
+    if (control_off_ >= control_tx_.size()) return true;
+    const size_t n = control_tx_.size() - control_off_;
+    const bool ok = send_all(fd_, control_tx_.data() + control_off_, n, config_.timeout_ms);
+    if (ok) sent_bytes_.fetch_add(n, std::memory_order_relaxed);
+    control_tx_.clear();
+    control_off_ = 0;
+    return ok;
+}
+
+bool RtmpStreamer::fits(size_t size) const {
+    if (queue_.empty()) return true;
+    return queue_.size() < config_.queue_packets && queue_bytes_ + size <= config_.queue_bytes;
+}
+
+bool RtmpStreamer::make_room(const EncodedPacket& pkt, bool* request_key) {
+    // 新来的帧本身就是非参考帧：丢它最便宜
+    if (!pkt.reference && !pkt.key) {
+        dropped_nonref_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    // 1. 从最旧的开始丢非参考帧，不影响后续解码
+    for (auto it = queue_.begin(); it != queue_.end() && !fits(pkt.size);) {
+        if (!it->reference && !it->key) {
+            queue_bytes_ -= it->size;
+            it = queue_.erase(it);
+            dropped_nonref_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            ++it;
+        }
+    }
+    if (fits(pkt.size)) return true;
+
+    // 2. 新的关键帧可以取代队列里所有旧帧
+    if (pkt.key) {
+        dropped_ref_.fetch_add(queue_.size(), std::memory_order_relaxed);
+        queue_.clear();
+        queue_bytes_ = 0;
+        return true;
+    }
+
+    // 3. 队列里有更新的关键帧时，丢掉它之前的整段 GOP
+    auto key = std::find_if(queue_.rbegin(), queue_.rend(), [](const EncodedPacket& p) { return p.key; });
+    if (key != queue_.rend()) {
+        const auto first_keep = std::prev(key.base());
+        for (auto it = queue_.begin(); it != first_keep; ++it) queue_bytes_ -= it->size;
+        dropped_ref_.fetch_add(size_t(first_keep - queue_.begin()), std::memory_order_relaxed);
+        queue_.erase(queue_.begin(), first_keep);
+        if (fits(pkt.size)) return true;
+    }
+
+    // 4. 仍然放不下：清空队列，丢弃参考帧直到下一个关键帧
+    dropped_ref_.fetch_add(queue_.size() + 1, std::memory_order_relaxed);
+    queue_.clear();
+    queue_bytes_ = 0;
+    waiting_key_ = true;
+    *request_key = true;
+    return false;
+}
+
+bool RtmpStreamer::send(const EncodedPacket& pkt) {
+    if (state() != State::kPublishing || !pkt.data || pkt.size == 0) return false;
+    bool accepted = true;
+    bool request_key = false;
+    std::function<void()> cb;
+    {
+        std::lock_guard<std::mutex> lk(queue_mutex_);
+        if (waiting_key_ && !pkt.key) {
+            dropped_ref_.fetch_add(1, std::memory_order_relaxed);
+            accepted = false;
+        } else {
+            if (pkt.key) waiting_key_ = false;
+            if (!fits(pkt.size)) accepted = make_room(pkt, &request_key);
+            if (accepted) {
+                queue_.push_back(pkt);
+                queue_bytes_ += pkt.size;
+            }
+        }
+        if (request_key) cb = key_frame_cb_;
+    }
+    if (accepted) {
+        const uint64_t one = 1;
+        (void)!::write(wake_fd_, &one, sizeof(one));
+    }
+    if (cb) cb();
+    return accepted;
+}
+
+// ---------------- 事件循环 ----------------
+
+bool RtmpStreamer::attach(std::string* err) {
+    loop_ = IoLoop::acquire();
+    if (!loop_) {
+        if (err) *err = "no io loop";
+        return false;
+    }
+    bool ok = true;
+    loop_->run_sync([&] {
+        attached_ = true;
+        blocked_ = false;
+        last_sent_ = sent_bytes_.load(std::memory_order_relaxed);
+        last_progress_ = std::chrono::steady_clock::now();
+        ok = loop_->add(fd_, EPOLLIN, [this](uint32_t ev) { on_socket(ev); }, err) &&
+             loop_->add(wake_fd_, EPOLLIN, [this](uint32_t) { on_wake(); }, err);
+        if (!ok) return;
+        timer_ = loop_->add_timer(kStallCheckMs, [this] { on_timer(); });
+        // publish 时排队的控制消息和 start() 之前送来的帧
+        service();
+    });
+    return ok;
+}
+
+void RtmpStreamer::detach() {
+    if (!loop_) return;
+    loop_->run_sync([this] {
+        if (!attached_) return;
+        attached_ = false;
+        loop_->remove(fd_);
+        loop_->remove(wake_fd_);
+        if (timer_) loop_->cancel_timer(timer_);
+        timer_ = 0;
+    });
+}
+
+void RtmpStreamer::on_socket(uint32_t events) {
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        if (!read_some(0)) {
+            fail("rtmp: connection to " + host_ + " lost");
+            return;
+        }
+        if (!parse_chunks()) return;
+    }
+    service();
+}
+
+void RtmpStreamer::on_wake() {
+    uint64_t v;
+    (void)!::read(wake_fd_, &v, sizeof(v));
+    service();
+}
+
+void RtmpStreamer::service() {
+    if (!attached_) return;
+    const int w = pump_writes();
+    if (w < 0) {
+        fail("rtmp: send to " + host_ + " failed: " + errno_string());
+        return;
+    }
+    blocked_ = w == 0;
+    loop_->modify(fd_, EPOLLIN | (blocked_ ? EPOLLOUT : 0u));
+
+    const uint64_t sent = sent_bytes_.load(std::memory_order_relaxed);
+    const auto now = std::chrono::steady_clock::now();
+    if (send_marks_.empty() ||
+        (sent > send_marks_.back().first && now - send_marks_.back().second >= std::chrono::milliseconds(kSendMarkMs))) {
+        if (send_marks_.size() == kMaxSendMarks) send_marks_.pop_front();
+        send_marks_.emplace_back(sent, now);
+    }
+}
+
+void RtmpStreamer::on_ack(uint64_t acked) {
+    // sent_bytes_ 不含握手的 3073 字节，服务器的计数口径可能差这么多，对时延没有影响；取被确认的最后一个标记
+    bool found = false;
+    std::chrono::steady_clock::time_point written;
+    while (!send_marks_.empty() && send_marks_.front().first <= acked) {
+        written = send_marks_.front().second;
+        found = true;
+        send_marks_.pop_front();
+    }
+    if (!found) return;
+    const auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - written);
+    ack_delay_ms_.store(uint32_t(delay.count()), std::memory_order_relaxed);
+}
+
+void RtmpStreamer::on_timer() {
+    tcp_info ti{};
+    socklen_t len = sizeof(ti);
+    if (::getsockopt(fd_, IPPROTO_TCP, TCP_INFO, &ti, &len) == 0) rtt_us_.store(ti.tcpi_rtt, std::memory_order_relaxed);
+    int outq = 0;
+    if (::ioctl(fd_, SIOCOUTQ, &outq) == 0) socket_bytes_.store(uint64_t(std::max(0, outq)), std::memory_order_relaxed);
+
+    // 服务器长时间不收数据：认为连接已失效，由上层重连
+    const auto now = std::chrono::steady_clock::now();
+    const uint64_t sent = sent_bytes_.load(std::memory_order_relaxed);
+    if (sent != last_sent_ || !blocked_) {
+        last_sent_ = sent;
+        last_progress_ = now;
+    } else if (now - last_progress_ > std::chrono::milliseconds(config_.timeout_ms)) {
+        fail("rtmp: send to " + host_ + " stalled for " + std::to_string(config_.timeout_ms) + " ms");
+    }
+}
+
+int RtmpStreamer::pump_writes() {
+    for (;;) {
+        // 控制消息只能插在两帧之间
+        if (control_off_ < control_tx_.size() && (!out_.active || out_.written == 0)) {
+            const ssize_t n = ::send(fd_, control_tx_.data() + control_off_, control_tx_.size() - control_off_,
+                                     MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+            }
+            control_off_ += size_t(n);
+            sent_bytes_.fetch_add(uint64_t(n), std::memory_order_relaxed);
+            if (control_off_ == control_tx_.size()) {
+                control_tx_.clear();
+                control_off_ = 0;
+            }
+            continue;
+        }
+        if (!out_.active) {
+            if (!begin_next_message()) return 1;
+            continue;
+        }
+
+        msghdr mh{};
+        mh.msg_iov = &out_.iov[out_.next];
+        mh.msg_iovlen = std::min(out_.iov.size() - out_.next, kMaxIov);
+        const ssize_t n = ::sendmsg(fd_, &mh, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        size_t left = size_t(n);
+        while (left > 0) {
+            iovec& v = out_.iov[out_.next];
+            if (left >= v.iov_len) {
+                left -= v.iov_len;
+                ++out_.next;
+            } else {
+                v.iov_base = static_cast<uint8_t*>(v.iov_base) + left;
+                v.iov_len -= left;
+                left = 0;
+            }
+        }
+        out_.written += size_t(n);
+        sent_bytes_.fetch_add(uint64_t(n), std::memory_order_relaxed);
+        if (out_.written >= out_.total) {
+            out_.active = false;
+            out_.packet = EncodedPacket();  // 归还编码器缓冲
+            sent_frames_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+bool RtmpStreamer::begin_next_message() {
+    {
+        std::lock_guard<std::mutex> lk(queue_mutex_);
+        if (queue_.empty()) return false;
+        out_.packet = std::move(queue_.front());
+        queue_.pop_front();
+        queue_bytes_ -= out_.packet.size;
+    }
+    const EncodedPacket& pkt = out_.packet;
+    if (pkt.key) {
+        // 关键帧带的参数集变化（或第一次出现）时先发序列头
+        ParamSets ps = params_;
+        if (collect_param_sets(config_.codec, pkt.data, pkt.size, &ps) && ps.complete(config_.codec) &&
+            (ps != params_ || !sent_sequence_header_)) {
+            const std::vector<uint8_t> body = flv_sequence_header(config_.codec, config_.hevc_mode, ps);
+            if (!body.empty()) {
+                queue_message(kVideoCsid, kMsgVideo, stream_id_, timestamp_of(pkt), body.data(), body.size());
+                params_ = ps;
+                sent_sequence_header_ = true;
+            }
+        }
+    }
+    if (!sent_sequence_header_) {
+        // 没有序列头播放端无法解码，等待带参数集的关键帧
+        dropped_ref_.fetch_add(1, std::memory_order_relaxed);
+        out_.packet = EncodedPacket();
+        return true;
+    }
+    build_message(&out_);
+    return true;
+}
+
+uint32_t RtmpStreamer::timestamp_of(const EncodedPacket& pkt) {
+    if (!have_base_) {
+        dts_base_ = pkt.dts;
+        have_base_ = true;
+    }
+    return uint32_t(std::max<int64_t>(0, (pkt.dts - dts_base_) / 90));
+}
+
+void RtmpStreamer::build_message(OutMessage* m) {
+    const EncodedPacket& pkt = m->packet;
+    nals_.clear();
+    for_each_nal(pkt.data, pkt.size, [&](const uint8_t* nal, size_t len) {
+        if (!flv_skip_nal(config_.codec, nal[0])) nals_.emplace_back(nal, len);
+    });
+
+    const uint32_t ts = timestamp_of(pkt);
+    const int32_t cts = int32_t((pkt.pts - pkt.dts) / 90);
+    uint8_t tag[kFlvVideoHeaderMax];
+    const size_t tag_len = flv_video_header(config_.codec, config_.hevc_mode, pkt.key, false, cts, tag);
+    size_t body = tag_len;
+    for (const auto& nal : nals_) body += 4 + nal.second;
+
+    // 一次性分配好所有头部的空间，iov 指向其中的地址，之后不能再扩容
+    const size_t chunk = size_t(config_.chunk_size);
+    const size_t chunks = (body + chunk - 1) / chunk;
+    m->scratch.resize(kChunkHeaderMax + tag_len + 4 * nals_.size() + chunks * 5);
+    uint8_t* s = m->scratch.data();
+    size_t used = 0;
+    m->iov.clear();
+    m->next = 0;
+    m->written = 0;
+    m->total = 0;
+
+    auto push = [m](const uint8_t* p, size_t n) {
+        // 相邻的头部字节合并成一个 iov
+        if (!m->iov.empty()) {
+            iovec& last = m->iov.back();
+            if (static_cast<uint8_t*>(last.iov_base) + last.iov_len == p) {
+                last.iov_len += n;
+                m->total += n;
+                return;
+            }
+        }
+        m->iov.push_back({const_cast<uint8_t*>(p), n});
+        m->total += n;
+    };
+    size_t in_chunk = 0;
+    auto add_body = [&](const uint8_t* p, size_t n) {
+        while (n > 0) {
+            if (in_chunk == chunk) {
+                const size_t h = continuation_header(s + used, kVideoCsid, ts);
+                push(s + used, h);
+                used += h;
+                in_chunk = 0;
+            }
+            const size_t take = std::min(n, chunk - in_chunk);
+            push(p, take);
+            p += take;
+            n -= take;
+            in_chunk += take;
+        }
+    };
+
+    const size_t h = chunk_header(s, kVideoCsid, ts, uint32_t(body), kMsgVideo, stream_id_);
+    push(s, h);
+    used = h;
+    std::memcpy(s + used, tag, tag_len);
+    const uint8_t* tag_at = s + used;
+    used += tag_len;
+    add_body(tag_at, tag_len);
+    for (const auto& nal : nals_) {
+        // AVCC/HVCC 的 4 字节长度前缀代替起始码，NAL 负载直接引用编码器缓冲
+        uint8_t* len = s + used;
+        set_be32(len, uint32_t(nal.second));
+        used += 4;
+        add_body(len, 4);
+        add_body(nal.first, nal.second);
+    }
+    m->active = true;
+}
+
+}  // namespace roi
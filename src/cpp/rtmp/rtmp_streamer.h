@@ -0,0 +1,201 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sys/uio.h>
+
+#include "../common/io_loop.h"
+#include "../encode/roi_encoder.h"
+#include "flv_muxer.h"
+
+namespace roi {
+
+struct RtmpConfig {
+    std::string url;  // rtmp://host[:port]/app[/instance]/stream[?query]
+    Codec codec = Codec::kH264;
+    int timeout_ms = 5000;            // 握手、publish 与发送停滞超时
+    size_t queue_bytes = 4 << 20;     // 发送队列上限（字节）
+    size_t queue_packets = 150;       // 发送队列上限（帧数）
+    int chunk_size = 4096;
+    HevcFlvMode hevc_mode = HevcFlvMode::kEnhanced;
+    // 以下仅写入 onMetaData
+    int width = 0;
+    int height = 0;
+    int fps = 0;
+    int bitrate_kbps = 0;
+};
+
+struct RtmpStats {
+    uint64_t sent_frames = 0;
+    uint64_t sent_bytes = 0;       // 写入 socket 的字节数（含 RTMP 头）
+    uint64_t acked_bytes = 0;      // 服务器 Acknowledgement 报告的累计字节数
+    uint64_t dropped_nonref = 0;   // 拥塞时丢弃的非参考帧
+    uint64_t dropped_ref = 0;      // 拥塞时丢弃的参考帧（之后等待下一个关键帧）
+    uint64_t queued_frames = 0;
+    uint64_t queued_bytes = 0;
+    // 码控用的拥塞信号，由 I/O 线程每 200ms 采样
+    uint64_t socket_bytes = 0;     // 内核发送缓冲里对端还没确认的字节（SIOCOUTQ）
+    uint32_t queued_ms = 0;        // 发送队列首尾两帧的 dts 跨度
+    uint32_t rtt_us = 0;           // TCP 平滑 RTT
+    uint32_t ack_delay_ms = 0;     // 最近一次 Acknowledgement 确认的字节从写出到被确认的时间，服务器不发确认时为 0
+};
+
+// RTMP 推流端。start() 在调用线程中完成握手与 connect/createStream/publish，
+// 成功后把 socket 切到非阻塞模式交给共享的 IoLoop，与同一线程上的其他推流、收流会话复用。
+// send() 只把编码输出放进有界队列就返回，慢速的服务器不会阻塞编码线程；
+// I/O 线程把 Annex-B 帧按 FLV/RTMP 分块格式直接用 sendmsg 分散写出，
+// 码流本身不做拷贝，只有 RTMP 块头、FLV 标签头和 NAL 长度前缀写在小缓冲里。
+class RtmpStreamer {
+public:
+    enum class State : int { kIdle = 0, kPublishing = 1, kError = 2, kStopped = 3 };
+
+    explicit RtmpStreamer(RtmpConfig config);
+    ~RtmpStreamer();
+    RtmpStreamer(const RtmpStreamer&) = delete;
+    RtmpStreamer& operator=(const RtmpStreamer&) = delete;
+
+    bool start();
+    void stop();
+
+    // 非阻塞入队，返回 false 表示该帧被丢弃。队列满时先丢非参考帧，
+    // 仍然放不下则丢掉参考帧并等待下一个关键帧，同时调用关键帧回调
+    bool send(const EncodedPacket& pkt);
+
+    // 丢弃参考帧后请求编码器尽快输出关键帧；回调在 send() 的调用线程中执行
+    void set_key_frame_callback(std::function<void()> cb);
+
+    State state() const { return state_.load(std::memory_order_acquire); }
+    const RtmpConfig& config() const { return config_; }
+    std::string last_error() const;
+    RtmpStats stats() const;
+
+private:
+    // 收到的一路块流的状态
+    struct ChunkStream {
+        uint32_t timestamp = 0;
+        uint32_t delta = 0;
+        uint32_t length = 0;
+        uint8_t type = 0;
+        uint32_t stream_id = 0;
+        bool extended = false;
+        std::vector<uint8_t> payload;
+    };
+
+    // 正在发送的一帧：iov 指向 scratch 中的头部和编码器缓冲中的 NAL
+    struct OutMessage {
+        EncodedPacket packet;
+        std::vector<uint8_t> scratch;
+        std::vector<iovec> iov;
+        size_t next = 0;     // 下一个未写完的 iov
+        size_t written = 0;  // 已写出的字节
+        size_t total = 0;
+        bool active = false;
+    };
+
+    bool handshake();
+    bool connect_app();
+    bool wait_command(double transaction, std::string* code, double* number);
+    bool read_some(int timeout_ms);
+    bool parse_chunks();
+    void on_message(const ChunkStream& cs);
+    void on_command(const uint8_t* p, size_t n);
+
+    void queue_message(uint32_t csid, uint8_t type, uint32_t stream_id, uint32_t timestamp, const uint8_t* body,
+                       size_t size);
+    void queue_control(uint8_t type, uint32_t value);
+    void queue_metadata();
+    bool flush_blocking();
+
+    bool attach(std::string* err);
+    void detach();
+    void on_socket(uint32_t events);
+    void on_wake();
+    void on_timer();
+    void service();     // 写出队列并按结果开关 EPOLLOUT
+    void on_ack(uint64_t acked);
+    int pump_writes();  // 1 队列已写空，0 socket 写满，-1 出错
+    bool begin_next_message();
+    uint32_t timestamp_of(const EncodedPacket& pkt);
+    void build_message(OutMessage* m);
+    bool fits(size_t size) const;
+    bool make_room(const EncodedPacket& pkt, bool* request_key);
+    void fail(const std::string& msg);
+
+    RtmpConfig config_;
+    std::string host_;
+    int port_ = 1935;
+    std::string app_;
+    std::string stream_name_;
+    std::string tc_url_;
+
+    int fd_ = -1;
+    int wake_fd_ = -1;
+    uint32_t stream_id_ = 0;
+    double next_transaction_ = 1;
+
+    // 接收方向
+    std::vector<uint8_t> rx_;
+    size_t rx_begin_ = 0;
+    size_t rx_end_ = 0;
+    uint32_t in_chunk_size_ = 128;
+    std::map<uint32_t, ChunkStream> in_streams_;
+    uint64_t rx_total_ = 0;
+    uint64_t rx_acked_ = 0;
+    uint32_t ack_window_ = 0;
+    // 握手阶段等待的命令应答
+    double pending_transaction_ = -1;
+    bool command_done_ = false;
+    bool command_error_ = false;
+    std::string command_code_;
+    double command_number_ = 0;
+
+    // 发送方向：控制消息（协议控制、命令、序列头）先于下一帧写出
+    std::vector<uint8_t> control_tx_;
+    size_t control_off_ = 0;
+    OutMessage out_;
+    std::vector<std::pair<const uint8_t*, size_t>> nals_;
+    ParamSets params_;
+    bool sent_sequence_header_ = false;
+    bool have_base_ = false;
+    int64_t dts_base_ = 0;
+
+    // 编码线程与事件循环之间的有界队列
+    mutable std::mutex queue_mutex_;
+    std::deque<EncodedPacket> queue_;
+    size_t queue_bytes_ = 0;
+    bool waiting_key_ = false;
+    std::function<void()> key_frame_cb_;
+
+    // 发布之后以上收发状态只在 IoLoop 线程里访问
+    std::shared_ptr<IoLoop> loop_;
+    uint64_t timer_ = 0;
+    bool attached_ = false;
+    bool blocked_ = false;  // 上次写到 socket 写满
+    uint64_t last_sent_ = 0;
+    std::chrono::steady_clock::time_point last_progress_;
+    // 写出进度的时间标记（累计字节，时刻），收到 Acknowledgement 时据此算确认时延
+    std::deque<std::pair<uint64_t, std::chrono::steady_clock::time_point>> send_marks_;
+
+    std::atomic<bool> running_{false};
+    std::atomic<State> state_{State::kIdle};
+    std::atomic<uint64_t> sent_frames_{0};
+    std::atomic<uint64_t> sent_bytes_{0};
+    std::atomic<uint64_t> acked_bytes_{0};
+    std::atomic<uint64_t> dropped_nonref_{0};
+    std::atomic<uint64_t> dropped_ref_{0};
+    std::atomic<uint64_t> socket_bytes_{0};
+    std::atomic<uint32_t> rtt_us_{0};
+    std::atomic<uint32_t> ack_delay_ms_{0};
+    mutable std::mutex error_mutex_;
+    std::string error_;
+};
+
+}  // namespace roi
@@ -0,0 +1,228 @@
+#include "rtp_depacketizer.h"
+
+namespace roi {
+
+namespace {
+const uint8_t kStartCode[4] = {0, 0, 0, 1};
+
+int param_index(Codec codec, int type) {
+    if (codec == Codec::kH265) {
+        if (type >= 32 && type <= 34) return type - 32;
+        return -1;
+    }
+    if (type == 7) return 1;
+    if (type == 8) return 2;
+    return -1;
+}
+}  // namespace
+
+RtpDepacketizer::RtpDepacketizer(AuRing* ring, Codec codec, int payload_type)
+    : ring_(ring), codec_(codec), payload_type_(payload_type) {}
+
+void RtpDepacketizer::set_parameter_sets(const std::vector<std::string>& nals) {
+    std::lock_guard<std::mutex> lk(params_mutex_);
+    for (const auto& nal : nals) {
+        if (nal.empty()) continue;
+        const int idx = param_index(codec_, nal_type(codec_, static_cast<uint8_t>(nal[0])));
+        if (idx >= 0) sdp_params_[idx] = nal;
+    }
+}
+
+std::vector<std::string> RtpDepacketizer::parameter_sets() const {
+    std::lock_guard<std::mutex> lk(params_mutex_);
+    std::vector<std::string> out;
+    for (int i = codec_ == Codec::kH265 ? 0 : 1; i < 3; ++i) {
+        const std::string& p = inband_params_[i].empty() ? sdp_params_[i] : inband_params_[i];
+        if (!p.empty()) out.push_back(p);
+    }
+    return out;
+}
+
+bool RtpDepacketizer::is_key_type(int type) const {
+    return codec_ == Codec::kH265 ? (type >= 16 && type <= 21) : type == 5;
+}
+
+bool RtpDepacketizer::is_param_type(int type) const { return param_index(codec_, type) >= 0; }
+
+void RtpDepacketizer::on_packet(const uint8_t* pkt, size_t len) {
+    if (len < 12 || (pkt[0] >> 6) != 2) return;
+    const bool padding = pkt[0] & 0x20;
+    const bool extension = pkt[0] & 0x10;
+    const int csrc = pkt[0] & 0x0f;
+    const bool marker = pkt[1] & 0x80;
+    const int pt = pkt[1] & 0x7f;
+    if (payload_type_ >= 0 && pt != payload_type_) return;
+    const uint16_t seq = static_cast<uint16_t>((pkt[2] << 8) | pkt[3]);
+    const uint32_t ts = (uint32_t(pkt[4]) << 24) | (uint32_t(pkt[5]) << 16) | (uint32_t(pkt[6]) << 8) | pkt[7];
+
+    size_t off = 12 + size_t(csrc) * 4;
+    if (extension) {
+        if (off + 4 > len) return;
+        off += 4 + ((size_t(pkt[off + 2]) << 8) | pkt[off + 3]) * 4;
+    }
+    size_t end = len;
+    if (padding) {
+        if (pkt[len - 1] > len) return;
+        end -= pkt[len - 1];
+    }
+    if (off >= end) return;
+    packets_.fetch_add(1, std::memory_order_relaxed);
+
+    if (have_seq_) {
+        const int16_t gap = static_cast<int16_t>(seq - uint16_t(last_seq_ + 1));
+        if (gap < 0) return;  // 重复或乱序到达的旧包，直接丢弃
+        if (gap > 0) {
+            lost_.fetch_add(uint64_t(gap), std::memory_order_relaxed);
+            mark_loss();
+        }
+        ext_ts_ += static_cast<int32_t>(ts - last_ts_);
+    } else {
+        ext_ts_ = ts;
+        have_seq_ = true;
+    }
+    last_seq_ = seq;
+    last_ts_ = ts;
+
+    if (au_open_ && ext_ts_ != au_pts_) finish_au();
+    if (!au_open_) {
+        ring_->begin(codec_);
+        au_open_ = true;
+        au_pts_ = ext_ts_;
+        au_flags_ = 0;
+        au_has_params_ = false;
+        in_fu_ = false;
+    }
+
+    if (codec_ == Codec::kH265) {
+        on_h265(pkt + off, end - off);
+    } else {
+        on_h264(pkt + off, end - off);
+    }
+    if (marker) finish_au();
+}
+
+void RtpDepacketizer::on_h264(const uint8_t* p, size_t n) {
+    const int type = p[0] & 0x1f;
+    if (type >= 1 && type <= 23) {
+        emit_nal(type, p, n);
+    } else if (type == 24) {  // STAP-A
+        const uint8_t* q = p + 1;
+        size_t rem = n - 1;
+        while (rem >= 2) {
+            const size_t sz = (size_t(q[0]) << 8) | q[1];
+            q += 2;
+            rem -= 2;
+            if (sz == 0 || sz > rem) {
+                mark_loss();
+                return;
+            }
+            emit_nal(q[0] & 0x1f, q, sz);
+            q += sz;
+            rem -= sz;
+        }
+    } else if (type == 28) {  // FU-A
+        if (n < 2) return;
+        const uint8_t fu = p[1];
+        const int nt = fu & 0x1f;
+        if (fu & 0x80) {
+            const uint8_t header = static_cast<uint8_t>((p[0] & 0xe0) | nt);
+            begin_nal(nt, &header, 1);
+            in_fu_ = true;
+        } else if (!in_fu_) {
+            mark_loss();  // 丢了分片起始包
+            return;
+        }
+        ring_->append(p + 2, n - 2);
+        if (fu & 0x40) in_fu_ = false;
+    }
+    // STAP-B / MTAP / FU-B 在摄像头上基本不会出现，忽略
+}
+
+void RtpDepacketizer::on_h265(const uint8_t* p, size_t n) {
+    if (n < 2) return;
+    const int type = (p[0] >> 1) & 0x3f;
+    if (type < 48) {
+        emit_nal(type, p, n);
+    } else if (type == 48) {  // AP，假定未启用 DONL
+        const uint8_t* q = p + 2;
+        size_t rem = n - 2;
+        while (rem >= 2) {
+            const size_t sz = (size_t(q[0]) << 8) | q[1];
+            q += 2;
+            rem -= 2;
+            if (sz < 2 || sz > rem) {
+                mark_loss();
+                return;
+            }
+            emit_nal((q[0] >> 1) & 0x3f, q, sz);
+            q += sz;
+            rem -= sz;
+        }
+    } else if (type == 49) {  // FU
+        if (n < 3) return;
+        const uint8_t fu = p[2];
+        const int nt = fu & 0x3f;
+        if (fu & 0x80) {
+            const uint8_t header[2] = {static_cast<uint8_t>((p[0] & 0x81) | (nt << 1)), p[1]};
+            begin_nal(nt, header, 2);
+            in_fu_ = true;
+        } else if (!in_fu_) {
+            mark_loss();
+            return;
+        }
+        ring_->append(p + 3, n - 3);
+        if (fu & 0x40) in_fu_ = false;
+    }
+}
+
+void RtpDepacketizer::begin_nal(int type, const uint8_t* header, size_t header_len) {
+    if (is_param_type(type)) {
+        au_has_params_ = true;
+        au_flags_ |= kAuParamSets;
+    } else if (is_key_type(type)) {
+        // 很多摄像头只在 SDP 里给参数集，关键帧前补上，下游解码器可以从任意关键帧起步
+        if (!au_has_params_) emit_param_sets();
+        au_flags_ |= kAuKeyFrame;
+    }
+    ring_->append(kStartCode, sizeof(kStartCode));
+    ring_->append(header, header_len);
+}
+
+void RtpDepacketizer::emit_nal(int type, const uint8_t* nal, size_t len) {
+    begin_nal(type, nal, len);
+    if (is_param_type(type)) remember_param_set(type, nal, len);
+}
+
+void RtpDepacketizer::emit_param_sets() {
+    std::lock_guard<std::mutex> lk(params_mutex_);
+    for (int i = codec_ == Codec::kH265 ? 0 : 1; i < 3; ++i) {
+        const std::string& p = inband_params_[i].empty() ? sdp_params_[i] : inband_params_[i];
+        if (p.empty()) continue;
+        ring_->append(kStartCode, sizeof(kStartCode));
+        ring_->append(reinterpret_cast<const uint8_t*>(p.data()), p.size());
+        au_has_params_ = true;
+        au_flags_ |= kAuParamSets;
+    }
+}
+
+void RtpDepacketizer::remember_param_set(int type, const uint8_t* nal, size_t len) {
+    const int idx = param_index(codec_, type);
+    std::string& slot = inband_params_[idx];
+    if (slot.size() == len && slot.compare(0, len, reinterpret_cast<const char*>(nal), len) == 0) return;
+    std::lock_guard<std::mutex> lk(params_mutex_);
+    slot.assign(reinterpret_cast<const char*>(nal), len);
+}
+
+void RtpDepacketizer::finish_au() {
+    if (!au_open_) return;
+    au_open_ = false;
+    in_fu_ = false;
+    ring_->commit(au_pts_, au_flags_);
+}
+
+void RtpDepacketizer::mark_loss() {
+    in_fu_ = false;
+    ring_->mark_loss();
+}
+
+}  // namespace roi
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../common/annexb.h"
+#include "../common/au_ring.h"
+
+namespace roi {
+
+// 把 RTP 负载（RFC 6184 / RFC 7798）还原成 Annex-B 访问单元，直接写入 AuRing。
+// 支持 H.264 的单 NAL / STAP-A / FU-A，以及 H.265 的单 NAL / AP / FU。
+// 只在 RTSP 接收线程中调用。
+class RtpDepacketizer {
+public:
+    RtpDepacketizer(AuRing* ring, Codec codec, int payload_type);
+
+    // SDP 中的带外参数集（不含起始码），关键帧前若码流里没有就补上
+    void set_parameter_sets(const std::vector<std::string>& nals);
+    // 最近一次看到的参数集（带内优先），供转封装使用
+    std::vector<std::string> parameter_sets() const;
+
+    void on_packet(const uint8_t* pkt, size_t len);
+
+    Codec codec() const { return codec_; }
+    uint64_t packets() const { return packets_.load(std::memory_order_relaxed); }
+    uint64_t lost() const { return lost_.load(std::memory_order_relaxed); }
+
+private:
+    void on_h264(const uint8_t* p, size_t n);
+    void on_h265(const uint8_t* p, size_t n);
+    void begin_nal(int type, const uint8_t* header, size_t header_len);
+    void emit_nal(int type, const uint8_t* nal, size_t len);
+    void emit_param_sets();
+    void remember_param_set(int type, const uint8_t* nal, size_t len);
+    void finish_au();
+    void mark_loss();
+
+    bool is_key_type(int type) const;
+    bool is_param_type(int type) const;
+
+    AuRing* ring_;
+    const Codec codec_;
+    const int payload_type_;
+
+    // 参数集：0=VPS 1=SPS 2=PPS（H.264 只用 1、2）。只在参数集变化时加锁
+    mutable std::mutex params_mutex_;
+    std::string sdp_params_[3];
+    std::string inband_params_[3];
+
+    bool have_seq_ = false;
+    uint16_t last_seq_ = 0;
+    uint32_t last_ts_ = 0;
+    int64_t ext_ts_ = 0;  // 32 位时间戳回绕后的展开值
+
+    bool au_open_ = false;
+    int64_t au_pts_ = 0;
+    uint32_t au_flags_ = 0;
+    bool au_has_params_ = false;
+    bool in_fu_ = false;
+
+    std::atomic<uint64_t> packets_{0};
+    std::atomic<uint64_t> lost_{0};
+};
+
+}  // namespace roi
@@ -0,0 +1,641 @@
+#include "rtsp_client.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "../common/md5.h"
+#include "../common/net.h"
+
+namespace roi {
+
+namespace {
+
+constexpr size_t kRxBufferBytes = 512 * 1024;
+constexpr int kTimerIntervalMs = 200;  // 保活与超时检测的周期
+// UDP 收流：一次 recvmmsg 最多取 kRtpBatch 个数据报，积压时连读 kRtpRounds 批后让给同一线程上的其他会话。
+// 摄像头的 RTP 包按 MTU 分片，超过槽位大小被截断的数据报直接丢弃，由解包器按序号缺口计入丢包
+constexpr unsigned kRtpBatch = 32;
+constexpr size_t kRtpSlotBytes = 4096;
+constexpr int kRtpRounds = 4;
+
+std::string lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return std::tolower(c); });
+    return s;
+}
+
+std::string trim(const std::string& s) {
+    size_t b = 0, e = s.size();
+    while (b < e && std::isspace(static_cast<unsigned char>(s[b]))) ++b;
+    while (e > b && std::isspace(static_cast<unsigned char>(s[e - 1]))) --e;
+    return s.substr(b, e - b);
+}
+
+bool starts_with(const std::string& s, const char* prefix) { return s.compare(0, std::strlen(prefix), prefix) == 0; }
+
+std::string base64_decode(const std::string& in) {
+    static const std::string chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    uint32_t acc = 0;
+    int bits = 0;
+    for (char c : in) {
+        if (c == '=') break;
+        const size_t v = chars.find(c);
+        if (v == std::string::npos) continue;
+        acc = (acc << 6) | uint32_t(v);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>((acc >> bits) & 0xff));
+        }
+    }
+    return out;
+}
+
+std::string base64_encode(const std::string& in) {
+    static const char* chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    uint32_t acc = 0;
+    int bits = 0;
+    for (unsigned char c : in) {
+        acc = (acc << 8) | c;
+        bits += 8;
+        while (bits >= 6) {
+            bits -= 6;
+            out.push_back(chars[(acc >> bits) & 0x3f]);
+        }
+    }
+    if (bits > 0) out.push_back(chars[(acc << (6 - bits)) & 0x3f]);
+    while (out.size() % 4) out.push_back('=');
+    return out;
+}
+
+// 取 key="value" 或 key=value 形式的参数
+std::string auth_param(const std::string& header, const std::string& key) {
+    const std::string h = lower(header);
+    size_t pos = 0;
+    while ((pos = h.find(key + "=", pos)) != std::string::npos) {
+        if (pos == 0 || h[pos - 1] == ' ' || h[pos - 1] == ',') break;
+        pos += key.size();
+    }
+    if (pos == std::string::npos) return "";
+    pos += key.size() + 1;
+    if (pos < header.size() && header[pos] == '"') {
+        const size_t end = header.find('"', pos + 1);
+        return header.substr(pos + 1, end == std::string::npos ? std::string::npos : end - pos - 1);
+    }
+    const size_t end = header.find_first_of(", ", pos);
+    return header.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+}
+
+std::string join_url(const std::string& base, const std::string& control) {
+    if (control.empty() || control == "*") return base;
+    if (starts_with(lower(control), "rtsp://")) return control;
+    if (!base.empty() && base.back() == '/') return base + control;
+    return base + "/" + control;
+}
+
+}  // namespace
+
+std::string RtspClient::Response::header(const std::string& key) const {
+    auto it = headers.find(key);
+    return it == headers.end() ? std::string() : it->second;
+}
+
+RtspClient::RtspClient(RtspConfig config)
+    : config_(std::move(config)), ring_(config_.ring_bytes, config_.ring_slots), rx_(kRxBufferBytes) {}
+
+RtspClient::~RtspClient() { stop(); }
+
+std::string RtspClient::last_error() const {
+    std::lock_guard<std::mutex> lk(error_mutex_);
+    return error_;
+}
+
+void RtspClient::fail(const std::string& msg) {
+    {
+        std::lock_guard<std::mutex> lk(error_mutex_);
+        error_ = msg;
+    }
+    state_.store(State::kError, std::memory_order_release);
+    ring_.wake_all();
+    // 在 I/O 线程里出错时立即注销，已经断开的 socket 在水平触发下会一直可读
+    detach();
+}
+
+std::vector<std::string> RtspClient::parameter_sets() const {
+    if (depacketizer_) return depacketizer_->parameter_sets();
+    return sdp_params_;
+}
+
+RtspStats RtspClient::stats() const {
+    RtspStats st;
+    if (depacketizer_) {
+        st.packets = depacketizer_->packets();
+        st.lost = depacketizer_->lost();
+    }
+    st.bytes = bytes_.load(std::memory_order_relaxed);
+    st.reads = reads_.load(std::memory_order_relaxed);
+    st.ring = ring_.stats();
+    return st;
+}
+
+bool RtspClient::start() {
+    if (running_.load()) return true;
+    if (!handshake()) {
+        close_fd(&tcp_fd_);
+        close_fd(&rtp_fd_);
+        close_fd(&rtcp_fd_);
+        return false;
+    }
+    running_.store(true);
+    state_.store(State::kPlaying, std::memory_order_release);
+    std::string err;
+    if (!attach(&err)) {
+        fail(err);
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void RtspClient::stop() {
+    running_.store(false);
+    detach();
+    loop_.reset();
+    if (tcp_fd_ >= 0 && !session_.empty()) {
+        // 发了一半的保活请求先补完，TEARDOWN 才不会和它交错
+        const bool flushed =
+            tx_off_ >= tx_.size() || send_all(tcp_fd_, tx_.data() + tx_off_, tx_.size() - tx_off_, config_.timeout_ms);
+        if (flushed) send_request("TEARDOWN", play_url_, "");
+    }
+    tx_.clear();
+    tx_off_ = 0;
+    session_.clear();
+    close_fd(&tcp_fd_);
+    close_fd(&rtp_fd_);
+    close_fd(&rtcp_fd_);
+    if (state_.load() != State::kIdle) state_.store(State::kStopped, std::memory_order_release);
+    ring_.wake_all();
+}
+
+// ---------------- 握手 ----------------
+
+bool RtspClient::handshake() {
+    // 解析 rtsp://[user[:pass]@]host[:port]/path
+    const std::string& url = config_.url;
+    if (!starts_with(lower(url), "rtsp://")) {
+        fail("not an rtsp url: " + url);
+        return false;
+    }
+    std::string rest = url.substr(7);
+    const size_t slash = rest.find('/');
+    std::string authority = rest.substr(0, slash);
+    const std::string path = slash == std::string::npos ? "/" : rest.substr(slash);
+    const size_t at = authority.rfind('@');
+    if (at != std::string::npos) {
+        const std::string cred = authority.substr(0, at);
+        authority = authority.substr(at + 1);
+        const size_t colon = cred.find(':');
+        user_ = cred.substr(0, colon);
+        if (colon != std::string::npos) password_ = cred.substr(colon + 1);
+    }
+    const size_t colon = authority.rfind(':');
+    if (colon != std::string::npos && authority.find(']', colon) == std::string::npos) {
+        host_ = authority.substr(0, colon);
+        port_ = std::atoi(authority.c_str() + colon + 1);
+    } else {
+        host_ = authority;
+    }
+    if (!host_.empty() && host_.front() == '[') host_ = host_.substr(1, host_.size() - 2);
+    request_url_ = "rtsp://" + authority + path;
+
+    std::string err;
+    tcp_fd_ = tcp_connect(host_, port_, config_.timeout_ms, false, &err);
+    if (tcp_fd_ < 0) {
+        fail(err);
+        return false;
+    }
+
+    Response resp;
+    if (!request("OPTIONS", request_url_, "", &resp)) return false;
+    has_get_parameter_ = resp.header("public").find("GET_PARAMETER") != std::string::npos;
+
+    if (!request("DESCRIBE", request_url_, "Accept: application/sdp\r\n", &resp)) return false;
+    if (resp.status != 200) {
+        fail("DESCRIBE failed with status " + std::to_string(resp.status));
+        return false;
+    }
+    std::string base = resp.header("content-base");
+    if (base.empty()) base = resp.header("content-location");
+    if (base.empty()) base = request_url_;
+    if (!parse_sdp(resp.body, base)) return false;
+
+    std::string transport;
+    if (config_.transport == RtspTransport::kTcp) {
+        transport = "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n";
+    } else {
+        int port = 0;
+        if (!udp_bind_pair(&rtp_fd_, &rtcp_fd_, &port, &err)) {
+            fail(err);
+            return false;
+        }
+        transport = "Transport: RTP/AVP;unicast;client_port=" + std::to_string(port) + "-" +
+                    std::to_string(port + 1) + "\r\n";
+    }
+    if (!request("SETUP", control_url_, transport, &resp)) return false;
+    if (resp.status != 200) {
+        fail("SETUP failed with status " + std::to_string(resp.status));
+        return false;
+    }
+    const std::string session = resp.header("session");
+    session_ = trim(session.substr(0, session.find(';')));
+    const size_t tpos = lower(session).find("timeout=");
+    if (tpos != std::string::npos) session_timeout_s_ = std::max(5, std::atoi(session.c_str() + tpos + 8));
+    const std::string reply_transport = lower(resp.header("transport"));
+    const size_t ipos = reply_transport.find("interleaved=");
+    if (ipos != std::string::npos) rtp_channel_ = std::atoi(reply_transport.c_str() + ipos + 12);
+
+    depacketizer_.reset(new RtpDepacketizer(&ring_, codec_, payload_type_));
+    depacketizer_->set_parameter_sets(sdp_params_);
+
+    if (!request("PLAY", play_url_, "Range: npt=0.000-\r\n", &resp)) return false;
+    if (resp.status != 200) {
+        fail("PLAY failed with status " + std::to_string(resp.status));
+        return false;
+    }
+    return true;
+}
+
+bool RtspClient::parse_sdp(const std::string& sdp, const std::string& base) {
+    std::istringstream in(sdp);
+    std::string line;
+    bool in_video = false;
+    bool seen_media = false;
+    std::string session_control;
+    std::string media_control;
+    while (std::getline(in, line)) {
+        line = trim(line);
+        if (starts_with(line, "m=")) {
+            seen_media = true;
+            in_video = starts_with(line, "m=video") && payload_type_ < 0;
+            if (in_video) {
+                std::istringstream m(line.substr(2));
+                std::string media, port, proto;
+                m >> media >> port >> proto >> payload_type_;
+            }
+            continue;
+        }
+        if (!starts_with(line, "a=")) continue;
+        const std::string attr = line.substr(2);
+        if (starts_with(attr, "control:")) {
+            if (!seen_media) {
+                session_control = trim(attr.substr(8));
+            } else if (in_video) {
+                media_control = trim(attr.substr(8));
+            }
+            continue;
+        }
+        if (!in_video) continue;
+        if (starts_with(attr, "rtpmap:")) {
+            const std::string enc = lower(attr.substr(attr.find(' ') + 1));
+            if (starts_with(enc, "h264/")) codec_ = Codec::kH264;
+            if (starts_with(enc, "h265/") || starts_with(enc, "hevc/")) codec_ = Codec::kH265;
+        } else if (starts_with(attr, "fmtp:")) {
+            std::istringstream params(attr.substr(attr.find(' ') + 1));
+            std::string kv;
+            while (std::getline(params, kv, ';')) {
+                kv = trim(kv);
+                const size_t eq = kv.find('=');
+                if (eq == std::string::npos) continue;
+                const std::string key = lower(kv.substr(0, eq));
+                const std::string value = kv.substr(eq + 1);
+                if (key == "sprop-parameter-sets") {
+                    std::istringstream sets(value);
+                    std::string one;
+                    while (std::getline(sets, one, ',')) sdp_params_.push_back(base64_decode(one));
+                } else if (key == "sprop-vps" || key == "sprop-sps" || key == "sprop-pps") {
+                    sdp_params_.push_back(base64_decode(value));
+                }
+            }
+        } else if (starts_with(attr, "framesize:")) {
+            const std::string dims = attr.substr(attr.find(' ') + 1);
+            std::sscanf(dims.c_str(), "%d-%d", &width_hint_, &height_hint_);
+        } else if (starts_with(attr, "x-dimensions:")) {
+            std::sscanf(attr.c_str() + 13, "%d,%d", &width_hint_, &height_hint_);
+        }
+    }
+    if (payload_type_ < 0 || codec_ == Codec::kUnknown) {
+        fail("SDP has no H.264/H.265 video track");
+        return false;
+    }
+    play_url_ = join_url(base, session_control);
+    control_url_ = join_url(base, media_control);
+    return true;
+}
+
+std::string RtspClient::auth_header(const std::string& method, const std::string& url) const {
+    if (digest_) {
+        const std::string ha1 = md5_hex(user_ + ":" + realm_ + ":" + password_);
+        const std::string ha2 = md5_hex(method + ":" + url);
+        std::string out = "Authorization: Digest username=\"" + user_ + "\", realm=\"" + realm_ +
+                          "\", nonce=\"" + nonce_ + "\", uri=\"" + url + "\"";
+        if (lower(qop_).find("auth") != std::string::npos) {
+            char nc[9];
+            std::snprintf(nc, sizeof(nc), "%08x", ++nonce_count_);
+            const std::string cnonce = md5_hex(nonce_ + nc).substr(0, 16);
+            out += ", qop=auth, nc=" + std::string(nc) + ", cnonce=\"" + cnonce + "\", response=\"" +
+                   md5_hex(ha1 + ":" + nonce_ + ":" + nc + ":" + cnonce + ":auth:" + ha2) + "\"";
+        } else {
+            out += ", response=\"" + md5_hex(ha1 + ":" + nonce_ + ":" + ha2) + "\"";
+        }
+        return out + "\r\n";
+    }
+    if (basic_) return "Authorization: Basic " + base64_encode(user_ + ":" + password_) + "\r\n";
+    return "";
+}
+
+std::string RtspClient::format_request(const std::string& method, const std::string& url, const std::string& extra) {
+    std::string req = method + " " + url + " RTSP/1.0\r\n";
+    req += "CSeq: " + std::to_string(++cseq_) + "\r\n";
+    req += "User-Agent: " + config_.user_agent + "\r\n";
+    req += auth_header(method, url);
+    if (!session_.empty()) req += "Session: " + session_ + "\r\n";
+    req += extra;
+    req += "\r\n";
+    return req;
+}
+
+// 阻塞发送，只用于接入 IoLoop 之前的握手和 stop() 里的 TEARDOWN
+bool RtspClient::send_request(const std::string& method, const std::string& url, const std::string& extra) {
+    const std::string req = format_request(method, url, extra);
+    return send_all(tcp_fd_, req.data(), req.size(), config_.timeout_ms);
+}
+
+bool RtspClient::request(const std::string& method, const std::string& url, const std::string& extra,
+                         Response* resp) {
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        if (!send_request(method, url, extra)) {
+            fail(method + ": send failed: " + errno_string());
+            return false;
+        }
+        if (!read_response(resp)) {
+            fail(method + ": no response from " + host_);
+            return false;
+        }
+        if (resp->status != 401 || user_.empty() || attempt > 0) break;
+
+        // 401：按服务器要求改用 Digest（优先）或 Basic 认证后重发一次
+        const std::string challenge = resp->header("www-authenticate");
+        const size_t digest_pos = lower(challenge).find("digest");
+        if (digest_pos != std::string::npos) {
+            const std::string d = challenge.substr(digest_pos);
+            digest_ = true;
+            realm_ = auth_param(d, "realm");
+            nonce_ = auth_param(d, "nonce");
+            qop_ = auth_param(d, "qop");
+            nonce_count_ = 0;
+        } else {
+            basic_ = true;
+        }
+    }
+    if (resp->status == 401) {
+        fail(method + ": authentication rejected");
+        return false;
+    }
+    return true;
+}
+
+int RtspClient::fill_rx(int timeout_ms) {
+    if (rx_begin_ == rx_end_) {
+        rx_begin_ = rx_end_ = 0;
+    } else if (rx_begin_ > rx_.size() / 2 || rx_end_ == rx_.size()) {
+        std::memmove(rx_.data(), rx_.data() + rx_begin_, rx_end_ - rx_begin_);
+        rx_end_ -= rx_begin_;
+        rx_begin_ = 0;
+    }
+    if (rx_end_ == rx_.size()) return -1;  // 单条消息超过缓冲区
+    if (timeout_ms != 0) {
+        const int r = wait_readable(tcp_fd_, timeout_ms);
+        if (r <= 0) return r;
+    }
+    const ssize_t n = ::recv(tcp_fd_, rx_.data() + rx_end_, rx_.size() - rx_end_, MSG_DONTWAIT);
+    reads_.fetch_add(1, std::memory_order_relaxed);
+    if (n > 0) {
+        rx_end_ += size_t(n);
+        bytes_.fetch_add(uint64_t(n), std::memory_order_relaxed);
+        last_rx_ = std::chrono::steady_clock::now();
+        return int(n);
+    }
+    if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+    return -1;
+}
+
+bool RtspClient::read_response(Response* resp) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(config_.timeout_ms);
+    for (;;) {
+        // 应答之前可能夹着交错 RTP 包，握手阶段直接跳过
+        while (rx_end_ - rx_begin_ >= 4 && rx_[rx_begin_] == '$') {
+            const size_t len = (size_t(rx_[rx_begin_ + 2]) << 8) | rx_[rx_begin_ + 3];
+            if (rx_end_ - rx_begin_ < 4 + len) break;
+            rx_begin_ += 4 + len;
+        }
+        const char* begin = reinterpret_cast<const char*>(rx_.data() + rx_begin_);
+        const std::string window(begin, rx_end_ - rx_begin_);
+        const size_t header_end = window.find("\r\n\r\n");
+        if (header_end != std::string::npos && starts_with(window, "RTSP/")) {
+            resp->headers.clear();
+            resp->body.clear();
+            std::istringstream lines(window.substr(0, header_end));
+            std::string line;
+            std::getline(lines, line);
+            resp->status = std::atoi(line.c_str() + line.find(' ') + 1);
+            while (std::getline(lines, line)) {
+                const size_t colon = line.find(':');
+                if (colon == std::string::npos) continue;
+                const std::string key = lower(trim(line.substr(0, colon)));
+                const std::string value = trim(line.substr(colon + 1));
+                auto& slot = resp->headers[key];
+                slot = slot.empty() ? value : slot + "\n" + value;  // 多个 WWW-Authenticate 时保留全部
+            }
+            const size_t body_len = size_t(std::atoi(resp->header("content-length").c_str()));
+            if (window.size() >= header_end + 4 + body_len) {
+                resp->body = window.substr(header_end + 4, body_len);
+                rx_begin_ += header_end + 4 + body_len;
+                return true;
+            }
+        }
+        const int left = int(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                 deadline - std::chrono::steady_clock::now())
+                                 .count());
+        if (left <= 0 || fill_rx(left) < 0) return false;
+    }
+}
+
+// ---------------- 收流 ----------------
+
+bool RtspClient::attach(std::string* err) {
+    loop_ = IoLoop::acquire();
+    if (!loop_) {
+        if (err) *err = "no io loop";
+        return false;
+    }
+    set_nonblocking(tcp_fd_, true);
+    if (rtp_fd_ >= 0) {
+        // 槽位和消息头只建一次，之后每批 recvmmsg 原样复用
+        udp_buf_.resize(kRtpBatch * kRtpSlotBytes);
+        udp_iov_.resize(kRtpBatch);
+        udp_msgs_.assign(kRtpBatch, mmsghdr{});
+        for (unsigned i = 0; i < kRtpBatch; ++i) {
+            udp_iov_[i] = {udp_buf_.data() + i * kRtpSlotBytes, kRtpSlotBytes};
+            udp_msgs_[i].msg_hdr.msg_iov = &udp_iov_[i];
+            udp_msgs_[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+    bool ok = true;
+    // 整个注册过程在 I/O 线程里完成，回调不会在注册到一半时开始执行
+    loop_->run_sync([&] {
+        last_rx_ = std::chrono::steady_clock::now();
+        last_keepalive_ = last_rx_;
+        attached_ = true;
+        ok = loop_->add(tcp_fd_, EPOLLIN, [this](uint32_t ev) { on_tcp(ev); }, err);
+        if (ok && rtp_fd_ >= 0) ok = loop_->add(rtp_fd_, EPOLLIN, [this](uint32_t) { on_rtp(); }, err);
+        if (ok && rtcp_fd_ >= 0) ok = loop_->add(rtcp_fd_, EPOLLIN, [this](uint32_t) { on_rtcp(); }, err);
+        if (ok) timer_ = loop_->add_timer(kTimerIntervalMs, [this] { on_timer(); });
+    });
+    return ok;
+}
+
+void RtspClient::detach() {
+    if (!loop_) return;
+    // fail() 可能在 I/O 线程里同时调用，都放到 I/O 线程里执行
+    loop_->run_sync([this] {
+        if (!attached_) return;
+        attached_ = false;
+        loop_->remove(tcp_fd_);
+        if (rtp_fd_ >= 0) loop_->remove(rtp_fd_);
+        if (rtcp_fd_ >= 0) loop_->remove(rtcp_fd_);
+        if (timer_) loop_->cancel_timer(timer_);
+        timer_ = 0;
+    });
+}
+
+void RtspClient::on_timer() {
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_rx_ > std::chrono::milliseconds(config_.timeout_ms)) {
+        fail("no data from " + host_ + " for " + std::to_string(config_.timeout_ms) + " ms");
+        return;
+    }
+    if (now - last_keepalive_ > std::chrono::seconds(std::max(2, session_timeout_s_ / 2))) {
+        send_keepalive();
+        last_keepalive_ = now;
+    }
+}
+
+void RtspClient::on_tcp(uint32_t events) {
+    if (events & EPOLLOUT) {
+        const int w = flush_tx();
+        if (w < 0) {
+            fail("keepalive to " + host_ + " failed: " + errno_string());
+            return;
+        }
+        if (w > 0) loop_->modify(tcp_fd_, EPOLLIN);
+        if (!(events & (EPOLLIN | EPOLLHUP | EPOLLERR))) return;
+    }
+    // 读到 EAGAIN 为止，但不独占线程：剩下的数据在下一轮事件里继续读
+    for (int round = 0; round < kRtpRounds; ++round) {
+        const int r = fill_rx(0);
+        if (r < 0) {
+            fail("connection to " + host_ + " lost");
+            return;
+        }
+        if (r == 0) return;
+        drain_tcp();
+    }
+}
+
+void RtspClient::on_rtp() {
+    for (int round = 0; round < kRtpRounds; ++round) {
+        const int n = ::recvmmsg(rtp_fd_, udp_msgs_.data(), kRtpBatch, MSG_DONTWAIT, nullptr);
+        reads_.fetch_add(1, std::memory_order_relaxed);
+        if (n <= 0) return;
+        for (int i = 0; i < n; ++i) {
+            const mmsghdr& m = udp_msgs_[size_t(i)];
+            bytes_.fetch_add(m.msg_len, std::memory_order_relaxed);
+            if (m.msg_hdr.msg_flags & MSG_TRUNC) continue;
+            depacketizer_->on_packet(udp_buf_.data() + size_t(i) * kRtpSlotBytes, m.msg_len);
+        }
+        last_rx_ = std::chrono::steady_clock::now();
+        if (unsigned(n) < kRtpBatch) return;
+    }
+}
+
+void RtspClient::on_rtcp() {
+    // 只排空，不解析发送端报告
+    while (::recv(rtcp_fd_, udp_buf_.data(), kRtpSlotBytes, MSG_DONTWAIT) > 0) {
+    }
+}
+
+void RtspClient::drain_tcp() {
+    while (rx_begin_ < rx_end_) {
+        const size_t avail = rx_end_ - rx_begin_;
+        const uint8_t* p = rx_.data() + rx_begin_;
+        if (p[0] == '$') {
+            if (avail < 4) return;
+            const size_t len = (size_t(p[2]) << 8) | p[3];
+            if (avail < 4 + len) return;
+            // 直接把接收缓冲区里的 RTP 包交给解包器，只在写入 AuRing 时拷贝一次
+            if (p[1] == rtp_channel_) depacketizer_->on_packet(p + 4, len);
+            rx_begin_ += 4 + len;
+        } else if (avail >= 5 && std::memcmp(p, "RTSP/", 5) == 0) {
+            // 保活请求的应答，解析出长度后丢弃
+            const std::string window(reinterpret_cast<const char*>(p), avail);
+            const size_t header_end = window.find("\r\n\r\n");
+            if (header_end == std::string::npos) return;
+            const size_t cl = lower(window.substr(0, header_end)).find("content-length:");
+            const size_t body = cl == std::string::npos ? 0 : size_t(std::atoi(window.c_str() + cl + 15));
+            if (avail < header_end + 4 + body) return;
+            rx_begin_ += header_end + 4 + body;
+        } else if (avail < 5 && p[0] == 'R') {
+            return;  // 应答头还没收全
+        } else {
+            // 失步：向后找下一个 '$'
+            const void* next = std::memchr(p + 1, '$', avail - 1);
+            rx_begin_ = next ? size_t(static_cast<const uint8_t*>(next) - rx_.data()) : rx_end_;
+        }
+    }
+}
+
+void RtspClient::send_keepalive() {
+    // 运行在共享的 I/O 线程里，不能像握手那样阻塞等待：发不出去的部分留在 tx_，等 EPOLLOUT 再发。
+    // 上一个保活还没发完说明连接已经堵住，不再追加
+    if (tx_off_ < tx_.size()) return;
+    tx_ = format_request(has_get_parameter_ ? "GET_PARAMETER" : "OPTIONS", play_url_, "");
+    tx_off_ = 0;
+    const int w = flush_tx();
+    if (w < 0) {
+        fail("keepalive to " + host_ + " failed: " + errno_string());
+    } else if (w == 0) {
+        loop_->modify(tcp_fd_, EPOLLIN | EPOLLOUT);
+    }
+}
+
+int RtspClient::flush_tx() {
+    while (tx_off_ < tx_.size()) {
+        const ssize_t n = ::send(tcp_fd_, tx_.data() + tx_off_, tx_.size() - tx_off_, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        tx_off_ += size_t(n);
+    }
+    tx_.clear();
+    tx_off_ = 0;
+    return 1;
+}
+
+}  // namespace roi
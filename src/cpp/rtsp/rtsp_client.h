@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include "../common/au_ring.h"
+#include "../common/io_loop.h"
+#include "rtp_depacketizer.h"
+
+namespace roi {
+
+enum class RtspTransport : int {
+    kTcp = 0,  // RTP over RTSP 交错通道
+    kUdp = 1,
+};
+
+struct RtspConfig {
+    std::string url;  // rtsp://[user[:pass]@]host[:port]/path
+    RtspTransport transport = RtspTransport::kTcp;
+    int timeout_ms = 5000;         // 握手与收流超时
+    size_t ring_bytes = 8 << 20;   // AU 环形缓冲区字节数
+    uint32_t ring_slots = 256;
+    std::string user_agent = "ROI-Video-Transmission/1.0";
+};
+
+struct RtspStats {
+    uint64_t packets = 0;
+    uint64_t lost = 0;
+    uint64_t bytes = 0;
+    uint64_t reads = 0;  // recv / recvmmsg 调用次数
+    AuRingStats ring;
+};
+
+// 拉取一路 RTSP 视频流，把 H.264/H.265 访问单元写入内部的 AuRing。
+// start() 在调用线程中完成 DESCRIBE/SETUP/PLAY 握手，成功后把 socket 切到非阻塞模式
+// 交给共享的 IoLoop：收流、保活和超时检测都在 I/O 线程的回调里完成，几十路摄像头
+// 只占一两个线程。断线后状态变为 kError，重连由上层负责。
+class RtspClient {
+public:
+    enum class State : int { kIdle = 0, kPlaying = 1, kError = 2, kStopped = 3 };
+
+    explicit RtspClient(RtspConfig config);
+    ~RtspClient();
+    RtspClient(const RtspClient&) = delete;
+    RtspClient& operator=(const RtspClient&) = delete;
+
+    bool start();
+    void stop();
+
+    AuRing& ring() { return ring_; }
+    Codec codec() const { return codec_; }
+    int width_hint() const { return width_hint_; }
+    int height_hint() const { return height_hint_; }
+    std::vector<std::string> parameter_sets() const;
+    State state() const { return state_.load(std::memory_order_acquire); }
+    std::string last_error() const;
+    RtspStats stats() const;
+
+private:
+    struct Response {
+        int status = 0;
+        std::map<std::string, std::string> headers;  // 键统一为小写
+        std::string body;
+        std::string header(const std::string& key) const;
+    };
+
+    bool handshake();
+    bool request(const std::string& method, const std::string& url, const std::string& extra, Response* resp);
+    std::string format_request(const std::string& method, const std::string& url, const std::string& extra);
+    bool send_request(const std::string& method, const std::string& url, const std::string& extra);
+    bool read_response(Response* resp);
+    std::string auth_header(const std::string& method, const std::string& url) const;
+    bool parse_sdp(const std::string& sdp, const std::string& base);
+    bool attach(std::string* err);
+    void detach();
+    void on_tcp(uint32_t events);
+    void on_rtp();
+    void on_rtcp();
+    void on_timer();
+    int fill_rx(int timeout_ms);  // timeout_ms 为 0 时不等待
+    void drain_tcp();
+    void send_keepalive();
+    int flush_tx();  // 1 发完，0 遇到 EAGAIN，-1 出错
+    void fail(const std::string& msg);
+
+    RtspConfig config_;
+    AuRing ring_;
+    std::unique_ptr<RtpDepacketizer> depacketizer_;
+
+    // URL 解析结果
+    std::string host_;
+    int port_ = 554;
+    std::string user_;
+    std::string password_;
+    std::string request_url_;  // 去掉了认证信息
+
+    // 会话状态
+    int cseq_ = 0;
+    std::string session_;
+    int session_timeout_s_ = 60;
+    std::string control_url_;  // SETUP 用的媒体级 control
+    std::string play_url_;     // PLAY / 保活 / TEARDOWN 用的会话级 control
+    std::string realm_;
+    std::string nonce_;
+    std::string qop_;
+    mutable uint32_t nonce_count_ = 0;
+    bool digest_ = false;
+    bool basic_ = false;
+    bool has_get_parameter_ = false;
+    int payload_type_ = -1;
+    Codec codec_ = Codec::kUnknown;
+    int width_hint_ = 0;
+    int height_hint_ = 0;
+    std::vector<std::string> sdp_params_;
+
+    int tcp_fd_ = -1;
+    int rtp_fd_ = -1;
+    int rtcp_fd_ = -1;
+    int rtp_channel_ = 0;
+    std::chrono::steady_clock::time_point last_rx_;
+    std::chrono::steady_clock::time_point last_keepalive_;
+
+    // TCP 接收缓冲：RTSP 应答与 '$' 交错包共用
+    std::vector<uint8_t> rx_;
+    size_t rx_begin_ = 0;
+    size_t rx_end_ = 0;
+    // UDP 批量接收：recvmmsg 一次取一批数据报，每个槽位一个
+    std::vector<uint8_t> udp_buf_;
+    std::vector<iovec> udp_iov_;
+    std::vector<mmsghdr> udp_msgs_;
+    // 保活请求的发送缓冲：I/O 线程里不能阻塞，发不完的部分等 EPOLLOUT 再发
+    std::string tx_;
+    size_t tx_off_ = 0;
+
+    // 握手之后以上收流状态只在 IoLoop 线程里访问
+    std::shared_ptr<IoLoop> loop_;
+    uint64_t timer_ = 0;
+    bool attached_ = false;
+
+    std::atomic<bool> running_{false};
+    std::atomic<State> state_{State::kIdle};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> reads_{0};
+    mutable std::mutex error_mutex_;
+    std::string error_;
+};
+
+}  // namespace roi
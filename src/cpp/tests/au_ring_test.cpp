@@ -0,0 +1,145 @@
+#include <cstdint>
+#include <vector>
+
+#include "../common/au_ring.h"
+#include "test.h"
+
+namespace {
+
+constexpr size_t kArena = 1 << 16;  // AuRing 的最小字节区
+
+// 写入一个 size 字节、内容为 fill 起递增字节的 AU
+bool push(roi::AuRing* ring, size_t size, bool key, int64_t pts, uint8_t fill) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; ++i) data[i] = uint8_t(fill + i);
+    ring->begin(roi::Codec::kH264);
+    // 分两次 append，覆盖 AU 跨越字节区末尾时已写部分的搬移
+    const size_t half = size / 2;
+    ring->append(data.data(), half);
+    ring->append(data.data() + half, size - half);
+    return ring->commit(pts, key ? roi::kAuKeyFrame : 0u);
+}
+
+bool intact(const roi::AccessUnitView& au, size_t size, uint8_t fill) {
+    if (au.size != size) return false;
+    for (size_t i = 0; i < size; ++i) {
+        if (au.data[i] != uint8_t(fill + i)) return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+TEST(au_ring_wraps_without_splitting_access_units) {
+    roi::AuRing ring(kArena, 16);
+    const int c = ring.add_consumer();
+    CHECK(c >= 0);
+    const uint8_t* arena_begin = nullptr;
+    // 每个 AU 约 0.3 个环，跑十几圈，每圈都有一个 AU 落在字节区末尾附近
+    for (int i = 0; i < 40; ++i) {
+        const size_t size = 19000 + size_t(i) * 37;
+        CHECK(push(&ring, size, i == 0, i * 3000, uint8_t(i)));
+        roi::AccessUnitView au;
+        CHECK(ring.peek(c, &au));
+        CHECK(intact(au, size, uint8_t(i)));
+        CHECK_EQ(au.pts, int64_t(i) * 3000);
+        CHECK_EQ(au.seq, uint64_t(i));
+        if (!arena_begin) arena_begin = au.data;
+        CHECK(au.data >= arena_begin && au.data + au.size <= arena_begin + ring.capacity());
+        ring.release(c);
+    }
+    const roi::AuRingStats st = ring.stats();
+    CHECK_EQ(st.committed, uint64_t(40));
+    CHECK_EQ(st.dropped, uint64_t(0));
+    CHECK_EQ(st.slots_used, uint32_t(0));
+}
+
+TEST(au_ring_rejects_access_units_over_half_capacity) {
+    roi::AuRing ring(kArena, 16);
+    const int c = ring.add_consumer();
+    CHECK(push(&ring, 1000, true, 0, 1));
+    CHECK(!push(&ring, ring.capacity() / 2 + 1, true, 3000, 2));
+    // 被丢弃的 AU 之后必须等到关键帧
+    CHECK(!push(&ring, 1000, false, 6000, 3));
+    CHECK(push(&ring, ring.capacity() / 2, true, 9000, 4));
+    roi::AccessUnitView au;
+    CHECK(ring.peek(c, &au));
+    CHECK(intact(au, 1000, 1));
+    ring.release(c);
+    CHECK(ring.peek(c, &au));
+    CHECK(intact(au, ring.capacity() / 2, 4));
+    CHECK(au.flags & roi::kAuDiscontinuity);
+    CHECK_EQ(ring.stats().dropped, uint64_t(2));
+}
+
+TEST(au_ring_drops_until_keyframe) {
+    roi::AuRing ring(kArena, 16);
+    const int c = ring.add_consumer();
+    // 起始时没有关键帧
+    CHECK(!push(&ring, 100, false, 0, 0));
+    CHECK(push(&ring, 100, true, 3000, 1));
+    CHECK(push(&ring, 100, false, 6000, 2));
+    ring.mark_loss();
+    CHECK(!push(&ring, 100, false, 9000, 3));
+    CHECK(!push(&ring, 100, false, 12000, 4));
+    CHECK(push(&ring, 100, true, 15000, 5));
+
+    roi::AccessUnitView au;
+    const uint8_t expected[] = {1, 2, 5};
+    for (uint8_t fill : expected) {
+        CHECK(ring.peek(c, &au));
+        CHECK(intact(au, 100, fill));
+        // 只有丢包之后的第一个关键帧带不连续标志
+        CHECK_EQ(bool(au.flags & roi::kAuDiscontinuity), fill == 5);
+        CHECK_EQ(bool(au.flags & roi::kAuKeyFrame), fill != 2);
+        ring.release(c);
+    }
+    CHECK(!ring.peek(c, &au));
+    CHECK_EQ(ring.stats().dropped, uint64_t(3));
+}
+
+TEST(au_ring_never_overwrites_a_lagging_consumer) {
+    roi::AuRing ring(kArena, 8);
+    const int slow = ring.add_consumer();
+    const int fast = ring.add_consumer();
+    roi::AccessUnitView au;
+    // 槽位用尽：慢消费者一个都没释放，第 9 个 AU 被丢弃
+    for (int i = 0; i < 8; ++i) {
+        CHECK(push(&ring, 200, i % 4 == 0, i, uint8_t(i)));
+        CHECK(ring.peek(fast, &au));
+        ring.release(fast);
+    }
+    CHECK(!push(&ring, 200, false, 8, 8));
+    CHECK_EQ(ring.stats().slots_used, uint32_t(8));
+    CHECK(ring.peek(slow, &au));
+    CHECK(intact(au, 200, 0));
+
+    // 慢消费者跳到最新的关键帧（第 4 个），腾出的槽位可以继续写
+    CHECK(ring.skip_to_latest_key(slow));
+    CHECK(ring.peek(slow, &au));
+    CHECK(intact(au, 200, 4));
+    CHECK(au.flags & roi::kAuKeyFrame);
+    CHECK_EQ(ring.stats().slots_used, uint32_t(4));
+    CHECK(push(&ring, 200, true, 9, 9));
+    CHECK(ring.peek(fast, &au));
+    CHECK(intact(au, 200, 9));
+    CHECK(au.flags & roi::kAuDiscontinuity);
+
+    // 字节区用尽：慢消费者压着的数据不会被新 AU 覆盖
+    roi::AuRing bytes(kArena, 64);
+    const int lag = bytes.add_consumer();
+    CHECK(push(&bytes, 20000, true, 0, 10));
+    CHECK(push(&bytes, 20000, false, 1, 11));
+    CHECK(push(&bytes, 20000, false, 2, 12));
+    CHECK(!push(&bytes, 20000, false, 3, 13));
+    CHECK(bytes.peek(lag, &au));
+    CHECK(intact(au, 20000, 10));
+    for (uint8_t fill = 10; fill <= 12; ++fill) {
+        CHECK(bytes.peek(lag, &au));
+        CHECK(intact(au, 20000, fill));
+        bytes.release(lag);
+    }
+    CHECK(push(&bytes, 20000, true, 4, 14));
+    CHECK(bytes.peek(lag, &au));
+    CHECK(intact(au, 20000, 14));
+}
@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "../infer/preprocess.h"
+#include "test.h"
+
+namespace {
+
+constexpr double kTolerance = 2.5 / 255;  // 定点插值和颜色转换的舍入误差
+
+// 带行距填充的 NV12 测试图：平滑的渐变加上噪声
+struct Nv12 {
+    int width;
+    int height;
+    int pitch;
+    std::vector<uint8_t> y;
+    std::vector<uint8_t> uv;
+
+    Nv12(int w, int h, uint32_t seed) : width(w), height(h), pitch(w + 16), y(size_t(pitch) * h), uv(size_t(pitch) * h / 2) {
+        std::mt19937 rng(seed);
+        for (int r = 0; r < h; ++r) {
+            for (int c = 0; c < w; ++c) y[size_t(r) * pitch + c] = uint8_t(16 + (r * 3 + c * 2) % 200 + rng() % 16);
+        }
+        for (int r = 0; r < h / 2; ++r) {
+            for (int c = 0; c < w; ++c) uv[size_t(r) * pitch + c] = uint8_t(64 + (r * 5 + c * 7) % 128 + rng() % 8);
+        }
+    }
+};
+
+// 像素中心对齐的双线性采样（INTER_LINEAR 的坐标映射），plane 每个样本间隔 step 字节
+double sample(const uint8_t* plane, int pitch, int step, int src_w, int src_h, int dst_w, int dst_h, int dx, int dy) {
+    auto coord = [](int d, int src, int dst, int* i0, int* i1) {
+        double s = (d + 0.5) * src / dst - 0.5;
+        if (s < 0) s = 0;
+        *i0 = std::min(int(s), src - 1);
+        *i1 = std::min(*i0 + 1, src - 1);
+        return s - *i0;
+    };
+    int x0, x1, y0, y1;
+    const double wx = coord(dx, src_w, dst_w, &x0, &x1);
+    const double wy = coord(dy, src_h, dst_h, &y0, &y1);
+    auto at = [&](int x, int yy) { return double(plane[size_t(yy) * pitch + size_t(x) * step]); };
+    const double top = at(x0, y0) * (1 - wx) + at(x1, y0) * wx;
+    const double bottom = at(x0, y1) * (1 - wx) + at(x1, y1) * wx;
+    return top * (1 - wy) + bottom * wy;
+}
+
+// 浮点的 BT.601 limited range 转换，输出归一化到 [0, 1] 的 RGB
+void reference_rgb(const Nv12& img, int x, int y, int w, int h, int out_w, int out_h, int dx, int dy, double rgb[3]) {
+    const uint8_t* py = img.y.data() + size_t(y) * img.pitch + x;
+    const uint8_t* puv = img.uv.data() + size_t(y / 2) * img.pitch + x;
+    const double luma = sample(py, img.pitch, 1, w, h, out_w, out_h, dx, dy);
+    const double u = sample(puv, img.pitch, 2, (w + 1) / 2, (h + 1) / 2, out_w, out_h, dx, dy) - 128;
+    const double v = sample(puv + 1, img.pitch, 2, (w + 1) / 2, (h + 1) / 2, out_w, out_h, dx, dy) - 128;
+    const double c = 1.164 * (luma - 16);
+    const double values[3] = {c + 1.596 * v, c - 0.391 * u - 0.813 * v, c + 2.018 * u};
+    for (int i = 0; i < 3; ++i) rgb[i] = std::max(0.0, std::min(255.0, values[i])) / 255;
+}
+
+// 检查 NCHW 张量中 slot 的 [ox, ox + out_w) x [oy, oy + out_h) 区域与参考实现一致，返回最大误差
+double compare(const float* tensor, int net_w, int net_h, int slot, int ox, int oy, int out_w, int out_h,
+               const Nv12& img, int x, int y, int w, int h) {
+    const size_t plane = size_t(net_w) * net_h;
+    double worst = 0;
+    for (int dy = 0; dy < out_h; ++dy) {
+        for (int dx = 0; dx < out_w; ++dx) {
+            double rgb[3];
+            reference_rgb(img, x, y, w, h, out_w, out_h, dx, dy, rgb);
+            const size_t at = size_t(slot) * 3 * plane + size_t(oy + dy) * net_w + ox + dx;
+            for (int ch = 0; ch < 3; ++ch) worst = std::max(worst, std::fabs(tensor[at + ch * plane] - rgb[ch]));
+        }
+    }
+    return worst;
+}
+
+}  // namespace
+
+TEST(preprocess_nv12_stretch_matches_reference) {
+    const Nv12 img(96, 64, 1);
+    for (const auto& size : {std::make_pair(48, 40), std::make_pair(96, 64), std::make_pair(160, 100)}) {
+        roi::PreprocessConfig cfg;
+        cfg.width = size.first;
+        cfg.height = size.second;
+        roi::Preprocessor pre(cfg);
+        const roi::LetterboxInfo info =
+            pre.run_nv12(0, img.y.data(), img.uv.data(), img.width, img.height, img.pitch, img.pitch);
+        CHECK_EQ(pre.bytes(), size_t(cfg.width) * cfg.height * 3 * sizeof(float));
+        CHECK_NEAR(info.scale_x, double(cfg.width) / img.width, 1e-6);
+        CHECK_NEAR(info.scale_y, double(cfg.height) / img.height, 1e-6);
+        CHECK_EQ(info.pad_x, 0);
+        CHECK_EQ(info.pad_y, 0);
+        const float* t = static_cast<const float*>(pre.data());
+        CHECK(compare(t, cfg.width, cfg.height, 0, 0, 0, cfg.width, cfg.height, img, 0, 0, img.width, img.height) <=
+              kTolerance);
+    }
+}
+
+TEST(preprocess_nv12_letterbox_pads_and_batches) {
+    const Nv12 a(128, 64, 2);
+    const Nv12 b(64, 128, 3);
+    roi::PreprocessConfig cfg;
+    cfg.width = 64;
+    cfg.height = 64;
+    cfg.batch = 2;
+    cfg.letterbox = true;
+    roi::Preprocessor pre(cfg);
+    const roi::LetterboxInfo ia = pre.run_nv12(0, a.y.data(), a.uv.data(), a.width, a.height, a.pitch, a.pitch);
+    const roi::LetterboxInfo ib = pre.run_nv12(1, b.y.data(), b.uv.data(), b.width, b.height, b.pitch, b.pitch);
+    CHECK_EQ(ia.pad_x, 0);
+    CHECK_EQ(ia.pad_y, 16);
+    CHECK_EQ(ib.pad_x, 16);
+    CHECK_EQ(ib.pad_y, 0);
+    CHECK_NEAR(ia.scale_x, 0.5, 1e-6);
+
+    const float* t = static_cast<const float*>(pre.data());
+    CHECK(compare(t, 64, 64, 0, 0, 16, 64, 32, a, 0, 0, a.width, a.height) <= kTolerance);
+    CHECK(compare(t, 64, 64, 1, 16, 0, 32, 64, b, 0, 0, b.width, b.height) <= kTolerance);
+    // 填充区域三个通道都是 pad_value / 255
+    const size_t plane = 64 * 64;
+    const float pad = 127.0f / 255.0f;
+    for (int ch = 0; ch < 3; ++ch) {
+        CHECK_EQ(t[ch * plane + 5 * 64 + 10], pad);
+        CHECK_EQ(t[ch * plane + 60 * 64 + 63], pad);
+        CHECK_EQ(t[3 * plane + ch * plane + 30 * 64 + 3], pad);
+        CHECK_EQ(t[3 * plane + ch * plane + 30 * 64 + 50], pad);
+    }
+}
+
+TEST(preprocess_int8_and_surface_region) {
+    const Nv12 img(80, 60, 4);
+    roi::Surface s;
+    s.width = img.width;
+    s.height = img.height;
+    s.data[0] = const_cast<uint8_t*>(img.y.data());
+    s.data[1] = const_cast<uint8_t*>(img.uv.data());
+    s.pitch[0] = s.pitch[1] = img.pitch;
+
+    roi::PreprocessConfig fcfg;
+    fcfg.width = 32;
+    fcfg.height = 24;
+    roi::Preprocessor pre(fcfg);
+    roi::LetterboxInfo info;
+    CHECK(pre.run_surface(0, s, 10, 8, 40, 30, &info));
+    CHECK(compare(static_cast<const float*>(pre.data()), 32, 24, 0, 0, 0, 32, 24, img, 10, 8, 40, 30) <=
+          kTolerance);
+    // 奇数坐标、越界和没有主机映射的帧都不处理
+    CHECK(!pre.run_surface(0, s, 11, 8, 40, 30, &info));
+    CHECK(!pre.run_surface(0, s, 50, 40, 40, 30, &info));
+    roi::Surface device = s;
+    device.data[0] = device.data[1] = nullptr;
+    CHECK(!pre.run_surface(0, device, &info));
+
+    roi::PreprocessConfig qcfg = fcfg;
+    qcfg.int8 = true;
+    roi::Preprocessor quant(qcfg);
+    CHECK(quant.run_surface(0, s, &info));
+    roi::Preprocessor full(fcfg);
+    CHECK(full.run_surface(0, s, &info));
+    CHECK_EQ(quant.bytes(), size_t(32 * 24 * 3));
+    const int8_t* q = static_cast<const int8_t*>(quant.data());
+    const float* f = static_cast<const float*>(full.data());
+    for (size_t i = 0; i < quant.bytes(); ++i) CHECK_EQ(int(q[i]), int(std::lround(f[i] * 127.0f)));
+}
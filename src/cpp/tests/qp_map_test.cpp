@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "../encode/qp_map.h"
+#include "test.h"
+
+namespace {
+
+constexpr int kNoRoi = 127;
+
+// 整图重建的参考实现：每块取覆盖它的 ROI 的最小偏移，没有 ROI 时取（静止）背景
+std::vector<int> rebuild(const roi::QpMap& map, const std::vector<roi::RoiBox>& boxes, int width, int height,
+                         int roi_background, const std::vector<uint8_t>& still, int static_delta, int* roi_blocks) {
+    const int b = map.block_size();
+    std::vector<int> out(size_t(map.cols()) * map.rows());
+    *roi_blocks = 0;
+    for (int r = 0; r < map.rows(); ++r) {
+        for (int c = 0; c < map.cols(); ++c) {
+            int v = kNoRoi;
+            for (const roi::RoiBox& box : boxes) {
+                const float x0 = std::max(0.0f, box.x);
+                const float y0 = std::max(0.0f, box.y);
+                const float x1 = std::min(float(width), box.x + box.w);
+                const float y1 = std::min(float(height), box.y + box.h);
+                if (x1 <= x0 || y1 <= y0) continue;
+                if (c < int(x0) / b || r < int(y0) / b || c >= int(std::ceil(x1 / b)) || r >= int(std::ceil(y1 / b)))
+                    continue;
+                const int d = std::min(box.qp_delta + map.roi_bias(), std::max(box.qp_delta, roi_background));
+                v = std::min(v, std::max(-51, std::min(51, d)));
+            }
+            const size_t i = size_t(r) * map.cols() + c;
+            *roi_blocks += v != kNoRoi;
+            out[i] = v != kNoRoi ? v : still[i] ? std::max(static_delta, map.background()) : map.background();
+        }
+    }
+    return out;
+}
+
+roi::RoiBox box(float x, float y, float w, float h, int delta = -8) {
+    roi::RoiBox b;
+    b.x = x;
+    b.y = y;
+    b.w = w;
+    b.h = h;
+    b.qp_delta = delta;
+    return b;
+}
+
+}  // namespace
+
+TEST(qp_map_incremental_update_matches_full_rebuild) {
+    constexpr int kWidth = 640;
+    constexpr int kHeight = 360;
+    constexpr int kStaticDelta = 2;
+    std::mt19937 rng(7);
+    for (int trial = 0; trial < 50; ++trial) {
+        roi::QpMap map(kWidth, kHeight, 16, 6);
+        std::vector<roi::RoiBox> boxes;
+        std::vector<uint8_t> still(size_t(map.cols()) * map.rows(), 0);
+        // ROI 的偏移按最近一次重新光栅化（update / set_roi_bias）时的背景抬高
+        int roi_background = map.background();
+        for (int step = 0; step < 150; ++step) {
+            const unsigned op = rng() % 12;
+            if (op == 0) {
+                for (uint8_t& s : still) s = rng() % 4 == 0;
+                map.set_static(still.data(), kStaticDelta);
+            } else if (op == 1) {
+                map.set_background(int(rng() % 12));
+            } else if (op == 2) {
+                const int bias = int(rng() % 6);
+                if (bias != map.roi_bias()) roi_background = map.background();
+                map.set_roi_bias(bias);
+            } else if (op == 3) {
+                map.reset();
+                boxes.clear();
+            } else {
+                if (boxes.empty() || rng() % 6 == 0) {
+                    // 换一批目标，允许越界、零面积和重叠
+                    boxes.resize(rng() % 7);
+                    for (roi::RoiBox& b : boxes) {
+                        b = box(float(int(rng() % 700) - 40), float(int(rng() % 400) - 40), float(rng() % 220),
+                                float(rng() % 220), -int(rng() % 10));
+                    }
+                } else if (op != 4) {
+                    // 大多数帧只是平移几个像素；op == 4 时原样重复上一帧
+                    for (roi::RoiBox& b : boxes) {
+                        if (rng() % 2) continue;
+                        b.x += float(int(rng() % 19) - 9);
+                        b.y += float(int(rng() % 19) - 9);
+                    }
+                }
+                map.update(boxes.data(), int(boxes.size()));
+                roi_background = map.background();
+            }
+            int roi_blocks = 0;
+            const std::vector<int> expected =
+                rebuild(map, boxes, kWidth, kHeight, roi_background, still, kStaticDelta, &roi_blocks);
+            int mismatched = 0;
+            for (size_t i = 0; i < expected.size(); ++i) mismatched += map.data()[i] != expected[i];
+            CHECK_EQ(mismatched, 0);
+            CHECK_EQ(map.roi_blocks(), roi_blocks);
+            if (mismatched || map.roi_blocks() != roi_blocks) return;
+        }
+    }
+}
+
+TEST(qp_map_touches_only_changed_blocks) {
+    roi::QpMap map(1920, 1080, 16, 6);
+    std::vector<roi::RoiBox> boxes = {box(160, 160, 64, 64), box(800, 400, 160, 320, -4)};
+    CHECK_EQ(map.update(boxes.data(), 2), 16 + 10 * 20);
+    CHECK_EQ(map.roi_blocks(), 16 + 10 * 20);
+    const uint32_t version = map.version();
+    // ROI 不动：不改写任何块，版本不变
+    CHECK_EQ(map.update(boxes.data(), 2), 0);
+    CHECK_EQ(map.version(), version);
+
+    // 平移一个块：只有离开的一列和进入的一列改变
+    boxes[1].x += 16;
+    CHECK_EQ(map.update(boxes.data(), 2), 2 * 20);
+    CHECK_EQ(map.version(), version + 1);
+    CHECK_EQ(int(map.data()[size_t(25) * map.cols() + 50]), 6);
+    CHECK_EQ(int(map.data()[size_t(25) * map.cols() + 60]), -4);
+
+    // 重叠处取最小偏移，去掉更优先的框后恢复成另一个框的偏移
+    boxes.push_back(box(800, 400, 64, 64, -10));
+    CHECK_EQ(map.update(boxes.data(), 3), 4 * 4);
+    CHECK_EQ(int(map.data()[size_t(25) * map.cols() + 50]), -10);
+    CHECK_EQ(int(map.data()[size_t(25) * map.cols() + 51]), -10);
+    boxes.pop_back();
+    CHECK_EQ(map.update(boxes.data(), 2), 4 * 4);
+    CHECK_EQ(int(map.data()[size_t(25) * map.cols() + 51]), -4);
+    CHECK_EQ(int(map.data()[size_t(25) * map.cols() + 50]), 6);
+
+    // 框的顺序变化不算变化
+    std::swap(boxes[0], boxes[1]);
+    CHECK_EQ(map.update(boxes.data(), 2), 0);
+
+    map.reset();
+    CHECK_EQ(map.roi_blocks(), 0);
+    CHECK_EQ(int(map.data()[size_t(10) * map.cols() + 10]), 6);
+    CHECK_EQ(map.update(boxes.data(), 2), 16 + 10 * 20);
+}
+
+TEST(qp_map_static_background_and_bias) {
+    roi::QpMap map(256, 256, 16, 4);
+    const roi::RoiBox roi = box(0, 0, 32, 32, -6);
+    map.update(&roi, 1);
+    std::vector<uint8_t> still(size_t(map.cols()) * map.rows(), 1);
+    // ROI 内的块不受静止标记影响
+    CHECK_EQ(map.set_static(still.data(), 10), 256 - 4);
+    CHECK_EQ(map.static_blocks(), 256);
+    CHECK_EQ(int(map.data()[0]), -6);
+    CHECK_EQ(int(map.data()[100]), 10);
+    // 背景压得比静止偏移还高时静止块跟着背景
+    map.set_background(12);
+    CHECK_EQ(int(map.data()[100]), 12);
+    map.set_background(4);
+    CHECK_EQ(int(map.data()[100]), 10);
+    // 抬高的 ROI 不会比背景更差
+    CHECK_EQ(map.set_roi_bias(20), 4);
+    CHECK_EQ(int(map.data()[0]), 4);
+    CHECK_EQ(map.set_roi_bias(20), 0);
+    CHECK_EQ(map.set_roi_bias(0), 4);
+    CHECK_EQ(int(map.data()[0]), -6);
+    // 清除静止标记
+    CHECK_EQ(map.set_static(nullptr, 10), 256 - 4);
+    CHECK_EQ(int(map.data()[100]), 4);
+    CHECK_EQ(map.static_blocks(), 0);
+}
@@ -0,0 +1,103 @@
+#include <random>
+#include <vector>
+
+#include "../encode/qp_map.h"
+#include "../encode/roi_smoother.h"
+#include "test.h"
+
+namespace {
+
+roi::RoiBox box(float x, float y, float w, float h, int delta = -8) {
+    roi::RoiBox b;
+    b.x = x;
+    b.y = y;
+    b.w = w;
+    b.h = h;
+    b.qp_delta = delta;
+    return b;
+}
+
+}  // namespace
+
+TEST(roi_smoother_dilates_and_aligns_to_blocks) {
+    roi::RoiSmoother smoother(1920, 1080, 16, roi::RoiSmootherConfig());
+    const roi::RoiBox in = box(100, 100, 100, 200, -5);
+    const std::vector<roi::RoiBox>& out = smoother.update(&in, 1);
+    CHECK_EQ(out.size(), size_t(1));
+    // 每边外扩 0.15 倍宽高再加 8 像素
+    CHECK_EQ(out[0].x, 64.0f);
+    CHECK_EQ(out[0].y, 48.0f);
+    CHECK_EQ(out[0].x + out[0].w, 224.0f);
+    CHECK_EQ(out[0].y + out[0].h, 352.0f);
+    CHECK_EQ(out[0].qp_delta, -5);
+
+    // 贴着画面边缘的框裁到画面内
+    const roi::RoiBox edge = box(1850, 1000, 70, 80);
+    smoother.reset();
+    const std::vector<roi::RoiBox>& clipped = smoother.update(&edge, 1);
+    CHECK_EQ(clipped.size(), size_t(1));
+    CHECK_EQ(clipped[0].x + clipped[0].w, 1920.0f);
+    CHECK_EQ(clipped[0].y + clipped[0].h, 1080.0f);
+}
+
+TEST(roi_smoother_absorbs_jitter) {
+    roi::RoiSmoother smoother(1920, 1080, 16, roi::RoiSmootherConfig());
+    roi::QpMap map(1920, 1080, 16, 6);
+    std::mt19937 rng(3);
+    int rewrites = 0;
+    for (int i = 0; i < 50; ++i) {
+        // NMS 输出的漂移：位置抖动几个像素，外扩后的边缘都落在同一个块里
+        const roi::RoiBox in = box(400 + float(rng() % 5), 300 + float(rng() % 5), 120, 240);
+        const std::vector<roi::RoiBox>& out = smoother.update(&in, 1);
+        CHECK_EQ(out.size(), size_t(1));
+        const int changed = map.update(out.data(), int(out.size()));
+        if (i > 0) rewrites += changed;
+    }
+    CHECK_EQ(rewrites, 0);
+    CHECK_EQ(smoother.tracks(), 1);
+}
+
+TEST(roi_smoother_grows_at_once_and_shrinks_slowly) {
+    roi::RoiSmoother smoother(1920, 1080, 16, roi::RoiSmootherConfig());
+    const roi::RoiBox small = box(400, 300, 100, 100);
+    const roi::RoiBox large = box(400, 300, 300, 100);
+    const roi::RoiBox first = smoother.update(&small, 1)[0];
+    const float small_right = first.x + first.w;
+    // 外扩在同一次更新里生效
+    const std::vector<roi::RoiBox>& grown = smoother.update(&large, 1);
+    const float large_right = grown[0].x + grown[0].w;
+    CHECK(large_right >= 400 + 300 + 300 * 0.15f + 8);
+
+    // 收缩逐次进行，且不会一步退回
+    float prev = large_right;
+    int steps = 0;
+    while (steps < 50) {
+        const std::vector<roi::RoiBox>& out = smoother.update(&small, 1);
+        const float right = out[0].x + out[0].w;
+        CHECK(right <= prev);
+        prev = right;
+        ++steps;
+        if (right <= small_right + 16) break;
+    }
+    CHECK(steps > 2);
+    CHECK(prev <= small_right + 16);
+}
+
+TEST(roi_smoother_holds_lost_targets) {
+    roi::RoiSmootherConfig config;
+    config.hold_updates = 3;
+    roi::RoiSmoother smoother(1920, 1080, 16, config);
+    const roi::RoiBox in = box(400, 300, 100, 100);
+    smoother.update(&in, 1);
+    // 目标消失后再保持 hold_updates 次更新
+    for (int i = 0; i < 3; ++i) CHECK_EQ(smoother.update(nullptr, 0).size(), size_t(1));
+    CHECK_EQ(smoother.update(nullptr, 0).size(), size_t(0));
+    CHECK_EQ(smoother.tracks(), 0);
+
+    // 在保持期间重新出现的目标沿用原来的 ROI，不新建
+    smoother.update(&in, 1);
+    smoother.update(nullptr, 0);
+    const roi::RoiBox moved = box(404, 302, 100, 100);
+    CHECK_EQ(smoother.update(&moved, 1).size(), size_t(1));
+    CHECK_EQ(smoother.tracks(), 1);
+}
@@ -0,0 +1,217 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../common/au_ring.h"
+#include "../rtsp/rtp_depacketizer.h"
+#include "test.h"
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+constexpr int kPayloadType = 96;
+
+struct RtpOptions {
+    int csrc = 0;        // CSRC 个数
+    int ext_words = -1;  // >= 0 时带一个该长度（32 位字）的头扩展
+    int padding = 0;     // 末尾的填充字节数（含最后的长度字节）
+};
+
+Bytes rtp(uint16_t seq, uint32_t ts, bool marker, const Bytes& payload, RtpOptions opt = RtpOptions()) {
+    Bytes p;
+    p.push_back(uint8_t(0x80 | (opt.padding ? 0x20 : 0) | (opt.ext_words >= 0 ? 0x10 : 0) | opt.csrc));
+    p.push_back(uint8_t((marker ? 0x80 : 0) | kPayloadType));
+    p.push_back(uint8_t(seq >> 8));
+    p.push_back(uint8_t(seq));
+    for (int shift = 24; shift >= 0; shift -= 8) p.push_back(uint8_t(ts >> shift));
+    for (int i = 0; i < 4; ++i) p.push_back(0x5a);  // SSRC
+    for (int i = 0; i < opt.csrc * 4; ++i) p.push_back(0xc5);
+    if (opt.ext_words >= 0) {
+        p.insert(p.end(), {0xbe, 0xde, 0, uint8_t(opt.ext_words)});
+        for (int i = 0; i < opt.ext_words * 4; ++i) p.push_back(0xee);
+    }
+    p.insert(p.end(), payload.begin(), payload.end());
+    for (int i = 1; i < opt.padding; ++i) p.push_back(0);
+    if (opt.padding) p.push_back(uint8_t(opt.padding));
+    return p;
+}
+
+Bytes cat(std::initializer_list<Bytes> parts) {
+    Bytes out;
+    for (const Bytes& b : parts) out.insert(out.end(), b.begin(), b.end());
+    return out;
+}
+
+Bytes annexb(std::initializer_list<Bytes> nals) {
+    Bytes out;
+    for (const Bytes& n : nals) {
+        out.insert(out.end(), {0, 0, 0, 1});
+        out.insert(out.end(), n.begin(), n.end());
+    }
+    return out;
+}
+
+Bytes sized(const Bytes& nal) { return cat({{uint8_t(nal.size() >> 8), uint8_t(nal.size())}, nal}); }
+
+struct Harness {
+    roi::AuRing ring{1 << 16, 16};
+    roi::RtpDepacketizer depay;
+    int consumer;
+    uint16_t seq = 1000;
+
+    explicit Harness(roi::Codec codec) : depay(&ring, codec, kPayloadType), consumer(ring.add_consumer()) {}
+
+    void send(uint32_t ts, bool marker, const Bytes& payload, RtpOptions opt = RtpOptions()) {
+        const Bytes p = rtp(seq++, ts, marker, payload, opt);
+        depay.on_packet(p.data(), p.size());
+    }
+
+    // 取出下一个 AU，没有时返回 false
+    bool next(Bytes* data, roi::AccessUnitView* view) {
+        if (!ring.peek(consumer, view)) return false;
+        data->assign(view->data, view->data + view->size);
+        ring.release(consumer);
+        return true;
+    }
+};
+
+// H.264：SPS / PPS / IDR / 非 IDR 分片
+const Bytes kSps = {0x67, 0x42, 0x00, 0x1f, 0xe9};
+const Bytes kPps = {0x68, 0xce, 0x3c, 0x80};
+const Bytes kIdrBody = {0x88, 0x84, 0x21, 0xa0, 0x11, 0x22, 0x33, 0x44, 0x55};
+const Bytes kSliceBody = {0x9a, 0x02, 0x04, 0x08};
+
+}  // namespace
+
+TEST(rtp_h264_single_nal_and_fu_a) {
+    Harness h(roi::Codec::kH264);
+    h.send(9000, false, kSps);
+    h.send(9000, false, kPps);
+    // IDR 分成三片：FU 指示字节带原 NRI，FU 头依次为 S、中间、E
+    h.send(9000, false, cat({{0x7c, 0x85}, Bytes(kIdrBody.begin(), kIdrBody.begin() + 3)}));
+    h.send(9000, false, cat({{0x7c, 0x05}, Bytes(kIdrBody.begin() + 3, kIdrBody.begin() + 6)}));
+    h.send(9000, true, cat({{0x7c, 0x45}, Bytes(kIdrBody.begin() + 6, kIdrBody.end())}));
+
+    Bytes au;
+    roi::AccessUnitView view;
+    CHECK(h.next(&au, &view));
+    CHECK(au == annexb({kSps, kPps, cat({{0x65}, kIdrBody})}));
+    CHECK_EQ(view.flags, uint32_t(roi::kAuKeyFrame | roi::kAuParamSets));
+    CHECK_EQ(view.pts, int64_t(9000));
+    CHECK_EQ(h.depay.lost(), uint64_t(0));
+    CHECK_EQ(h.depay.packets(), uint64_t(5));
+    CHECK_EQ(h.depay.parameter_sets().size(), size_t(2));
+}
+
+TEST(rtp_h264_stap_a_and_sdp_parameter_sets) {
+    Harness h(roi::Codec::kH264);
+    const Bytes idr = cat({{0x65}, kIdrBody});
+    h.send(0, true, cat({{0x78}, sized(kSps), sized(kPps), sized(idr)}));
+    // 下一个关键帧不带参数集：补上第一个 AU 里带内收到的 SPS / PPS
+    h.send(3000, true, idr);
+    // 非关键帧不补
+    h.send(6000, true, cat({{0x41}, kSliceBody}));
+
+    Bytes au;
+    roi::AccessUnitView view;
+    CHECK(h.next(&au, &view));
+    CHECK(au == annexb({kSps, kPps, idr}));
+    CHECK(h.next(&au, &view));
+    CHECK(au == annexb({kSps, kPps, idr}));
+    CHECK_EQ(view.flags, uint32_t(roi::kAuKeyFrame | roi::kAuParamSets));
+    CHECK(h.next(&au, &view));
+    CHECK(au == annexb({cat({{0x41}, kSliceBody})}));
+    CHECK_EQ(view.flags, uint32_t(0));
+
+    // 只在 SDP 里给出参数集的摄像头
+    Harness sdp(roi::Codec::kH264);
+    sdp.depay.set_parameter_sets({std::string(kSps.begin(), kSps.end()), std::string(kPps.begin(), kPps.end())});
+    sdp.send(0, true, idr);
+    CHECK(sdp.next(&au, &view));
+    CHECK(au == annexb({kSps, kPps, idr}));
+}
+
+TEST(rtp_h265_aggregation_and_fragmentation) {
+    Harness h(roi::Codec::kH265);
+    const Bytes vps = {0x40, 0x01, 0x0c, 0x01};
+    const Bytes sps = {0x42, 0x01, 0x01, 0x60};
+    const Bytes pps = {0x44, 0x01, 0xc1, 0x72};
+    const Bytes body = {0xaf, 0x03, 0x30, 0x41, 0x52, 0x63, 0x74};
+    // AP（类型 48）装下三个参数集，IDR_W_RADL（类型 19）用 FU（类型 49）分两片
+    h.send(0, false, cat({{0x60, 0x01}, sized(vps), sized(sps), sized(pps)}));
+    h.send(0, false, cat({{0x62, 0x01, 0x80 | 19}, Bytes(body.begin(), body.begin() + 4)}));
+    h.send(0, true, cat({{0x62, 0x01, 0x40 | 19}, Bytes(body.begin() + 4, body.end())}));
+    // TRAIL_R（类型 1）单 NAL
+    const Bytes trail = {0x02, 0x01, 0xd0, 0x0e};
+    h.send(3000, true, trail);
+
+    Bytes au;
+    roi::AccessUnitView view;
+    CHECK(h.next(&au, &view));
+    CHECK(au == annexb({vps, sps, pps, cat({{0x26, 0x01}, body})}));
+    CHECK_EQ(view.flags, uint32_t(roi::kAuKeyFrame | roi::kAuParamSets));
+    CHECK_EQ(int(view.codec), int(roi::Codec::kH265));
+    CHECK(h.next(&au, &view));
+    CHECK(au == annexb({trail}));
+    CHECK_EQ(view.flags, uint32_t(0));
+    CHECK_EQ(h.depay.parameter_sets().size(), size_t(3));
+}
+
+TEST(rtp_sequence_gap_drops_until_keyframe) {
+    Harness h(roi::Codec::kH264);
+    const Bytes idr = cat({{0x65}, kIdrBody});
+    h.depay.set_parameter_sets({std::string(kSps.begin(), kSps.end()), std::string(kPps.begin(), kPps.end())});
+    h.send(0, true, idr);
+    // 非关键帧的 FU-A 丢了中间一片
+    h.send(3000, false, cat({{0x5c, 0x81}, kSliceBody}));
+    ++h.seq;
+    h.send(3000, true, cat({{0x5c, 0x41}, kSliceBody}));
+    // 之后的非关键帧继续丢弃，直到关键帧
+    h.send(6000, true, cat({{0x41}, kSliceBody}));
+    h.send(9000, true, idr);
+    // 重复到达的旧包被忽略
+    const Bytes old = rtp(uint16_t(h.seq - 1), 9000, true, idr);
+    h.depay.on_packet(old.data(), old.size());
+
+    Bytes au;
+    roi::AccessUnitView view;
+    CHECK(h.next(&au, &view));
+    CHECK_EQ(view.pts, int64_t(0));
+    CHECK(h.next(&au, &view));
+    CHECK_EQ(view.pts, int64_t(9000));
+    CHECK(view.flags & roi::kAuKeyFrame);
+    CHECK(view.flags & roi::kAuDiscontinuity);
+    CHECK(au == annexb({kSps, kPps, idr}));
+    CHECK(!h.next(&au, &view));
+    CHECK_EQ(h.depay.lost(), uint64_t(1));
+}
+
+TEST(rtp_padding_extension_and_csrc) {
+    Harness h(roi::Codec::kH264);
+    const Bytes idr = cat({{0x65}, kIdrBody});
+    RtpOptions opt;
+    opt.csrc = 2;
+    opt.ext_words = 3;
+    opt.padding = 5;
+    h.send(0, false, kSps, opt);
+    opt.ext_words = 0;
+    h.send(0, false, kPps, opt);
+    h.send(0, true, idr, RtpOptions{0, -1, 1});
+
+    Bytes au;
+    roi::AccessUnitView view;
+    CHECK(h.next(&au, &view));
+    CHECK(au == annexb({kSps, kPps, idr}));
+
+    // 填充长度超过包长、扩展头越界的包直接丢弃
+    Bytes bad = rtp(h.seq++, 3000, true, idr);
+    bad[0] |= 0x20;
+    bad.back() = 0xff;
+    h.depay.on_packet(bad.data(), bad.size());
+    Bytes truncated = rtp(h.seq++, 3000, true, {});
+    truncated[0] |= 0x10;
+    h.depay.on_packet(truncated.data(), truncated.size());
+    CHECK(!h.next(&au, &view));
+    CHECK_EQ(h.depay.packets(), uint64_t(3));
+}
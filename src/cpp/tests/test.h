@@ -0,0 +1,48 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+
+// 原生单元测试的最小框架：TEST(name) 注册用例，CHECK* 失败时记下文件行号并继续执行该用例，
+// roi_tests 依次运行所有（或 --filter 子串匹配的）用例，有失败时以非 0 退出（见 tests/test_main.cpp）。
+
+namespace roi_test {
+
+using TestFn = void (*)();
+
+struct Registrar {
+    Registrar(const char* name, TestFn fn);
+};
+
+void fail(const char* file, int line, const std::string& what);
+
+template <typename A, typename B>
+void check_eq(const A& a, const B& b, const char* expr_a, const char* expr_b, const char* file, int line) {
+    if (a == b) return;
+    std::ostringstream os;
+    os << expr_a << " == " << expr_b << " (" << +a << " vs " << +b << ")";
+    fail(file, line, os.str());
+}
+
+inline void check_near(double a, double b, double tolerance, const char* expr_a, const char* expr_b,
+                       const char* file, int line) {
+    if (a - b <= tolerance && b - a <= tolerance) return;
+    std::ostringstream os;
+    os << expr_a << " ~= " << expr_b << " (" << a << " vs " << b << ", tolerance " << tolerance << ")";
+    fail(file, line, os.str());
+}
+
+}  // namespace roi_test
+
+#define TEST(name)                                                   \
+    static void test_##name();                                       \
+    static const roi_test::Registrar registrar_##name(#name, test_##name); \
+    static void test_##name()
+
+#define CHECK(cond)                                                    \
+    do {                                                               \
+        if (!(cond)) roi_test::fail(__FILE__, __LINE__, "CHECK(" #cond ")"); \
+    } while (0)
+
+#define CHECK_EQ(a, b) roi_test::check_eq((a), (b), #a, #b, __FILE__, __LINE__)
+#define CHECK_NEAR(a, b, tolerance) roi_test::check_near((a), (b), (tolerance), #a, #b, __FILE__, __LINE__)
@@ -0,0 +1,67 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+namespace roi_test {
+
+namespace {
+
+struct Case {
+    const char* name;
+    TestFn fn;
+};
+
+// 静态初始化顺序不确定，用函数内的静态变量保存注册表
+std::vector<Case>& registry() {
+    static std::vector<Case> cases;
+    return cases;
+}
+
+int g_failures = 0;
+
+}  // namespace
+
+Registrar::Registrar(const char* name, TestFn fn) { registry().push_back({name, fn}); }
+
+void fail(const char* file, int line, const std::string& what) {
+    ++g_failures;
+    std::fprintf(stderr, "  %s:%d: %s\n", file, line, what.c_str());
+}
+
+}  // namespace roi_test
+
+int main(int argc, char** argv) {
+    const char* filter = nullptr;
+    bool list = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--list") == 0) {
+            list = true;
+        } else {
+            std::fprintf(stderr, "usage: %s [--filter <substring>] [--list]\n", argv[0]);
+            return 2;
+        }
+    }
+    int run = 0;
+    int failed = 0;
+    for (const roi_test::Case& c : roi_test::registry()) {
+        if (filter && std::strstr(c.name, filter) == nullptr) continue;
+        if (list) {
+            std::printf("%s\n", c.name);
+            continue;
+        }
+        const int before = roi_test::g_failures;
+        c.fn();
+        ++run;
+        const bool ok = roi_test::g_failures == before;
+        failed += !ok;
+        std::fprintf(stderr, "%-4s %s\n", ok ? "ok" : "FAIL", c.name);
+    }
+    if (list) return 0;
+    std::fprintf(stderr, "%d tests, %d failed\n", run, failed);
+    return failed ? 1 : 0;
+}
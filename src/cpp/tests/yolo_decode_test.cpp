@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "../infer/yolo_decode.h"
+#include "test.h"
+
+namespace {
+
+// 逐行标量实现，作为 SIMD 筛选和 argmax 的对照
+std::vector<roi::Detection> reference(const std::vector<std::vector<float>>& heads, int stride,
+                                      const roi::YoloDecodeParams& params) {
+    std::vector<roi::Detection> out;
+    for (const std::vector<float>& head : heads) {
+        const int rows = int(head.size()) / stride;
+        for (int i = 0; i < rows; ++i) {
+            const float* r = head.data() + size_t(i) * stride;
+            if (!(r[4] > params.conf_threshold)) continue;
+            int best = 0;
+            for (int c = 1; c < stride - 5; ++c) {
+                if (r[5 + c] > r[5 + best]) best = c;
+            }
+            if (!(r[5 + best] > params.conf_threshold)) continue;
+            roi::Detection d;
+            d.w = r[2] * float(params.width);
+            d.h = r[3] * float(params.height);
+            d.x = r[0] * float(params.width) - d.w / 2;
+            d.y = r[1] * float(params.height) - d.h / 2;
+            d.confidence = r[5 + best];
+            d.class_id = best;
+            out.push_back(d);
+        }
+    }
+    std::stable_sort(out.begin(), out.end(),
+                     [](const roi::Detection& a, const roi::Detection& b) { return a.confidence > b.confidence; });
+    std::vector<roi::Detection> kept;
+    for (const roi::Detection& d : out) {
+        bool suppressed = false;
+        for (const roi::Detection& k : kept) {
+            if (params.per_class && k.class_id != d.class_id) continue;
+            const float iw = std::min(d.x + d.w, k.x + k.w) - std::max(d.x, k.x);
+            const float ih = std::min(d.y + d.h, k.y + k.h) - std::max(d.y, k.y);
+            if (iw > 0 && ih > 0 && iw * ih / (d.w * d.h + k.w * k.h - iw * ih) > params.nms_threshold) {
+                suppressed = true;
+                break;
+            }
+        }
+        if (!suppressed) kept.push_back(d);
+    }
+    return kept;
+}
+
+// 与 YOLOv3 输出相同的分布：大多数行目标置信度很低，类别得分已乘上目标置信度
+std::vector<float> random_head(std::mt19937* rng, int rows, int stride) {
+    std::uniform_real_distribution<float> u(0.0f, 1.0f);
+    std::vector<float> head(size_t(rows) * stride);
+    for (int i = 0; i < rows; ++i) {
+        float* r = head.data() + size_t(i) * stride;
+        // 框集中在几个位置，NMS 才有东西可抑制
+        r[0] = 0.1f + 0.2f * float((*rng)() % 4) + 0.02f * u(*rng);
+        r[1] = 0.2f + 0.3f * float((*rng)() % 3) + 0.02f * u(*rng);
+        r[2] = 0.05f + 0.2f * u(*rng);
+        r[3] = 0.05f + 0.3f * u(*rng);
+        r[4] = u(*rng) < 0.1f ? 0.4f + 0.6f * u(*rng) : 0.3f * u(*rng);
+        for (int c = 5; c < stride; ++c) r[c] = r[4] * u(*rng);
+        // 偶尔出现并列的最高分，argmax 要取靠前的类别
+        if (stride > 6 && (*rng)() % 16 == 0) r[stride - 1] = r[5];
+    }
+    return head;
+}
+
+bool same(const std::vector<roi::Detection>& a, const std::vector<roi::Detection>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].x != b[i].x || a[i].y != b[i].y || a[i].w != b[i].w || a[i].h != b[i].h ||
+            a[i].confidence != b[i].confidence || a[i].class_id != b[i].class_id) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+TEST(yolo_decode_matches_scalar_reference) {
+    std::mt19937 rng(20240601);
+    // 80 类走 SIMD argmax，2 类走标量；行数不是 8 的倍数，覆盖 SIMD 筛选的尾部
+    for (const int stride : {85, 7}) {
+        for (const bool per_class : {true, false}) {
+            std::vector<std::vector<float>> heads = {random_head(&rng, 507, stride), random_head(&rng, 2028, stride),
+                                                     random_head(&rng, 13, stride)};
+            std::vector<roi::YoloHead> views;
+            for (const auto& h : heads) views.push_back(roi::YoloHead{h.data(), int(h.size()) / stride, stride});
+            roi::YoloDecodeParams params;
+            params.width = 1920;
+            params.height = 1080;
+            params.per_class = per_class;
+            std::vector<roi::Detection> out;
+            roi::yolo_decode(views.data(), int(views.size()), params, &out);
+            const std::vector<roi::Detection> expected = reference(heads, stride, params);
+            CHECK(!expected.empty());
+            CHECK_EQ(out.size(), expected.size());
+            CHECK(same(out, expected));
+            for (size_t i = 1; i < out.size(); ++i) CHECK(out[i - 1].confidence >= out[i].confidence);
+        }
+    }
+}
+
+TEST(yolo_decode_skips_empty_heads) {
+    std::vector<float> data(7 * 4, 0.0f);
+    const roi::YoloHead heads[] = {{nullptr, 10, 85}, {data.data(), 4, 5}, {data.data(), 0, 7}};
+    std::vector<roi::Detection> out(3);
+    roi::yolo_decode(heads, 3, roi::YoloDecodeParams(), &out);
+    CHECK(out.empty());
+}
+
+TEST(nms_per_class_and_across_classes) {
+    auto det = [](float x, float confidence, int class_id) {
+        roi::Detection d;
+        d.x = x;
+        d.y = 0;
+        d.w = 100;
+        d.h = 100;
+        d.confidence = confidence;
+        d.class_id = class_id;
+        return d;
+    };
+    // 前三个两两 IoU 约 0.82，第四个与它们不相交
+    const std::vector<roi::Detection> input = {det(10, 0.6f, 0), det(0, 0.9f, 0), det(5, 0.8f, 1), det(300, 0.7f, 0)};
+    CHECK_NEAR(roi::iou(input[0], input[1]), 90.0 * 100 / (2 * 10000 - 9000), 1e-6);
+    CHECK_EQ(roi::iou(input[1], input[3]), 0.0f);
+
+    std::vector<roi::Detection> dets = input;
+    roi::nms(&dets, 0.5f, true);
+    CHECK_EQ(dets.size(), size_t(3));
+    CHECK_EQ(dets[0].confidence, 0.9f);
+    CHECK_EQ(dets[1].class_id, 1);
+    CHECK_EQ(dets[2].x, 300.0f);
+
+    dets = input;
+    roi::nms(&dets, 0.5f, false);
+    CHECK_EQ(dets.size(), size_t(2));
+    CHECK_EQ(dets[0].confidence, 0.9f);
+    CHECK_EQ(dets[1].confidence, 0.7f);
+
+    dets = input;
+    roi::nms(&dets, 0.95f, false);
+    CHECK_EQ(dets.size(), size_t(4));
+}
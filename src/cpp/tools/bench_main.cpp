@@ -0,0 +1,447 @@
+// 微基准：roi_bench [--filter <子串>] [--min-time <ms>] [--out <file.json>] [--list]
+// 覆盖热路径上的纯 CPU 内核：YOLO 解码 + NMS、融合预处理、QP 图增量更新、FLV 封装和 AU 环形缓冲区。
+// 输入由固定种子生成，同一台机器上可重复；结果为 JSON（默认写到 stdout），
+// 用 src/python/bench/compare.py 对比两次结果找出回归。
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <sys/utsname.h>
+#include <thread>
+#include <vector>
+
+#include "../common/annexb.h"
+#include "../common/au_ring.h"
+#include "../decode/surface_scaler.h"
+#include "../encode/qp_map.h"
+#include "../infer/preprocess.h"
+#include "../infer/yolo_decode.h"
+#include "../rtmp/flv_muxer.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t kSeed = 20240601;
+constexpr double kSampleNs = 200e3;  // 每个计时样本至少 0.2ms，p50/p99 按样本内的平均单次耗时统计
+
+struct Result {
+    std::string name;
+    uint64_t iterations = 0;
+    double ns_per_op = 0;
+    double p50_ns = 0;
+    double p99_ns = 0;
+    double bytes_per_op = 0;  // 非 0 时额外输出 MB/s
+    uint64_t dropped = 0;
+};
+
+struct Options {
+    std::string filter;
+    std::string out;
+    int min_time_ms = 1000;
+    bool list = false;
+};
+
+// 阻止编译器把结果当成无用计算删掉
+template <typename T>
+inline void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+double percentile(std::vector<double> v, double q) {
+    if (v.empty()) return 0;
+    const size_t i = std::min(v.size() - 1, size_t(q * double(v.size() - 1) + 0.5));
+    std::nth_element(v.begin(), v.begin() + ptrdiff_t(i), v.end());
+    return v[i];
+}
+
+double elapsed_ns(Clock::time_point since) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - since).count();
+}
+
+// 先估计单次耗时，按 kSampleNs 定批大小，预热一批后采样到 min_time_ms
+Result measure(const std::string& name, double bytes_per_op, int min_time_ms, const std::function<void()>& op) {
+    auto t = Clock::now();
+    op();
+    const double first = std::max(1.0, elapsed_ns(t));
+    const uint64_t batch = std::max<uint64_t>(1, uint64_t(kSampleNs / first));
+    for (uint64_t i = 0; i < batch; ++i) op();
+
+    Result r;
+    r.name = name;
+    r.bytes_per_op = bytes_per_op;
+    std::vector<double> samples;
+    double total = 0;
+    const double budget = double(min_time_ms) * 1e6;
+    while (total < budget || samples.size() < 10) {
+        t = Clock::now();
+        for (uint64_t i = 0; i < batch; ++i) op();
+        const double ns = elapsed_ns(t);
+        total += ns;
+        r.iterations += batch;
+        samples.push_back(ns / double(batch));
+    }
+    r.ns_per_op = total / double(r.iterations);
+    r.p50_ns = percentile(samples, 0.5);
+    r.p99_ns = percentile(samples, 0.99);
+    return r;
+}
+
+// ---------------- YOLO 解码 + NMS ----------------
+
+// 两个输出头（416 输入的 13x13 与 26x26，各 3 个 anchor），80 类；
+// 约 1% 的行过阈值，且成簇分布，NMS 有真实的重叠可以抑制
+struct YoloInput {
+    std::vector<float> data[2];
+    roi::YoloHead heads[2];
+
+    explicit YoloInput(int classes) {
+        std::mt19937 rng(kSeed);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        const int stride = 5 + classes;
+        const int grids[2] = {13, 26};
+        for (int h = 0; h < 2; ++h) {
+            const int rows = grids[h] * grids[h] * 3;
+            data[h].assign(size_t(rows) * stride, 0.0f);
+            for (int r = 0; r < rows; ++r) {
+                float* row = &data[h][size_t(r) * stride];
+                row[4] = unit(rng) * 0.3f;
+                if (unit(rng) < 0.01f) {
+                    const float cx = 0.2f + 0.6f * float(r % 7) / 7.0f;
+                    row[0] = cx + unit(rng) * 0.02f;
+                    row[1] = 0.5f + unit(rng) * 0.02f;
+                    row[2] = 0.1f + unit(rng) * 0.02f;
+                    row[3] = 0.2f + unit(rng) * 0.02f;
+                    row[4] = 0.6f + unit(rng) * 0.4f;
+                    row[5 + r % classes] = row[4] * (0.7f + unit(rng) * 0.3f);
+                }
+            }
+            heads[h].data = data[h].data();
+            heads[h].rows = rows;
+            heads[h].stride = stride;
+        }
+    }
+};
+
+std::vector<roi::Detection> random_boxes(int count) {
+    std::mt19937 rng(kSeed);
+    std::uniform_real_distribution<float> pos(0.0f, 1800.0f);
+    std::uniform_real_distribution<float> size(20.0f, 200.0f);
+    std::uniform_real_distribution<float> conf(0.3f, 1.0f);
+    std::vector<roi::Detection> boxes(static_cast<size_t>(count));
+    for (auto& d : boxes) {
+        d.x = pos(rng) * 0.2f + 800.0f;  // 挤在画面中间，互相重叠
+        d.y = pos(rng) * 0.1f + 400.0f;
+        d.w = size(rng);
+        d.h = size(rng);
+        d.confidence = conf(rng);
+        d.class_id = int(rng() % 4);
+    }
+    return boxes;
+}
+
+// ---------------- 预处理 ----------------
+
+struct Nv12Frame {
+    int width;
+    int height;
+    std::vector<uint8_t> y;
+    std::vector<uint8_t> uv;
+
+    Nv12Frame(int w, int h) : width(w), height(h), y(size_t(w) * h), uv(size_t(w) * h / 2) {
+        std::mt19937 rng(kSeed);
+        for (auto& v : y) v = uint8_t(rng());
+        for (auto& v : uv) v = uint8_t(rng());
+    }
+};
+
+// ---------------- FLV 封装 ----------------
+
+// 一个 H.264 关键帧 AU：AUD + SPS + PPS + 4 个 IDR slice，共约 size 字节
+std::vector<uint8_t> make_h264_au(size_t size) {
+    std::mt19937 rng(kSeed);
+    std::vector<uint8_t> au;
+    auto nal = [&](std::initializer_list<uint8_t> head, size_t payload) {
+        au.insert(au.end(), {0, 0, 0, 1});
+        au.insert(au.end(), head);
+        for (size_t i = 0; i < payload; ++i) {
+            uint8_t b = uint8_t(rng());
+            // 避开起始码仿真：载荷里不出现连续的两个 0
+            if (b == 0) b = 1;
+            au.push_back(b);
+        }
+    };
+    nal({0x09, 0xf0}, 0);
+    nal({0x67, 0x64, 0x00, 0x28}, 12);
+    nal({0x68, 0xee}, 2);
+    for (int i = 0; i < 4; ++i) nal({0x65, 0x88}, size / 4);
+    return au;
+}
+
+size_t flv_mux(const std::vector<uint8_t>& au, roi::ParamSets* ps, std::vector<std::pair<const uint8_t*, size_t>>* nals,
+               uint8_t* tag) {
+    roi::collect_param_sets(roi::Codec::kH264, au.data(), au.size(), ps);
+    nals->clear();
+    roi::for_each_nal(au.data(), au.size(), [&](const uint8_t* nal, size_t len) {
+        if (!roi::flv_skip_nal(roi::Codec::kH264, nal[0])) nals->emplace_back(nal, len);
+    });
+    size_t body = roi::flv_video_header(roi::Codec::kH264, roi::HevcFlvMode::kEnhanced, true, false, 0, tag);
+    for (const auto& n : *nals) body += 4 + n.second;
+    return body;
+}
+
+// ---------------- AU 环形缓冲区 ----------------
+
+// 生产者线程写入、消费者线程读出并释放；环满时生产者让出 CPU 而不是丢帧
+Result ring_throughput(int min_time_ms) {
+    constexpr uint32_t kSlots = 256;
+    constexpr size_t kChunk = 1400;  // 按 RTP 载荷大小分片追加
+    roi::AuRing ring(8u << 20, kSlots);
+    const int consumer = ring.add_consumer();
+    std::mt19937 rng(kSeed);
+    std::vector<uint32_t> sizes(1024);
+    for (auto& s : sizes) s = 2000 + rng() % 30000;
+    std::vector<uint8_t> payload(32768, 0x5a);
+
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> consumed{0};
+    std::thread reader([&] {
+        roi::AccessUnitView au;
+        uint64_t sum = 0;
+        while (!done.load(std::memory_order_relaxed) || ring.peek(consumer, &au)) {
+            if (!ring.wait(consumer, &au, std::chrono::milliseconds(10))) continue;
+            sum += au.data[au.size - 1];
+            ring.release(consumer);
+            consumed.fetch_add(1, std::memory_order_relaxed);
+        }
+        keep(sum);
+    });
+
+    Result r;
+    r.name = "au_ring/handoff_17k";
+    std::vector<double> samples;
+    uint64_t bytes = 0;
+    const auto start = Clock::now();
+    const double budget = double(min_time_ms) * 1e6;
+    constexpr uint64_t kPerSample = 256;
+    while (elapsed_ns(start) < budget || samples.size() < 10) {
+        const auto t = Clock::now();
+        for (uint64_t i = 0; i < kPerSample; ++i) {
+            while (ring.stats().slots_used >= kSlots - 1) std::this_thread::yield();
+            const uint32_t size = sizes[r.iterations % sizes.size()];
+            ring.begin(roi::Codec::kH264);
+            for (size_t off = 0; off < size; off += kChunk) ring.append(payload.data(), std::min<size_t>(kChunk, size - off));
+            if (!ring.commit(int64_t(r.iterations) * 3600, roi::kAuKeyFrame)) ++r.dropped;
+            bytes += size;
+            ++r.iterations;
+        }
+        samples.push_back(elapsed_ns(t) / double(kPerSample));
+    }
+    while (consumed.load() + r.dropped < r.iterations) std::this_thread::yield();
+    const double total = elapsed_ns(start);
+    done.store(true);
+    ring.wake_all();
+    reader.join();
+    r.ns_per_op = total / double(r.iterations);
+    r.p50_ns = percentile(samples, 0.5);
+    r.p99_ns = percentile(samples, 0.99);
+    r.bytes_per_op = double(bytes) / double(r.iterations);
+    return r;
+}
+
+// ---------------- 主程序 ----------------
+
+struct Case {
+    const char* name;
+    std::function<Result(const Options&)> run;
+};
+
+std::vector<Case> cases() {
+    std::vector<Case> out;
+    out.push_back({"yolo_decode_nms/416x80", [](const Options& o) {
+                       YoloInput in(80);
+                       roi::YoloDecodeParams p;
+                       p.width = 1920;
+                       p.height = 1080;
+                       std::vector<roi::Detection> dets;
+                       return measure("yolo_decode_nms/416x80", 0, o.min_time_ms, [&] {
+                           roi::yolo_decode(in.heads, 2, p, &dets);
+                           keep(dets.size());
+                       });
+                   }});
+    out.push_back({"nms/200", [](const Options& o) {
+                       const std::vector<roi::Detection> boxes = random_boxes(200);
+                       std::vector<roi::Detection> work;
+                       return measure("nms/200", 0, o.min_time_ms, [&] {
+                           work = boxes;
+                           roi::nms(&work, 0.4f, false);
+                           keep(work.size());
+                       });
+                   }});
+    for (const bool int8 : {false, true}) {
+        const char* name = int8 ? "preprocess_nv12/1080p_416_i8" : "preprocess_nv12/1080p_416_f32";
+        out.push_back({name, [name, int8](const Options& o) {
+                           const Nv12Frame f(1920, 1080);
+                           roi::PreprocessConfig cfg;
+                           cfg.int8 = int8;
+                           roi::Preprocessor pre(cfg);
+                           return measure(name, double(f.y.size() + f.uv.size()), o.min_time_ms, [&] {
+                               keep(pre.run_nv12(0, f.y.data(), f.uv.data(), f.width, f.height, f.width, f.width));
+                           });
+                       }});
+    }
+    out.push_back({"scale_nv12/1080p_to_720p", [](const Options& o) {
+                       const Nv12Frame f(1920, 1080);
+                       roi::Surface src;
+                       src.width = f.width;
+                       src.height = f.height;
+                       src.data[0] = const_cast<uint8_t*>(f.y.data());
+                       src.data[1] = const_cast<uint8_t*>(f.uv.data());
+                       src.pitch[0] = src.pitch[1] = f.width;
+                       roi::SurfaceScaler scaler(1280, 720, 2);
+                       roi::SurfacePtr out;
+                       std::string err;
+                       return measure("scale_nv12/1080p_to_720p", double(f.y.size() + f.uv.size()), o.min_time_ms,
+                                      [&] {
+                                          scaler.scale(src, &out, &err);
+                                          out.reset();
+                                      });
+                   }});
+    out.push_back({"preprocess_bgr/720p_416_letterbox", [](const Options& o) {
+                       std::vector<uint8_t> bgr(size_t(1280) * 720 * 3);
+                       std::mt19937 rng(kSeed);
+                       for (auto& v : bgr) v = uint8_t(rng());
+                       roi::PreprocessConfig cfg;
+                       cfg.letterbox = true;
+                       roi::Preprocessor pre(cfg);
+                       return measure("preprocess_bgr/720p_416_letterbox", double(bgr.size()), o.min_time_ms, [&] {
+                           keep(pre.run_bgr(0, bgr.data(), 1280, 720, 1280 * 3));
+                       });
+                   }});
+    out.push_back({"qp_map_update/1080p_8rois_moving", [](const Options& o) {
+                       roi::QpMap map(1920, 1080, 16, 6);
+                       std::vector<roi::RoiBox> boxes(8);
+                       uint32_t frame = 0;
+                       return measure("qp_map_update/1080p_8rois_moving", 0, o.min_time_ms, [&] {
+                           // 每帧平移几个像素，和真实跟踪框一样只有边缘的块改变归属
+                           for (size_t i = 0; i < boxes.size(); ++i) {
+                               boxes[i].x = float(100 + 220 * i + (frame * 3) % 64);
+                               boxes[i].y = float(200 + 60 * (i % 4) + (frame * 2) % 48);
+                               boxes[i].w = 160;
+                               boxes[i].h = 320;
+                           }
+                           ++frame;
+                           keep(map.update(boxes.data(), int(boxes.size())));
+                       });
+                   }});
+    out.push_back({"qp_map_update/1080p_8rois_static", [](const Options& o) {
+                       roi::QpMap map(1920, 1080, 16, 6);
+                       std::vector<roi::RoiBox> boxes(8);
+                       for (size_t i = 0; i < boxes.size(); ++i) {
+                           boxes[i].x = float(100 + 220 * i);
+                           boxes[i].y = 300;
+                           boxes[i].w = 160;
+                           boxes[i].h = 320;
+                       }
+                       return measure("qp_map_update/1080p_8rois_static", 0, o.min_time_ms,
+                                      [&] { keep(map.update(boxes.data(), int(boxes.size()))); });
+                   }});
+    out.push_back({"flv_mux/h264_key_64k", [](const Options& o) {
+                       const std::vector<uint8_t> au = make_h264_au(64 * 1024);
+                       roi::ParamSets ps;
+                       std::vector<std::pair<const uint8_t*, size_t>> nals;
+                       uint8_t tag[roi::kFlvVideoHeaderMax];
+                       return measure("flv_mux/h264_key_64k", double(au.size()), o.min_time_ms,
+                                      [&] { keep(flv_mux(au, &ps, &nals, tag)); });
+                   }});
+    out.push_back({"au_ring/handoff_17k", [](const Options& o) { return ring_throughput(o.min_time_ms); }});
+    return out;
+}
+
+std::string json_escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+void write_json(FILE* f, const std::vector<Result>& results, const Options& o) {
+    utsname u{};
+    uname(&u);
+    std::fprintf(f, "{\n  \"schema\": 1,\n  \"bench\": \"micro\",\n");
+    std::fprintf(f, "  \"host\": \"%s\",\n  \"machine\": \"%s\",\n  \"cpus\": %u,\n", json_escape(u.nodename).c_str(),
+                 json_escape(u.machine).c_str(), std::thread::hardware_concurrency());
+    std::fprintf(f, "  \"compiler\": \"%s\",\n  \"min_time_ms\": %d,\n  \"results\": [\n", json_escape(__VERSION__).c_str(),
+                 o.min_time_ms);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        std::fprintf(f,
+                     "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.1f, \"p50_ns\": %.1f, "
+                     "\"p99_ns\": %.1f",
+                     json_escape(r.name).c_str(), (unsigned long long)r.iterations, r.ns_per_op, r.p50_ns, r.p99_ns);
+        if (r.bytes_per_op > 0) std::fprintf(f, ", \"mb_per_s\": %.1f", r.bytes_per_op / r.ns_per_op * 1e3);
+        if (r.dropped) std::fprintf(f, ", \"dropped\": %llu", (unsigned long long)r.dropped);
+        std::fprintf(f, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(f, "  ]\n}\n");
+}
+
+bool parse(int argc, char** argv, Options* o) {
+    for (int i = 1; i < argc; ++i) {
+        const bool more = i + 1 < argc;
+        if (std::strcmp(argv[i], "--filter") == 0 && more) {
+            o->filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--min-time") == 0 && more) {
+            o->min_time_ms = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--out") == 0 && more) {
+            o->out = argv[++i];
+        } else if (std::strcmp(argv[i], "--list") == 0) {
+            o->list = true;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options o;
+    if (!parse(argc, argv, &o)) {
+        std::fprintf(stderr, "usage: %s [--filter <substring>] [--min-time <ms>] [--out <file.json>] [--list]\n",
+                     argv[0]);
+        return 2;
+    }
+    std::vector<Result> results;
+    for (const Case& c : cases()) {
+        if (!o.filter.empty() && std::strstr(c.name, o.filter.c_str()) == nullptr) continue;
+        if (o.list) {
+            std::printf("%s\n", c.name);
+            continue;
+        }
+        results.push_back(c.run(o));
+        const Result& r = results.back();
+        std::fprintf(stderr, "%-36s %12.1f ns/op  p50 %10.1f  p99 %10.1f", r.name.c_str(), r.ns_per_op, r.p50_ns,
+                     r.p99_ns);
+        if (r.bytes_per_op > 0) std::fprintf(stderr, "  %8.1f MB/s", r.bytes_per_op / r.ns_per_op * 1e3);
+        std::fprintf(stderr, "\n");
+    }
+    if (o.list) return 0;
+    FILE* f = o.out.empty() ? stdout : std::fopen(o.out.c_str(), "w");
+    if (!f) {
+        std::perror(o.out.c_str());
+        return 1;
+    }
+    write_json(f, results, o);
+    if (f != stdout) std::fclose(f);
+    return 0;
+}
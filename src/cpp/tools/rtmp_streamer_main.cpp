@@ -0,0 +1,80 @@
+// 转推工具：rtmp_streamer <rtsp-url> <rtmp-url> [seconds]
+// 把 RTSP 收到的访问单元原样推到 RTMP（不重新编码），用来单独测量收流与推流两段的开销。
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "../rtmp/rtmp_streamer.h"
+#include "../rtsp/rtsp_client.h"
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::fprintf(stderr, "usage: %s <rtsp-url> <rtmp-url> [seconds]\n", argv[0]);
+        return 2;
+    }
+    const int seconds = argc > 3 ? std::atoi(argv[3]) : 0;
+
+    roi::RtspConfig in_cfg;
+    in_cfg.url = argv[1];
+    roi::RtspClient client(in_cfg);
+    if (!client.start()) {
+        std::fprintf(stderr, "rtsp: %s\n", client.last_error().c_str());
+        return 1;
+    }
+    roi::RtmpConfig out_cfg;
+    out_cfg.url = argv[2];
+    out_cfg.codec = client.codec();
+    out_cfg.width = client.width_hint();
+    out_cfg.height = client.height_hint();
+    roi::RtmpStreamer streamer(out_cfg);
+    if (!streamer.start()) {
+        std::fprintf(stderr, "rtmp: %s\n", streamer.last_error().c_str());
+        return 1;
+    }
+
+    const int consumer = client.ring().add_consumer();
+    const auto start = std::chrono::steady_clock::now();
+    auto last_report = start;
+    while (client.state() == roi::RtspClient::State::kPlaying &&
+           streamer.state() == roi::RtmpStreamer::State::kPublishing) {
+        roi::AccessUnitView au;
+        if (client.ring().wait(consumer, &au, std::chrono::milliseconds(200))) {
+            // 环形缓冲区的槽位要按顺序归还，推流队列需要自己持有一份数据
+            auto buf = std::make_shared<std::vector<uint8_t>>(au.data, au.data + au.size);
+            roi::EncodedPacket pkt;
+            pkt.data = buf->data();
+            pkt.size = buf->size();
+            pkt.pts = pkt.dts = au.pts;
+            pkt.key = (au.flags & roi::kAuKeyFrame) != 0;
+            pkt.codec = au.codec;
+            pkt.owner = std::move(buf);
+            client.ring().release(consumer);
+            streamer.send(pkt);
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (now - last_report >= std::chrono::seconds(1)) {
+            const roi::RtmpStats st = streamer.stats();
+            std::printf("sent %llu frames %llu bytes  queued %llu  dropped %llu/%llu (nonref/ref)\n",
+                        (unsigned long long)st.sent_frames, (unsigned long long)st.sent_bytes,
+                        (unsigned long long)st.queued_frames, (unsigned long long)st.dropped_nonref,
+                        (unsigned long long)st.dropped_ref);
+            last_report = now;
+        }
+        if (seconds > 0 && now - start >= std::chrono::seconds(seconds)) break;
+    }
+    int rc = 0;
+    if (client.state() == roi::RtspClient::State::kError) {
+        std::fprintf(stderr, "rtsp: %s\n", client.last_error().c_str());
+        rc = 1;
+    }
+    if (streamer.state() == roi::RtmpStreamer::State::kError) {
+        std::fprintf(stderr, "rtmp: %s\n", streamer.last_error().c_str());
+        rc = 1;
+    }
+    streamer.stop();
+    client.stop();
+    return rc;
+}
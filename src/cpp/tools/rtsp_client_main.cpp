@@ -0,0 +1,99 @@
+// 拉流诊断工具：rtsp_client <rtsp-url> [seconds] [tcp|udp] [capture.au]
+// 每秒打印一次接收码率、RTP 丢包和 AU 统计，用来在 SE5 上评估原生收流路径。
+//
+// 给出 capture.au 时把收到的 AU 从第一个关键帧起录下来，供 src/python/bench 的端到端回放使用。
+// 文件格式（小端）：8 字节头 "ROIAU01" + 编码（1 = H.264，2 = H.265），之后每个 AU 为
+// u32 size、u32 flags、i64 pts（90kHz）、i64 arrival_us（相对第一个 AU 的到达时刻）和 size 字节的 Annex-B 码流。
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../rtsp/rtsp_client.h"
+
+namespace {
+
+bool write_au(FILE* f, const roi::AccessUnitView& au, int64_t arrival_us) {
+    const uint32_t head[2] = {au.size, au.flags};
+    const int64_t times[2] = {au.pts, arrival_us};
+    return std::fwrite(head, sizeof(head), 1, f) == 1 && std::fwrite(times, sizeof(times), 1, f) == 1 &&
+           std::fwrite(au.data, 1, au.size, f) == au.size;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <rtsp-url> [seconds] [tcp|udp] [capture.au]\n", argv[0]);
+        return 2;
+    }
+    roi::RtspConfig cfg;
+    cfg.url = argv[1];
+    const int seconds = argc > 2 ? std::atoi(argv[2]) : 10;
+    if (argc > 3 && std::strcmp(argv[3], "udp") == 0) cfg.transport = roi::RtspTransport::kUdp;
+
+    roi::RtspClient client(cfg);
+    if (!client.start()) {
+        std::fprintf(stderr, "rtsp: %s\n", client.last_error().c_str());
+        return 1;
+    }
+    const int consumer = client.ring().add_consumer();
+    std::printf("codec %s  %dx%d\n", client.codec() == roi::Codec::kH265 ? "h265" : "h264", client.width_hint(),
+                client.height_hint());
+    FILE* capture = nullptr;
+    if (argc > 4) {
+        capture = std::fopen(argv[4], "wb");
+        char header[8] = {'R', 'O', 'I', 'A', 'U', '0', '1', char(client.codec())};
+        if (!capture || std::fwrite(header, sizeof(header), 1, capture) != 1) {
+            std::perror(argv[4]);
+            client.stop();
+            return 1;
+        }
+    }
+    int64_t first_arrival = -1;
+    uint64_t recorded = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    auto last_report = start;
+    uint64_t aus = 0, keys = 0, bytes = 0;
+    while (client.state() == roi::RtspClient::State::kPlaying) {
+        roi::AccessUnitView au;
+        if (client.ring().wait(consumer, &au, std::chrono::milliseconds(200))) {
+            ++aus;
+            bytes += au.size;
+            if (au.flags & roi::kAuKeyFrame) ++keys;
+            if (capture && (first_arrival >= 0 || (au.flags & roi::kAuKeyFrame))) {
+                if (first_arrival < 0) first_arrival = au.arrival_us;
+                if (!write_au(capture, au, au.arrival_us - first_arrival)) {
+                    std::perror(argv[4]);
+                    std::fclose(capture);
+                    capture = nullptr;
+                } else {
+                    ++recorded;
+                }
+            }
+            client.ring().release(consumer);
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (now - last_report >= std::chrono::seconds(1)) {
+            const double dt = std::chrono::duration<double>(now - last_report).count();
+            const roi::RtspStats st = client.stats();
+            std::printf("%6.1f fps  %8.1f kbps  key %llu  rtp %llu (%llu reads)  lost %llu  ring %u/%llu dropped\n",
+                        aus / dt, bytes * 8 / dt / 1000, (unsigned long long)keys, (unsigned long long)st.packets,
+                        (unsigned long long)st.reads, (unsigned long long)st.lost, st.ring.slots_used,
+                        (unsigned long long)st.ring.dropped);
+            aus = keys = bytes = 0;
+            last_report = now;
+        }
+        if (seconds > 0 && now - start >= std::chrono::seconds(seconds)) break;
+    }
+    const bool failed = client.state() == roi::RtspClient::State::kError;
+    if (failed) std::fprintf(stderr, "rtsp: %s\n", client.last_error().c_str());
+    if (capture) {
+        std::fclose(capture);
+        std::printf("recorded %llu access units to %s\n", (unsigned long long)recorded, argv[4]);
+    }
+    client.stop();
+    return failed ? 1 : 0;
+}
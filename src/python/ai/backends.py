@@ -0,0 +1,332 @@
+import logging
+import os
+
+import cv2
+import numpy as np
+
+from src.python.ai.models import ModelError, check_darknet_weights
+from src.python.ai.preprocess import NativePreprocessor
+from src.python.native import lib as native
+
+log = logging.getLogger(__name__)
+
+# cv2.dnn 的 backend / target 名称
+_CV_BACKENDS = {
+    'default': cv2.dnn.DNN_BACKEND_DEFAULT,
+    'opencv': cv2.dnn.DNN_BACKEND_OPENCV,
+}
+_CV_TARGETS = {
+    'cpu': cv2.dnn.DNN_TARGET_CPU,
+    'opencl': cv2.dnn.DNN_TARGET_OPENCL,
+    'opencl_fp16': cv2.dnn.DNN_TARGET_OPENCL_FP16,
+}
+
+
+def parse_darknet_cfg(path):
+    """读出 cfg 中推理需要的部分：输入尺寸和各 [yolo] 层的 anchors / mask / classes"""
+    net = {}
+    yolo = []
+    section = None
+    current = None
+    with open(path, 'r') as f:
+        for line in f:
+            line = line.split('#', 1)[0].strip()
+            if not line:
+                continue
+            if line.startswith('['):
+                section = line.strip('[]').strip()
+                current = {} if section == 'yolo' else None
+                if current is not None:
+                    yolo.append(current)
+                continue
+            key, _, value = line.partition('=')
+            key, value = key.strip(), value.strip()
+            if section == 'net':
+                net[key] = value
+            elif current is not None:
+                current[key] = value
+    layers = []
+    for layer in yolo:
+        anchors = [float(v) for v in layer['anchors'].split(',') if v.strip()]
+        anchors = list(zip(anchors[0::2], anchors[1::2]))
+        mask = [int(v) for v in layer.get('mask', '').split(',') if v.strip()] or list(range(len(anchors)))
+        layers.append({'anchors': [anchors[i] for i in mask], 'classes': int(layer.get('classes', 80))})
+    return int(net.get('width', 416)), int(net.get('height', 416)), layers
+
+
+class _Backend:
+    """后端公共部分：原生库可用时用融合预处理直接写输入张量
+
+    frames 中的每一项可以是 BGR ndarray，也可以是 decoder.DecodedFrame（仅在原生预处理可用时）。
+    forward() 之后 letterbox 是每帧的 (scale_x, scale_y, pad_x, pad_y)，用于把框换算回原图；
+    不做 letterbox 时为 None，输出坐标直接按原图尺寸归一化。
+    """
+
+    letterbox_enabled = False
+
+    def _init_preprocess(self, letterbox, int8=False, int8_scale=127.0):
+        self.letterbox_enabled = letterbox
+        self._int8 = int8
+        self._int8_scale = int8_scale
+        self._pre = None
+        self.letterbox = []
+        self.native_preprocess = native.load() is not None
+
+    def _preprocess(self, frames, batch=None):
+        """把 frames 写进预分配的输入张量，返回 (N, 3, H, W) 视图；batch 固定时按 batch 分配"""
+        n = len(frames)
+        size = max(n, batch or 0)
+        if self._pre is None or self._pre.batch < size:
+            if self._pre is not None:
+                self._pre.close()
+            w, h = self.input_size
+            self._pre = NativePreprocessor(w, h, size, letterbox=self.letterbox_enabled, int8=self._int8,
+                                           int8_scale=self._int8_scale)
+        infos = [self._pre.run(i, frame) for i, frame in enumerate(frames)]
+        self.letterbox = infos if self.letterbox_enabled else [None] * n
+        return self._pre.tensor[:batch or n]
+
+
+class OpenCvBackend(_Backend):
+    """cv2.dnn 读取 Darknet 模型，默认在 CPU 上运行；没有 TPU 时的回退路径"""
+
+    name = 'opencv'
+
+    def __init__(self, model_weights, model_cfg, input_size=(416, 416), dnn_backend='default', dnn_target='cpu',
+                 letterbox=False, cache=None):
+        if cache is None:
+            # readNetFromDarknet 读到不匹配的权重时常常不报错，先核对权重与 cfg
+            check_darknet_weights(model_cfg, model_weights)
+            self.net = cv2.dnn.readNetFromDarknet(model_cfg, model_weights)
+        else:
+            # 缓存项在建立时已经核对过；权重从内存映射直接交给 OpenCV
+            entry = cache.entry(model_cfg, model_weights)
+            if dnn_target.startswith('opencl'):
+                cache.enable_opencl()
+            self.net = cv2.dnn.readNetFromDarknet(np.frombuffer(entry.cfg_bytes(), dtype=np.uint8),
+                                                  np.frombuffer(entry.weights(), dtype=np.uint8))
+        self.net.setPreferableBackend(_CV_BACKENDS[dnn_backend])
+        self.net.setPreferableTarget(_CV_TARGETS[dnn_target])
+        self.input_size = input_size
+        names = self.net.getLayerNames()
+        # 不同版本的 OpenCV 返回 (N, 1) 或 (N,)，统一展平
+        self.output_layers = [names[i - 1] for i in np.array(self.net.getUnconnectedOutLayers()).flatten()]
+        self._init_preprocess(letterbox)
+        if letterbox and not self.native_preprocess:
+            raise RuntimeError('letterbox preprocessing needs the native pipeline library')
+
+    def forward(self, frames):
+        """返回每个 YOLO 层的输出 (N, rows, 5 + classes)：归一化的 cx, cy, w, h、目标置信度、各类得分"""
+        if self.native_preprocess:
+            blob = self._preprocess(frames)
+        else:
+            blob = cv2.dnn.blobFromImages(frames, 1/255.0, self.input_size, (0, 0, 0), True, crop=False)
+            self.letterbox = [None] * len(frames)
+        self.net.setInput(blob)
+        outs = self.net.forward(self.output_layers)
+        # 批大小为 1 时每层输出是 (rows, C)，大于 1 时是 (N, rows, C)，统一成后者
+        n = len(frames)
+        return [out.reshape(n, -1, out.shape[-1]) for out in outs]
+
+
+def _sigmoid(x):
+    return 1.0 / (1.0 + np.exp(-x))
+
+
+class SailBackend(_Backend):
+    """SE5 TPU 后端：用 sophon.sail 运行 bmnetd 编译的同一网络（INT8 或 FP16 bmodel）
+
+    bmodel 的批大小在编译时固定，帧数不足时补零、超出时分多次运行。
+    编译时保留了 yolo 层的模型直接输出 (N, rows, 5 + classes)；只编译到最后一层卷积的模型
+    输出 (N, A * (5 + classes), H, W)，这里按 cfg 中的 anchors 解码成同样的格式，
+    下游的阈值、NMS 与 cv2.dnn 路径完全一致。
+    """
+
+    name = 'sail'
+
+    def __init__(self, bmodel, model_cfg, device_index=0, letterbox=False):
+        import sophon.sail as sail
+
+        self.sail = sail
+        self.engine = sail.Engine(bmodel, device_index, sail.IOMode.SYSIO)
+        self.graph = self.engine.get_graph_names()[0]
+        self.input_name = self.engine.get_input_names(self.graph)[0]
+        self.output_names = self.engine.get_output_names(self.graph)
+        shape = self.engine.get_input_shape(self.graph, self.input_name)
+        self.batch, _, self.net_h, self.net_w = (int(v) for v in shape)
+        self.input_size = (self.net_w, self.net_h)
+        self.input_int8 = self.engine.get_input_dtype(self.graph, self.input_name) in (sail.Dtype.BM_INT8,
+                                                                                      sail.Dtype.BM_UINT8)
+        self.input_scale = float(self.engine.get_input_scale(self.graph, self.input_name))
+        self.output_scales = [float(self.engine.get_output_scale(self.graph, name)) for name in self.output_names]
+        _, _, self.yolo_layers = parse_darknet_cfg(model_cfg)
+        self._check_outputs(bmodel, model_cfg)
+        self._init_preprocess(letterbox, self.input_int8, self.input_scale)
+        log.info('bmodel %s: batch=%d input=%dx%d %s', bmodel, self.batch, self.net_w, self.net_h,
+                 'int8' if self.input_int8 else 'fp32')
+
+    def _check_outputs(self, bmodel, model_cfg):
+        """bmodel 的输出要能和 cfg 的 [yolo] 层一一对应，否则解码出来的框没有意义"""
+        if len(self.output_names) != len(self.yolo_layers):
+            raise ModelError('%s has %d outputs but %s has %d [yolo] layers' % (bmodel, len(self.output_names),
+                                                                                 model_cfg, len(self.yolo_layers)))
+        for name in self.output_names:
+            shape = [int(v) for v in self.engine.get_output_shape(self.graph, name)]
+            rows = [5 + layer['classes'] for layer in self.yolo_layers]
+            if len(shape) == 3:
+                ok = shape[-1] in rows
+            else:
+                ok = any(shape[1] == len(layer['anchors']) * r for layer, r in zip(self.yolo_layers, rows))
+            if not ok:
+                raise ModelError('%s output %s has shape %s, which does not match the heads in %s'
+                                 % (bmodel, name, shape, model_cfg))
+
+    def _input(self, frames):
+        if self.native_preprocess:
+            # 融合预处理直接输出 bmodel 要求的 float32 或 int8 张量，补齐到编译时的批大小
+            return self._preprocess(frames, self.batch)
+        data = np.zeros((self.batch, 3, self.net_h, self.net_w), dtype=np.float32)
+        for i, frame in enumerate(frames):
+            if hasattr(frame, 'handle'):
+                frame = frame.to_bgr()
+            resized = cv2.resize(frame, self.input_size, interpolation=cv2.INTER_LINEAR)
+            rgb = cv2.cvtColor(resized, cv2.COLOR_BGR2RGB)
+            data[i] = rgb.transpose(2, 0, 1) * (1 / 255.0)
+        if self.input_int8:
+            data = np.clip(np.round(data * self.input_scale), -128, 127).astype(np.int8)
+        self.letterbox = [None] * len(frames)
+        return data
+
+    def forward(self, frames):
+        results = None
+        letterbox = []
+        for start in range(0, len(frames), self.batch):
+            chunk = frames[start:start + self.batch]
+            outputs = self.engine.process(self.graph, {self.input_name: self._input(chunk)})
+            letterbox.extend(self.letterbox)
+            outs = []
+            for name, scale in zip(self.output_names, self.output_scales):
+                out = outputs[name]
+                if out.dtype != np.float32 or scale != 1.0:
+                    out = out.astype(np.float32) * scale
+                outs.append(out[:len(chunk)])
+            outs = self._decode_heads(outs)
+            results = outs if results is None else [np.concatenate(pair) for pair in zip(results, outs)]
+        self.letterbox = letterbox
+        return results
+
+    def _decode_heads(self, outs):
+        if all(out.ndim == 3 for out in outs):
+            return outs
+        # 原始卷积输出按网格从粗到细排列，与 cfg 中 [yolo] 层的顺序一致
+        outs = sorted(outs, key=lambda out: out.shape[-1])
+        decoded = []
+        for out, layer in zip(outs, self.yolo_layers):
+            n, _, gh, gw = out.shape
+            anchors = np.array(layer['anchors'], dtype=np.float32)
+            a = len(anchors)
+            p = out.reshape(n, a, 5 + layer['classes'], gh, gw).transpose(0, 3, 4, 1, 2)
+            gx = np.arange(gw, dtype=np.float32).reshape(1, 1, gw, 1)
+            gy = np.arange(gh, dtype=np.float32).reshape(1, gh, 1, 1)
+            rows = np.empty_like(p)
+            rows[..., 0] = (_sigmoid(p[..., 0]) + gx) / gw
+            rows[..., 1] = (_sigmoid(p[..., 1]) + gy) / gh
+            rows[..., 2] = np.exp(p[..., 2]) * anchors[:, 0] / self.net_w
+            rows[..., 3] = np.exp(p[..., 3]) * anchors[:, 1] / self.net_h
+            rows[..., 4] = _sigmoid(p[..., 4])
+            # 与 cv2.dnn 的 region 层一致：类别得分乘上目标置信度
+            rows[..., 5:] = _sigmoid(p[..., 5:]) * rows[..., 4:5]
+            decoded.append(rows.reshape(n, -1, rows.shape[-1]))
+        return decoded
+
+
+class MultiSizeBackend:
+    """同一网络按几种输入尺寸各建一份，运行时用 select() 切换，不重新加载模型
+
+    cv2.dnn 的 Darknet 网络虽然能接受任意 32 倍数的输入，但输入形状一变就要重新分配
+    每层的缓冲，在尺寸间来回切换时代价接近重新加载；所以每个尺寸各持有一个已经
+    完成分配的网络和预处理张量。TPU 上 bmodel 的输入形状在编译时固定，每个尺寸各编译一个。
+    """
+
+    def __init__(self, backends):
+        # backends: {(w, h): backend}，按面积从小到大排列
+        self.backends = dict(sorted(backends.items(), key=lambda item: item[0][0] * item[0][1]))
+        self.sizes = list(self.backends)
+        self.current = self.backends[self.sizes[len(self.sizes) // 2]]
+
+    @property
+    def name(self):
+        return self.current.name
+
+    @property
+    def input_size(self):
+        return self.current.input_size
+
+    @property
+    def native_preprocess(self):
+        return self.current.native_preprocess
+
+    @property
+    def letterbox(self):
+        return self.current.letterbox
+
+    def select(self, size):
+        """切换到 size=(w, h) 的网络；没有这个尺寸时取面积最接近的一个"""
+        if size not in self.backends:
+            area = size[0] * size[1]
+            size = min(self.sizes, key=lambda s: abs(s[0] * s[1] - area))
+        self.current = self.backends[size]
+        return size
+
+    def forward(self, frames):
+        return self.current.forward(frames)
+
+
+def _create_one(kind, model_weights, model_cfg, bmodel, device_index, input_size, dnn_target, letterbox, cache):
+    if kind in ('auto', 'sail') and bmodel:
+        try:
+            return SailBackend(bmodel, model_cfg, device_index, letterbox)
+        except ImportError:
+            if kind == 'sail':
+                raise RuntimeError('sophon.sail is not installed, cannot load %s' % bmodel)
+            log.warning('sophon.sail not available, falling back to cv2.dnn on %s', dnn_target)
+    elif kind == 'sail':
+        raise ValueError('sail backend needs a bmodel path')
+    return OpenCvBackend(model_weights, model_cfg, input_size, dnn_target=dnn_target, letterbox=letterbox,
+                         cache=cache)
+
+
+def create_backend(kind, model_weights, model_cfg, bmodel=None, device_index=0, input_size=(416, 416),
+                   dnn_target='cpu', letterbox=False, input_sizes=None, cache=None):
+    """kind 为 'auto'（有 bmodel 且能导入 sophon.sail 时用 TPU，否则 cv2.dnn）、'sail' 或 'opencv'
+
+    input_sizes 给出多个输入边长（如 (320, 416, 608)）时返回 MultiSizeBackend，所有尺寸在这里
+    一次建好。TPU 上 bmodel 路径里写 {size} 占位，按每个尺寸找对应的 bmodel，缺的尺寸跳过。
+    cache 为 cache.ModelCache 时 cv2.dnn 的模型经由缓存加载（bmodel 本身就是编译好的引擎，不经过缓存）。
+    """
+    if not input_sizes or len(input_sizes) < 2:
+        if bmodel and '{size}' in bmodel:
+            bmodel = bmodel.format(size=input_size[0])
+        return _create_one(kind, model_weights, model_cfg, bmodel, device_index, input_size, dnn_target, letterbox,
+                           cache)
+    backends = {}
+    for side in input_sizes:
+        if side <= 0 or side % 32:
+            raise ValueError('network input size %d is not a multiple of 32' % side)
+        path = bmodel.format(size=side) if bmodel and '{size}' in bmodel else bmodel
+        if path != bmodel and not os.path.exists(path) and kind != 'opencv':
+            log.warning('no bmodel for input size %d (%s), skipping it', side, path)
+            continue
+        backend = _create_one(kind, model_weights, model_cfg, path, device_index, (side, side), dnn_target,
+                              letterbox, cache)
+        backends[tuple(backend.input_size)] = backend
+        if backend.name == 'sail' and path == bmodel:
+            # 没有 {size} 占位时只有一个固定形状的 bmodel，不随 input_size 变化
+            log.warning('bmodel %s has a fixed input size, adaptive input size disabled', bmodel)
+            break
+    if not backends:
+        raise RuntimeError('no detector network could be built for input sizes %s' % (input_sizes,))
+    if len(backends) == 1:
+        return next(iter(backends.values()))
+    log.info('detector input sizes: %s', ', '.join('%dx%d' % size for size in backends))
+    return MultiSizeBackend(backends)
@@ -0,0 +1,235 @@
+import logging
+import threading
+import time
+
+from src.python.native import lib as native
+
+log = logging.getLogger(__name__)
+
+
+class _Request:
+    __slots__ = ('stream_id', 'image', 'size', 'submitted', 'result', 'error', 'done', 'owner')
+
+    def __init__(self, stream_id, image, size=None):
+        self.stream_id = stream_id
+        self.image = image
+        self.size = size
+        self.submitted = time.perf_counter()
+        self.result = None
+        self.error = None
+        self.done = threading.Event()
+        self.owner = None  # 等待超时而仍在 forward 中时，替调用方持有的 Frame 引用
+
+    def wait(self, timeout=None):
+        if not self.done.wait(timeout):
+            raise TimeoutError('batched inference for stream %r timed out' % (self.stream_id,))
+        if self.error is not None:
+            raise self.error
+        return self.result
+
+
+class BatchInference:
+    """多路摄像头共享一个检测器：把各路提交的帧攒成一批，用一次 forward 完成
+
+    一批在凑满 max_batch 帧，或最早的请求等待超过 max_wait_ms 时发出，单帧延迟有上界。
+    每路一个 client(stream_id)，它提供和 Processor 相同的 detect() 接口，
+    可以直接交给该路的 InferenceStage；结果按提交请求的 stream_id 分发回去。
+    同一路上一帧还没发出时又提交新帧，旧请求以空结果结束（latest-wins）。
+    各路可以请求不同的网络输入尺寸，一批内同尺寸的帧合并 forward（见 Processor.detect_batch）。
+
+    等待的路数超过 max_batch 时按加权公平排队选出一批：每路累计的已服务帧数除以它的
+    priority，小的先上。priority 为 4 的路得到 priority 为 1 的 4 倍算力，低优先级的路
+    也一定会轮到，不会饿死；新加入的路从当前最小的进度开始，不会因为欠账而独占。
+    processor 可以是一个列表（如每个 TPU 一个实例），每个实例一个工作线程，共用同一个等待集合。
+    """
+
+    def __init__(self, processor, max_batch=4, max_wait_ms=20.0):
+        self.processors = list(processor) if isinstance(processor, (list, tuple)) else [processor]
+        self.processor = self.processors[0]
+        self.max_batch = max(1, int(max_batch))
+        self.max_wait = max_wait_ms / 1000.0
+        self._pending = {}  # stream_id -> _Request，保持提交顺序
+        self._priority = {}  # stream_id -> 权重
+        self._served = {}    # stream_id -> 已服务帧数 / 权重
+        self._cond = threading.Condition()
+        self._running = False
+        self._threads = []
+        self.batches = 0
+        self.frames = 0
+        self.superseded = 0
+        self.timeouts = 0
+        self.wait_time = 0.0
+        self.forward_time = 0.0
+
+    def start(self):
+        self._running = True
+        for i, processor in enumerate(self.processors):
+            thread = threading.Thread(target=self._run, args=(processor, i), name='batch-inference-%d' % i,
+                                      daemon=True)
+            thread.start()
+            self._threads.append(thread)
+        return self
+
+    def stop(self):
+        with self._cond:
+            self._running = False
+            pending = list(self._pending.values())
+            self._pending.clear()
+            self._cond.notify_all()
+        for req in pending:
+            req.error = RuntimeError('batched inference stopped')
+            req.done.set()
+        for thread in self._threads:
+            thread.join()
+        self._threads = []
+
+    def submit(self, stream_id, image, size=None):
+        req = _Request(stream_id, image, size)
+        with self._cond:
+            if not self._running:
+                raise RuntimeError('batched inference is not running')
+            old = self._pending.pop(stream_id, None)
+            self._pending[stream_id] = req
+            self._cond.notify_all()
+        if old is not None:
+            self.superseded += 1
+            old.result = []
+            old.done.set()
+        return req
+
+    def cancel(self, req, owner=None):
+        """调用方等待超时：还没发出的请求从等待集合中撤下；已经在 forward 中的，
+        让请求持有 owner（输入图像所属的 Frame）的一个引用，批处理结束时归还，
+        调用方随后释放自己的引用也不会让原生缓冲在推理途中被回收。
+        请求在此之前已经完成时返回 False，结果照常可用"""
+        with self._cond:
+            if req.done.is_set():
+                return False
+            self.timeouts += 1
+            if self._pending.get(req.stream_id) is req:
+                del self._pending[req.stream_id]
+                req.image = None
+            elif owner is not None:
+                req.owner = owner.retain()
+            return True
+
+    def client(self, stream_id, priority=1.0):
+        self.set_priority(stream_id, priority)
+        return BatchClient(self, stream_id)
+
+    def set_priority(self, stream_id, priority):
+        with self._cond:
+            self._priority[stream_id] = max(0.01, float(priority))
+            if stream_id not in self._served:
+                self._served[stream_id] = min(self._served.values(), default=0.0)
+
+    def remove(self, stream_id):
+        """某一路下线：未发出的请求以空结果结束，公平调度的记账一并清掉"""
+        with self._cond:
+            req = self._pending.pop(stream_id, None)
+            self._priority.pop(stream_id, None)
+            self._served.pop(stream_id, None)
+        if req is not None:
+            req.result = []
+            req.done.set()
+
+    def _collect(self):
+        with self._cond:
+            while self._running and not self._pending:
+                self._cond.wait()
+            if not self._running:
+                return []
+            # 从最早的请求开始计时，凑满一批或到期就发出
+            deadline = next(iter(self._pending.values())).submitted + self.max_wait
+            while self._running and len(self._pending) < self.max_batch:
+                left = deadline - time.perf_counter()
+                if left <= 0:
+                    break
+                self._cond.wait(left)
+            chosen = list(self._pending)
+            if len(chosen) > self.max_batch:
+                chosen = sorted(chosen, key=lambda s: self._served.get(s, 0.0))[:self.max_batch]
+            batch = []
+            for stream_id in chosen:
+                batch.append(self._pending.pop(stream_id))
+                if stream_id in self._served:
+                    self._served[stream_id] += 1.0 / self._priority[stream_id]
+            return batch
+
+    def _run(self, processor, index):
+        native.enter_thread(native.THREAD_INFER, 'roi-infer-%d' % index)
+        while self._running:
+            batch = self._collect()
+            if not batch:
+                continue
+            start = time.perf_counter()
+            self.wait_time += sum(start - req.submitted for req in batch)
+            try:
+                sizes = [req.size for req in batch]
+                results = processor.detect_batch([req.image for req in batch], sizes if any(sizes) else None)
+            except Exception as e:
+                log.exception('batched inference failed')
+                results = None
+                for req in batch:
+                    req.error = e
+            self.forward_time += time.perf_counter() - start
+            self.batches += 1
+            self.frames += len(batch)
+            owners = []
+            # 与 cancel() 互斥：请求要么在这里之前拿到 owner 的引用，要么看到已经完成
+            with self._cond:
+                for i, req in enumerate(batch):
+                    if results is not None:
+                        req.result = results[i]
+                    req.image = None
+                    if req.owner is not None:
+                        owners.append(req.owner)
+                        req.owner = None
+                    req.done.set()
+            for owner in owners:
+                owner.release()
+
+    def stats(self):
+        return {
+            'batches': self.batches,
+            'frames': self.frames,
+            'mean_batch': round(self.frames / self.batches, 2) if self.batches else 0.0,
+            'mean_wait_ms': round(1000.0 * self.wait_time / self.frames, 2) if self.frames else 0.0,
+            'mean_forward_ms': round(1000.0 * self.forward_time / self.batches, 2) if self.batches else 0.0,
+            'superseded': self.superseded,
+            'timeouts': self.timeouts,
+            'workers': len(self.processors),
+        }
+
+
+class BatchClient:
+    """某一路在 BatchInference 上的代理，接口与 Processor 一致"""
+
+    def __init__(self, batcher, stream_id, timeout=5.0):
+        self.batcher = batcher
+        self.stream_id = stream_id
+        self.timeout = timeout
+
+    @property
+    def classes(self):
+        return self.batcher.processor.classes
+
+    @property
+    def accepts_native(self):
+        return getattr(self.batcher.processor, 'accepts_native', False)
+
+    @property
+    def input_sizes(self):
+        return self.batcher.processor.input_sizes
+
+    def detect(self, frame, size=None, owner=None):
+        """等待超过 timeout 时和被新帧顶替一样以空结果返回，一次慢的 forward 不算该路出错；
+        owner 为 frame 所属的 pipeline.stage.Frame：超时返回后 frame 可能仍在 forward 中，
+        由请求替调用方保留它的引用（见 BatchInference.cancel）"""
+        req = self.batcher.submit(self.stream_id, frame, size)
+        if not req.done.wait(self.timeout) and self.batcher.cancel(req, owner):
+            return []
+        return req.wait(0)
+
+    def draw_prediction(self, *args):
+        return self.batcher.processor.draw_prediction(*args)
@@ -0,0 +1,113 @@
+import hashlib
+import json
+import logging
+import mmap
+import os
+import threading
+
+from src.python.ai.models import check_darknet_weights
+
+log = logging.getLogger(__name__)
+
+DEFAULT_ROOT = os.path.join(os.path.expanduser('~'), '.cache', 'roi-pipeline', 'models')
+
+
+def _atomic_write(path, data):
+    tmp = '%s.%d.tmp' % (path, os.getpid())
+    with open(tmp, 'w', encoding='utf-8') as f:
+        json.dump(data, f)
+    os.replace(tmp, path)
+
+
+class CacheEntry:
+    """缓存中的一个模型，目录名为 cfg 与权重内容的哈希
+
+    meta.json 记录首次加载时核对过的参数个数，之后的启动不再重复核对；weights() 把权重文件
+    映射进内存直接交给 cv2.dnn，不经过 Python 端的读文件。
+    """
+
+    def __init__(self, root, key, cfg, weights, meta):
+        self.root = root
+        self.key = key
+        self.cfg = cfg
+        self.weights_path = weights
+        self.meta = meta
+        self._map = None
+
+    def cfg_bytes(self):
+        with open(self.cfg, 'rb') as f:
+            return f.read()
+
+    def weights(self):
+        """权重文件的只读映射，多次调用返回同一个映射"""
+        if self._map is None:
+            with open(self.weights_path, 'rb') as f:
+                self._map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        return self._map
+
+
+class ModelCache:
+    """按内容哈希存放的模型缓存（默认 ~/.cache/roi-pipeline/models，ROI_MODEL_CACHE 可改）
+
+    哈希只在文件的大小或修改时间变化后重算：index.json 记下每个文件上一次的 (size, mtime, digest)，
+    滚动升级时模型文件换了内容，键随之改变，旧的缓存目录不会被误用。
+    ocl/ 存放 OpenCV 编译好的 OpenCL 程序和 OCL4DNN 的调优结果（见 enable_opencl），
+    dnn_target 为 opencl 时首帧不必再编译内核；OpenCV 按内核源码和设备区分它们，各模型共用。
+    """
+
+    def __init__(self, root=None):
+        self.root = root or os.environ.get('ROI_MODEL_CACHE') or DEFAULT_ROOT
+        os.makedirs(self.root, exist_ok=True)
+        self._index_path = os.path.join(self.root, 'index.json')
+        self._lock = threading.Lock()
+        try:
+            with open(self._index_path, 'r', encoding='utf-8') as f:
+                self._index = json.load(f)
+        except (OSError, ValueError):
+            self._index = {}
+
+    @property
+    def opencl_dir(self):
+        return os.path.join(self.root, 'ocl')
+
+    def enable_opencl(self):
+        """OpenCV 在第一次编译 OpenCL 程序时才读这些变量，须在第一次 forward 之前调用"""
+        os.makedirs(self.opencl_dir, exist_ok=True)
+        os.environ.setdefault('OPENCV_OPENCL_CACHE_ENABLE', 'true')
+        os.environ.setdefault('OPENCV_OPENCL_CACHE_DIR', self.opencl_dir)
+        os.environ.setdefault('OPENCV_OCL4DNN_CONFIG_PATH', self.opencl_dir)
+
+    def digest(self, path):
+        path = os.path.abspath(path)
+        st = os.stat(path)
+        known = self._index.get(path)
+        if known and known[0] == st.st_size and known[1] == st.st_mtime_ns:
+            return known[2]
+        h = hashlib.sha256()
+        with open(path, 'rb') as f:
+            for chunk in iter(lambda: f.read(1 << 20), b''):
+                h.update(chunk)
+        digest = h.hexdigest()
+        self._index[path] = [st.st_size, st.st_mtime_ns, digest]
+        _atomic_write(self._index_path, self._index)
+        return digest
+
+    def entry(self, cfg, weights):
+        """返回 (cfg, weights) 的缓存项；第一次见到这对文件时核对权重并建立缓存目录"""
+        with self._lock:
+            key = hashlib.sha256((self.digest(cfg) + self.digest(weights)).encode()).hexdigest()[:24]
+            root = os.path.join(self.root, key)
+            meta_path = os.path.join(root, 'meta.json')
+            try:
+                with open(meta_path, 'r', encoding='utf-8') as f:
+                    meta = json.load(f)
+            except (OSError, ValueError):
+                meta = None
+            if meta is None:
+                count = check_darknet_weights(cfg, weights)
+                os.makedirs(root, exist_ok=True)
+                meta = {'cfg': os.path.abspath(cfg), 'weights': os.path.abspath(weights), 'weight_count': count}
+                _atomic_write(meta_path, meta)
+                log.info('model cache: added %s (%s)', key, os.path.basename(cfg))
+            return CacheEntry(root, key, cfg, weights, meta)
+
@@ -0,0 +1,117 @@
+import json
+import logging
+
+log = logging.getLogger(__name__)
+
+
+def read_names(path):
+    """读 Darknet 的 .names 文件：每行一个类名，跳过空行和 # 开头的注释"""
+    names = []
+    with open(path, 'r', encoding='utf-8') as f:
+        for line in f:
+            line = line.split('#', 1)[0].strip()
+            if line:
+                names.append(line)
+    return names
+
+
+class ClassSpec:
+    """一个检测类别的业务配置
+
+    priority 越大越优先：ROI 数量受限时先保留高优先级的目标。
+    qp_delta 为该类 ROI 的 QP 偏移，None 表示这一类只检测、不作为 ROI（按背景编码）。
+    min_confidence 为该类自己的置信度阈值，None 时使用 Processor.conf_threshold。
+    """
+
+    __slots__ = ('name', 'priority', 'qp_delta', 'min_confidence')
+
+    def __init__(self, name, priority=0, qp_delta=None, min_confidence=None):
+        self.name = name
+        self.priority = int(priority)
+        self.qp_delta = None if qp_delta is None else int(qp_delta)
+        self.min_confidence = None if min_confidence is None else float(min_confidence)
+
+    def __repr__(self):
+        return 'ClassSpec(%r, priority=%d, qp_delta=%r)' % (self.name, self.priority, self.qp_delta)
+
+
+class ClassConfig:
+    """类别配置：下标就是模型输出的类别号
+
+    从 JSON 读取（见 model/classes.json）：
+        {"default": {"priority": 0, "qp_delta": null},
+         "classes": [{"name": "face", "priority": 3, "qp_delta": -8}, ...]}
+    也可以直接给 .names 文件，这时每一类都用 default_qp 作为 ROI。
+    模型实际输出的类别数（cfg 里 [yolo] 的 classes）少于配置时，多出的类别被丢弃并打警告，
+    多于配置时补上 default 配置的 classN。
+    """
+
+    def __init__(self, specs, default=None):
+        self.specs = list(specs)
+        self.default = default or ClassSpec('', priority=0, qp_delta=None)
+
+    @classmethod
+    def load(cls, path, num_classes=None, default_qp=-8):
+        if path.endswith('.json'):
+            with open(path, 'r', encoding='utf-8') as f:
+                doc = json.load(f)
+            default = ClassSpec('', **doc.get('default', {}))
+            specs = [ClassSpec(**entry) for entry in doc.get('classes', [])]
+        else:
+            default = ClassSpec('', priority=0, qp_delta=default_qp)
+            specs = [ClassSpec(name, qp_delta=default_qp) for name in read_names(path)]
+        config = cls(specs, default)
+        if num_classes is not None:
+            config.fit(num_classes, path)
+        return config
+
+    def fit(self, num_classes, source='class config'):
+        """让类别数与模型输出一致"""
+        if len(self.specs) > num_classes:
+            log.warning('%s lists %d classes but the model outputs %d, ignoring %s', source, len(self.specs),
+                        num_classes, ', '.join(spec.name for spec in self.specs[num_classes:]))
+            del self.specs[num_classes:]
+        while len(self.specs) < num_classes:
+            d = self.default
+            self.specs.append(ClassSpec('class%d' % len(self.specs), d.priority, d.qp_delta, d.min_confidence))
+
+    @property
+    def names(self):
+        return [spec.name for spec in self.specs]
+
+    def __len__(self):
+        return len(self.specs)
+
+    def spec(self, class_id):
+        return self.specs[class_id] if 0 <= class_id < len(self.specs) else self.default
+
+    def qp_delta(self, class_id):
+        return self.spec(class_id).qp_delta
+
+    def priority(self, class_id):
+        return self.spec(class_id).priority
+
+    def is_roi(self, det):
+        """det 是否作为 ROI：检测结果 (class_id, confidence, box) 看该类有没有 qp_delta，
+        直接给的框或 (box, qp_delta) 总是 ROI"""
+        return len(det) != 3 or self.qp_delta(det[0]) is not None
+
+    @property
+    def has_thresholds(self):
+        return any(spec.min_confidence is not None for spec in self.specs)
+
+    def min_confidence(self, default):
+        """各类阈值中最低的一个，原生解码先按它筛选，再逐类过滤"""
+        values = [spec.min_confidence for spec in self.specs if spec.min_confidence is not None]
+        return min(values + [default]) if values else default
+
+    def accept(self, class_id, confidence, default_threshold):
+        threshold = self.spec(class_id).min_confidence
+        return confidence > (default_threshold if threshold is None else threshold)
+
+
+def has_rois(classes, detections):
+    """detections 中是否有 ROI；没有类别配置（classes 为 None）时每个检测都是"""
+    if classes is None:
+        return bool(detections)
+    return any(classes.is_roi(det) for det in detections)
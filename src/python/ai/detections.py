@@ -0,0 +1,163 @@
+import bisect
+import json
+import logging
+import mmap
+import struct
+import threading
+
+log = logging.getLogger(__name__)
+
+MAGIC = b'ROIDET01'
+_HEADER = struct.Struct('<III')  # 录制时的帧宽、帧高、类别名 JSON 的字节数
+_FRAME = struct.Struct('<qI')    # pts（90kHz）、框数
+_BOX = struct.Struct('<5fi')     # x, y, w, h（原图像素）、置信度、类别号
+
+
+class DetectionRecorder:
+    """把写进 RoiState 的检测结果按帧的 pts 追加到文件，供 DetectionIndex 回放
+
+    文件是只追加的记录流：头部（魔数、帧尺寸、类别名）之后每条记录为 pts、框数和这些框，
+    写到一半被打断也只丢最后一条。检测结果没有变化的帧不写（回放时沿用前一条），
+    所以隔帧检测和 latest-wins 丢帧都不会让文件变大。由推理阶段的线程调用 write()。
+    """
+
+    def __init__(self, path, class_names=None):
+        self.path = path
+        self.class_names = list(class_names or [])
+        self.frames = 0
+        self.boxes = 0
+        self._file = None
+        self._last = None
+        self._lock = threading.Lock()
+
+    def write(self, pts, detections, width, height):
+        boxes = [_unpack(det) for det in detections]
+        if boxes == self._last:
+            return
+        self._last = boxes
+        record = _FRAME.pack(int(pts), len(boxes)) + b''.join(
+            _BOX.pack(x, y, w, h, confidence, class_id) for class_id, confidence, (x, y, w, h) in boxes)
+        with self._lock:
+            if self._file is None:
+                meta = json.dumps({'classes': self.class_names}).encode()
+                self._file = open(self.path, 'wb')
+                self._file.write(MAGIC + _HEADER.pack(int(width), int(height), len(meta)) + meta)
+            self._file.write(record)
+        self.frames += 1
+        self.boxes += len(boxes)
+
+    def close(self):
+        with self._lock:
+            if self._file is not None:
+                self._file.close()
+                self._file = None
+        log.info('recorded %d detection updates (%d boxes) to %s', self.frames, self.boxes, self.path)
+
+    def stats(self):
+        return {'updates': self.frames, 'boxes': self.boxes}
+
+
+def _unpack(det):
+    """Processor.detect() 的 (class_id, confidence, [x, y, w, h])，或不带类别的框"""
+    if len(det) == 3:
+        return int(det[0]), float(det[1]), tuple(float(v) for v in det[2][:4])
+    if len(det) == 2:
+        return 0, 1.0, tuple(float(v) for v in det[0][:4])
+    return 0, 1.0, tuple(float(v) for v in det[:4])
+
+
+class DetectionIndex:
+    """内存映射的逐帧检测框索引（DetectionRecorder 写出的文件），按 pts 查找
+
+    打开时只扫一遍记录头建立 pts -> 偏移的表，框数据留在映射里，用到时才解出来；
+    同一个文件被多个流水线或多个进程回放时共享页缓存。本身只读，可以跨线程共享，
+    每个消费者用 cursor() 取得自己的游标。
+    """
+
+    def __init__(self, path):
+        self.path = path
+        with open(path, 'rb') as f:
+            self._map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        data = self._map
+        if len(data) < len(MAGIC) + _HEADER.size or data[:len(MAGIC)] != MAGIC:
+            raise ValueError('%s: not a detection index' % path)
+        self.width, self.height, meta_len = _HEADER.unpack_from(data, len(MAGIC))
+        off = len(MAGIC) + _HEADER.size
+        self.class_names = json.loads(bytes(data[off:off + meta_len]).decode() or '{}').get('classes', [])
+        off += meta_len
+        entries = []
+        while off + _FRAME.size <= len(data):
+            pts, count = _FRAME.unpack_from(data, off)
+            end = off + _FRAME.size + count * _BOX.size
+            if end > len(data):
+                break  # 录制被打断的最后一条
+            entries.append((pts, off))
+            off = end
+        if any(entries[i][0] > entries[i + 1][0] for i in range(len(entries) - 1)):
+            entries.sort(key=lambda e: e[0])
+        self._pts = [e[0] for e in entries]
+        self._offsets = [e[1] for e in entries]
+
+    def __len__(self):
+        return len(self._pts)
+
+    @property
+    def first_pts(self):
+        return self._pts[0] if self._pts else 0
+
+    def find(self, pts):
+        """不晚于 pts 的最后一条记录的序号，没有时为 -1"""
+        return bisect.bisect_right(self._pts, pts) - 1
+
+    def boxes(self, entry):
+        """第 entry 条记录的 [(class_id, confidence, [x, y, w, h]), ...]"""
+        off = self._offsets[entry]
+        _, count = _FRAME.unpack_from(self._map, off)
+        start = off + _FRAME.size
+        return [(class_id, confidence, [x, y, w, h]) for x, y, w, h, confidence, class_id in
+                _BOX.iter_unpack(self._map[start:start + count * _BOX.size])]
+
+    def cursor(self, align=True):
+        return DetectionCursor(self, align)
+
+    def close(self):
+        self._map.close()
+
+
+class DetectionCursor:
+    """一个编码阶段回放索引的游标：snapshot() 与 RoiState.snapshot() 的前两项一致
+
+    align 为 True 时把看到的第一帧对齐到索引的第一条记录：同一段录像重新拉流时 RTP 时间戳的
+    起点会变，但帧间的 pts 差不变。帧尺寸和录制时不同（例如缩放后的码流）时框按比例换算。
+    version 是记录的序号加一，帧落在同一条记录内时不变，编码器不必重建 QP 图。
+    """
+
+    def __init__(self, index, align=True):
+        self.index = index
+        self.align = align
+        self.lookups = 0
+        self.misses = 0  # 早于第一条记录、没有检测结果的帧
+        self._offset = None
+        self._entry = None
+        self._detections = []
+
+    def snapshot(self, pts, width=None, height=None):
+        if self._offset is None:
+            self._offset = pts - self.index.first_pts if self.align else 0
+        self.lookups += 1
+        entry = self.index.find(pts - self._offset)
+        if entry < 0:
+            self.misses += 1
+            return 0, []
+        if entry != self._entry:
+            self._entry = entry
+            detections = self.index.boxes(entry)
+            sx = width / self.index.width if width and self.index.width else 1.0
+            sy = height / self.index.height if height and self.index.height else 1.0
+            if sx != 1.0 or sy != 1.0:
+                detections = [(c, p, [x * sx, y * sy, w * sx, h * sy]) for c, p, (x, y, w, h) in detections]
+            self._detections = detections
+        return entry + 1, self._detections
+
+    def stats(self):
+        return {'entries': len(self.index), 'lookups': self.lookups, 'misses': self.misses}
@@ -0,0 +1,167 @@
+import json
+import os
+import struct
+
+
+class ModelError(RuntimeError):
+    """模型文件缺失，或权重与 cfg 对不上"""
+
+
+def _sections(path):
+    """按顺序读出 cfg 的各段 [(name, {key: value}), ...]"""
+    sections = []
+    with open(path, 'r') as f:
+        for line in f:
+            line = line.split('#', 1)[0].strip()
+            if not line:
+                continue
+            if line.startswith('['):
+                sections.append((line.strip('[]').strip(), {}))
+            elif sections:
+                key, _, value = line.partition('=')
+                sections[-1][1][key.strip()] = value.strip()
+    return sections
+
+
+def darknet_weight_count(cfg_path):
+    """cfg 描述的网络在 .weights 中应有的 float 个数
+
+    只有卷积层带参数：有 batch_normalize 时是 bias、scale、mean、variance 各 filters 个，
+    否则只有 bias，再加 filters * (输入通道 / groups) * size * size 个卷积核。输入通道
+    沿着各层推算：route 拼接（或按 groups 切分）引用层的输出，其余层不改变通道数。
+    """
+    sections = _sections(cfg_path)
+    if not sections or sections[0][0] not in ('net', 'network'):
+        raise ModelError('%s does not start with a [net] section' % cfg_path)
+    channels = int(sections[0][1].get('channels', 3))
+    outputs = []
+    count = 0
+    for index, (name, opts) in enumerate(sections[1:]):
+        if name in ('convolutional', 'conv'):
+            filters = int(opts.get('filters', 1))
+            size = int(opts.get('size', 1))
+            groups = int(opts.get('groups', 1))
+            count += filters * (4 if int(opts.get('batch_normalize', 0)) else 1)
+            count += filters * (channels // groups) * size * size
+            channels = filters
+        elif name == 'route':
+            layers = [int(v) for v in opts['layers'].split(',') if v.strip()]
+            channels = sum(outputs[v if v >= 0 else index + v] for v in layers) // int(opts.get('groups', 1))
+        elif name in ('connected', 'local', 'deconvolutional', 'crnn', 'rnn', 'lstm'):
+            raise ModelError('%s: [%s] layers are not supported by the weight check' % (cfg_path, name))
+        outputs.append(channels)
+    return count
+
+
+def check_darknet_weights(cfg_path, weights_path):
+    """加载前确认 .weights 是与 cfg 同一个网络的 Darknet 权重，不是时抛 ModelError
+
+    cv2.dnn 读到不匹配的权重往往不报错，只是输出全是噪声，所以在这里先按文件大小核对。
+    """
+    for path in (cfg_path, weights_path):
+        if not os.path.isfile(path):
+            raise ModelError('model file %s not found' % path)
+    size = os.path.getsize(weights_path)
+    with open(weights_path, 'rb') as f:
+        head = f.read(20)
+    if head.lstrip().startswith(b'['):
+        raise ModelError('%s is a Darknet cfg (text), not a weights checkpoint' % weights_path)
+    if len(head) < 16:
+        raise ModelError('%s is too small to be a Darknet weights file (%d bytes)' % (weights_path, size))
+    # 头部 major、minor、revision 各 int32，之后是训练见过的图片数：0.2 版本起为 int64
+    major, minor, _ = struct.unpack('<3i', head[:12])
+    header = 20 if major * 10 + minor >= 2 and major < 1000 and minor < 1000 else 16
+    expected = darknet_weight_count(cfg_path)
+    actual = (size - header) / 4.0
+    if actual != expected:
+        raise ModelError('%s holds %.0f weights but %s needs %d, they are not the same network'
+                         % (weights_path, actual, cfg_path, expected))
+    return expected
+
+
+class ModelSpec:
+    """注册表中的一个检测模型
+
+    variant 为 full / tiny / nano 等规模标签，只用于展示和选择；cfg + weights 给 cv2.dnn，
+    bmodel（可以有 {size} 占位，见 backends.create_backend）给 TPU，classes 为类别配置。
+    """
+
+    __slots__ = ('name', 'variant', 'cfg', 'weights', 'bmodel', 'classes', 'input_sizes', 'description')
+
+    def __init__(self, name, cfg, weights=None, bmodel=None, classes=None, variant='full', input_sizes=None,
+                 description=''):
+        self.name = name
+        self.variant = variant
+        self.cfg = cfg
+        self.weights = weights
+        self.bmodel = bmodel
+        self.classes = classes
+        self.input_sizes = list(input_sizes) if input_sizes else None
+        self.description = description
+
+    def __repr__(self):
+        return 'ModelSpec(%r, variant=%r, cfg=%r)' % (self.name, self.variant, self.cfg)
+
+    def available_bmodel(self, input_sizes=None):
+        """bmodel 存在时返回它的路径（{size} 占位时至少要有一个尺寸的文件），否则 None"""
+        if not self.bmodel:
+            return None
+        if '{size}' not in self.bmodel:
+            return self.bmodel if os.path.isfile(self.bmodel) else None
+        sizes = input_sizes or self.input_sizes or []
+        return self.bmodel if any(os.path.isfile(self.bmodel.format(size=s)) for s in sizes) else None
+
+    def validate(self, backend='auto', input_sizes=None):
+        """按将要使用的后端检查文件：TPU 只需要 cfg 和 bmodel，cv2.dnn 需要匹配的 weights"""
+        if not os.path.isfile(self.cfg):
+            raise ModelError('model %s: cfg %s not found' % (self.name, self.cfg))
+        if backend != 'opencv' and self.available_bmodel(input_sizes):
+            return
+        if backend == 'sail':
+            raise ModelError('model %s: bmodel %s not found' % (self.name, self.bmodel))
+        if not self.weights:
+            raise ModelError('model %s has no weights for cv2.dnn' % self.name)
+        check_darknet_weights(self.cfg, self.weights)
+
+
+class ModelRegistry:
+    """模型注册表（见 model/models.json）：各路按名字选用 full / tiny 等不同规模的检测器
+
+        {"default": "yolov3-face",
+         "models": {"yolov3-tiny-face": {"variant": "tiny", "cfg": "yolov3-tiny-face.cfg", ...}}}
+    相对路径相对于注册表文件所在目录。
+    """
+
+    def __init__(self, models, default=None):
+        self.models = dict(models)
+        self.default = default or next(iter(self.models), None)
+
+    @classmethod
+    def load(cls, path):
+        with open(path, 'r', encoding='utf-8') as f:
+            doc = json.load(f)
+        root = os.path.dirname(os.path.abspath(path))
+
+        def resolve(value):
+            return value if not value or os.path.isabs(value) else os.path.join(root, value)
+
+        models = {}
+        for name, entry in doc.get('models', {}).items():
+            entry = dict(entry)
+            for key in ('cfg', 'weights', 'bmodel', 'classes'):
+                entry[key] = resolve(entry.get(key))
+            models[name] = ModelSpec(name, **entry)
+        return cls(models, doc.get('default'))
+
+    def names(self):
+        return list(self.models)
+
+    def get(self, name=None):
+        name = name or self.default
+        spec = self.models.get(name)
+        if spec is None:
+            # 也可以直接给规模标签，取该规模下的第一个模型
+            spec = next((s for s in self.models.values() if s.variant == name), None)
+        if spec is None:
+            raise ModelError('unknown model %r, registered: %s' % (name, ', '.join(self.models)))
+        return spec
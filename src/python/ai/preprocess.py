@@ -0,0 +1,84 @@
+import ctypes
+
+import numpy as np
+
+from src.python.native import lib as native
+
+
+class NativePreprocessor:
+    """融合预处理（src/cpp/infer/preprocess.h）：解码器的 NV12 帧或 BGR 图像一次写成网络输入
+
+    张量 (batch, 3, H, W) 在构造时分配，之后每帧原地改写，tensor 是它的 numpy 视图。
+    int8=True 时输出按 int8_scale 量化的 int8，直接作为 TPU 的量化输入。
+    run() 返回 (scale_x, scale_y, pad_x, pad_y)：网络输入坐标 = 原图坐标 * scale + pad。
+    """
+
+    def __init__(self, width, height, batch=1, letterbox=False, int8=False, int8_scale=127.0, pad_value=127):
+        self.lib = native.load()
+        if self.lib is None:
+            raise RuntimeError('native pipeline library not built, run make in src/cpp')
+        cfg = native.RoiPreprocessConfig(width=width, height=height, batch=batch, letterbox=1 if letterbox else 0,
+                                         pad_value=pad_value, int8=1 if int8 else 0, int8_scale=int8_scale)
+        self.handle = self.lib.roi_preprocess_open(ctypes.byref(cfg))
+        if not self.handle:
+            raise RuntimeError('preprocess open failed: %s' % native.last_error())
+        self.width = width
+        self.height = height
+        self.batch = batch
+        self.letterbox = letterbox
+        size = ctypes.c_uint64()
+        ptr = self.lib.roi_preprocess_tensor(self.handle, ctypes.byref(size))
+        dtype = np.int8 if int8 else np.float32
+        self.tensor = np.frombuffer(native.view(ptr, size.value, writable=True), dtype=dtype).reshape(
+            batch, 3, height, width)
+        self._info = native.RoiLetterbox()
+
+    def run(self, slot, image):
+        """image 为 decoder.DecodedFrame（需有主机映射）、其上的 Crop 或 BGR ndarray"""
+        if isinstance(image, Crop):
+            r = self.lib.roi_preprocess_surface_crop(self.handle, slot, image.frame.handle, image.x, image.y,
+                                                     image.width, image.height, ctypes.byref(self._info))
+        elif hasattr(image, 'handle'):
+            r = self.lib.roi_preprocess_surface(self.handle, slot, image.handle, ctypes.byref(self._info))
+        else:
+            if image.dtype != np.uint8 or image.ndim != 3 or image.strides[1:] != (3, 1):
+                image = np.ascontiguousarray(image, dtype=np.uint8)
+            h, w = image.shape[:2]
+            r = self.lib.roi_preprocess_bgr(self.handle, slot, image.ctypes.data, w, h, image.strides[0],
+                                            ctypes.byref(self._info))
+        if r < 0:
+            raise RuntimeError(native.last_error())
+        info = self._info
+        return info.scale_x, info.scale_y, info.pad_x, info.pad_y
+
+    def close(self):
+        if self.handle:
+            self.tensor = None
+            self.lib.roi_preprocess_close(self.handle)
+            self.handle = None
+
+    def __del__(self):
+        self.close()
+
+
+class Crop:
+    """DecodedFrame 中的一块区域，交给融合预处理时直接从 NV12 平面裁剪缩放，不转 BGR
+
+    BGR ndarray 的裁剪直接用切片视图即可，预处理按行距读取，同样不拷贝。
+    """
+
+    __slots__ = ('frame', 'x', 'y', 'width', 'height')
+
+    def __init__(self, frame, x, y, width, height):
+        self.frame = frame
+        self.x = x
+        self.y = y
+        self.width = width
+        self.height = height
+
+
+def image_size(image):
+    """(width, height)，image 为 BGR ndarray、DecodedFrame 或 Crop"""
+    if not hasattr(image, 'shape'):
+        return image.width, image.height
+    return image.shape[1], image.shape[0]
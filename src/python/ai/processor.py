@@ -1,32 +1,193 @@
+import logging
+import threading
+import time
+
 import cv2
 import numpy as np
 
+from src.python.ai.backends import create_backend, parse_darknet_cfg
+from src.python.ai.classes import ClassConfig
+from src.python.ai.preprocess import image_size
+from src.python.native import lib as native
+
+log = logging.getLogger(__name__)
+
 
 class Processor:
     # def __init__(self, model_weights, model_cfg, class_names):
     #     self.net = cv2.dnn.readNet(model_weights, model_cfg)
     #     self.classes = open(class_names).read().strip().split('\n')
-    def __init__(self, model_weights, model_cfg, class_names):
-        self.net = cv2.dnn.readNetFromDarknet(model_cfg, model_weights)
-        self.classes = []
-        with open(class_names, 'r') as f:
-            self.classes = [line.strip() for line in f.readlines()]
-
-    def process_frame(self, frame):
-
-        # 将图像转换为 YOLOv3 需要的格式
-        height, width, _ = frame.shape
-        blob = cv2.dnn.blobFromImage(frame, 1/255.0, (416, 416), (0, 0, 0), True, crop=False)
-
-        # 将 blob 输入到网络中进行预测
-        self.net.setInput(blob)
-        outs = self.net.forward(self.get_output_layers())
-
+    def __init__(self, model_weights, model_cfg, class_names, backend='auto', bmodel=None, device_index=0,
+                 dnn_target='cpu', letterbox=False, input_sizes=None, cache=None):
+        """backend 见 backends.create_backend：给了 bmodel 时优先在 SE5 TPU 上运行，否则用 cv2.dnn
+
+        class_names 为类别配置（.json，见 classes.ClassConfig）、.names 文件或 ClassConfig，
+        类别数按 cfg 中 [yolo] 层的 classes 对齐。
+        input_sizes 为可切换的网络输入边长（如 (320, 416, 608)），每个尺寸的网络在构造时建好，
+        detect() 的 size 参数按帧选择；不给时只用 cfg 中的尺寸。
+        cache 为 cache.ModelCache 时 cv2.dnn 模型经由缓存加载，见 backends.OpenCvBackend。
+        detect() / detect_batch() 可以从多个线程调用（内部串行），多路共用一个实例见 shared()。
+        """
+        width, height, yolo_layers = parse_darknet_cfg(model_cfg)
+        self.backend = create_backend(backend, model_weights, model_cfg, bmodel, device_index,
+                                      input_size=(width, height), dnn_target=dnn_target, letterbox=letterbox,
+                                      input_sizes=input_sizes, cache=cache)
+        self._lock = threading.Lock()
+        self.input_sizes = list(getattr(self.backend, 'sizes', [tuple(self.backend.input_size)]))
+        self.conf_threshold = 0.5
+        self.nms_threshold = 0.4
+        self.per_class_nms = True
+        # 原生库可用时阈值筛选、框解码和 NMS 都在 C++ 里一次完成（见 src/cpp/infer/yolo_decode.h）
+        self._native = native.load()
+        self._heads = (native.RoiYoloHead * 8)()
+        self._dets = (native.RoiDetection * 512)()
+        num_classes = yolo_layers[0]['classes'] if yolo_layers else None
+        if isinstance(class_names, ClassConfig):
+            self.class_config = class_names
+            if num_classes is not None:
+                self.class_config.fit(num_classes)
+        else:
+            self.class_config = ClassConfig.load(class_names, num_classes)
+        self.classes = self.class_config.names
+
+    @classmethod
+    def from_spec(cls, spec, class_names=None, backend='auto', bmodel=None, input_sizes=None, **kwargs):
+        """按 models.ModelSpec 创建：先校验模型文件，再用注册表里的 cfg / weights / bmodel / 类别配置
+
+        bmodel、class_names 给出时覆盖注册表中的值；input_sizes 缺省时用注册表为该模型列出的尺寸。
+        """
+        input_sizes = input_sizes or spec.input_sizes
+        if bmodel is None:
+            spec.validate(backend, input_sizes)
+            bmodel = spec.available_bmodel(input_sizes) if backend != 'opencv' else None
+        return cls(spec.weights, spec.cfg, class_names or spec.classes, backend=backend, bmodel=bmodel,
+                   input_sizes=input_sizes, **kwargs)
+
+    _shared = {}
+    _shared_lock = threading.Lock()
+
+    @classmethod
+    def shared(cls, spec, class_names=None, **kwargs):
+        """同一进程内按 (模型, 参数) 共用一个已加载、已预热的实例，各路不再各自加载一份"""
+        key = (spec.name, spec.cfg, spec.weights, str(class_names),
+               tuple(sorted((k, str(v)) for k, v in kwargs.items() if k != 'cache')))
+        with cls._shared_lock:
+            processor = cls._shared.get(key)
+            if processor is None:
+                processor = cls.from_spec(spec, class_names, **kwargs)
+                processor.warmup()
+                cls._shared[key] = processor
+            return processor
+
+    def warmup(self, batch_sizes=(1,)):
+        """每个输入尺寸、每个批大小各跑一次全零的 forward，返回总耗时（秒）
+
+        cv2.dnn 在第一次 forward 时才分配各层的缓冲、融合算子（OpenCL 还要编译内核），TPU 第一次
+        运行时要搬运权重；这些开销放在启动阶段，流开始后的第一帧就能按正常速度检测。
+        """
+        start = time.perf_counter()
+        with self._lock:
+            current = tuple(self.backend.input_size)
+            for size in self.input_sizes:
+                if hasattr(self.backend, 'select'):
+                    self.backend.select(size)
+                frame = np.zeros((size[1], size[0], 3), dtype=np.uint8)
+                for n in batch_sizes:
+                    self.backend.forward([frame] * max(1, int(n)))
+            if hasattr(self.backend, 'select'):
+                self.backend.select(current)
+        elapsed = time.perf_counter() - start
+        log.info('detector warm-up: %s in %.0f ms', ', '.join('%dx%d' % s for s in self.input_sizes),
+                 1000.0 * elapsed)
+        return elapsed
+
+    @property
+    def accepts_native(self):
+        """可以直接接收 decoder.DecodedFrame（NV12 一次预处理成网络输入，不经过 BGR）"""
+        return self.backend.native_preprocess
+
+    def detect(self, frame, size=None, owner=None):
+        """运行检测并返回 [(class_id, confidence, [x, y, w, h]), ...]，坐标为原图像素
+
+        size 为网络输入尺寸 (w, h)，须是 input_sizes 之一，None 时用当前尺寸。
+        owner 是 frame 所属的 Frame，同步检测返回时已用完 frame，不需要它（见 BatchClient.detect）。
+        """
+        return self.detect_batch([frame], None if size is None else [size])[0]
+
+    def detect_batch(self, frames, sizes=None):
+        """一次 forward 处理多帧（可以来自不同的流、尺寸也可以不同），按输入顺序返回每帧的检测结果
+
+        cfg 里的 batch=1 只影响训练，推理时的批大小由输入 blob 的 N 维决定。
+        sizes 给出每帧的网络输入尺寸时，同一尺寸的帧合成一批，各尺寸分别 forward。
+        """
+        if not frames:
+            return []
+        with self._lock:
+            return self._detect_sized(frames, sizes)
+
+    def _detect_sized(self, frames, sizes):
+        if sizes is not None and len(self.input_sizes) > 1:
+            results = [None] * len(frames)
+            current = tuple(self.backend.input_size)
+            groups = {}
+            for i, size in enumerate(sizes):
+                size = tuple(size) if size else current
+                groups.setdefault(size if size in self.input_sizes else self.backend.select(size), []).append(i)
+            for size, indices in groups.items():
+                self.backend.select(size)
+                for i, dets in zip(indices, self._detect_batch([frames[i] for i in indices])):
+                    results[i] = dets
+            return results
+        return self._detect_batch(frames)
+
+    def _detect_batch(self, frames):
+        # 预处理与前向由后端完成，每层输出统一为 (N, rows, 5 + classes)
+        outs = self.backend.forward(frames)
+        decode = self._decode_native if self._native is not None else self._decode
+        # 先按各类阈值中最低的一个解码，再逐类过滤
+        threshold = self.class_config.min_confidence(self.conf_threshold)
+        results = []
+        for i, frame in enumerate(frames):
+            letterbox = self.backend.letterbox[i]
+            if letterbox is None:
+                width, height = image_size(frame)
+                dets = decode([out[i] for out in outs], width, height, threshold)
+            else:
+                # letterbox 时先解码到网络输入坐标，再去掉填充、缩放回原图
+                net_w, net_h = self.backend.input_size
+                sx, sy, px, py = letterbox
+                dets = [(class_id, confidence, [(x - px) / sx, (y - py) / sy, w / sx, h / sy])
+                        for class_id, confidence, (x, y, w, h) in decode([out[i] for out in outs], net_w, net_h,
+                                                                         threshold)]
+            if self.class_config.has_thresholds:
+                dets = [d for d in dets if self.class_config.accept(d[0], d[1], self.conf_threshold)]
+            results.append(dets)
+        return results
+
+    def _decode_native(self, outs, width, height, conf_threshold):
+        if len(outs) > len(self._heads):
+            self._heads = (native.RoiYoloHead * len(outs))()
+        # 保持连续的 float32 数组存活到调用结束
+        outs = [np.ascontiguousarray(out, dtype=np.float32) for out in outs]
+        for head, out in zip(self._heads, outs):
+            head.data = out.ctypes.data
+            head.rows = out.shape[0]
+            head.stride = out.shape[1]
+        args = (self._heads, len(outs), width, height, conf_threshold, self.nms_threshold,
+                1 if self.per_class_nms else 0)
+        n = self._native.roi_yolo_decode(*args, self._dets, len(self._dets))
+        if n > len(self._dets):
+            # 返回值是截断前的总数：缓冲按 2 的幂扩大后重新解码，之后一直沿用
+            log.info('%d detections exceed the decode buffer of %d, growing it', n, len(self._dets))
+            self._dets = (native.RoiDetection * (1 << (n - 1).bit_length()))()
+            n = self._native.roi_yolo_decode(*args, self._dets, len(self._dets))
+        return [(d.class_id, d.confidence, [d.x, d.y, d.w, d.h]) for d in self._dets[:n]]
+
+    def _decode(self, outs, width, height, conf_threshold):
         class_ids = []
         confidences = []
         boxes = []
-        conf_threshold = 0.5
-        nms_threshold = 0.4
+        nms_threshold = self.nms_threshold
 
         # 解析预测结果
         for out in outs:
@@ -55,22 +216,24 @@ class Processor:
                     # cv2.rectangle(frame, (left, top), (right, bottom), (0, 255, 0), 2)
                     # cv2.putText(frame, self.classes[class_id], (left, top - 10), cv2
 
-        indices = cv2.dnn.NMSBoxes(boxes, confidences, conf_threshold, nms_threshold)
+        if not boxes:
+            return []
+        if self.per_class_nms and hasattr(cv2.dnn, 'NMSBoxesBatched'):
+            indices = cv2.dnn.NMSBoxesBatched(boxes, confidences, class_ids, conf_threshold, nms_threshold)
+        else:
+            indices = cv2.dnn.NMSBoxes(boxes, confidences, conf_threshold, nms_threshold)
+
+        # 不同版本的 OpenCV 返回 (N, 1) 或 (N,)，统一展平
+        return [(class_ids[i], confidences[i], boxes[i]) for i in np.array(indices, dtype=np.int64).flatten()]
 
-        for i in indices:
-            i = i[0]
-            box = boxes[i]
+    def process_frame(self, frame):
+        for class_id, confidence, box in self.detect(frame):
             x, y, w, h = box[0], box[1], box[2], box[3]
 
-            self.draw_prediction(frame, class_ids[i], confidences[i], round(x), round(y), round(x + w), round(y + h))
+            self.draw_prediction(frame, class_id, confidence, round(x), round(y), round(x + w), round(y + h))
 
         return frame
 
-    def get_output_layers(self):
-        layer_names = self.net.getLayerNames()
-        output_layers = [layer_names[i[0] - 1] for i in self.net.getUnconnectedOutLayers()]
-        return output_layers
-
     def draw_prediction(self, img, class_id, confidence, x, y, x_plus_w, y_plus_h):
         label = str(self.classes[class_id])
         color = (0, 255, 0)
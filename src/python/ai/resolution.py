@@ -0,0 +1,73 @@
+class ResolutionPolicy:
+    """按路选择检测器的网络输入尺寸（Processor.input_sizes 中的一个）
+
+    每次检测后根据结果和耗时调整下一次的尺寸：
+    - 推理耗时的滑动平均超过 budget_ms（系统过载）时降一档，回落到 budget_ms 的 70% 以下才允许升档；
+    - 连续 empty_runs 次没有检测到目标时降到最小的尺寸，一旦出现目标回到默认尺寸；
+    - 最小目标在网络输入上的短边不足 small_pixels 时升一档，小目标因此还能被检出；
+      所有目标在低一档尺寸下仍大于 large_pixels 时降一档，省下算力。
+    两次切换之间至少隔 min_dwell 次检测，避免在两档之间来回跳。
+    """
+
+    def __init__(self, sizes, default=None, budget_ms=None, empty_runs=10, small_pixels=16, large_pixels=64,
+                 min_dwell=5, smoothing=0.2):
+        self.sizes = sorted((tuple(s) for s in sizes), key=lambda s: s[0] * s[1])
+        self.default = self.sizes.index(tuple(default)) if default else len(self.sizes) // 2
+        self.budget_ms = budget_ms
+        self.empty_runs = max(1, int(empty_runs))
+        self.small_pixels = small_pixels
+        self.large_pixels = large_pixels
+        self.min_dwell = max(1, int(min_dwell))
+        self.smoothing = smoothing
+        self.level = self.default
+        self.latency_ms = 0.0
+        self.switches = 0
+        self._empty = 0
+        self._dwell = 0
+
+    @property
+    def size(self):
+        return self.sizes[self.level]
+
+    def observe(self, detections, frame_width, frame_height, elapsed_ms):
+        """一次检测完成：detections 为原图坐标的检测结果，elapsed_ms 为这次 detect() 的耗时"""
+        a = self.smoothing
+        self.latency_ms = elapsed_ms if self.latency_ms == 0.0 else (1 - a) * self.latency_ms + a * elapsed_ms
+        self._dwell += 1
+        self._empty = 0 if detections else self._empty + 1
+        level = self._target(detections, frame_width, frame_height)
+        if level == self.level:
+            return
+        # 场景从空变为有目标时立即恢复，其余切换受 min_dwell 限制
+        if self._dwell < self.min_dwell and not (detections and self.level < self.default <= level):
+            return
+        self.level = level
+        self.switches += 1
+        self._dwell = 0
+
+    def _target(self, detections, frame_width, frame_height):
+        top = len(self.sizes) - 1
+        overloaded = self.budget_ms is not None and self.latency_ms > self.budget_ms
+        if overloaded:
+            return max(0, self.level - 1)
+        headroom = self.budget_ms is None or self.latency_ms < 0.7 * self.budget_ms
+        if not detections:
+            return 0 if self._empty >= self.empty_runs else self.level
+        level = max(self.level, self.default) if self.level < self.default and headroom else self.level
+        # 最小目标的短边换算到当前网络输入上的像素数
+        net_w, net_h = self.sizes[level]
+        smallest = min(min(w * net_w / frame_width, h * net_h / frame_height) for _, _, (_, _, w, h) in detections)
+        if smallest < self.small_pixels and level < top and headroom:
+            return level + 1
+        if level > 0:
+            lower_w, lower_h = self.sizes[level - 1]
+            if smallest * min(lower_w / net_w, lower_h / net_h) > self.large_pixels:
+                return level - 1
+        return level
+
+    def stats(self):
+        return {
+            'input_size': '%dx%d' % self.size,
+            'latency_ms': round(self.latency_ms, 2),
+            'switches': self.switches,
+        }
@@ -0,0 +1,54 @@
+import numpy as np
+
+
+class DetectionScheduler:
+    """决定哪些帧运行检测器，其余帧由跟踪器外推
+
+    固定模式每 interval 帧检测一次（interval=1 即每帧检测）。
+    自适应模式下比较当前帧与上次检测帧的低分辨率亮度图：平均差超过 motion_threshold
+    时立即检测，场景静止时最多隔 max_interval 帧检测一次，两次检测至少相隔 min_interval 帧。
+    帧间隔按 frame.index 计算，推理队列丢掉的帧也算在内。
+    """
+
+    def __init__(self, interval=1, adaptive=False, motion_threshold=6.0, min_interval=2, max_interval=30,
+                 motion_width=80):
+        self.interval = max(1, int(interval))
+        self.adaptive = adaptive
+        self.motion_threshold = motion_threshold
+        self.min_interval = max(1, int(min_interval))
+        self.max_interval = max(self.min_interval, int(max_interval))
+        self.motion_width = motion_width
+        self.last_index = None
+        self.motion = 0.0
+        self._reference = None
+
+    def should_detect(self, frame):
+        if self.last_index is None:
+            return True
+        gap = frame.index - self.last_index
+        if not self.adaptive:
+            return gap >= self.interval
+        if gap < self.min_interval:
+            return False
+        if gap >= self.max_interval:
+            return True
+        thumb = self.thumbnail(frame)
+        if self._reference is None or thumb.shape != self._reference.shape:
+            return True
+        self.motion = float(np.mean(np.abs(thumb - self._reference)))
+        return self.motion >= self.motion_threshold
+
+    def detected(self, frame):
+        """检测器在这一帧上运行过"""
+        self.last_index = frame.index
+        if self.adaptive:
+            self._reference = self.thumbnail(frame)
+
+    def thumbnail(self, frame):
+        """抽点得到的低分辨率亮度图；原生帧直接取 NV12 的 Y 平面，不做颜色转换"""
+        if frame.native is not None and frame.native.y is not None:
+            luma = frame.native.y
+        else:
+            luma = frame.bgr()[:, :, 1]  # 绿色通道近似亮度
+        step = max(1, luma.shape[1] // self.motion_width)
+        return luma[::step, ::step].astype(np.int16)
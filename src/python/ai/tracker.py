@@ -0,0 +1,134 @@
+import numpy as np
+
+
+def iou(a, b):
+    """两个 [x, y, w, h] 框的交并比"""
+    ax2, ay2 = a[0] + a[2], a[1] + a[3]
+    bx2, by2 = b[0] + b[2], b[1] + b[3]
+    iw = min(ax2, bx2) - max(a[0], b[0])
+    ih = min(ay2, by2) - max(a[1], b[1])
+    if iw <= 0 or ih <= 0:
+        return 0.0
+    inter = iw * ih
+    return inter / (a[2] * a[3] + b[2] * b[3] - inter)
+
+
+class KalmanBox:
+    """匀速模型的框滤波器，状态为 [cx, cy, w, h, vx, vy, vw, vh]，时间单位是帧"""
+
+    def __init__(self, box, process_noise=1.0, measure_noise=4.0):
+        x, y, w, h = (float(v) for v in box)
+        self.x = np.array([x + w / 2, y + h / 2, w, h, 0, 0, 0, 0], dtype=np.float64)
+        self.P = np.diag([measure_noise, measure_noise, measure_noise, measure_noise, 100, 100, 25, 25])
+        self.q = process_noise
+        self.R = np.eye(4) * measure_noise
+        self.H = np.eye(4, 8)
+
+    def predict(self, dt=1):
+        if dt <= 0:
+            return
+        F = np.eye(8)
+        F[0, 4] = F[1, 5] = F[2, 6] = F[3, 7] = dt
+        self.x = F @ self.x
+        # 尺寸不允许外推成负数
+        self.x[2] = max(self.x[2], 1.0)
+        self.x[3] = max(self.x[3], 1.0)
+        Q = np.eye(8) * self.q
+        Q[4:, 4:] *= 0.1
+        self.P = F @ self.P @ F.T + Q * dt
+
+    def update(self, box):
+        x, y, w, h = (float(v) for v in box)
+        z = np.array([x + w / 2, y + h / 2, w, h])
+        S = self.H @ self.P @ self.H.T + self.R
+        K = self.P @ self.H.T @ np.linalg.inv(S)
+        self.x = self.x + K @ (z - self.H @ self.x)
+        self.P = (np.eye(8) - K @ self.H) @ self.P
+
+    def box(self):
+        cx, cy, w, h = self.x[:4]
+        return [cx - w / 2, cy - h / 2, w, h]
+
+
+class Track:
+    __slots__ = ('id', 'class_id', 'confidence', 'filter', 'frame_index', 'hits', 'misses')
+
+    def __init__(self, track_id, class_id, confidence, box, frame_index):
+        self.id = track_id
+        self.class_id = class_id
+        self.confidence = confidence
+        self.filter = KalmanBox(box)
+        self.frame_index = frame_index
+        self.hits = 1
+        self.misses = 0
+
+    def advance(self, frame_index):
+        self.filter.predict(frame_index - self.frame_index)
+        self.frame_index = frame_index
+
+    def detection(self):
+        return self.class_id, self.confidence, self.filter.box()
+
+
+class IouTracker:
+    """检测帧之间外推检测框的轻量跟踪器（IoU 关联 + 卡尔曼匀速预测）
+
+    update() 在跑了检测器的帧上调用，按 IoU 贪心关联同类框；predict() 在其余帧上调用，
+    只做卡尔曼预测，不需要图像。输出与 Processor.detect() 相同的
+    [(class_id, confidence, [x, y, w, h]), ...]，可以直接交给 ROI 编码器。
+    连续 max_misses 次检测都没关联上的轨迹被删除。
+    """
+
+    def __init__(self, iou_threshold=0.3, max_misses=2):
+        self.iou_threshold = iou_threshold
+        self.max_misses = max_misses
+        self.tracks = []
+        self._next_id = 1
+
+    def update(self, detections, frame_index):
+        for track in self.tracks:
+            track.advance(frame_index)
+        predicted = [track.filter.box() for track in self.tracks]
+        pairs = []
+        for ti, track in enumerate(self.tracks):
+            for di, (class_id, _, box) in enumerate(detections):
+                if class_id != track.class_id:
+                    continue
+                score = iou(predicted[ti], box)
+                if score >= self.iou_threshold:
+                    pairs.append((score, ti, di))
+        pairs.sort(reverse=True)
+        matched_tracks = set()
+        matched_dets = set()
+        for _, ti, di in pairs:
+            if ti in matched_tracks or di in matched_dets:
+                continue
+            matched_tracks.add(ti)
+            matched_dets.add(di)
+            track = self.tracks[ti]
+            _, confidence, box = detections[di]
+            track.filter.update(box)
+            track.confidence = confidence
+            track.hits += 1
+            track.misses = 0
+        for ti, track in enumerate(self.tracks):
+            if ti not in matched_tracks:
+                track.misses += 1
+        self.tracks = [t for t in self.tracks if t.misses < self.max_misses]
+        for di, (class_id, confidence, box) in enumerate(detections):
+            if di not in matched_dets:
+                self.tracks.append(Track(self._next_id, class_id, confidence, box, frame_index))
+                self._next_id += 1
+        return self.detections()
+
+    def predict(self, frame_index):
+        for track in self.tracks:
+            track.advance(frame_index)
+        return self.detections()
+
+    def detections(self):
+        # 本次检测没关联上的轨迹仍保留一段时间，避免漏检一帧时 ROI 闪烁
+        return [track.detection() for track in self.tracks]
+
+    def reset(self):
+        self.tracks = []
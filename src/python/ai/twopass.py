@@ -0,0 +1,142 @@
+import cv2
+
+from src.python.ai.classes import ClassConfig
+from src.python.ai.preprocess import Crop, image_size
+
+
+def _iou(a, b):
+    ax, ay, aw, ah = a
+    bx, by, bw, bh = b
+    iw = min(ax + aw, bx + bw) - max(ax, bx)
+    ih = min(ay + ah, by + bh) - max(ay, by)
+    if iw <= 0 or ih <= 0:
+        return 0.0
+    inter = iw * ih
+    return inter / (aw * ah + bw * bh - inter)
+
+
+class TwoPassDetector:
+    """两遍检测：低分辨率找行人 / 车辆，再在它们周围按原图分辨率裁剪跑人脸模型
+
+    1080p 整帧缩到 416x416 时远处的人脸只剩几个像素，检不出来也就拿不到 ROI；整帧用高分辨率
+    又太贵。第一遍 coarse 在整帧上找较大的目标（人、车），第二遍 fine 只在这些目标外扩
+    context 倍后的区域上运行，所有裁剪合成一批 forward。裁剪来自原图，不先缩小：
+    ndarray 用切片视图，DecodedFrame 用 Crop 直接从 NV12 平面缩放（见 preprocess.Crop）。
+
+    输出的类别号先排 fine 的类别、再排 coarse 的类别（class_config 即两者拼接），
+    coarse 的检测结果照常输出，自身也可以作为 ROI。接口与 Processor 一致，可以直接交给
+    InferenceStage 或 BatchInference。
+    """
+
+    def __init__(self, coarse, fine, triggers=None, context=0.3, min_crop=64, max_crops=8, merge_overlap=0.5,
+                 nms_threshold=0.4):
+        """coarse / fine 为 Processor；triggers 为触发第二遍的 coarse 类名，None 时为所有作为 ROI 的类"""
+        self.coarse = coarse
+        self.fine = fine
+        self.context = context
+        self.min_crop = min_crop
+        self.max_crops = max(1, int(max_crops))
+        self.merge_overlap = merge_overlap
+        self.nms_threshold = nms_threshold
+        self.offset = len(fine.class_config)
+        specs = coarse.class_config.specs
+        if triggers is None:
+            self.triggers = {i for i, spec in enumerate(specs) if spec.qp_delta is not None}
+        else:
+            self.triggers = {i for i, spec in enumerate(specs) if spec.name in set(triggers)}
+        self.class_config = ClassConfig(fine.class_config.specs + specs, fine.class_config.default)
+        self.classes = self.class_config.names
+        self.input_sizes = coarse.input_sizes
+        self.crops = 0
+        self.fine_runs = 0
+
+    @property
+    def backend(self):
+        return self.coarse.backend
+
+    @property
+    def accepts_native(self):
+        return self.coarse.accepts_native and self.fine.accepts_native
+
+    def warmup(self):
+        return self.coarse.warmup() + self.fine.warmup()
+
+    def detect(self, frame, size=None, owner=None):
+        return self.detect_batch([frame], None if size is None else [size])[0]
+
+    def detect_batch(self, frames, sizes=None):
+        firsts = self.coarse.detect_batch(frames, sizes)
+        # 所有帧的裁剪合成一批，按 fine 的输入尺寸分组（见 Processor.detect_batch）
+        crops = []
+        owners = []
+        for i, (frame, dets) in enumerate(zip(frames, firsts)):
+            for x, y, w, h in self._regions(frame, dets):
+                crops.append(Crop(frame, x, y, w, h) if hasattr(frame, 'handle') else frame[y:y + h, x:x + w])
+                owners.append((i, x, y))
+        results = [[(class_id + self.offset, confidence, box) for class_id, confidence, box in dets]
+                   for dets in firsts]
+        if not crops:
+            return results
+        self.crops += len(crops)
+        self.fine_runs += 1
+        fine_sizes = [self._fine_size(image_size(crop)) for crop in crops] if len(self.fine.input_sizes) > 1 else None
+        seconds = [[] for _ in frames]
+        for (i, ox, oy), dets in zip(owners, self.fine.detect_batch(crops, fine_sizes)):
+            seconds[i].extend((class_id, confidence, [x + ox, y + oy, w, h]) for class_id, confidence, (x, y, w, h)
+                              in dets)
+        for i, dets in enumerate(seconds):
+            results[i] = self._suppress(dets) + results[i]
+        return results
+
+    def _regions(self, frame, detections):
+        """触发类的检测框外扩后对齐成偶数坐标的裁剪区域，重叠较多的区域合并"""
+        width, height = image_size(frame)
+        boxes = sorted((d for d in detections if d[0] in self.triggers), key=lambda d: -d[1])
+        regions = []
+        for _, _, (x, y, w, h) in boxes[:self.max_crops]:
+            side = max(self.min_crop, w, h) * self.context
+            regions.append([max(0.0, x - side), max(0.0, y - side), min(width, x + w + side),
+                            min(height, y + h + side)])
+        merged = []
+        for r in regions:
+            for m in merged:
+                ix = min(r[2], m[2]) - max(r[0], m[0])
+                iy = min(r[3], m[3]) - max(r[1], m[1])
+                smaller = min((r[2] - r[0]) * (r[3] - r[1]), (m[2] - m[0]) * (m[3] - m[1]))
+                if ix > 0 and iy > 0 and ix * iy > self.merge_overlap * smaller:
+                    m[:] = [min(r[0], m[0]), min(r[1], m[1]), max(r[2], m[2]), max(r[3], m[3])]
+                    break
+            else:
+                merged.append(r)
+        out = []
+        for x0, y0, x1, y1 in merged:
+            x0, y0 = int(x0) & ~1, int(y0) & ~1
+            x1, y1 = min(width, int(x1 + 0.5)), min(height, int(y1 + 0.5))
+            if x1 - x0 >= 8 and y1 - y0 >= 8:
+                out.append((x0, y0, x1 - x0, y1 - y0))
+        return out
+
+    def _fine_size(self, crop_size):
+        # 够放下裁剪的最小输入尺寸：小裁剪不必放大到最大的网络
+        longest = max(crop_size)
+        for size in self.fine.input_sizes:
+            if size[0] >= longest and size[1] >= longest:
+                return size
+        return self.fine.input_sizes[-1]
+
+    def _suppress(self, detections):
+        """相邻裁剪有重叠，同一张脸可能被检出两次，按置信度保留一个"""
+        kept = []
+        for det in sorted(detections, key=lambda d: -d[1]):
+            if all(k[0] != det[0] or _iou(k[2], det[2]) <= self.nms_threshold for k in kept):
+                kept.append(det)
+        return kept
+
+    def stats(self):
+        return {'crops': self.crops, 'fine_runs': self.fine_runs}
+
+    def draw_prediction(self, img, class_id, confidence, x, y, x_plus_w, y_plus_h):
+        label = str(self.classes[class_id])
+        color = (0, 255, 0) if class_id < self.offset else (255, 128, 0)
+        cv2.rectangle(img, (x, y), (x_plus_w, y_plus_h), color, 2)
+        cv2.putText(img, label, (x - 10, y - 10), cv2.FONT_HERSHEY_SIMPLEX, 0.5, color, 2)
@@ -0,0 +1,99 @@
+import struct
+
+MAGIC = b'ROIAU01'
+CODEC_H264 = 1
+CODEC_H265 = 2
+KEY_FRAME = 1  # 与原生 AccessUnitView 的 kAuKeyFrame 一致
+
+_RECORD = struct.Struct('<IIqq')
+
+
+class AccessUnit:
+    __slots__ = ('data', 'flags', 'pts', 'arrival_us')
+
+    def __init__(self, data, flags, pts, arrival_us):
+        self.data = data
+        self.flags = flags
+        self.pts = pts
+        self.arrival_us = arrival_us
+
+    @property
+    def key(self):
+        return bool(self.flags & KEY_FRAME)
+
+
+class Capture:
+    """rtsp_client 录下的 .au 抓包（格式见 src/cpp/tools/rtsp_client_main.cpp）
+
+    整个文件读进内存：回放时按 pts 定时发送，不能被磁盘读取拖慢。pts 统一平移到从 0 开始。
+    """
+
+    def __init__(self, path):
+        self.path = path
+        with open(path, 'rb') as f:
+            blob = f.read()
+        if len(blob) < 8 or blob[:7] != MAGIC:
+            raise ValueError('%s: not a ROIAU01 capture' % path)
+        self.codec = blob[7]
+        if self.codec not in (CODEC_H264, CODEC_H265):
+            raise ValueError('%s: unknown codec %d' % (path, self.codec))
+        self.units = []
+        off = 8
+        base = None
+        while off + _RECORD.size <= len(blob):
+            size, flags, pts, arrival_us = _RECORD.unpack_from(blob, off)
+            off += _RECORD.size
+            if off + size > len(blob):
+                break  # 录制中途被打断的最后一个 AU
+            if base is None:
+                base = pts
+            self.units.append(AccessUnit(blob[off:off + size], flags, pts - base, arrival_us))
+            off += size
+        if not self.units:
+            raise ValueError('%s: no access units' % path)
+
+    @property
+    def codec_name(self):
+        return 'h265' if self.codec == CODEC_H265 else 'h264'
+
+    @property
+    def duration(self):
+        """一轮回放的 90kHz 时长：最后一个 AU 的 pts 加一个平均帧间隔"""
+        if len(self.units) < 2:
+            return 3600
+        last = self.units[-1].pts
+        return last + last // (len(self.units) - 1)
+
+    def parameter_sets(self):
+        """第一个关键帧里的参数集 NAL：H.264 为 (sps, pps)，H.265 为 (vps, sps, pps)，缺的为 None"""
+        found = {}
+        for nal in split_nals(next(u for u in self.units if u.key).data):
+            if self.codec == CODEC_H265:
+                kind = {32: 'vps', 33: 'sps', 34: 'pps'}.get((nal[0] >> 1) & 0x3f)
+            else:
+                kind = {7: 'sps', 8: 'pps'}.get(nal[0] & 0x1f)
+            if kind and kind not in found:
+                found[kind] = nal
+        names = ('vps', 'sps', 'pps') if self.codec == CODEC_H265 else ('sps', 'pps')
+        return tuple(found.get(k) for k in names)
+
+    def write_annexb(self, path):
+        """把码流写成裸 Annex-B 文件，质量评估时作为参考解码"""
+        with open(path, 'wb') as f:
+            for unit in self.units:
+                f.write(unit.data)
+
+
+def split_nals(data):
+    """按 00 00 01 / 00 00 00 01 起始码切分 Annex-B，返回不含起始码的 NAL 列表"""
+    nals = []
+    pos = data.find(b'\x00\x00\x01')
+    while pos >= 0:
+        start = pos + 3
+        pos = data.find(b'\x00\x00\x01', start)
+        end = len(data) if pos < 0 else pos
+        # 四字节起始码的前导 0 和 NAL 末尾的 trailing zero 一起去掉
+        nal = data[start:end].rstrip(b'\x00') if pos >= 0 else data[start:end]
+        if nal:
+            nals.append(nal)
+    return nals
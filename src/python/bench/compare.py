@@ -0,0 +1,84 @@
+import argparse
+import json
+import sys
+
+# 端到端结果里参与比较的指标：(路径, 越大越好)
+E2E_METRICS = (
+    ('fps', True),
+    ('latency_p50_ms', False),
+    ('latency_p99_ms', False),
+    ('cpu_pct_mean', False),
+    ('rss_peak_mb', False),
+    ('publish_age.p99_ms', False),
+    ('quality.psnr_y', True),
+    ('quality.roi_psnr_y', True),
+    ('quality.vmaf', True),
+)
+# PSNR / VMAF 的绝对差，小于它不算变化（单位分别是 dB 和 VMAF 分）
+QUALITY_TOLERANCE = 0.3
+
+
+def _get(results, path):
+    value = results
+    for key in path.split('.'):
+        if not isinstance(value, dict) or value.get(key) is None:
+            return None
+        value = value[key]
+    return value
+
+
+def compare_micro(base, new, threshold):
+    """按用例名对比 ns_per_op；两边都有的用例才比较"""
+    old = {r['name']: r for r in base['results']}
+    rows = []
+    for r in new['results']:
+        b = old.get(r['name'])
+        if b is None or not b['ns_per_op']:
+            continue
+        ratio = r['ns_per_op'] / b['ns_per_op']
+        rows.append((r['name'], b['ns_per_op'], r['ns_per_op'], ratio, ratio > 1 + threshold))
+    return rows
+
+
+def compare_e2e(base, new, threshold):
+    rows = []
+    for path, higher_better in E2E_METRICS:
+        b, n = _get(base['results'], path), _get(new['results'], path)
+        if b is None or n is None:
+            continue
+        ratio = n / b if b else float('inf') if n else 1.0
+        if path.startswith('quality.'):
+            worse = (b - n if higher_better else n - b) > QUALITY_TOLERANCE
+        else:
+            worse = ratio < 1 - threshold if higher_better else ratio > 1 + threshold
+        rows.append((path, b, n, ratio, worse))
+    return rows
+
+
+def main():
+    parser = argparse.ArgumentParser(description='对比两次基准结果（roi_bench 或 bench.e2e 的 JSON），有回退时退出码为 1')
+    parser.add_argument('baseline')
+    parser.add_argument('candidate')
+    parser.add_argument('--threshold', type=float, default=0.10, help='相对变化超过多少算回退（默认 0.10）')
+    args = parser.parse_args()
+    with open(args.baseline) as f:
+        base = json.load(f)
+    with open(args.candidate) as f:
+        new = json.load(f)
+    if base.get('bench') != new.get('bench'):
+        raise SystemExit('cannot compare %s results with %s results' % (base.get('bench'), new.get('bench')))
+    if base.get('host') != new.get('host') or base.get('cpu_model') != new.get('cpu_model'):
+        print('warning: results come from different hosts (%s / %s)' % (base.get('host'), new.get('host')))
+    rows = (compare_micro if base['bench'] == 'micro' else compare_e2e)(base, new, args.threshold)
+    width = max([len(r[0]) for r in rows] + [6])
+    print('%-*s %14s %14s %8s' % (width, 'metric', 'baseline', 'candidate', 'ratio'))
+    for name, b, n, ratio, worse in rows:
+        print('%-*s %14.4g %14.4g %8.3f%s' % (width, name, b, n, ratio, '  REGRESSION' if worse else ''))
+    regressions = sum(1 for r in rows if r[4])
+    if regressions:
+        print('%d regression(s) beyond %.0f%%' % (regressions, 100 * args.threshold))
+    sys.exit(1 if regressions else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,290 @@
+import argparse
+import bisect
+import json
+import logging
+import os
+import platform
+import re
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+import urllib.request
+
+from .capture import Capture
+from .replay import ReplayServer
+from .rtmp_sink import RtmpSink
+
+log = logging.getLogger(__name__)
+
+REPO = os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..', '..'))
+CLOCK_TICKS = os.sysconf('SC_CLK_TCK')
+SAMPLE_INTERVAL = 0.5
+STARTUP_GRACE = 60.0
+
+_BUCKET = re.compile(r'^(\w+)_bucket\{(.*),le="([^"]+)"\} (\d+)$')
+
+
+def _free_port():
+    with socket.socket() as s:
+        s.bind(('127.0.0.1', 0))
+        return s.getsockname()[1]
+
+
+def _percentile(values, q):
+    if not values:
+        return None
+    values = sorted(values)
+    return values[min(len(values) - 1, int(q * len(values)))]
+
+
+class ProcessSampler:
+    """按 /proc/<pid> 采样进程的 CPU 占用（所有线程合计，100% 为一个核）和常驻内存"""
+
+    def __init__(self, pid):
+        self.pid = pid
+        self.samples = []  # (时刻, cpu%, rss MB)
+        self._last = None
+
+    def _cpu_seconds(self):
+        with open('/proc/%d/stat' % self.pid) as f:
+            fields = f.read().rsplit(')', 1)[1].split()
+        return (int(fields[11]) + int(fields[12])) / CLOCK_TICKS  # utime + stime
+
+    def _status(self, key):
+        with open('/proc/%d/status' % self.pid) as f:
+            for line in f:
+                if line.startswith(key + ':'):
+                    return int(line.split()[1]) / 1024.0
+        return 0.0
+
+    def sample(self):
+        try:
+            now = time.perf_counter()
+            cpu = self._cpu_seconds()
+            rss = self._status('VmRSS')
+        except (OSError, IndexError, ValueError):
+            return
+        if self._last is not None and now > self._last[0]:
+            self.samples.append((now, 100.0 * (cpu - self._last[1]) / (now - self._last[0]), rss))
+        self._last = (now, cpu)
+
+    def peak_rss(self):
+        try:
+            return self._status('VmHWM')
+        except OSError:
+            return max((s[2] for s in self.samples), default=0.0)
+
+    def summary(self, since):
+        cpu = [s[1] for s in self.samples if s[0] >= since]
+        rss = [s[2] for s in self.samples if s[0] >= since]
+        return {'cpu_pct_mean': round(sum(cpu) / len(cpu), 1) if cpu else None,
+                'cpu_pct_max': round(max(cpu), 1) if cpu else None,
+                'rss_mb_mean': round(sum(rss) / len(rss), 1) if rss else None}
+
+
+def scrape_age(port, stage='publish'):
+    """从 main.py 的 /metrics 取某个阶段的帧年龄直方图，按桶估计 p50/p99（毫秒）"""
+    try:
+        with urllib.request.urlopen('http://127.0.0.1:%d/metrics' % port, timeout=2) as resp:
+            text = resp.read().decode()
+    except OSError as e:
+        log.warning('metrics scrape failed: %s', e)
+        return None
+    buckets = []
+    for line in text.splitlines():
+        m = _BUCKET.match(line)
+        if m and m.group(1) == 'roi_frame_age_seconds' and 'stage="%s"' % stage in m.group(2):
+            bound = float('inf') if m.group(3) == '+Inf' else float(m.group(3))
+            buckets.append((bound, int(m.group(4))))
+    if not buckets or not buckets[-1][1]:
+        return None
+    total = buckets[-1][1]
+
+    def quantile(q):
+        rank = q * total
+        lo, seen = 0.0, 0
+        for bound, cumulative in buckets:
+            if cumulative >= rank:
+                if bound == float('inf'):
+                    return lo
+                return lo + (bound - lo) * (rank - seen) / max(1, cumulative - seen)
+            lo, seen = bound, cumulative
+        return lo
+
+    return {'count': total, 'p50_ms': round(1000 * quantile(0.5), 2), 'p99_ms': round(1000 * quantile(0.99), 2)}
+
+
+def match_latency(sent, frames, since):
+    """把输出帧按 pts 对回回放端的发送时刻，返回 warmup 之后每帧的端到端时延（毫秒）
+
+    RTMP 时间戳从第一个编码帧的 dts 起算。回放从关键帧开始，流水线在第一帧编码之前不丢帧
+    （编码和推流队列都是背压），所以输出的时间戳 0 就是抓包的 pts 0，换回 90kHz 时最多差 1ms，
+    在已发送的 pts 里找最近的一个。
+    """
+    sent = sorted(sent)
+    keys = [p for p, _ in sent]
+    out = []
+    for frame in frames:
+        if frame.received < since:
+            continue
+        target = frame.pts_ms * 90
+        i = bisect.bisect_left(keys, target - 90)
+        if i < len(keys) and abs(keys[i] - target) <= 90:
+            out.append(1000.0 * (frame.received - sent[i][1]))
+    return out
+
+
+def host_info():
+    cpu_model = platform.processor()
+    try:
+        with open('/proc/cpuinfo') as f:
+            for line in f:
+                if line.lower().startswith(('model name', 'hardware')):
+                    cpu_model = line.split(':', 1)[1].strip()
+                    break
+    except OSError:
+        pass
+    try:
+        rev = subprocess.run(['git', 'rev-parse', '--short', 'HEAD'], cwd=REPO, capture_output=True, text=True,
+                             timeout=10).stdout.strip() or None
+    except (OSError, subprocess.SubprocessError):
+        rev = None
+    return {'host': platform.node(), 'machine': platform.machine(), 'cpus': os.cpu_count(), 'cpu_model': cpu_model,
+            'git': rev}
+
+
+def run(args, extra):
+    capture = Capture(args.capture)
+    speed = 0.0 if args.speed == 'max' else float(args.speed)
+    workdir = args.workdir or tempfile.mkdtemp(prefix='roi-e2e-')
+    os.makedirs(workdir, exist_ok=True)
+    flv = os.path.join(workdir, 'output.flv') if args.quality else None
+    rois = os.path.join(workdir, 'rois.jsonl')
+    metrics_port = _free_port()
+
+    sink = RtmpSink(flv_path=flv).start()
+    replay = ReplayServer(capture, speed=speed, loops=args.loops).start()
+    cmd = [args.python, os.path.join(REPO, 'main.py'), '--source', replay.url, '--rtmp', sink.url, '--headless',
+           '--metrics-port', str(metrics_port), '--roi-log', rois, '--stats-interval', '0']
+    if '--codec' not in extra:
+        cmd += ['--codec', capture.codec_name]
+    cmd += extra
+    log.info('running %s', ' '.join(cmd))
+    with open(os.path.join(workdir, 'main.log'), 'w') as main_log:
+        proc = subprocess.Popen(cmd, cwd=REPO, stdout=main_log, stderr=subprocess.STDOUT)
+    sampler = ProcessSampler(proc.pid)
+    started = time.perf_counter()
+    peak_rss = 0.0
+    age = None
+    try:
+        # 回放发完后再等输出停止增长（编码和推流队列排空），或者 main.py 自己退出；
+        # 还没有任何输出时（模型加载慢、推流端还没连上）多等 STARTUP_GRACE 秒
+        deadline = None
+        last_frames = -1
+        while proc.poll() is None:
+            time.sleep(SAMPLE_INTERVAL)
+            sampler.sample()
+            peak_rss = max(peak_rss, sampler.peak_rss())
+            if time.perf_counter() - started > args.timeout:
+                log.warning('timed out after %.0fs', args.timeout)
+                break
+            if not replay.done.is_set():
+                continue
+            if deadline is None:
+                deadline = time.perf_counter() + args.drain
+            now = time.perf_counter()
+            if len(sink.frames) == last_frames and now >= deadline and (last_frames > 0 or
+                                                                      now >= deadline + STARTUP_GRACE):
+                break
+            last_frames = len(sink.frames)
+        age = scrape_age(metrics_port)
+    finally:
+        if proc.poll() is None:
+            proc.terminate()
+            try:
+                proc.wait(timeout=15)
+            except subprocess.TimeoutExpired:
+                proc.kill()
+                proc.wait()
+        replay.stop()
+        sink.stop()
+
+    frames = list(sink.frames)
+    first = replay.sent[0][1] if replay.sent else started
+    since = first + args.warmup
+    steady = [f for f in frames if f.received >= since]
+    latency = match_latency(replay.sent, frames, since)
+    result = {
+        'frames_sent': len(replay.sent),
+        'frames_received': len(frames),
+        'fps': None,
+        'latency_p50_ms': None,
+        'latency_p99_ms': None,
+        'latency_matched': len(latency),
+        'bitrate_kbps': sink.stats().get('kbps'),
+        'rss_peak_mb': round(peak_rss, 1),
+        'publish_age': age,
+        'exit_code': proc.returncode,
+    }
+    if len(steady) > 1:
+        span = steady[-1].received - steady[0].received
+        if span > 0:
+            result['fps'] = round((len(steady) - 1) / span, 2)
+    if latency:
+        result['latency_p50_ms'] = round(_percentile(latency, 0.5), 2)
+        result['latency_p99_ms'] = round(_percentile(latency, 0.99), 2)
+    result.update(sampler.summary(since))
+    if replay.error or sink.error:
+        result['errors'] = [e for e in (replay.error, sink.error) if e]
+    if args.quality and frames:
+        from .quality import RoiLog, evaluate
+
+        roi_log = RoiLog(rois) if os.path.exists(rois) and os.path.getsize(rois) else None
+        result['quality'] = evaluate(capture, flv, frames, roi_log, workdir, step=args.quality_step,
+                                     vmaf=not args.no_vmaf)
+
+    report = {'schema': 1, 'bench': 'e2e', 'time': time.strftime('%Y-%m-%dT%H:%M:%S'), **host_info(),
+              'capture': {'path': os.path.abspath(args.capture), 'codec': capture.codec_name,
+                          'access_units': len(capture.units), 'seconds': round(capture.duration / 90000.0, 2)},
+              'speed': args.speed, 'loops': args.loops, 'warmup_s': args.warmup, 'args': extra, 'workdir': workdir,
+              'results': result}
+    return report
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='端到端基准：回放 RTSP 抓包，经 main.py 的完整流水线推到本地 RTMP 接收端，测吞吐、时延、资源和画质',
+        epilog='-- 之后的参数原样交给 main.py，例如 -- --model yolov4-tiny-face --bitrate 1500')
+    parser.add_argument('--capture', required=True, help='rtsp_client 录下的 .au 抓包')
+    parser.add_argument('--speed', default='1', help='回放倍速，max 表示尽快发送（默认 1）')
+    parser.add_argument('--loops', type=int, default=1, help='抓包回放的轮数')
+    parser.add_argument('--warmup', type=float, default=2.0, help='开头多少秒不计入 fps、时延和 CPU')
+    parser.add_argument('--drain', type=float, default=2.0, help='回放结束后等输出排空的最短时间（秒）')
+    parser.add_argument('--timeout', type=float, default=3600.0, help='整个运行的上限（秒）')
+    parser.add_argument('--quality', action='store_true', help='保存输出并与抓包比较 PSNR / ROI PSNR / VMAF（需要 OpenCV）')
+    parser.add_argument('--quality-step', type=int, default=1, help='画质每隔几帧评估一帧')
+    parser.add_argument('--no-vmaf', action='store_true', help='不调用 ffmpeg libvmaf')
+    parser.add_argument('--workdir', default=None, help='存放 main.py 日志、ROI 记录和输出码流的目录（默认临时目录）')
+    parser.add_argument('--python', default=sys.executable, help='运行 main.py 的解释器')
+    parser.add_argument('--out', default=None, help='把结果写成 JSON 文件（默认打印到标准输出）')
+    argv = sys.argv[1:]
+    extra = []
+    if '--' in argv:
+        i = argv.index('--')
+        argv, extra = argv[:i], argv[i + 1:]
+    args = parser.parse_args(argv)
+    logging.basicConfig(level=logging.INFO, format='%(asctime)s %(levelname)s %(name)s: %(message)s')
+    report = run(args, extra)
+    text = json.dumps(report, indent=2, ensure_ascii=False)
+    if args.out:
+        with open(args.out, 'w') as f:
+            f.write(text + '\n')
+        log.info('results written to %s', args.out)
+    else:
+        print(text)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,145 @@
+import bisect
+import json
+import logging
+import math
+import os
+import shutil
+import subprocess
+
+log = logging.getLogger(__name__)
+
+
+class RoiLog:
+    """main.py --roi-log 写出的 JSONL：每行 {"pts": 90kHz, "boxes": [[x, y, w, h], ...]}
+
+    只在检测结果变化时写一行，某个 pts 的 ROI 是不晚于它的最后一行。
+    """
+
+    def __init__(self, path):
+        entries = []
+        with open(path) as f:
+            for line in f:
+                line = line.strip()
+                if line:
+                    item = json.loads(line)
+                    entries.append((int(item['pts']), item['boxes']))
+        entries.sort(key=lambda e: e[0])
+        self._pts = [e[0] for e in entries]
+        self._boxes = [e[1] for e in entries]
+
+    def boxes_at(self, pts):
+        i = bisect.bisect_right(self._pts, pts) - 1
+        return self._boxes[i] if i >= 0 else []
+
+
+def _psnr(mse):
+    return 99.0 if mse <= 1e-10 else 10.0 * math.log10(255.0 * 255.0 / mse)
+
+
+class _Accumulator:
+    """按像素累加平方误差，整段的 PSNR 由总 MSE 计算（避免逐帧 PSNR 平均时完美帧的 99dB 拉高结果）"""
+
+    def __init__(self):
+        self.sq = 0.0
+        self.pixels = 0
+
+    def add(self, sq, pixels):
+        self.sq += float(sq)
+        self.pixels += int(pixels)
+
+    def value(self):
+        return round(_psnr(self.sq / self.pixels), 2) if self.pixels else None
+
+
+def _reference_frames(reference_path, capture):
+    """按显示顺序逐帧解码参考码流，多轮回放时从头再来，pts 接着往后排（90kHz）"""
+    import cv2
+
+    duration = capture.duration
+    loop = 0
+    while True:
+        reader = cv2.VideoCapture(reference_path)
+        for unit in capture.units:
+            ok, frame = reader.read()
+            if not ok:
+                break
+            yield unit.pts + loop * duration, frame
+        reader.release()
+        loop += 1
+
+
+def evaluate(capture, flv_path, frames, rois=None, workdir='.', step=1, vmaf=True):
+    """比较推流输出与抓包原始码流的画质
+
+    frames 为 RtmpSink 按解码顺序记下的视频帧（输出码流不带 B 帧，解码顺序即显示顺序），
+    输出帧和参考帧按 pts 对齐：RTMP 的时间戳从第一个编码帧的 pts 起算，编码阶段和直通
+    都沿用抓包的 pts，所以输出的 pts_ms * 90 就是参考帧的 pts（多轮回放时跨轮累加）。
+    降帧或丢掉的帧不参与比较。step > 1 时每 step 个输出帧评估一帧。
+    返回 PSNR（Y 分量，整帧、ROI 内、ROI 外），以及找得到 ffmpeg libvmaf 时的整帧 VMAF。
+    """
+    import cv2
+    import numpy as np
+
+    reference = os.path.join(workdir, 'reference.' + capture.codec_name)
+    capture.write_annexb(reference)
+    output = cv2.VideoCapture(flv_path)
+    refs = _reference_frames(reference, capture)
+    ref_pts, ref_frame = next(refs, (None, None))
+    # 半个帧间隔以内算同一帧
+    tolerance = max(1, capture.duration // max(1, len(capture.units)) // 2)
+    whole, roi, background = _Accumulator(), _Accumulator(), _Accumulator()
+    compared = 0
+    missing = 0
+    for index, info in enumerate(frames):
+        ok, out = output.read()
+        if not ok:
+            break
+        if index % step:
+            continue
+        target = info.pts_ms * 90
+        while ref_pts is not None and ref_pts < target - tolerance:
+            ref_pts, ref_frame = next(refs, (None, None))
+        if ref_pts is None:
+            break
+        if abs(ref_pts - target) > tolerance or ref_frame.shape != out.shape:
+            missing += 1
+            continue
+        a = cv2.cvtColor(out, cv2.COLOR_BGR2YUV)[:, :, 0].astype(np.float32)
+        b = cv2.cvtColor(ref_frame, cv2.COLOR_BGR2YUV)[:, :, 0].astype(np.float32)
+        diff = (a - b) ** 2
+        whole.add(diff.sum(), diff.size)
+        if rois is not None:
+            mask = np.zeros(diff.shape, dtype=bool)
+            for x, y, w, h in rois.boxes_at(ref_pts % capture.duration):
+                x0, y0 = max(0, int(x)), max(0, int(y))
+                mask[y0:max(y0, int(y + h)), x0:max(x0, int(x + w))] = True
+            inside = int(mask.sum())
+            if inside:
+                roi.add(diff[mask].sum(), inside)
+            background.add(diff[~mask].sum(), diff.size - inside)
+        compared += 1
+    output.release()
+
+    result = {'frames_compared': compared, 'frames_unmatched': missing, 'psnr_y': whole.value(),
+              'roi_psnr_y': roi.value(), 'background_psnr_y': background.value(), 'vmaf': None}
+    if vmaf:
+        result['vmaf'] = _vmaf(flv_path, reference, workdir, len(frames), len(capture.units))
+    return result
+
+
+def _vmaf(flv_path, reference, workdir, output_frames, reference_frames):
+    """ffmpeg libvmaf 的整帧 VMAF；两路都按帧序号对齐，所以只在输出帧与参考帧一一对应时计算"""
+    ffmpeg = shutil.which('ffmpeg')
+    if ffmpeg is None or output_frames != reference_frames:
+        return None
+    log_path = os.path.join(workdir, 'vmaf.json')
+    graph = ('[0:v]setpts=N/(30*TB)[d];[1:v]setpts=N/(30*TB)[r];'
+             '[d][r]libvmaf=log_fmt=json:log_path=%s' % log_path)
+    try:
+        subprocess.run([ffmpeg, '-nostdin', '-loglevel', 'error', '-i', flv_path, '-i', reference,
+                        '-lavfi', graph, '-f', 'null', '-'], check=True, timeout=3600)
+        with open(log_path) as f:
+            return round(json.load(f)['pooled_metrics']['vmaf']['mean'], 2)
+    except (OSError, subprocess.SubprocessError, KeyError, ValueError) as e:
+        log.warning('vmaf unavailable: %s', e)
+        return None
@@ -0,0 +1,230 @@
+import argparse
+import base64
+import logging
+import socket
+import struct
+import threading
+import time
+
+from .capture import CODEC_H265, Capture, split_nals
+
+log = logging.getLogger(__name__)
+
+MTU = 1400  # 单个 RTP 负载的上限，超过的 NAL 按 FU 分片
+PAYLOAD_TYPE = 96
+SSRC = 0x524f4931
+
+
+class ReplayServer:
+    """把 .au 抓包当作 RTSP 摄像头回放（只支持 TCP interleaved，一次服务一个客户端）
+
+    speed 为 1.0 时按抓包的 pts 节奏发送，0 时不等待、尽快发送（受 TCP 背压限制）。
+    回放 loops 轮，每轮的 pts 接着上一轮往后排。每个 AU 最后一个包写入 socket 的时刻
+    按 (pts, 时刻) 记在 sent 里（time.perf_counter），端到端时延从这里算起。
+    """
+
+    def __init__(self, capture, port=0, speed=1.0, loops=1, host='127.0.0.1'):
+        self.capture = capture
+        self.speed = speed
+        self.loops = max(1, int(loops))
+        self.host = host
+        self.sent = []
+        self.done = threading.Event()
+        self.error = None
+        self._listener = socket.socket()
+        self._listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self._listener.bind((host, port))
+        self._listener.listen(1)
+        self.port = self._listener.getsockname()[1]
+        self._stopping = threading.Event()
+        self._lock = threading.Lock()
+        self._conn = None
+        self._thread = None
+
+    @property
+    def url(self):
+        return 'rtsp://%s:%d/replay' % (self.host, self.port)
+
+    def start(self):
+        self._thread = threading.Thread(target=self._serve, name='rtsp-replay', daemon=True)
+        self._thread.start()
+        return self
+
+    def stop(self):
+        self._stopping.set()
+        self._listener.close()
+        conn = self._conn
+        if conn is not None:
+            try:
+                conn.shutdown(socket.SHUT_RDWR)
+            except OSError:
+                pass
+        if self._thread is not None:
+            self._thread.join(timeout=5)
+
+    # ---------------- RTSP ----------------
+
+    def _serve(self):
+        try:
+            conn, _ = self._listener.accept()
+        except OSError:
+            return
+        self._conn = conn
+        conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        buf = b''
+        try:
+            while not self._stopping.is_set():
+                data = conn.recv(65536)
+                if not data:
+                    break
+                buf += data
+                buf = self._requests(conn, buf)
+        except OSError as e:
+            if not self._stopping.is_set():
+                self.error = str(e)
+        finally:
+            self._stopping.set()
+            conn.close()
+
+    def _requests(self, conn, buf):
+        while buf:
+            if buf[:1] == b'$':  # 客户端发来的 interleaved RTCP
+                if len(buf) < 4:
+                    return buf
+                size = 4 + struct.unpack('!H', buf[2:4])[0]
+                if len(buf) < size:
+                    return buf
+                buf = buf[size:]
+                continue
+            end = buf.find(b'\r\n\r\n')
+            if end < 0:
+                return buf
+            head = buf[:end].decode('latin-1').split('\r\n')
+            headers = {}
+            for line in head[1:]:
+                key, _, value = line.partition(':')
+                headers[key.strip().lower()] = value.strip()
+            body = int(headers.get('content-length', 0))
+            if len(buf) < end + 4 + body:
+                return buf
+            buf = buf[end + 4 + body:]
+            self._handle(conn, head[0].split()[0], headers)
+        return buf
+
+    def _reply(self, conn, cseq, extra='', body='', status='200 OK'):
+        msg = 'RTSP/1.0 %s\r\nCSeq: %s\r\n%s' % (status, cseq, extra)
+        if body:
+            msg += 'Content-Length: %d\r\n' % len(body)
+        msg += '\r\n' + body
+        with self._lock:
+            conn.sendall(msg.encode())
+
+    def _handle(self, conn, method, headers):
+        cseq = headers.get('cseq', '0')
+        session = 'Session: 52494f31;timeout=60\r\n'
+        if method == 'OPTIONS':
+            self._reply(conn, cseq, 'Public: OPTIONS, DESCRIBE, SETUP, PLAY, GET_PARAMETER, TEARDOWN\r\n')
+        elif method == 'DESCRIBE':
+            self._reply(conn, cseq, 'Content-Base: %s/\r\nContent-Type: application/sdp\r\n' % self.url, self._sdp())
+        elif method == 'SETUP':
+            if 'interleaved' not in headers.get('transport', ''):
+                self._reply(conn, cseq, status='461 Unsupported Transport')
+                return
+            self._reply(conn, cseq, session + 'Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n')
+        elif method == 'PLAY':
+            self._reply(conn, cseq, session)
+            threading.Thread(target=self._play, args=(conn,), name='rtsp-replay-send', daemon=True).start()
+        elif method == 'TEARDOWN':
+            self._reply(conn, cseq, session)
+            self._stopping.set()
+        else:
+            self._reply(conn, cseq, session)
+
+    def _sdp(self):
+        b64 = [base64.b64encode(p).decode() if p else '' for p in self.capture.parameter_sets()]
+        if self.capture.codec == CODEC_H265:
+            rtpmap = 'H265/90000'
+            fmtp = 'sprop-vps=%s;sprop-sps=%s;sprop-pps=%s' % tuple(b64)
+        else:
+            rtpmap = 'H264/90000'
+            fmtp = 'packetization-mode=1;sprop-parameter-sets=%s,%s' % tuple(b64)
+        return ('v=0\r\no=- 0 0 IN IP4 %s\r\ns=roi replay\r\nt=0 0\r\na=control:*\r\n'
+                'm=video 0 RTP/AVP %d\r\na=rtpmap:%d %s\r\na=fmtp:%d %s\r\na=control:track1\r\n'
+                % (self.host, PAYLOAD_TYPE, PAYLOAD_TYPE, rtpmap, PAYLOAD_TYPE, fmtp))
+
+    # ---------------- RTP ----------------
+
+    def _packets(self, nal):
+        """一个 NAL 的 RTP 负载：放得下时单包发送，否则 FU-A（H.264）或 FU（H.265, type 49）分片"""
+        if len(nal) <= MTU:
+            return [nal]
+        if self.capture.codec == CODEC_H265:
+            head = bytes([(nal[0] & 0x81) | (49 << 1), nal[1]])
+            kind = (nal[0] >> 1) & 0x3f
+            body = nal[2:]
+        else:
+            head = bytes([(nal[0] & 0xe0) | 28])
+            kind = nal[0] & 0x1f
+            body = nal[1:]
+        chunks = [body[i:i + MTU] for i in range(0, len(body), MTU)]
+        out = []
+        for i, chunk in enumerate(chunks):
+            fu = kind | (0x80 if i == 0 else 0) | (0x40 if i == len(chunks) - 1 else 0)
+            out.append(head + bytes([fu]) + chunk)
+        return out
+
+    def _play(self, conn):
+        # 每个 AU 先拆好 RTP 负载，发送循环里只做定时和写 socket
+        units = [(u.pts, [p for nal in split_nals(u.data) for p in self._packets(nal)]) for u in self.capture.units]
+        duration = self.capture.duration
+        seq = 0
+        start = time.perf_counter()
+        try:
+            for loop in range(self.loops):
+                for pts, payloads in units:
+                    if self._stopping.is_set():
+                        return
+                    pts += loop * duration
+                    if self.speed > 0:
+                        delay = start + pts / 90000.0 / self.speed - time.perf_counter()
+                        if delay > 0:
+                            time.sleep(delay)
+                    frames = []
+                    for i, payload in enumerate(payloads):
+                        marker = 0x80 if i == len(payloads) - 1 else 0
+                        rtp = struct.pack('!BBHII', 0x80, PAYLOAD_TYPE | marker, seq & 0xffff, pts & 0xffffffff,
+                                          SSRC) + payload
+                        frames.append(b'$\x00' + struct.pack('!H', len(rtp)) + rtp)
+                        seq += 1
+                    with self._lock:
+                        conn.sendall(b''.join(frames))
+                    self.sent.append((pts, time.perf_counter()))
+        except OSError as e:
+            if not self._stopping.is_set():
+                self.error = str(e)
+        finally:
+            self.done.set()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='把 rtsp_client 录下的 .au 抓包当作 RTSP 摄像头回放')
+    parser.add_argument('capture')
+    parser.add_argument('--port', type=int, default=8554)
+    parser.add_argument('--host', default='127.0.0.1')
+    parser.add_argument('--speed', default='1', help='回放倍速，max 表示不等待')
+    parser.add_argument('--loops', type=int, default=1)
+    args = parser.parse_args()
+    logging.basicConfig(level=logging.INFO, format='%(asctime)s %(levelname)s %(name)s: %(message)s')
+    capture = Capture(args.capture)
+    while True:
+        server = ReplayServer(capture, args.port, 0 if args.speed == 'max' else float(args.speed), args.loops,
+                              args.host).start()
+        log.info('serving %d %s access units on %s', len(capture.units), capture.codec_name, server.url)
+        server.done.wait()
+        server.stop()
+        log.info('replay finished: %d access units sent%s', len(server.sent),
+                 ', error %s' % server.error if server.error else '')
+
+
+if __name__ == '__main__':
+    main()
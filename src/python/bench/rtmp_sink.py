@@ -0,0 +1,314 @@
+import argparse
+import logging
+import os
+import socket
+import struct
+import threading
+import time
+
+log = logging.getLogger(__name__)
+
+HANDSHAKE_BYTES = 1536
+ACK_WINDOW = 2500000  # 客户端没有声明窗口时，每收到这么多字节回一个 Acknowledgement
+
+MSG_SET_CHUNK_SIZE = 1
+MSG_ACK = 3
+MSG_WINDOW_ACK_SIZE = 5
+MSG_SET_PEER_BANDWIDTH = 6
+MSG_AUDIO = 8
+MSG_VIDEO = 9
+MSG_DATA_AMF0 = 18
+MSG_COMMAND_AMF0 = 20
+
+
+class VideoFrame:
+    __slots__ = ('received', 'pts_ms', 'size', 'key')
+
+    def __init__(self, received, pts_ms, size, key):
+        self.received = received
+        self.pts_ms = pts_ms
+        self.size = size
+        self.key = key
+
+
+# ---------------- AMF0 ----------------
+
+def _amf_string(s):
+    b = s.encode()
+    return b'\x02' + struct.pack('!H', len(b)) + b
+
+
+def _amf_number(v):
+    return b'\x00' + struct.pack('!d', v)
+
+
+def _amf_object(props):
+    out = b'\x03'
+    for key, value in props.items():
+        k = key.encode()
+        out += struct.pack('!H', len(k)) + k
+        out += _amf_number(value) if isinstance(value, (int, float)) else _amf_string(value)
+    return out + b'\x00\x00\x09'
+
+
+def _amf_read(p, off):
+    """读一个 AMF0 值，返回 (值, 新偏移)；对象按 dict 返回"""
+    kind = p[off]
+    off += 1
+    if kind == 0x00:
+        return struct.unpack_from('!d', p, off)[0], off + 8
+    if kind == 0x01:
+        return bool(p[off]), off + 1
+    if kind == 0x02:
+        n = struct.unpack_from('!H', p, off)[0]
+        return p[off + 2:off + 2 + n].decode('utf-8', 'replace'), off + 2 + n
+    if kind in (0x03, 0x08):
+        if kind == 0x08:
+            off += 4
+        obj = {}
+        while off + 3 <= len(p):
+            n = struct.unpack_from('!H', p, off)[0]
+            if n == 0 and p[off + 2] == 0x09:
+                return obj, off + 3
+            key = p[off + 2:off + 2 + n].decode('utf-8', 'replace')
+            obj[key], off = _amf_read(p, off + 2 + n)
+        return obj, len(p)
+    if kind in (0x05, 0x06):
+        return None, off
+    raise ValueError('unsupported AMF0 type %d' % kind)
+
+
+class RtmpSink:
+    """只收不发的最小 RTMP 服务器，作为基准测试里推流的对端
+
+    应答 connect / createStream / publish，按客户端声明的窗口回 Acknowledgement
+    （推流端用它估计确认时延）。每个视频帧记下收到的时刻（time.perf_counter）、
+    显示时间戳（FLV 的 timestamp + composition time，毫秒）和大小。给了 flv_path 时把收到的
+    音视频和元数据原样写成 FLV 文件，供质量评估解码。
+    """
+
+    def __init__(self, port=0, flv_path=None, host='127.0.0.1'):
+        self.host = host
+        self.flv_path = flv_path
+        self.frames = []
+        self.metadata = None
+        self.error = None
+        self.published = threading.Event()
+        self._listener = socket.socket()
+        self._listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self._listener.bind((host, port))
+        self._listener.listen(1)
+        self.port = self._listener.getsockname()[1]
+        self._stopping = threading.Event()
+        self._conn = None
+        self._flv = None
+        self._reader = None
+        self._thread = None
+
+    @property
+    def url(self):
+        return 'rtmp://%s:%d/live/bench' % (self.host, self.port)
+
+    def start(self):
+        self._thread = threading.Thread(target=self._serve, name='rtmp-sink', daemon=True)
+        self._thread.start()
+        return self
+
+    def stop(self):
+        self._stopping.set()
+        self._listener.close()
+        conn = self._conn
+        if conn is not None:
+            try:
+                conn.shutdown(socket.SHUT_RDWR)
+            except OSError:
+                pass
+        if self._thread is not None:
+            self._thread.join(timeout=5)
+
+    def stats(self):
+        frames = list(self.frames)
+        out = {'frames': len(frames), 'bytes': sum(f.size for f in frames)}
+        if len(frames) > 1:
+            span = (frames[-1].pts_ms - frames[0].pts_ms) / 1000.0
+            if span > 0:
+                out['kbps'] = round(out['bytes'] * 8 / span / 1000.0, 1)
+        return out
+
+    # ---------------- 连接 ----------------
+
+    def _serve(self):
+        try:
+            conn, _ = self._listener.accept()
+        except OSError:
+            return
+        self._conn = conn
+        if self.flv_path:
+            self._flv = open(self.flv_path, 'wb')
+            self._flv.write(b'FLV\x01\x05\x00\x00\x00\x09' + b'\x00' * 4)
+        try:
+            self._reader = _Reader(conn)
+            self._handshake(conn)
+            self._session(conn)
+        except (OSError, EOFError, ValueError) as e:
+            if not self._stopping.is_set() and not isinstance(e, EOFError):
+                self.error = str(e)
+        finally:
+            conn.close()
+            if self._flv is not None:
+                self._flv.close()
+
+    def _handshake(self, conn):
+        c0c1 = self._reader.read(1 + HANDSHAKE_BYTES)
+        s1 = struct.pack('!II', 0, 0) + os.urandom(HANDSHAKE_BYTES - 8)
+        conn.sendall(b'\x03' + s1 + c0c1[1:])
+        self._reader.read(HANDSHAKE_BYTES)
+
+    def _send(self, conn, csid, kind, stream_id, body):
+        """按默认的 128 字节块发送一条消息（服务器只发短小的控制和命令消息，不改块大小）"""
+        out = bytes([csid]) + b'\x00\x00\x00' + struct.pack('!I', len(body))[1:] + bytes([kind]) + \
+            struct.pack('<I', stream_id)
+        for off in range(0, len(body), 128):
+            if off:
+                out += bytes([0xc0 | csid])
+            out += body[off:off + 128]
+        conn.sendall(out)
+
+    def _session(self, conn):
+        chunk_size = 128
+        window = ACK_WINDOW
+        acked = 0
+        streams = {}  # csid -> [timestamp, length, type, stream_id, payload, extended]
+        reader = self._reader
+        while not self._stopping.is_set():
+            b0 = reader.read(1)[0]
+            fmt = b0 >> 6
+            csid = b0 & 0x3f
+            if csid == 0:
+                csid = 64 + reader.read(1)[0]
+            elif csid == 1:
+                b = reader.read(2)
+                csid = 64 + b[0] + 256 * b[1]
+            st = streams.setdefault(csid, [0, 0, 0, 0, b'', False])
+            if fmt < 3:
+                head = reader.read((11, 7, 3)[fmt])
+                delta = int.from_bytes(head[0:3], 'big')
+                if fmt <= 1:
+                    st[1] = int.from_bytes(head[3:6], 'big')
+                    st[2] = head[6]
+                if fmt == 0:
+                    st[3] = struct.unpack('<I', head[7:11])[0]
+                st[5] = delta == 0xffffff
+                if st[5]:
+                    delta = struct.unpack('!I', reader.read(4))[0]
+                st[0] = delta if fmt == 0 else st[0] + delta
+            elif st[5]:
+                reader.read(4)
+            take = min(chunk_size, st[1] - len(st[4]))
+            st[4] += reader.read(take)
+            if reader.total - acked >= window:
+                acked = reader.total
+                self._send(conn, 2, MSG_ACK, 0, struct.pack('!I', acked & 0xffffffff))
+            if len(st[4]) < st[1]:
+                continue
+            timestamp, _, kind, stream_id, body, _ = st
+            st[4] = b''
+            if kind == MSG_SET_CHUNK_SIZE:
+                chunk_size = struct.unpack('!I', body[:4])[0] & 0x7fffffff
+            elif kind == MSG_WINDOW_ACK_SIZE:
+                window = struct.unpack('!I', body[:4])[0] or ACK_WINDOW
+            elif kind == MSG_COMMAND_AMF0:
+                self._command(conn, body)
+            elif kind in (MSG_VIDEO, MSG_AUDIO, MSG_DATA_AMF0):
+                if kind == MSG_VIDEO:
+                    self._video(timestamp, body)
+                elif kind == MSG_DATA_AMF0 and self.metadata is None:
+                    self.metadata = body
+                self._write_tag(kind, timestamp, body)
+
+    def _command(self, conn, body):
+        name, off = _amf_read(body, 0)
+        txn, off = _amf_read(body, off)
+        if name == 'connect':
+            self._send(conn, 2, MSG_WINDOW_ACK_SIZE, 0, struct.pack('!I', ACK_WINDOW))
+            self._send(conn, 2, MSG_SET_PEER_BANDWIDTH, 0, struct.pack('!IB', ACK_WINDOW, 2))
+            reply = (_amf_string('_result') + _amf_number(txn) +
+                     _amf_object({'fmsVer': 'FMS/3,0,1,123', 'capabilities': 31}) +
+                     _amf_object({'level': 'status', 'code': 'NetConnection.Connect.Success',
+                                  'description': 'Connection succeeded.'}))
+            self._send(conn, 3, MSG_COMMAND_AMF0, 0, reply)
+        elif name == 'createStream':
+            self._send(conn, 3, MSG_COMMAND_AMF0, 0, _amf_string('_result') + _amf_number(txn) + b'\x05' +
+                       _amf_number(1.0))
+        elif name == 'publish':
+            reply = (_amf_string('onStatus') + _amf_number(0) + b'\x05' +
+                     _amf_object({'level': 'status', 'code': 'NetStream.Publish.Start',
+                                  'description': 'Start publishing.'}))
+            self._send(conn, 5, MSG_COMMAND_AMF0, 1, reply)
+            self.published.set()
+
+    def _video(self, timestamp, body):
+        if len(body) < 2:
+            return
+        if body[0] & 0x80:
+            # Enhanced RTMP：低 4 位是包类型，1 = CodedFrames（带 composition time），3 = CodedFramesX
+            packet = body[0] & 0x0f
+            if packet not in (1, 3):
+                return
+            cts = _si24(body[5:8]) if packet == 1 and len(body) >= 8 else 0
+        else:
+            if len(body) < 5 or body[1] != 1:  # 0 是序列头
+                return
+            cts = _si24(body[2:5])
+        key = (body[0] >> 4) & 0x07 == 1
+        self.frames.append(VideoFrame(time.perf_counter(), timestamp + cts, len(body), key))
+
+    def _write_tag(self, kind, timestamp, body):
+        if self._flv is None:
+            return
+        head = bytes([kind]) + struct.pack('!I', len(body))[1:] + struct.pack('!I', timestamp & 0xffffff)[1:] + \
+            bytes([(timestamp >> 24) & 0xff]) + b'\x00\x00\x00'
+        self._flv.write(head + body + struct.pack('!I', 11 + len(body)))
+
+
+class _Reader:
+    def __init__(self, conn):
+        self.conn = conn
+        self.buf = bytearray()
+        self.total = 0
+
+    def read(self, n):
+        while len(self.buf) < n:
+            data = self.conn.recv(262144)
+            if not data:
+                raise EOFError
+            self.buf += data
+            self.total += len(data)
+        out = bytes(self.buf[:n])
+        del self.buf[:n]
+        return out
+
+
+def _si24(b):
+    v = int.from_bytes(b, 'big')
+    return v - (1 << 24) if v & 0x800000 else v
+
+
+def main():
+    parser = argparse.ArgumentParser(description='收下 RTMP 推流并统计帧数、码率，可选写成 FLV')
+    parser.add_argument('--port', type=int, default=1935)
+    parser.add_argument('--host', default='127.0.0.1')
+    parser.add_argument('--flv', default=None)
+    args = parser.parse_args()
+    logging.basicConfig(level=logging.INFO, format='%(asctime)s %(levelname)s %(name)s: %(message)s')
+    sink = RtmpSink(args.port, args.flv, args.host).start()
+    log.info('waiting for a publisher on %s', sink.url)
+    try:
+        sink._thread.join()
+    except KeyboardInterrupt:
+        sink.stop()
+    log.info('publish ended: %s%s', sink.stats(), ', error %s' % sink.error if sink.error else '')
+
+
+if __name__ == '__main__':
+    main()
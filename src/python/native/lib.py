@@ -0,0 +1,644 @@
+import ctypes
+import logging
+import os
+import threading
+
+# 原生流水线动态库（src/cpp 编译产物）的加载与函数原型声明。
+# 库不存在时 load() 返回 None，调用方退回到 OpenCV 路径。
+# 库经 ctypes.CDLL 加载，每次调用期间都释放 GIL：阻塞的读取（roi_rtsp_read、roi_decoder_read）、
+# 编码和预处理运行时其余 Python 线程照常执行。像素和码流不经过 Python 对象，交给 Python 的
+# 只是指向原生缓冲的 memoryview（view()）或带生命周期的数组视图（NativeArray）。
+
+_ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..', '..'))
+_DEFAULT_PATH = os.path.join(_ROOT, 'src', 'cpp', 'build', 'libroi_pipeline.so')
+
+_lib = None
+_tried = False
+
+CODEC_H264 = 1
+CODEC_H265 = 2
+
+AU_KEY = 1
+AU_DISCONTINUITY = 2
+AU_PARAM_SETS = 4
+
+TRANSPORT_TCP = 0
+TRANSPORT_UDP = 1
+
+DECODER_AUTO = 0
+DECODER_SOPHON = 1
+DECODER_SOFTWARE = 2
+
+MEMORY_HOST = 0
+MEMORY_DEVICE = 1
+
+ENCODER_AUTO = 0
+ENCODER_SOPHON = 1
+ENCODER_X264 = 2
+ENCODER_X265 = 3
+
+HEVC_FLV_ENHANCED = 0
+HEVC_FLV_LEGACY = 1
+
+MODE_ENCODE = 0
+MODE_PASSTHROUGH = 1
+
+THREAD_RTSP = 0
+THREAD_DECODE = 1
+THREAD_INFER = 2
+THREAD_RTMP = 3
+
+# 线程布局预设：SE5 的 8 个 A53 核上收流和推流共用 0 核、解码 1 核、推理提交 2 核、CPU 线程池 3-7 核
+AFFINITY_PRESETS = {
+    'se5': 'workers=3-7;rtsp=0;rtmp=0;decode=1;infer=2',
+}
+_AFFINITY_KEYS = ('workers', 'rtsp', 'decode', 'infer', 'rtmp', 'threads', 'io')
+
+
+class RoiAu(ctypes.Structure):
+    _fields_ = [
+        ('data', ctypes.c_void_p),
+        ('size', ctypes.c_uint32),
+        ('flags', ctypes.c_uint32),
+        ('pts', ctypes.c_int64),
+        ('seq', ctypes.c_uint64),
+        ('codec', ctypes.c_int32),
+        ('arrival_us', ctypes.c_int64),
+    ]
+
+
+class RoiRtspStats(ctypes.Structure):
+    _fields_ = [
+        ('packets', ctypes.c_uint64),
+        ('lost', ctypes.c_uint64),
+        ('bytes', ctypes.c_uint64),
+        ('au_committed', ctypes.c_uint64),
+        ('au_dropped', ctypes.c_uint64),
+        ('ring_slots_used', ctypes.c_uint32),
+        ('reads', ctypes.c_uint64),
+    ]
+
+
+class RoiSurface(ctypes.Structure):
+    _fields_ = [
+        ('width', ctypes.c_int32),
+        ('height', ctypes.c_int32),
+        ('pts', ctypes.c_int64),
+        ('seq', ctypes.c_uint64),
+        ('memory', ctypes.c_int32),
+        ('device_index', ctypes.c_int32),
+        ('y', ctypes.c_void_p),
+        ('uv', ctypes.c_void_p),
+        ('pitch_y', ctypes.c_int32),
+        ('pitch_uv', ctypes.c_int32),
+        ('device_y', ctypes.c_uint64),
+        ('device_uv', ctypes.c_uint64),
+        ('handle', ctypes.c_void_p),
+        ('arrival_us', ctypes.c_int64),
+    ]
+
+
+class RoiPoolStats(ctypes.Structure):
+    _fields_ = [
+        ('capacity', ctypes.c_uint32),
+        ('in_use', ctypes.c_uint32),
+        ('high_water', ctypes.c_uint32),
+        ('reserved', ctypes.c_uint32),
+        ('acquired', ctypes.c_uint64),
+        ('misses', ctypes.c_uint64),
+    ]
+
+
+class RoiDecoderStats(ctypes.Structure):
+    _fields_ = [
+        ('decoded', ctypes.c_uint64),
+        ('dropped', ctypes.c_uint64),
+        ('errors', ctypes.c_uint64),
+        ('queued', ctypes.c_uint32),
+    ]
+
+
+class RoiEncoderConfig(ctypes.Structure):
+    _fields_ = [
+        ('codec', ctypes.c_int32),
+        ('backend', ctypes.c_int32),
+        ('width', ctypes.c_int32),
+        ('height', ctypes.c_int32),
+        ('fps', ctypes.c_int32),
+        ('bitrate_kbps', ctypes.c_int32),
+        ('gop', ctypes.c_int32),
+        ('device_index', ctypes.c_int32),
+        ('roi_qp_delta', ctypes.c_int32),
+        ('background_qp_delta', ctypes.c_int32),
+        ('base_qp', ctypes.c_int32),
+    ]
+
+
+class RoiSmoothing(ctypes.Structure):
+    _fields_ = [
+        ('alpha', ctypes.c_float),
+        ('dilate', ctypes.c_float),
+        ('pad_pixels', ctypes.c_int32),
+        ('hold_updates', ctypes.c_int32),
+        ('match_iou', ctypes.c_float),
+        ('shrink_margin', ctypes.c_float),
+    ]
+
+
+class RoiStaticConfig(ctypes.Structure):
+    _fields_ = [
+        ('threshold', ctypes.c_float),
+        ('static_frames', ctypes.c_int32),
+        ('sample_step', ctypes.c_int32),
+        ('qp_delta', ctypes.c_int32),
+    ]
+
+
+class RoiBox(ctypes.Structure):
+    _fields_ = [
+        ('x', ctypes.c_float),
+        ('y', ctypes.c_float),
+        ('w', ctypes.c_float),
+        ('h', ctypes.c_float),
+        ('qp_delta', ctypes.c_int32),
+    ]
+
+
+class RoiPacket(ctypes.Structure):
+    _fields_ = [
+        ('data', ctypes.c_void_p),
+        ('size', ctypes.c_uint64),
+        ('pts', ctypes.c_int64),
+        ('dts', ctypes.c_int64),
+        ('key', ctypes.c_int32),
+        ('reference', ctypes.c_int32),
+        ('codec', ctypes.c_int32),
+        ('handle', ctypes.c_void_p),
+    ]
+
+
+class RoiRtmpConfig(ctypes.Structure):
+    _fields_ = [
+        ('url', ctypes.c_char_p),
+        ('codec', ctypes.c_int32),
+        ('hevc_mode', ctypes.c_int32),
+        ('timeout_ms', ctypes.c_int32),
+        ('queue_bytes', ctypes.c_uint64),
+        ('queue_packets', ctypes.c_int32),
+        ('chunk_size', ctypes.c_int32),
+        ('width', ctypes.c_int32),
+        ('height', ctypes.c_int32),
+        ('fps', ctypes.c_int32),
+        ('bitrate_kbps', ctypes.c_int32),
+    ]
+
+
+class RoiRtmpStats(ctypes.Structure):
+    _fields_ = [
+        ('sent_frames', ctypes.c_uint64),
+        ('sent_bytes', ctypes.c_uint64),
+        ('acked_bytes', ctypes.c_uint64),
+        ('dropped_nonref', ctypes.c_uint64),
+        ('dropped_ref', ctypes.c_uint64),
+        ('queued_frames', ctypes.c_uint64),
+        ('queued_bytes', ctypes.c_uint64),
+        ('socket_bytes', ctypes.c_uint64),
+        ('queued_ms', ctypes.c_uint32),
+        ('rtt_us', ctypes.c_uint32),
+        ('ack_delay_ms', ctypes.c_uint32),
+        ('reserved', ctypes.c_uint32),
+    ]
+
+
+class RoiYoloHead(ctypes.Structure):
+    _fields_ = [
+        ('data', ctypes.c_void_p),
+        ('rows', ctypes.c_int32),
+        ('stride', ctypes.c_int32),
+    ]
+
+
+class RoiDetection(ctypes.Structure):
+    _fields_ = [
+        ('x', ctypes.c_float),
+        ('y', ctypes.c_float),
+        ('w', ctypes.c_float),
+        ('h', ctypes.c_float),
+        ('confidence', ctypes.c_float),
+        ('class_id', ctypes.c_int32),
+    ]
+
+
+class RoiPreprocessConfig(ctypes.Structure):
+    _fields_ = [
+        ('width', ctypes.c_int32),
+        ('height', ctypes.c_int32),
+        ('batch', ctypes.c_int32),
+        ('letterbox', ctypes.c_int32),
+        ('pad_value', ctypes.c_int32),
+        ('int8', ctypes.c_int32),
+        ('int8_scale', ctypes.c_float),
+    ]
+
+
+class RoiLetterbox(ctypes.Structure):
+    _fields_ = [
+        ('scale_x', ctypes.c_float),
+        ('scale_y', ctypes.c_float),
+        ('pad_x', ctypes.c_int32),
+        ('pad_y', ctypes.c_int32),
+    ]
+
+
+class RoiPassthroughStats(ctypes.Structure):
+    _fields_ = [
+        ('forwarded_frames', ctypes.c_uint64),
+        ('forwarded_bytes', ctypes.c_uint64),
+        ('encoded_frames', ctypes.c_uint64),
+        ('skipped_source', ctypes.c_uint64),
+        ('skipped_encoded', ctypes.c_uint64),
+        ('switches', ctypes.c_uint32),
+        ('codec_mismatch', ctypes.c_uint32),
+        ('source_kbps', ctypes.c_double),
+    ]
+
+
+class RoiSchedulerConfig(ctypes.Structure):
+    _fields_ = [
+        ('workers', ctypes.c_int32),
+        ('worker_cpus', ctypes.c_char_p),
+        ('rtsp_cpus', ctypes.c_char_p),
+        ('decode_cpus', ctypes.c_char_p),
+        ('infer_cpus', ctypes.c_char_p),
+        ('rtmp_cpus', ctypes.c_char_p),
+        ('io_threads', ctypes.c_int32),
+    ]
+
+
+class RoiSchedulerStats(ctypes.Structure):
+    _fields_ = [
+        ('threads', ctypes.c_uint32),
+        ('io_threads', ctypes.c_uint32),
+        ('executed', ctypes.c_uint64),
+        ('stolen', ctypes.c_uint64),
+        ('parked', ctypes.c_uint64),
+    ]
+
+
+def _declare(lib):
+    vp = ctypes.c_void_p
+    lib.roi_last_error.restype = ctypes.c_char_p
+    lib.roi_last_error.argtypes = []
+
+    lib.roi_rtsp_open.restype = vp
+    lib.roi_rtsp_open.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_int, ctypes.c_uint64]
+    lib.roi_rtsp_close.restype = None
+    lib.roi_rtsp_close.argtypes = [vp]
+    lib.roi_rtsp_state.restype = ctypes.c_int
+    lib.roi_rtsp_state.argtypes = [vp]
+    lib.roi_rtsp_error.restype = ctypes.c_char_p
+    lib.roi_rtsp_error.argtypes = [vp]
+    lib.roi_rtsp_codec.restype = ctypes.c_int
+    lib.roi_rtsp_codec.argtypes = [vp]
+    lib.roi_rtsp_add_consumer.restype = ctypes.c_int
+    lib.roi_rtsp_add_consumer.argtypes = [vp]
+    lib.roi_rtsp_remove_consumer.restype = None
+    lib.roi_rtsp_remove_consumer.argtypes = [vp, ctypes.c_int]
+    lib.roi_rtsp_read.restype = ctypes.c_int
+    lib.roi_rtsp_read.argtypes = [vp, ctypes.c_int, ctypes.POINTER(RoiAu), ctypes.c_int]
+    lib.roi_rtsp_release.restype = None
+    lib.roi_rtsp_release.argtypes = [vp, ctypes.c_int]
+    lib.roi_rtsp_get_stats.restype = None
+    lib.roi_rtsp_get_stats.argtypes = [vp, ctypes.POINTER(RoiRtspStats)]
+
+    lib.roi_decoder_open.restype = vp
+    lib.roi_decoder_open.argtypes = [vp, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int]
+    lib.roi_decoder_close.restype = None
+    lib.roi_decoder_close.argtypes = [vp]
+    lib.roi_decoder_backend.restype = ctypes.c_char_p
+    lib.roi_decoder_backend.argtypes = [vp]
+    lib.roi_decoder_read.restype = ctypes.c_int
+    lib.roi_decoder_read.argtypes = [vp, ctypes.POINTER(RoiSurface), ctypes.c_int]
+    lib.roi_decoder_get_stats.restype = None
+    lib.roi_decoder_get_stats.argtypes = [vp, ctypes.POINTER(RoiDecoderStats)]
+    lib.roi_decoder_get_pool_stats.restype = None
+    lib.roi_decoder_get_pool_stats.argtypes = [vp, ctypes.POINTER(RoiPoolStats)]
+    lib.roi_surface_release.restype = None
+    lib.roi_surface_release.argtypes = [vp]
+    lib.roi_surface_retain.restype = vp
+    lib.roi_surface_retain.argtypes = [vp]
+    lib.roi_scaler_open.restype = vp
+    lib.roi_scaler_open.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_int]
+    lib.roi_scaler_close.restype = None
+    lib.roi_scaler_close.argtypes = [vp]
+    lib.roi_scaler_scale.restype = ctypes.c_int
+    lib.roi_scaler_scale.argtypes = [vp, vp, ctypes.POINTER(RoiSurface)]
+    lib.roi_scaler_get_pool_stats.restype = None
+    lib.roi_scaler_get_pool_stats.argtypes = [vp, ctypes.POINTER(RoiPoolStats)]
+
+    i32 = ctypes.c_int
+    u8p = ctypes.c_void_p
+    lib.roi_encoder_open.restype = vp
+    lib.roi_encoder_open.argtypes = [ctypes.POINTER(RoiEncoderConfig)]
+    lib.roi_encoder_close.restype = None
+    lib.roi_encoder_close.argtypes = [vp]
+    lib.roi_encoder_backend.restype = ctypes.c_char_p
+    lib.roi_encoder_backend.argtypes = [vp]
+    lib.roi_encoder_block_size.restype = i32
+    lib.roi_encoder_block_size.argtypes = [vp]
+    lib.roi_encoder_set_rois.restype = i32
+    lib.roi_encoder_set_rois.argtypes = [vp, ctypes.POINTER(RoiBox), i32]
+    lib.roi_encoder_set_smoothing.restype = i32
+    lib.roi_encoder_set_smoothing.argtypes = [vp, ctypes.POINTER(RoiSmoothing)]
+    lib.roi_encoder_set_static.restype = i32
+    lib.roi_encoder_set_static.argtypes = [vp, ctypes.POINTER(RoiStaticConfig)]
+    lib.roi_encoder_static_blocks.restype = i32
+    lib.roi_encoder_static_blocks.argtypes = [vp]
+    lib.roi_encoder_set_qp_offsets.restype = i32
+    lib.roi_encoder_set_qp_offsets.argtypes = [vp, i32, i32]
+    lib.roi_encoder_qp_map.restype = ctypes.c_void_p
+    lib.roi_encoder_qp_map.argtypes = [vp, ctypes.POINTER(i32), ctypes.POINTER(i32)]
+    lib.roi_encoder_encode_surface.restype = i32
+    lib.roi_encoder_encode_surface.argtypes = [vp, vp, i32]
+    lib.roi_encoder_encode_nv12.restype = i32
+    lib.roi_encoder_encode_nv12.argtypes = [vp, u8p, u8p, i32, i32, ctypes.c_int64, i32]
+    lib.roi_encoder_encode_i420.restype = i32
+    lib.roi_encoder_encode_i420.argtypes = [vp, u8p, u8p, u8p, i32, i32, ctypes.c_int64, i32]
+    lib.roi_encoder_receive.restype = i32
+    lib.roi_encoder_receive.argtypes = [vp, ctypes.POINTER(RoiPacket)]
+    lib.roi_encoder_get_pool_stats.restype = None
+    lib.roi_encoder_get_pool_stats.argtypes = [vp, ctypes.POINTER(RoiPoolStats)]
+    lib.roi_packet_release.restype = None
+    lib.roi_packet_release.argtypes = [vp]
+
+    lib.roi_rtmp_open.restype = vp
+    lib.roi_rtmp_open.argtypes = [ctypes.POINTER(RoiRtmpConfig)]
+    lib.roi_rtmp_close.restype = None
+    lib.roi_rtmp_close.argtypes = [vp]
+    lib.roi_rtmp_state.restype = i32
+    lib.roi_rtmp_state.argtypes = [vp]
+    lib.roi_rtmp_error.restype = ctypes.c_char_p
+    lib.roi_rtmp_error.argtypes = [vp]
+    lib.roi_rtmp_attach_encoder.restype = None
+    lib.roi_rtmp_attach_encoder.argtypes = [vp, vp]
+    lib.roi_rtmp_send_packet.restype = i32
+    lib.roi_rtmp_send_packet.argtypes = [vp, vp]
+    lib.roi_rtmp_send_from_encoder.restype = i32
+    lib.roi_rtmp_send_from_encoder.argtypes = [vp, vp]
+    lib.roi_rtmp_get_stats.restype = None
+    lib.roi_rtmp_get_stats.argtypes = [vp, ctypes.POINTER(RoiRtmpStats)]
+
+    lib.roi_passthrough_open.restype = vp
+    lib.roi_passthrough_open.argtypes = [vp, vp]
+    lib.roi_passthrough_close.restype = None
+    lib.roi_passthrough_close.argtypes = [vp]
+    lib.roi_passthrough_set_mode.restype = None
+    lib.roi_passthrough_set_mode.argtypes = [vp, i32]
+    lib.roi_passthrough_active.restype = i32
+    lib.roi_passthrough_active.argtypes = [vp]
+    lib.roi_passthrough_last_dts.restype = ctypes.c_int64
+    lib.roi_passthrough_last_dts.argtypes = [vp]
+    lib.roi_passthrough_send_packet.restype = i32
+    lib.roi_passthrough_send_packet.argtypes = [vp, vp]
+    lib.roi_passthrough_get_stats.restype = None
+    lib.roi_passthrough_get_stats.argtypes = [vp, ctypes.POINTER(RoiPassthroughStats)]
+
+    lib.roi_yolo_decode.restype = i32
+    lib.roi_yolo_decode.argtypes = [ctypes.POINTER(RoiYoloHead), i32, i32, i32, ctypes.c_float, ctypes.c_float, i32,
+                                    ctypes.POINTER(RoiDetection), i32]
+
+    lib.roi_preprocess_open.restype = vp
+    lib.roi_preprocess_open.argtypes = [ctypes.POINTER(RoiPreprocessConfig)]
+    lib.roi_preprocess_close.restype = None
+    lib.roi_preprocess_close.argtypes = [vp]
+    lib.roi_preprocess_tensor.restype = vp
+    lib.roi_preprocess_tensor.argtypes = [vp, ctypes.POINTER(ctypes.c_uint64)]
+    lib.roi_preprocess_nv12.restype = i32
+    lib.roi_preprocess_nv12.argtypes = [vp, i32, vp, vp, i32, i32, i32, i32, ctypes.POINTER(RoiLetterbox)]
+    lib.roi_preprocess_bgr.restype = i32
+    lib.roi_preprocess_bgr.argtypes = [vp, i32, vp, i32, i32, i32, ctypes.POINTER(RoiLetterbox)]
+    lib.roi_preprocess_surface.restype = i32
+    lib.roi_preprocess_surface.argtypes = [vp, i32, vp, ctypes.POINTER(RoiLetterbox)]
+    lib.roi_preprocess_surface_crop.restype = i32
+    lib.roi_preprocess_surface_crop.argtypes = [vp, i32, vp, i32, i32, i32, i32, ctypes.POINTER(RoiLetterbox)]
+
+    lib.roi_scheduler_configure.restype = i32
+    lib.roi_scheduler_configure.argtypes = [ctypes.POINTER(RoiSchedulerConfig)]
+    lib.roi_scheduler_enter.restype = i32
+    lib.roi_scheduler_enter.argtypes = [i32, ctypes.c_char_p]
+    lib.roi_scheduler_get_stats.restype = i32
+    lib.roi_scheduler_get_stats.argtypes = [ctypes.POINTER(RoiSchedulerStats)]
+
+
+def load():
+    """加载原生库；可用环境变量 ROI_NATIVE_LIB 指定路径"""
+    global _lib, _tried
+    if _tried:
+        return _lib
+    _tried = True
+    path = os.environ.get('ROI_NATIVE_LIB', _DEFAULT_PATH)
+    if not os.path.exists(path):
+        return None
+    lib = ctypes.CDLL(path)
+    _declare(lib)
+    _lib = lib
+    return _lib
+
+
+def last_error():
+    lib = load()
+    if lib is None:
+        return 'native library not loaded'
+    return lib.roi_last_error().decode('utf-8', 'replace')
+
+
+_PyBUF_READ = 0x100
+_PyBUF_WRITE = 0x200
+_memory_view = ctypes.pythonapi.PyMemoryView_FromMemory
+_memory_view.restype = ctypes.py_object
+_memory_view.argtypes = [ctypes.c_void_p, ctypes.c_ssize_t, ctypes.c_int]
+
+
+def view(address, size, writable=False):
+    """把原生内存包装成格式为 'B' 的 memoryview，不拷贝"""
+    return _memory_view(address, size, _PyBUF_WRITE if writable else _PyBUF_READ)
+
+
+# ---------------- 数组视图（numpy __array_interface__ / DLPack） ----------------
+
+class _DLDevice(ctypes.Structure):
+    _fields_ = [('device_type', ctypes.c_int32), ('device_id', ctypes.c_int32)]
+
+
+class _DLDataType(ctypes.Structure):
+    _fields_ = [('code', ctypes.c_uint8), ('bits', ctypes.c_uint8), ('lanes', ctypes.c_uint16)]
+
+
+class _DLTensor(ctypes.Structure):
+    _fields_ = [
+        ('data', ctypes.c_void_p),
+        ('device', _DLDevice),
+        ('ndim', ctypes.c_int32),
+        ('dtype', _DLDataType),
+        ('shape', ctypes.POINTER(ctypes.c_int64)),
+        ('strides', ctypes.POINTER(ctypes.c_int64)),  # 以元素计
+        ('byte_offset', ctypes.c_uint64),
+    ]
+
+
+_DL_DELETER = ctypes.CFUNCTYPE(None, ctypes.c_void_p)
+
+
+class _DLManagedTensor(ctypes.Structure):
+    _fields_ = [('dl_tensor', _DLTensor), ('manager_ctx', ctypes.c_void_p), ('deleter', _DL_DELETER)]
+
+
+_DL_CPU = 1
+_DL_TYPES = {'|u1': (1, 8), '|i1': (0, 8), '<f4': (2, 32), '<i4': (0, 32), '<u2': (1, 16)}
+_CAPSULE_NAME = b'dltensor'
+_CAPSULE_DESTRUCTOR = ctypes.CFUNCTYPE(None, ctypes.c_void_p)
+_capsule_new = ctypes.pythonapi.PyCapsule_New
+_capsule_new.restype = ctypes.py_object
+_capsule_new.argtypes = [ctypes.c_void_p, ctypes.c_char_p, _CAPSULE_DESTRUCTOR]
+_capsule_is_valid = ctypes.pythonapi.PyCapsule_IsValid
+_capsule_is_valid.restype = ctypes.c_int
+_capsule_is_valid.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+_capsule_pointer = ctypes.pythonapi.PyCapsule_GetPointer
+_capsule_pointer.restype = ctypes.c_void_p
+_capsule_pointer.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+
+# 导出给 DLPack 使用方、还没有被删除的张量：地址 -> (DLManagedTensor, shape, strides, owner)
+_exported = {}
+_exported_lock = threading.Lock()
+
+
+@_DL_DELETER
+def _dl_delete(address):
+    # 使用方用完时调用（可能在它自己的线程里；ctypes 回调会先取得 GIL）
+    with _exported_lock:
+        _exported.pop(address, None)
+
+
+@_CAPSULE_DESTRUCTOR
+def _dl_capsule_destructor(capsule):
+    # 没有被任何使用方取走（名字仍是 dltensor）的 capsule 由自己释放
+    if _capsule_is_valid(capsule, _CAPSULE_NAME):
+        _dl_delete(_capsule_pointer(capsule, _CAPSULE_NAME))
+
+
+class NativeArray:
+    """原生缓冲上的 N 维数组视图，不拷贝
+
+    np.asarray(a) 经 __array_interface__ 得到 ndarray，ndarray 引用着 NativeArray；
+    np.from_dlpack(a) / torch.from_dlpack(a) 经 DLPack 导出。owner 是持有原生缓冲的对象
+    （例如 decoder.SurfaceRef），只要还有任何一个视图或导出的张量存活它就不会被回收，
+    所以这样得到的数组可以比产生它的帧活得更久。strides 以字节计，typestr 如 '|u1'、'<f4'。
+    """
+
+    def __init__(self, address, shape, strides, typestr, owner, readonly=True):
+        self.address = address
+        self.shape = tuple(int(v) for v in shape)
+        self.strides = tuple(int(v) for v in strides)
+        self.typestr = typestr
+        self.owner = owner
+        self.readonly = readonly
+
+    @property
+    def __array_interface__(self):
+        return {'version': 3, 'shape': self.shape, 'typestr': self.typestr, 'strides': self.strides,
+                'data': (self.address, self.readonly)}
+
+    def __dlpack_device__(self):
+        return _DL_CPU, 0
+
+    def __dlpack__(self, stream=None, **kwargs):
+        """主机内存，没有需要同步的流；kwargs 接受 DLPack 1.0 使用方多传的参数（只导出旧版 capsule）"""
+        code, bits = _DL_TYPES[self.typestr]
+        itemsize = bits // 8
+        ndim = len(self.shape)
+        shape = (ctypes.c_int64 * ndim)(*self.shape)
+        strides = (ctypes.c_int64 * ndim)(*(s // itemsize for s in self.strides))
+        managed = _DLManagedTensor()
+        managed.dl_tensor = _DLTensor(self.address, _DLDevice(_DL_CPU, 0), ndim, _DLDataType(code, bits, 1),
+                                      shape, strides, 0)
+        managed.deleter = _dl_delete
+        address = ctypes.addressof(managed)
+        with _exported_lock:
+            _exported[address] = (managed, shape, strides, self.owner)
+        return _capsule_new(address, _CAPSULE_NAME, _dl_capsule_destructor)
+
+
+def pool_stats(st):
+    """RoiPoolStats 转成与 pipeline.pool.FramePool.stats() 相同的 dict"""
+    return {name: getattr(st, name) for name, _ in st._fields_ if name != 'reserved'}
+
+
+def parse_affinity(text):
+    """解析 "workers=3-7;rtsp=0;decode=1;infer=2;rtmp=0[;threads=N][;io=N]" 或预设名，返回 dict
+
+    threads 为 CPU 线程池的线程数，缺省时等于 workers 中的核数；没有 workers 时不建线程池。
+    io 为收流 / 推流共用的 I/O 线程数，缺省为 1。
+    """
+    text = AFFINITY_PRESETS.get(text, text)
+    layout = {}
+    for item in text.split(';'):
+        item = item.strip()
+        if not item:
+            continue
+        key, sep, value = item.partition('=')
+        key = key.strip()
+        if not sep or key not in _AFFINITY_KEYS:
+            raise ValueError('bad affinity item %r (expected one of %s)' % (item, ', '.join(_AFFINITY_KEYS)))
+        layout[key] = value.strip()
+    layout['io'] = int(layout.get('io', 1))
+    if 'threads' in layout:
+        layout['threads'] = int(layout['threads'])
+    else:
+        layout['threads'] = _cpu_count(layout.get('workers', ''))
+    return layout
+
+
+def _cpu_count(cpus):
+    count = 0
+    for part in cpus.split(','):
+        lo, _, hi = part.strip().partition('-')
+        if lo:
+            count += int(hi or lo) - int(lo) + 1
+    return count
+
+
+_scheduler_configured = False
+
+
+def configure_scheduler(layout):
+    """按 parse_affinity() 的结果配置原生线程布局，须在打开收流 / 解码 / 推流句柄之前调用"""
+    global _scheduler_configured
+    lib = load()
+    if lib is None:
+        raise RuntimeError('thread affinity needs the native library')
+
+    def cpus(key):
+        return layout.get(key, '').encode()
+
+    cfg = RoiSchedulerConfig(layout.get('threads', 0), cpus('workers'), cpus('rtsp'), cpus('decode'), cpus('infer'),
+                             cpus('rtmp'), layout.get('io', 1))
+    if lib.roi_scheduler_configure(ctypes.byref(cfg)) < 0:
+        raise ValueError('thread affinity: %s' % last_error())
+    _scheduler_configured = True
+
+
+def enter_thread(role, name):
+    """Python 线程按角色绑核并设置线程名；没有配置线程布局时什么也不做"""
+    if not _scheduler_configured:
+        return
+    if _lib.roi_scheduler_enter(role, name.encode()) < 0:
+        logging.getLogger(__name__).warning('pin %s: %s', name, last_error())
+
+
+def scheduler_stats():
+    lib = load()
+    if lib is None or not _scheduler_configured:
+        return None
+    st = RoiSchedulerStats()
+    lib.roi_scheduler_get_stats(ctypes.byref(st))
+    return {name: getattr(st, name) for name, _ in st._fields_}
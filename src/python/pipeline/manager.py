@@ -0,0 +1,358 @@
+import json
+import logging
+import os
+import random
+import threading
+import time
+
+from src.python.pipeline.pipeline import Pipeline, open_source
+
+log = logging.getLogger(__name__)
+
+
+class StreamConfig:
+    """一路摄像头的配置（streams.json 中 streams 的一项）
+
+        {"name": "gate", "source": "rtsp://...", "rtmp": "rtmp://...", "priority": 4,
+         "codec": "h264", "bitrate": 2000, "fps": 25, "enabled": true}
+    priority 为共享推理中的权重（见 ai.batching.BatchInference）；其余未知的键原样保存在 extra 里，
+    交给 main 的编码器 / 调度器工厂按路定制。
+    """
+
+    KEYS = ('name', 'source', 'rtmp', 'priority', 'codec', 'bitrate', 'fps', 'enabled')
+
+    def __init__(self, name, source, rtmp=None, priority=1.0, codec='h264', bitrate=2000, fps=25, enabled=True,
+                 **extra):
+        self.name = name
+        self.source = source
+        self.rtmp = rtmp
+        self.priority = float(priority)
+        self.codec = codec
+        self.bitrate = int(bitrate)
+        self.fps = int(fps)
+        self.enabled = bool(enabled)
+        self.extra = extra
+
+    def as_dict(self):
+        d = {key: getattr(self, key) for key in self.KEYS}
+        d.update(self.extra)
+        return d
+
+    def __eq__(self, other):
+        return isinstance(other, StreamConfig) and self.as_dict() == other.as_dict()
+
+    def __repr__(self):
+        return 'StreamConfig(%r, %r, priority=%g)' % (self.name, self.source, self.priority)
+
+
+def load_streams(path):
+    with open(path, 'r', encoding='utf-8') as f:
+        doc = json.load(f)
+    configs = [StreamConfig(**entry) for entry in doc.get('streams', [])]
+    names = [c.name for c in configs]
+    duplicated = sorted({n for n in names if names.count(n) > 1})
+    if duplicated:
+        raise ValueError('%s: duplicate stream names %s' % (path, ', '.join(duplicated)))
+    return configs
+
+
+class ManagedStream:
+    """一路的运行状态：当前的 Pipeline、重连退避、最近一次错误"""
+
+    def __init__(self, config):
+        self.config = config
+        self.pipeline = None
+        self.client = None
+        self.state = 'idle'  # idle / starting / running / backoff / stopped
+        self.error = None
+        self.restarts = 0
+        self.backoff = 0.0
+        self.retry_at = 0.0
+        self.started_at = 0.0
+        self.last_progress = 0.0
+        self.busy = False    # 工作线程正在建 / 停这一路的流水线，监督线程跳过它
+        self.worker = None
+        self._processed = -1
+
+    def progress(self, now):
+        """距源阶段上一次出帧的秒数；OpenCV 源断线后只会不停地读失败，不会自己退出"""
+        processed = self.pipeline.source.processed
+        if processed != self._processed:
+            self._processed = processed
+            self.last_progress = now
+        return now - self.last_progress
+
+
+class StreamManager:
+    """多路摄像头管理：每路独立的收流、解码、ROI 编码和推流，检测共用一个 BatchInference
+
+    每路一个 Pipeline，出错、源结束或 stall_seconds 秒没有新帧时停掉，按指数退避
+    （backoff_min 起每次翻倍，最多 backoff_max，带 ±20% 抖动）重建；连续运行 stable_seconds
+    之后退避清零。各路的重连互不影响：打开源（RTSP 握手）、建流水线和 Pipeline.stop() 都可能
+    阻塞数秒，它们在该路自己的工作线程里进行，_lock 只保护状态，监督线程、指标导出和
+    add() / remove() 不会等某一路的重连。add() / remove() / reload() 可以在运行中调用，
+    watch() 之后配置文件修改时自动按差异增删、重启有变化的路，不影响其余各路。
+
+    工厂都按路调用：encoder_factory(config, width, height)、streamer_factory(config, encoder)、
+    detection_factory(config) 返回 Pipeline 的 scheduler / tracker / resolution 等关键字参数。
+    """
+
+    def __init__(self, batcher, encoder_factory=None, streamer_factory=None, detection_factory=None,
+                 decoder_backend='auto', backoff_min=1.0, backoff_max=60.0, stable_seconds=30.0, stall_seconds=10.0,
+                 poll=0.5):
+        self.batcher = batcher
+        self.encoder_factory = encoder_factory
+        self.streamer_factory = streamer_factory
+        self.detection_factory = detection_factory
+        self.decoder_backend = decoder_backend
+        self.backoff_min = backoff_min
+        self.backoff_max = backoff_max
+        self.stable_seconds = stable_seconds
+        self.stall_seconds = stall_seconds
+        self.poll = poll
+        self.streams = {}
+        self._retired = {}  # 路名 -> 正在停掉已移除的那一路的工作线程
+        self._lock = threading.RLock()
+        self._running = False
+        self._thread = None
+        self._watch_path = None
+        self._watch_mtime = None
+
+    # 单路出错只会让它进入退避，不会让整个进程退出；各路的错误见 stats()
+    error = None
+
+    @property
+    def running(self):
+        return self._running
+
+    def start(self):
+        self._running = True
+        self._thread = threading.Thread(target=self._supervise, name='stream-manager', daemon=True)
+        self._thread.start()
+        return self
+
+    def stop(self):
+        self._running = False
+        if self._thread is not None:
+            self._thread.join()
+            self._thread = None
+        with self._lock:
+            names = list(self.streams)
+        for name in names:
+            self.remove(name)
+        with self._lock:
+            workers = list(self._retired.values())
+            self._retired.clear()
+        for worker in workers:
+            worker.join()
+
+    def watch(self, path):
+        """加载 path 中的各路，并在文件修改后自动 reload()"""
+        self._watch_path = path
+        self._watch_mtime = os.path.getmtime(path)
+        self.reload(load_streams(path))
+
+    def add(self, config):
+        with self._lock:
+            if config.name in self.streams:
+                raise ValueError('stream %r already exists' % config.name)
+            stream = ManagedStream(config)
+            self.streams[config.name] = stream
+            if config.enabled:
+                stream.state = 'starting'
+                # 同名的旧一路可能还在停，新的一路等它停完再连同一个摄像头和推流地址
+                self._spawn(stream, self._launch, self._retired.pop(config.name, None))
+            else:
+                stream.state = 'stopped'
+        log.info('stream %s added (%s)', config.name, config.source)
+
+    def remove(self, name):
+        """移除一路并立即返回，它的流水线在工作线程里停掉（stop() 会等这些线程结束）"""
+        with self._lock:
+            stream = self.streams.pop(name, None)
+            if stream is None:
+                return
+            # 先让这一路等待中的检测请求结束，推理阶段才能及时退出
+            self.batcher.remove(name)
+            stream.state = 'stopped'
+            self._retired[name] = self._spawn(stream, self._retire, stream.worker)
+        log.info('stream %s removed', name)
+
+    def reload(self, configs):
+        """按新的配置列表增删各路；只有配置变了的路会重启"""
+        wanted = {c.name: c for c in configs}
+        removed = []
+        added = []
+        with self._lock:
+            for name in self.streams:
+                if name not in wanted:
+                    removed.append(name)
+            for name, config in wanted.items():
+                current = self.streams.get(name)
+                if current is None:
+                    added.append(config)
+                elif current.config != config:
+                    old = dict(current.config.as_dict(), priority=None)
+                    if old == dict(config.as_dict(), priority=None):
+                        # 只改了优先级：调整权重即可，不必重连
+                        current.config = config
+                        self.batcher.set_priority(name, config.priority)
+                        continue
+                    removed.append(name)
+                    added.append(config)
+        for name in removed:
+            self.remove(name)
+        for config in added:
+            self.add(config)
+
+    def _spawn(self, stream, target, *args):
+        """在该路的工作线程里运行 target(stream, *args)；调用方持有 _lock"""
+        stream.busy = True
+        worker = threading.Thread(target=target, args=(stream,) + args, name='stream-' + stream.config.name,
+                                  daemon=True)
+        stream.worker = worker
+        worker.start()
+        return worker
+
+    def _launch(self, stream, previous=None):
+        """工作线程：打开源、建流水线并启动，不持有 _lock；任何一步出错都让这一路进入退避"""
+        config = stream.config
+        if previous is not None:
+            previous.join()
+        pipeline = None
+        error = None
+        try:
+            stream.client = self.batcher.client(config.name, config.priority)
+            try:
+                source = open_source(config.source, decoder_backend=self.decoder_backend)
+            except Exception as e:
+                raise ConnectionError('open failed: %s' % e) from e
+            pipeline = self._build(config, source, stream.client)
+        except Exception as e:
+            log.debug('stream %s launch failed', config.name, exc_info=True)
+            error = str(e) if isinstance(e, ConnectionError) else 'launch failed: %s' % e
+        with self._lock:
+            stream.busy = False
+            current = self.streams.get(config.name) is stream
+            if not current:
+                # 建的过程中被 remove() 了；同名的路没有重新加入时把推理权重也清掉
+                if config.name not in self.streams:
+                    self.batcher.remove(config.name)
+            elif error is not None:
+                self._fail(stream, error)
+            else:
+                now = time.monotonic()
+                stream.pipeline = pipeline
+                stream.state = 'running'
+                stream.started_at = now
+                stream.last_progress = now
+                stream._processed = -1
+        if not current and pipeline is not None:
+            pipeline.stop()
+
+    def _build(self, config, source, client):
+        encoder_factory = None
+        streamer_factory = None
+        if config.rtmp and self.encoder_factory is not None:
+            def encoder_factory(width, height):
+                return self.encoder_factory(config, width, height)
+
+            if self.streamer_factory is not None:
+                def streamer_factory(encoder):
+                    return self.streamer_factory(config, encoder)
+        try:
+            extras = self.detection_factory(config) if self.detection_factory is not None else {}
+            pipeline = Pipeline(source, client, encoder_factory, streamer_factory, name=config.name, **extras)
+        except Exception:
+            # 源阶段还没启动，它的 teardown 不会自己运行
+            source.teardown()
+            raise
+        try:
+            pipeline.start()
+        except Exception:
+            pipeline.stop()
+            raise
+        return pipeline
+
+    def _retire(self, stream, worker):
+        """工作线程：等这一路进行中的建 / 停结束，再停掉它的流水线"""
+        if worker is not None:
+            worker.join()
+        pipeline, stream.pipeline = stream.pipeline, None
+        if pipeline is not None:
+            pipeline.stop()
+
+    def _stop(self, stream, pipeline):
+        try:
+            pipeline.stop()
+        finally:
+            with self._lock:
+                stream.busy = False
+
+    def _fail(self, stream, error):
+        """调用方持有 _lock：记下错误和退避，流水线交给工作线程停掉"""
+        pipeline, stream.pipeline = stream.pipeline, None
+        stream.error = error
+        stream.restarts += 1
+        stream.backoff = min(self.backoff_max, max(self.backoff_min, stream.backoff * 2))
+        delay = stream.backoff * random.uniform(0.8, 1.2)
+        stream.retry_at = time.monotonic() + delay
+        stream.state = 'backoff'
+        if pipeline is not None:
+            self._spawn(stream, self._stop, pipeline)
+        log.warning('stream %s: %s, retrying in %.1f s', stream.config.name, error, delay)
+
+    def _supervise(self):
+        while self._running:
+            time.sleep(self.poll)
+            self._check_config()
+            # 持锁期间只检查和改状态，建 / 停流水线都交给各路的工作线程
+            with self._lock:
+                for stream in self.streams.values():
+                    if stream.busy:
+                        continue
+                    now = time.monotonic()
+                    if stream.state == 'backoff' and now >= stream.retry_at:
+                        stream.state = 'starting'
+                        self._spawn(stream, self._launch)
+                    elif stream.state == 'running':
+                        if not stream.pipeline.running:
+                            self._fail(stream, stream.pipeline.error or 'source ended')
+                        elif stream.progress(now) > self.stall_seconds:
+                            self._fail(stream, 'no frames for %.0f s' % self.stall_seconds)
+                        elif stream.backoff and now - stream.started_at > self.stable_seconds:
+                            stream.backoff = 0.0
+
+    def _check_config(self):
+        if self._watch_path is None:
+            return
+        try:
+            mtime = os.path.getmtime(self._watch_path)
+            if mtime == self._watch_mtime:
+                return
+            self._watch_mtime = mtime
+            configs = load_streams(self._watch_path)
+        except (OSError, ValueError, TypeError) as e:
+            # 写了一半或格式错误的配置不生效，保持现有各路
+            log.error('stream config %s not reloaded: %s', self._watch_path, e)
+            return
+        log.info('stream config %s changed, reloading', self._watch_path)
+        self.reload(configs)
+
+    def pipelines(self):
+        """正在运行的各路 {路名: Pipeline}，供指标导出（pipeline.metrics.MetricsServer）"""
+        with self._lock:
+            return {name: stream.pipeline for name, stream in self.streams.items() if stream.pipeline is not None}
+
+    def stats(self):
+        with self._lock:
+            streams = list(self.streams.values())
+        out = {}
+        for stream in streams:
+            st = {'state': stream.state, 'priority': stream.config.priority, 'restarts': stream.restarts,
+                  'error': stream.error}
+            pipeline = stream.pipeline
+            if pipeline is not None:
+                st['pipeline'] = pipeline.stats()
+            out[stream.config.name] = st
+        return {'streams': out, 'inference': self.batcher.stats()}
@@ -0,0 +1,307 @@
+import bisect
+import collections
+import json
+import logging
+import os
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+log = logging.getLogger(__name__)
+
+# 直方图桶的上界（秒）：从单阶段的亚毫秒耗时到端到端的数秒，相邻两档约差 1.5 倍
+BUCKETS = (0.0005, 0.001, 0.0015, 0.002, 0.003, 0.004, 0.005, 0.0075, 0.01, 0.015, 0.02, 0.025, 0.03, 0.04,
+           0.05, 0.075, 0.1, 0.15, 0.2, 0.3, 0.5, 0.75, 1.0, 2.0, 5.0)
+
+_tracer = None
+
+
+class Histogram:
+    """固定桶的耗时直方图
+
+    每个实例只由一个线程写入（阶段自己的线程），observe() 只有一次二分查找和三次累加；
+    读取方拿到的是近似一致的快照，用于导出和统计，不影响热路径。
+    """
+
+    def __init__(self, bounds=BUCKETS):
+        self.bounds = bounds
+        self.counts = [0] * (len(bounds) + 1)  # 最后一个是超出最大上界的
+        self.count = 0
+        self.sum = 0.0
+
+    def observe(self, seconds):
+        self.counts[bisect.bisect_left(self.bounds, seconds)] += 1
+        self.count += 1
+        self.sum += seconds
+
+    def quantile(self, q):
+        """按桶内线性插值估计分位数（秒）；超出最大上界的部分按最大上界计"""
+        counts = list(self.counts)
+        total = sum(counts)
+        if not total:
+            return 0.0
+        rank = q * total
+        seen = 0
+        for i, c in enumerate(counts[:-1]):
+            if c and seen + c >= rank:
+                lo = self.bounds[i - 1] if i else 0.0
+                return lo + (self.bounds[i] - lo) * (rank - seen) / c
+            seen += c
+        return self.bounds[-1]
+
+    def summary(self):
+        count = self.count
+        return {
+            'count': count,
+            'mean_ms': round(1000.0 * self.sum / count, 2) if count else 0.0,
+            'p50_ms': round(1000.0 * self.quantile(0.5), 2),
+            'p99_ms': round(1000.0 * self.quantile(0.99), 2),
+        }
+
+
+class Tracer:
+    """Chrome trace 记录器（chrome://tracing 或 Perfetto 打开）
+
+    每个阶段处理一项记一个完整事件（ph=X），线程按 '路/阶段' 命名。
+    最多保留 max_events 个，之后丢弃最旧的，长时间运行也只占固定内存。
+    """
+
+    def __init__(self, max_events=200000):
+        self.events = collections.deque(maxlen=max_events)
+        self.pid = os.getpid()
+        self._threads = {}
+        self._t0 = time.perf_counter()
+
+    def complete(self, label, name, start, end, args):
+        tid = threading.get_ident()
+        if tid not in self._threads:
+            self._threads[tid] = label
+        self.events.append((name, tid, start, end, args))
+
+    def to_json(self):
+        events = [{'name': 'thread_name', 'ph': 'M', 'pid': self.pid, 'tid': tid, 'args': {'name': label}}
+                  for tid, label in list(self._threads.items())]
+        for name, tid, start, end, args in list(self.events):
+            events.append({'name': name, 'ph': 'X', 'pid': self.pid, 'tid': tid, 'ts': (start - self._t0) * 1e6,
+                           'dur': (end - start) * 1e6, 'args': args})
+        return {'traceEvents': events, 'displayTimeUnit': 'ms'}
+
+    def dump(self, path):
+        with open(path, 'w') as f:
+            json.dump(self.to_json(), f)
+        log.info('chrome trace with %d events written to %s', len(self.events), path)
+
+
+def enable_trace(max_events=200000):
+    """开启进程内的 Chrome trace 记录，之后各阶段每处理一项记一个事件"""
+    global _tracer
+    if _tracer is None:
+        _tracer = Tracer(max_events)
+    return _tracer
+
+
+def tracer():
+    return _tracer
+
+
+class StageTimer:
+    """一个阶段的打点：每项的处理耗时、离开阶段时帧的年龄，以及打点本身花掉的时间
+
+    帧的年龄从 origin 算起（摄像头读出的时刻，RTSP 路径是原生收齐 AU 的时刻），编码包沿用
+    来源帧的 origin，所以推流阶段的年龄就是本机内从收到画面到交给 RTMP 发送队列的时延。
+    带 marks 的项（Frame、编码包）记下离开每个阶段的时刻。
+    """
+
+    def __init__(self, name, stream='main'):
+        self.name = name
+        self.stream = stream
+        self.latency = Histogram()
+        self.age = Histogram()
+        self.overhead = 0.0
+
+    def record(self, start, end, item=None):
+        self.latency.observe(end - start)
+        origin = getattr(item, 'origin', None)
+        if origin is not None:
+            self.age.observe(end - origin)
+            item.marks[self.name] = end
+        trace = _tracer
+        if trace is not None:
+            args = {'age_ms': round(1000.0 * (end - origin), 2)} if origin is not None else {}
+            if getattr(item, 'index', None) is not None:
+                args['frame'] = item.index
+            trace.complete('%s/%s' % (self.stream, self.name), self.name, start, end, args)
+        self.overhead += time.perf_counter() - end
+
+    def summary(self):
+        count = self.latency.count
+        out = {'latency': self.latency.summary()}
+        if self.age.count:
+            out['age'] = self.age.summary()
+        if count:
+            out['overhead_us'] = round(1e6 * self.overhead / count, 2)
+        return out
+
+
+def _escape(value):
+    return str(value).replace('\\', '\\\\').replace('"', '\\"').replace('\n', '\\n')
+
+
+class _Exposition:
+    """按指标族收集样本，输出 Prometheus 文本格式（同一族的样本必须连续）"""
+
+    def __init__(self):
+        self._families = {}
+
+    def _family(self, name, kind, doc):
+        family = self._families.get(name)
+        if family is None:
+            family = self._families[name] = ['# HELP %s %s' % (name, doc), '# TYPE %s %s' % (name, kind)]
+        return family
+
+    @staticmethod
+    def _labels(labels, extra=None):
+        items = list(labels.items()) + (list(extra.items()) if extra else [])
+        return '{%s}' % ','.join('%s="%s"' % (k, _escape(v)) for k, v in items)
+
+    def sample(self, name, kind, doc, labels, value):
+        self._family(name, kind, doc).append('%s%s %s' % (name, self._labels(labels), repr(float(value))))
+
+    def histogram(self, name, doc, labels, hist):
+        family = self._family(name, 'histogram', doc)
+        counts = list(hist.counts)
+        cumulative = 0
+        for bound, c in zip(hist.bounds, counts):
+            cumulative += c
+            family.append('%s_bucket%s %d' % (name, self._labels(labels, {'le': repr(bound)}), cumulative))
+        cumulative += counts[-1]
+        family.append('%s_bucket%s %d' % (name, self._labels(labels, {'le': '+Inf'}), cumulative))
+        family.append('%s_sum%s %s' % (name, self._labels(labels), repr(hist.sum)))
+        family.append('%s_count%s %d' % (name, self._labels(labels), cumulative))
+
+    def text(self):
+        return '\n'.join(line for family in self._families.values() for line in family) + '\n'
+
+
+def _timers(pipeline):
+    for stage in pipeline.stages:
+        yield stage, stage.timer
+    if pipeline.preview_timer.latency.count:
+        yield None, pipeline.preview_timer
+
+
+def render(pipelines):
+    """把 {路名: Pipeline} 渲染成 Prometheus 文本格式
+
+    只读 Python 侧的计数和各阶段缓存的最近一次原生统计（推流的 last_stats、帧池的 last_pools），
+    不在抓取线程里调用原生句柄，
+    抓取和各路的停止、重建互不影响。
+    """
+    out = _Exposition()
+    for name, pipeline in pipelines.items():
+        stream = {'stream': name}
+        for stage, timer in _timers(pipeline):
+            labels = {'stream': name, 'stage': timer.name}
+            out.histogram('roi_stage_latency_seconds', 'Time a stage spends on one item.', labels, timer.latency)
+            out.histogram('roi_frame_age_seconds',
+                          'Time from frame ingress (camera read or RTSP AU arrival) to leaving the stage.',
+                          labels, timer.age)
+            out.sample('roi_instrumentation_seconds_total', 'counter', 'Time spent in the instrumentation itself.',
+                       labels, timer.overhead)
+            if stage is not None:
+                out.sample('roi_stage_items_total', 'counter', 'Items processed by the stage.', labels,
+                           stage.processed)
+                out.sample('roi_stage_busy_seconds_total', 'counter', 'Time the stage spent processing.', labels,
+                           stage.busy_time)
+        for queue in pipeline.queues:
+            labels = {'stream': name, 'queue': queue.name}
+            out.sample('roi_queue_depth', 'gauge', 'Items waiting in the queue.', labels, len(queue))
+            out.sample('roi_queue_capacity', 'gauge', 'Queue capacity.', labels, queue.maxsize)
+            out.sample('roi_queue_high_water', 'gauge', 'Largest queue depth seen.', labels, queue.high_water)
+            out.sample('roi_queue_dropped_total', 'counter', 'Items dropped by the queue policy.', labels,
+                       queue.drop_count)
+            out.sample('roi_queue_blocked_seconds_total', 'counter', 'Time producers were blocked by backpressure.',
+                       labels, queue.blocked_time)
+        pool = pipeline.pool.stats()
+        out.sample('roi_frame_pool_in_use', 'gauge', 'BGR frame buffers in use.', stream, pool['in_use'])
+        out.sample('roi_frame_pool_capacity', 'gauge', 'BGR frame pool capacity.', stream, pool['capacity'])
+        out.sample('roi_frame_pool_misses_total', 'counter', 'Frame buffers allocated outside the pool.', stream,
+                   pool['misses'])
+        # 同一尺寸的缩放器被几路编码共用，按池名去重
+        native_pools = {}
+        for stage in pipeline.stages:
+            native_pools.update(stage.last_pools)
+        for pool_name, st in sorted(native_pools.items()):
+            labels = {'stream': name, 'pool': pool_name}
+            out.sample('roi_native_pool_in_use', 'gauge', 'Native decoder / scaler / encoder buffers in use.', labels,
+                       st['in_use'])
+            out.sample('roi_native_pool_capacity', 'gauge', 'Native buffer pool capacity.', labels, st['capacity'])
+            out.sample('roi_native_pool_misses_total', 'counter', 'Native buffers allocated outside the pool.', labels,
+                       st['misses'])
+        for rendition, _, publish in pipeline.renditions:
+            rtmp = publish.last_stats if publish is not None else None
+            if not rtmp:
+                continue
+            labels = {'stream': name, 'rendition': rendition.name}
+            out.sample('roi_rtmp_queue_seconds', 'gauge', 'Media time waiting in the native RTMP send queue.', labels,
+                       rtmp['queued_ms'] / 1000.0)
+            out.sample('roi_rtmp_socket_bytes', 'gauge', 'Bytes in the kernel send buffer.', labels,
+                       rtmp['socket_bytes'])
+            out.sample('roi_rtmp_sent_bytes_total', 'counter', 'Bytes written to the RTMP socket.', labels,
+                       rtmp['sent_bytes'])
+            for kind in ('ref', 'nonref'):
+                out.sample('roi_rtmp_dropped_frames_total', 'counter', 'Frames dropped by RTMP congestion control.',
+                           dict(labels, kind=kind), rtmp['dropped_' + kind])
+    return out.text()
+
+
+class MetricsServer:
+    """Prometheus 抓取端点：GET /metrics；开启了 trace 时 GET /trace 返回当前的 Chrome trace JSON
+
+    collect() 返回 {路名: Pipeline}，每次抓取时调用。HTTP 线程是守护线程，stop() 关闭监听。
+    """
+
+    def __init__(self, collect, port, host='0.0.0.0'):
+        self.collect = collect
+        self.port = port
+        self.host = host
+        self._server = None
+        self._thread = None
+
+    def start(self):
+        collect = self.collect
+
+        class Handler(BaseHTTPRequestHandler):
+            def do_GET(self):
+                path = self.path.split('?', 1)[0]
+                if path == '/metrics':
+                    body = render(collect()).encode()
+                    ctype = 'text/plain; version=0.0.4; charset=utf-8'
+                elif path == '/trace' and _tracer is not None:
+                    body = json.dumps(_tracer.to_json()).encode()
+                    ctype = 'application/json'
+                else:
+                    self.send_error(404)
+                    return
+                self.send_response(200)
+                self.send_header('Content-Type', ctype)
+                self.send_header('Content-Length', str(len(body)))
+                self.end_headers()
+                self.wfile.write(body)
+
+            def log_message(self, fmt, *args):
+                log.debug('metrics %s: ' + fmt, self.address_string(), *args)
+
+        self._server = ThreadingHTTPServer((self.host, self.port), Handler)
+        self._server.daemon_threads = True
+        self.port = self._server.server_address[1]
+        self._thread = threading.Thread(target=self._server.serve_forever, name='metrics-http', daemon=True)
+        self._thread.start()
+        log.info('metrics endpoint on http://%s:%d/metrics', self.host, self.port)
+        return self
+
+    def stop(self):
+        if self._server is not None:
+            self._server.shutdown()
+            self._server.server_close()
+            self._server = None
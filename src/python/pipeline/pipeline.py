@@ -0,0 +1,236 @@
+import logging
+import threading
+import time
+
+from src.python.pipeline.metrics import StageTimer
+from src.python.pipeline.pool import FramePool
+from src.python.pipeline.queues import DROP_LATEST, DROP_NEVER, StageQueue
+from src.python.pipeline.stage import RoiState
+from src.python.pipeline.stages import (CaptureStage, DecodeStage, EncodeStage, InferenceStage,
+                                        PublishStage)
+
+log = logging.getLogger(__name__)
+
+
+def open_source(source, resolution=(640, 480), decoder_backend='auto'):
+    """按 source 创建源阶段：rtsp:// 且原生库可用时走原生收流 + VPU 解码，其余交给 OpenCV"""
+    if isinstance(source, str) and source.startswith('rtsp://'):
+        from src.python.native import lib as native
+        if native.load() is not None:
+            from src.python.stream.camera import RtspIngest
+            from src.python.stream.decoder import Decoder
+            ingest = RtspIngest(source)
+            try:
+                # 推理和显示都要在 CPU 上读帧，所以解码输出映射到主机内存
+                decoder = Decoder(ingest, backend=decoder_backend, keep_on_device=False)
+            except Exception:
+                ingest.stop()
+                raise
+            return DecodeStage(ingest, decoder)
+        log.warning('native pipeline library not built, falling back to OpenCV for %s', source)
+    from src.python.stream.camera import CameraStream
+    if isinstance(source, str) and source.isdigit():
+        source = int(source)
+    return CaptureStage(CameraStream(source, resolution))
+
+
+class Rendition:
+    """多码率输出中的一路：自己的编码器、推流端和码控，共用流水线的解码和检测
+
+    encoder_factory(width, height) / streamer_factory(encoder) 与 Pipeline 的同名参数相同；
+    size 为 (width, height) 时编码前把帧缩放到这个尺寸，None 为源尺寸；也可以是 size(width, height)，
+    第一帧到来时按源尺寸调用，返回编码尺寸或 None。
+    """
+
+    def __init__(self, name, encoder_factory, streamer_factory=None, size=None, rate_control=None):
+        self.name = name
+        self.encoder_factory = encoder_factory
+        self.streamer_factory = streamer_factory
+        self.size = size if callable(size) or not size else (int(size[0]) & ~1, int(size[1]) & ~1)
+        self.rate_control = rate_control
+
+    def __repr__(self):
+        return 'Rendition(%r, size=%r)' % (self.name, self.size)
+
+
+class Pipeline:
+    """多阶段流水线，每个阶段一个线程，阶段之间是有界队列
+
+        capture/decode ─┬─> [latest-wins] inference ──> [latest-wins] preview（Tk 线程轮询）
+                        └─> [never-drop]  encode ──> [never-drop] publish
+
+    推理按自己的速度只处理最新一帧，结果通过 RoiState 交给编码；编码按源帧率逐帧进行，
+    队列满时阻塞源阶段形成背压，而不是丢帧。各队列的深度和策略都可以配置。
+    没有配置推流地址时 encode/publish 两个阶段不创建。
+    scheduler / tracker（见 ai.scheduler、ai.tracker）让检测器隔帧运行，中间的帧由跟踪器外推。
+    resolution（见 ai.resolution）按场景和负载为这一路切换检测器的输入尺寸。
+    passthrough（见 stream.passthrough.PassthroughPolicy）让没有目标的时段直接转发源码流，
+    只对原生 RTSP 源有效。
+    rate_control（见 stream.ratecontrol.RateController）按推流时延闭环调整编码的 QP 偏移和背景帧率。
+    源阶段的 BGR 帧来自本路的 FramePool，pool_frames 为 None 时按各队列深度加上
+    每个阶段手里的一帧推算；stats()['pool'] 给出它的占用，用来判断下游是否积压。
+    name 是这一路在指标和 trace 里的标签（见 pipeline.metrics），预览窗口的打点记在 preview_timer。
+    roi_log 交给编码阶段，记录每次变化的检测框（见 EncodeStage）。
+    record_detections（ai.detections.DetectionRecorder）录下推理阶段的结果；replay_detections
+    （ai.detections.DetectionIndex）让各编码阶段各用一个游标回放录好的结果，这时 processor 可以为 None。
+    renditions（Rendition 列表）代替 encoder_factory / streamer_factory 输出多个码流：
+
+        decode ─┬─> inference
+                ├─> [never-drop] encode ──> publish                （第一路，源尺寸时可以直通）
+                └─> [never-drop] encode.<name> ──> publish.<name>  （其余各路，可以缩放）
+
+    各路共用解码和一次检测，尺寸相同的各路共用一次缩放（原生帧用 stream.decoder.Scaler）。
+    第一路沿用 encode / publish 的阶段名，passthrough 和 roi_log 只作用于它；rate_control 只用于不给
+    renditions 的情形，多路时每路用自己的 Rendition.rate_control。任何一路的阶段退出都会让 running 变为 False。
+    """
+
+    def __init__(self, source, processor, encoder_factory=None, streamer_factory=None, preview=False,
+                 scheduler=None, tracker=None, resolution=None, passthrough=None, rate_control=None,
+                 inference_depth=1, inference_policy=DROP_LATEST,
+                 encode_depth=8, encode_policy=DROP_NEVER,
+                 publish_depth=32, publish_policy=DROP_NEVER,
+                 preview_depth=1, preview_policy=DROP_LATEST, pool_frames=None, name='main', roi_log=None,
+                 record_detections=None, replay_detections=None, renditions=None):
+        self.name = name
+        self.source = source
+        if pool_frames is None:
+            pool_frames = inference_depth + encode_depth + preview_depth + 4
+        self.pool = FramePool(source.name, pool_frames)
+        source.pool = self.pool
+        self.roi_state = RoiState()
+        self.key_request = threading.Event()
+        self.queues = []
+        self.stages = [source]
+
+        self.inference = None
+        if processor is not None:
+            inbox = self._queue('inference', inference_depth, inference_policy)
+            self.inference = InferenceStage(processor, self.roi_state, inbox, scheduler, tracker, resolution,
+                                            record_detections)
+            source.connect(inbox)
+            self.stages.append(self.inference)
+
+        self.preview = None
+        if preview:
+            self.preview = self._queue('preview', preview_depth, preview_policy)
+            (self.inference or source).connect(self.preview)
+
+        if renditions is None:
+            renditions = [Rendition('main', encoder_factory, streamer_factory, rate_control=rate_control)] \
+                if encoder_factory is not None else []
+        self.renditions = []  # 每路的 (Rendition, EncodeStage, PublishStage 或 None)
+        self.scalers = {}
+        self._scaler_lock = threading.Lock()
+        self._scaler_frames = encode_depth + 4  # 编码队列里的帧各持有一个缩放结果，再加上编码器手里的几帧
+        self.passthrough = None
+        if passthrough is not None and renditions and renditions[0].streamer_factory is not None \
+                and renditions[0].size is None:
+            # 直通转发的是源码流，只有第一路按源尺寸编码时才有意义
+            if isinstance(source, DecodeStage):
+                self.passthrough = passthrough
+            else:
+                log.warning('passthrough needs the native rtsp source, %s re-encodes every frame', source.name)
+        for i, rendition in enumerate(renditions):
+            primary = i == 0
+            self._add_rendition(rendition, '' if primary else '.' + rendition.name,
+                                replay_detections.cursor() if replay_detections is not None else None,
+                                self.passthrough if primary else None, roi_log if primary else None,
+                                encode_depth, encode_policy, publish_depth, publish_policy)
+        _, self.encode, self.publish = self.renditions[0] if self.renditions else (None, None, None)
+        self.rate_control = self.encode.rate_control if self.encode is not None else None
+
+        for stage in self.stages:
+            stage.timer.stream = name
+        self.preview_timer = StageTimer('preview', name)
+
+    def _add_rendition(self, rendition, suffix, replay, passthrough, roi_log, encode_depth, encode_policy,
+                       publish_depth, publish_policy):
+        source = self.source
+        # 每路各自请求关键帧：一路推流拥塞丢了参考帧，不影响其余各路的 GOP
+        key_request = self.key_request if not suffix else threading.Event()
+        rate_control = rendition.rate_control if rendition.streamer_factory is not None else None
+        inbox = self._queue('encode' + suffix, encode_depth, encode_policy)
+        encode = EncodeStage(rendition.encoder_factory, self.roi_state, inbox, key_request, passthrough,
+                             rate_control, roi_log, replay, rendition.size, self.scaler_for, name='encode' + suffix)
+        source.connect(inbox)
+        self.stages.append(encode)
+        publish = None
+        if rendition.streamer_factory is not None:
+            inbox = self._queue('publish' + suffix, publish_depth, publish_policy)
+            streamer_factory = rendition.streamer_factory
+            publish = PublishStage(lambda: streamer_factory(encode.encoder), inbox, key_request, passthrough,
+                                   getattr(source, 'ingest', None), rate_control, name='publish' + suffix)
+            encode.connect(inbox)
+            self.stages.append(publish)
+        self.renditions.append((rendition, encode, publish))
+
+    def scaler_for(self, size):
+        """size 对应的原生缩放器，同一尺寸的各路共用一个；由各编码阶段在第一帧时调用"""
+        with self._scaler_lock:
+            scaler = self.scalers.get(size)
+            if scaler is None:
+                from src.python.stream.decoder import Scaler
+                scaler = self.scalers[size] = Scaler(size[0], size[1], self._scaler_frames)
+            return scaler
+
+    def _queue(self, name, depth, policy):
+        queue = StageQueue(name, depth, policy)
+        self.queues.append(queue)
+        return queue
+
+    def start(self):
+        # 先启动下游，源阶段最后启动，避免第一批帧堆在还没人消费的队列里
+        for stage in reversed(self.stages):
+            stage.start()
+        return self
+
+    def stop(self, timeout=2.0):
+        """从源头开始逐级停止；关闭队列时残留的帧和包会被归还"""
+        for _, encode, _ in self.renditions:
+            if encode.rate_control is not None:
+                encode.rate_control.detach()
+        if self.passthrough is not None:
+            # 直通引用着源的收流缓冲区，须在源阶段关闭收流之前断开
+            self.passthrough.detach()
+        for stage in self.stages:
+            stage.stop()
+            stage.join(timeout)
+        if self.preview is not None:
+            self.preview.close()
+        for scaler in self.scalers.values():
+            scaler.close()
+
+    @property
+    def running(self):
+        return all(stage.alive for stage in self.stages)
+
+    @property
+    def error(self):
+        for stage in self.stages:
+            if stage.error is not None:
+                return '%s: %s' % (stage.name, stage.error)
+        return None
+
+    def wait(self, poll=0.5):
+        """阻塞直到某个阶段退出（出错或源结束）"""
+        while self.running:
+            time.sleep(poll)
+        return self.error
+
+    def stats(self):
+        st = {
+            'stages': {stage.name: stage.stats() for stage in self.stages},
+            'queues': {queue.name: queue.stats() for queue in self.queues},
+            'pool': self.pool.stats(),
+            'instrumentation_pct': self.instrumentation_pct(),
+        }
+        scalers = [(size, scaler) for size, scaler in list(self.scalers.items()) if scaler.handle]
+        if scalers:
+            st['scalers'] = {'%dx%d' % size: scaler.pool_stats() for size, scaler in scalers}
+        return st
+
+    def instrumentation_pct(self):
+        """打点本身的耗时占各阶段处理耗时之和的百分比"""
+        busy = sum(stage.busy_time for stage in self.stages)
+        overhead = sum(stage.timer.overhead for stage in self.stages) + self.preview_timer.overhead
+        return round(100.0 * overhead / busy, 3) if busy > 0 else 0.0
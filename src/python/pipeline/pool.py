@@ -0,0 +1,65 @@
+import threading
+
+import numpy as np
+
+
+class FramePool:
+    """每路一个的 BGR 帧缓冲池，采集、BGR 转换都从这里取内存，帧释放时归还
+
+    count 在启动时按流水线中能同时存活的帧数确定（各队列深度加上正在处理的帧），
+    缓冲在第一次用到某个尺寸时分配，之后稳态下不再分配；尺寸变化时整池换代，
+    旧尺寸的缓冲归还时直接丢弃。池空时临时分配并计入 misses，
+    in_use 长期接近 capacity 说明下游在积压。
+    """
+
+    def __init__(self, name, count):
+        self.name = name
+        self.count = max(1, int(count))
+        self._lock = threading.Lock()
+        self._shape = None
+        self._owned = {}  # id -> ndarray，当前尺寸属于池的缓冲
+        self._free = []
+        self.acquired = 0
+        self.misses = 0
+        self.high_water = 0
+
+    def acquire(self, shape, dtype=np.uint8):
+        shape = tuple(shape)
+        with self._lock:
+            if shape != self._shape:
+                self._shape = shape
+                self._owned = {}
+                self._free = []
+            if self._free:
+                array = self._free.pop()
+            elif len(self._owned) < self.count:
+                array = np.empty(shape, dtype=dtype)
+                self._owned[id(array)] = array
+            else:
+                self.misses += 1
+                return np.empty(shape, dtype=dtype)
+            self.acquired += 1
+            self.high_water = max(self.high_water, len(self._owned) - len(self._free))
+            return array
+
+    def release(self, array):
+        """归还 acquire() 得到的缓冲；不属于池（临时分配或旧尺寸）的直接忽略"""
+        if array is None:
+            return
+        with self._lock:
+            if self._owned.get(id(array)) is array:
+                self._free.append(array)
+
+    def owns(self, array):
+        with self._lock:
+            return self._owned.get(id(array)) is array
+
+    def stats(self):
+        with self._lock:
+            return {
+                'capacity': self.count,
+                'in_use': len(self._owned) - len(self._free),
+                'high_water': self.high_water,
+                'acquired': self.acquired,
+                'misses': self.misses,
+            }
@@ -0,0 +1,115 @@
+import collections
+import threading
+import time
+
+# 队列满时的处理策略
+DROP_NEVER = 'never'    # 阻塞生产者（背压），一帧都不丢，用于编码/推流
+DROP_LATEST = 'latest'  # latest-wins：丢掉队列里最旧的，只保留最新的几项，用于推理/预览
+DROP_NEWEST = 'newest'  # 丢掉新来的这一项，队列里已有的保持不变
+
+POLICIES = (DROP_NEVER, DROP_LATEST, DROP_NEWEST)
+
+
+def _release(item):
+    release = getattr(item, 'release', None)
+    if release is not None:
+        release()
+
+
+class StageQueue:
+    """阶段之间的有界队列
+
+    被策略丢弃或关闭时残留的项会交给 on_drop（默认调用 item.release()），
+    这样原生解码缓冲、编码包之类的资源不会因为丢帧而泄漏。
+    """
+
+    def __init__(self, name, maxsize=4, policy=DROP_NEVER, on_drop=_release):
+        if policy not in POLICIES:
+            raise ValueError('unknown drop policy %r, expected one of %s' % (policy, ', '.join(POLICIES)))
+        self.name = name
+        self.maxsize = max(1, int(maxsize))
+        self.policy = policy
+        self.on_drop = on_drop
+        self._items = collections.deque()
+        self._cond = threading.Condition()
+        self._closed = False
+        self.put_count = 0
+        self.drop_count = 0
+        self.high_water = 0
+        self.blocked_time = 0.0  # 生产者因背压阻塞的累计秒数
+
+    def put(self, item, timeout=None):
+        """放入一项，返回 False 表示该项没有入队（被丢弃或队列已关闭），由调用方处理"""
+        dropped = None
+        with self._cond:
+            if self._closed:
+                return False
+            if len(self._items) >= self.maxsize:
+                if self.policy == DROP_NEWEST:
+                    self.drop_count += 1
+                    return False
+                if self.policy == DROP_LATEST:
+                    dropped = self._items.popleft()
+                    self.drop_count += 1
+                else:
+                    start = time.perf_counter()
+                    deadline = None if timeout is None else start + timeout
+                    while len(self._items) >= self.maxsize and not self._closed:
+                        left = None if deadline is None else deadline - time.perf_counter()
+                        if left is not None and left <= 0:
+                            break
+                        self._cond.wait(left)
+                    self.blocked_time += time.perf_counter() - start
+                    if self._closed or len(self._items) >= self.maxsize:
+                        return False
+            self._items.append(item)
+            self.put_count += 1
+            self.high_water = max(self.high_water, len(self._items))
+            self._cond.notify_all()
+        if dropped is not None and self.on_drop is not None:
+            self.on_drop(dropped)
+        return True
+
+    def get(self, timeout=None):
+        """取出一项；超时或队列关闭且为空时返回 None"""
+        with self._cond:
+            deadline = None if timeout is None else time.perf_counter() + timeout
+            while not self._items and not self._closed:
+                left = None if deadline is None else deadline - time.perf_counter()
+                if left is not None and left <= 0:
+                    return None
+                self._cond.wait(left)
+            if not self._items:
+                return None
+            item = self._items.popleft()
+            self._cond.notify_all()
+            return item
+
+    @property
+    def closed(self):
+        return self._closed
+
+    def close(self):
+        """关闭队列并唤醒所有等待者，残留的项交给 on_drop"""
+        with self._cond:
+            self._closed = True
+            items = list(self._items)
+            self._items.clear()
+            self._cond.notify_all()
+        if self.on_drop is not None:
+            for item in items:
+                self.on_drop(item)
+
+    def __len__(self):
+        return len(self._items)
+
+    def stats(self):
+        return {
+            'depth': len(self._items),
+            'maxsize': self.maxsize,
+            'policy': self.policy,
+            'put': self.put_count,
+            'dropped': self.drop_count,
+            'high_water': self.high_water,
+            'blocked_s': round(self.blocked_time, 3),
+        }
@@ -0,0 +1,52 @@
+import json
+
+
+class RenditionConfig:
+    """多码率输出中一路的配置（renditions.json 中 renditions 的一项）
+
+        {"name": "live", "rtmp": "rtmp://...", "codec": "h264", "bitrate": 800,
+         "width": 640, "height": 360, "background_qp": 10, "roi_qp": -6}
+    没有给出的编码参数（codec / bitrate / background_qp / roi_qp）用命令行的值；
+    width / height 都不给时按源尺寸编码，只给一个时按源的宽高比推算另一个（见 size_for）。
+    """
+
+    KEYS = ('name', 'rtmp', 'codec', 'bitrate', 'width', 'height', 'background_qp', 'roi_qp')
+
+    def __init__(self, name, rtmp, codec=None, bitrate=None, width=None, height=None, background_qp=None,
+                 roi_qp=None):
+        if not rtmp:
+            raise ValueError('rendition %s has no rtmp url' % name)
+        self.name = name
+        self.rtmp = rtmp
+        self.codec = codec
+        self.bitrate = int(bitrate) if bitrate is not None else None
+        self.width = int(width) if width else None
+        self.height = int(height) if height else None
+        self.background_qp = background_qp
+        self.roi_qp = roi_qp
+
+    def size_for(self, width, height):
+        """源为 width x height 时这一路的编码尺寸（偶数），与源相同时返回 None"""
+        if self.width is None and self.height is None:
+            return None
+        w = self.width or int(round(self.height * width / float(height)))
+        h = self.height or int(round(self.width * height / float(width)))
+        size = (max(2, w & ~1), max(2, h & ~1))
+        return None if size == (width, height) else size
+
+    def __repr__(self):
+        return 'RenditionConfig(%r, %s)' % (self.name, '%sx%s' % (self.width, self.height)
+                                            if self.width or self.height else 'source size')
+
+
+def load_renditions(path):
+    with open(path, 'r', encoding='utf-8') as f:
+        doc = json.load(f)
+    configs = [RenditionConfig(**entry) for entry in doc.get('renditions', [])]
+    if not configs:
+        raise ValueError('%s: no renditions' % path)
+    names = [c.name for c in configs]
+    duplicated = sorted({n for n in names if names.count(n) > 1})
+    if duplicated:
+        raise ValueError('%s: duplicate rendition names %s' % (path, ', '.join(duplicated)))
+    return configs
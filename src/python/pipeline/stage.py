@@ -0,0 +1,244 @@
+import logging
+import threading
+import time
+
+from src.python.pipeline.metrics import StageTimer
+
+log = logging.getLogger(__name__)
+
+
+class Frame:
+    """在各阶段之间流动的一帧
+
+    image 是 BGR ndarray（摄像头路径），native 是 decoder.DecodedFrame（RTSP 路径）。
+    同一帧会同时送往推理和编码，用引用计数决定何时归还原生解码缓冲：
+    每放进一个队列 retain() 一次，每个消费者处理完 release() 一次。
+    pool（pipeline.pool.FramePool）给出时，BGR 图像取自池，最后一次 release() 时归还，
+    所以各阶段不能在 release 之后继续持有 bgr() 的结果。
+    多码率输出时各路的编码输入由 scaled() 得到，同一尺寸只缩放一次，随本帧最后一次 release() 归还。
+    origin 是画面进入本机的时刻（time.perf_counter，默认取创建时刻），marks 记下离开各阶段的时刻，
+    见 pipeline.metrics.StageTimer。
+    """
+
+    def __init__(self, index, pts, image=None, native=None, pool=None, origin=None):
+        self.index = index
+        self.pts = pts
+        self.image = image
+        self.native = native
+        self.pool = pool
+        self.created = time.perf_counter()
+        self.origin = origin if origin is not None else self.created
+        self.marks = {}
+        self._scaled = {}  # (w, h) -> 缩放后的 DecodedFrame 或 BGR 图像
+        self._refs = 1
+        self._lock = threading.Lock()
+
+    @property
+    def width(self):
+        return self.native.width if self.native is not None else self.image.shape[1]
+
+    @property
+    def height(self):
+        return self.native.height if self.native is not None else self.image.shape[0]
+
+    def bgr(self):
+        """BGR 图像；原生帧第一次调用时转换并缓存"""
+        with self._lock:
+            if self.image is None and self.native is not None:
+                dst = self.pool.acquire((self.native.height, self.native.width, 3)) if self.pool else None
+                self.image = self.native.to_bgr(dst)
+            return self.image
+
+    def scaled(self, size, scaler=None):
+        """缩放到 size = (w, h) 的编码输入：原生帧经 scaler（stream.decoder.Scaler）得到 DecodedFrame，
+        BGR 帧用 cv2.resize。先到的编码线程做缩放，同一尺寸的其余各路直接复用"""
+        with self._lock:
+            out = self._scaled.get(size)
+            if out is None:
+                if self.native is not None:
+                    out = scaler.scale(self.native)
+                else:
+                    import cv2
+                    out = cv2.resize(self.image, size, interpolation=cv2.INTER_AREA)
+                self._scaled[size] = out
+            return out
+
+    def retain(self):
+        with self._lock:
+            self._refs += 1
+        return self
+
+    def release(self):
+        with self._lock:
+            self._refs -= 1
+            last = self._refs == 0
+        if not last:
+            return
+        for out in self._scaled.values():
+            if hasattr(out, 'release'):
+                out.release()
+        self._scaled = {}
+        if self.native is not None:
+            self.native.release()
+            self.native = None
+        if self.pool is not None and self.image is not None:
+            self.pool.release(self.image)
+            self.image = None
+
+
+class RoiState:
+    """推理阶段写、编码阶段读的最新检测结果；version 变化时编码端才需要更新 QP 图"""
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self.version = 0
+        self.detections = []
+        self.frame_index = -1
+        self.updated = 0.0
+
+    def update(self, detections, frame_index):
+        with self._lock:
+            self.detections = detections
+            self.frame_index = frame_index
+            self.version += 1
+            self.updated = time.perf_counter()
+
+    def snapshot(self):
+        with self._lock:
+            return self.version, self.detections, self.frame_index
+
+
+class Stage:
+    """流水线阶段：独占一个线程，从 inbox 取一项交给 process()，把结果分发到 outputs
+
+    没有 inbox 的是源阶段，改为反复调用 produce()。process()/produce() 返回 None、
+    单个结果或结果列表。inbox 取出的 Frame 处理完后由基类 release；返回的 Frame
+    会被 emit 消耗一个引用，所以把输入帧原样传下去时要返回 frame.retain()。
+    每项的耗时和帧的年龄记在 timer（pipeline.metrics.StageTimer）里。
+    持有原生帧池的阶段（解码、编码）在自己的线程里把最近一次的池统计缓存在 last_pools
+    （{池名: pool_stats() 的 dict}），指标导出读它而不是另外访问原生句柄。
+    """
+
+    poll_interval = 0.2
+
+    def __init__(self, name, inbox=None):
+        self.name = name
+        self.inbox = inbox
+        self.outputs = []
+        self.running = False
+        self.error = None
+        self.processed = 0
+        self.busy_time = 0.0
+        self.started = None
+        self.timer = StageTimer(name)
+        self.last_pools = {}
+        self._thread = None
+
+    def connect(self, queue):
+        self.outputs.append(queue)
+        return queue
+
+    # ---- 子类覆盖 ----
+
+    def setup(self):
+        pass
+
+    def produce(self):
+        raise NotImplementedError
+
+    def process(self, item):
+        raise NotImplementedError
+
+    def teardown(self):
+        pass
+
+    # ---- 线程控制 ----
+
+    def start(self):
+        self.running = True
+        self.started = time.perf_counter()
+        self._thread = threading.Thread(target=self._run, name='stage-' + self.name, daemon=True)
+        self._thread.start()
+
+    def stop(self):
+        self.running = False
+        if self.inbox is not None:
+            self.inbox.close()
+
+    def join(self, timeout=None):
+        if self._thread is not None:
+            self._thread.join(timeout)
+
+    @property
+    def alive(self):
+        return self._thread is not None and self._thread.is_alive()
+
+    def _run(self):
+        try:
+            self.setup()
+            while self.running:
+                if self.inbox is None:
+                    start = time.perf_counter()
+                    result = self.produce()
+                    if result is not None:
+                        self._handle(result, start, result)
+                    continue
+                item = self.inbox.get(self.poll_interval)
+                if item is None:
+                    if self.inbox.closed:
+                        break
+                    continue
+                start = time.perf_counter()
+                try:
+                    self._handle(self.process(item), start, item)
+                finally:
+                    if isinstance(item, Frame):
+                        item.release()
+        except Exception as e:
+            self.error = e
+            log.exception('stage %s failed', self.name)
+        finally:
+            self.running = False
+            # 阶段退出后关闭 inbox，背压阻塞中的上游不会一直等下去
+            if self.inbox is not None:
+                self.inbox.close()
+            try:
+                self.teardown()
+            except Exception:
+                log.exception('stage %s teardown failed', self.name)
+
+    def _handle(self, result, start, item):
+        end = time.perf_counter()
+        self.busy_time += end - start
+        self.processed += 1
+        self.timer.record(start, end, item)
+        if result is not None:
+            self.emit(result)
+
+    def emit(self, result):
+        """分发结果并消耗其中每个 Frame 的一个引用"""
+        for item in result if isinstance(result, list) else (result,):
+            if isinstance(item, Frame):
+                for queue in self.outputs:
+                    item.retain()
+                    if not queue.put(item):
+                        item.release()
+                item.release()
+                continue
+            # 编码包之类没有引用计数的项：一个下游都没收下时由这里归还
+            accepted = False
+            for queue in self.outputs:
+                accepted = queue.put(item) or accepted
+            if not accepted and hasattr(item, 'release'):
+                item.release()
+
+    def stats(self):
+        elapsed = time.perf_counter() - self.started if self.started else 0.0
+        return {
+            'processed': self.processed,
+            'fps': round(self.processed / elapsed, 2) if elapsed > 0 else 0.0,
+            'busy_ms': round(1000.0 * self.busy_time / self.processed, 2) if self.processed else 0.0,
+            'timing': self.timer.summary(),
+            'alive': self.alive,
+            'error': repr(self.error) if self.error else None,
+        }
@@ -0,0 +1,347 @@
+import json
+import threading
+import time
+
+from src.python.native import lib as native
+from src.python.pipeline.stage import Frame, Stage
+
+PTS_CLOCK = 90000
+MAX_PENDING_ORIGINS = 64  # 编码器攒帧的深度远小于它，多出来的是没有输出的帧
+
+
+class CaptureStage(Stage):
+    """OpenCV 采集阶段（摄像头或 OpenCV 能打开的任意源），输出 BGR 帧
+
+    pts 取采集时刻，换算成 90kHz，交给编码器时与 RTSP 路径保持一致。
+    pool（FramePool）由 Pipeline 设置，第一帧之后每帧都读进池里的缓冲。
+    """
+
+    def __init__(self, camera, pool=None):
+        super().__init__('capture')
+        self.camera = camera
+        self.pool = pool
+        self.index = 0
+        self._t0 = None
+        self._shape = None
+
+    def produce(self):
+        buf = self.pool.acquire(self._shape) if self.pool is not None and self._shape else None
+        image = self.camera.get_frame(buf)
+        if image is not buf and buf is not None:
+            # 读失败，或源尺寸变了 OpenCV 另行分配了图像
+            self.pool.release(buf)
+        if image is None:
+            time.sleep(0.01)
+            return None
+        self._shape = image.shape
+        now = time.perf_counter()
+        if self._t0 is None:
+            self._t0 = now
+        frame = Frame(self.index, int((now - self._t0) * PTS_CLOCK), image=image, pool=self.pool)
+        self.index += 1
+        return frame
+
+    def teardown(self):
+        self.camera.stop()
+
+
+class DecodeStage(Stage):
+    """RTSP 路径的源阶段：从原生解码器取 NV12 帧
+
+    收流和解码本身已经在原生线程里（RtspClient / DecodeSession）并行运行，
+    这里只负责把解码输出变成 Frame 分发给推理和编码，帧数据不经过拷贝。
+    解码帧本身来自原生帧池；pool（FramePool）只用于需要 BGR 时的转换缓冲。
+    """
+
+    def __init__(self, ingest, decoder, read_timeout_ms=200, pool=None):
+        super().__init__('decode')
+        self.ingest = ingest
+        self.decoder = decoder
+        self.read_timeout_ms = read_timeout_ms
+        self.pool = pool
+        self.index = 0
+
+    def produce(self):
+        decoded = self.decoder.read(self.read_timeout_ms)
+        if decoded is None:
+            if not self.ingest.alive:
+                raise ConnectionError('rtsp ingest stopped: %s' % self.ingest.error())
+            return None
+        frame = Frame(self.index, decoded.pts, native=decoded, pool=self.pool, origin=decoded.arrival)
+        self.index += 1
+        self.last_pools = {'decoder': self.decoder.pool_stats()}
+        return frame
+
+    def teardown(self):
+        self.decoder.stop()
+        self.ingest.stop()
+
+    def stats(self):
+        st = super().stats()
+        if self.decoder.handle:
+            st['decoder_pool'] = self.decoder.pool_stats()
+        return st
+
+
+class InferenceStage(Stage):
+    """推理阶段：按自己的速度处理 latest-wins 队列里最新的一帧，结果写进 RoiState
+
+    配了 scheduler 和 tracker 时只在调度器选中的帧上跑检测器，其余帧用跟踪器
+    外推上一次的检测框，ROI 依然逐帧更新。接了输出队列（预览）时把帧和检测结果一起往下传。
+    配了 resolution（ai.resolution.ResolutionPolicy）时每次检测按它选择网络输入尺寸。
+    配了 recorder（ai.detections.DetectionRecorder）时把写进 RoiState 的结果按帧的 pts 录下来，
+    之后的编码可以回放它而不再跑检测。
+    """
+
+    def __init__(self, processor, roi_state, inbox, scheduler=None, tracker=None, resolution=None, recorder=None):
+        super().__init__('inference', inbox)
+        self.processor = processor
+        self.roi_state = roi_state
+        self.scheduler = scheduler
+        self.tracker = tracker
+        self.resolution = resolution
+        self.recorder = recorder
+        self.detector_runs = 0
+
+    def setup(self):
+        # 配置了线程布局（main --affinity）时推理提交线程固定在推理核上，不与编码抢核
+        native.enter_thread(native.THREAD_INFER, 'roi-infer')
+
+    def process(self, frame):
+        if self.tracker is None or self.scheduler is None or self.scheduler.should_detect(frame):
+            if self.resolution is None:
+                detections = self.processor.detect(self.input_of(frame), owner=frame)
+            else:
+                start = time.perf_counter()
+                detections = self.processor.detect(self.input_of(frame), self.resolution.size, owner=frame)
+                self.resolution.observe(detections, frame.width, frame.height,
+                                        1000.0 * (time.perf_counter() - start))
+            self.detector_runs += 1
+            if self.scheduler is not None:
+                self.scheduler.detected(frame)
+            if self.tracker is not None:
+                detections = self.tracker.update(detections, frame.index)
+        else:
+            detections = self.tracker.predict(frame.index)
+        self.roi_state.update(detections, frame.index)
+        if self.recorder is not None:
+            self.recorder.write(frame.pts, detections, frame.width, frame.height)
+        if not self.outputs:
+            return None
+        frame.detections = detections
+        return frame.retain()
+
+    def input_of(self, frame):
+        # 原生帧直接交给融合预处理，省掉一次整帧的 BGR 转换
+        if frame.native is not None and getattr(self.processor, 'accepts_native', False):
+            return frame.native
+        return frame.bgr()
+
+    def stats(self):
+        st = super().stats()
+        st['detector_runs'] = self.detector_runs
+        if self.resolution is not None:
+            st['resolution'] = self.resolution.stats()
+        if self.recorder is not None:
+            st['recorded'] = self.recorder.stats()
+        if hasattr(self.processor, 'stats'):
+            st['detector'] = self.processor.stats()
+        return st
+
+
+def scale_detections(detections, sx, sy):
+    """把检测框换算到缩放后的画面，保留 RoiEncoder.update_rois 接受的各种形式"""
+    out = []
+    for det in detections:
+        if len(det) == 3:
+            x, y, w, h = det[2][:4]
+            out.append((det[0], det[1], [x * sx, y * sy, w * sx, h * sy]))
+        elif len(det) == 2:
+            x, y, w, h = det[0][:4]
+            out.append(([x * sx, y * sy, w * sx, h * sy], det[1]))
+        else:
+            x, y, w, h = det[:4]
+            out.append([x * sx, y * sy, w * sx, h * sy])
+    return out
+
+
+class EncodeStage(Stage):
+    """ROI 编码阶段：逐帧编码，不丢帧；检测结果有新版本时才重建 QP 图
+
+    编码器在第一帧到来时按实际分辨率创建。key_request 由推流阶段在拥塞丢掉参考帧后置位，
+    编码器只在本线程里访问，下一帧强制编成关键帧。
+    配了 passthrough（stream.passthrough.PassthroughPolicy）时由它逐帧决定是否编码：
+    源码流直通推流期间帧直接归还，编码器空闲。
+    配了 rate_control（stream.ratecontrol.RateController）时由它按推流时延调整 QP 偏移，
+    最后一级会跳过没有 ROI 的帧。
+    配了 roi_log（可写的文本文件）时检测结果每次变化都按 {"pts", "boxes"} 写一行 JSON，
+    基准测试用它计算 ROI 内外的画质（src/python/bench/quality.py）。
+    配了 detections（ai.detections.DetectionCursor）时检测结果按帧的 pts 从录下的索引里取，
+    不读 roi_state，这一路不需要推理阶段。
+    多码率输出时每路一个编码阶段（name 区分）：size 为 (w, h)（或第一帧时按源尺寸调用的 size(w, h)）
+    且与源不同时，编码输入取 frame.scaled()，原生帧用 scaler_for(size) 给出的缩放器，
+    同一尺寸的各路共用一次缩放；检测框按同样的比例换算。
+    """
+
+    def __init__(self, encoder_factory, roi_state, inbox, key_request=None, passthrough=None, rate_control=None,
+                 roi_log=None, detections=None, size=None, scaler_for=None, name='encode'):
+        super().__init__(name, inbox)
+        self.encoder_factory = encoder_factory
+        self.roi_state = roi_state
+        self.key_request = key_request or threading.Event()
+        self.passthrough = passthrough
+        self.rate_control = rate_control
+        self.roi_log = roi_log
+        self.detections = detections
+        self.size = size
+        self.scaler_for = scaler_for
+        self.scaler = None
+        self.encoder = None
+        self.ready = threading.Event()
+        self.skipped = 0
+        self.decimated = 0
+        self._version = 0
+        self._origins = {}  # pts -> 来源帧的 (origin, marks)，编码包按 pts 认领
+
+    def process(self, frame):
+        if self.encoder is None:
+            if callable(self.size):
+                self.size = self.size(frame.width, frame.height)
+            if self.size is not None:
+                self.size = tuple(self.size)
+                if self.size == (frame.width, frame.height):
+                    self.size = None
+                elif frame.native is not None:
+                    self.scaler = self.scaler_for(self.size)
+            width, height = self.size or (frame.width, frame.height)
+            self.encoder = self.encoder_factory(width, height)
+            self.ready.set()
+        if self.detections is not None:
+            version, detections = self.detections.snapshot(frame.pts, frame.width, frame.height)
+        else:
+            version, detections, _ = self.roi_state.snapshot()
+        if version != self._version:
+            rois = detections
+            if self.size is not None:
+                rois = scale_detections(detections, self.size[0] / frame.width, self.size[1] / frame.height)
+            self.encoder.update_rois(rois)
+            self._version = version
+            if self.roi_log is not None:
+                self._log_rois(frame.pts, rois)
+        force_key = False
+        if self.passthrough is not None:
+            encode, force_key = self.passthrough.update(detections, frame.pts)
+            if not encode:
+                self.skipped += 1
+                return None
+        if self.rate_control is not None and not self.rate_control.update(self.encoder, detections):
+            self.decimated += 1
+            if force_key:
+                # 恢复编码的关键帧落到下一个编码的帧上
+                self.key_request.set()
+            return None
+        if self.key_request.is_set():
+            self.key_request.clear()
+            force_key = True
+        if self.size is not None:
+            source = frame.scaled(self.size, self.scaler)
+        else:
+            source = frame.native if frame.native is not None else frame.bgr()
+        self._origins[frame.pts] = (frame.origin, frame.marks)
+        while len(self._origins) > MAX_PENDING_ORIGINS:
+            del self._origins[next(iter(self._origins))]
+        packets = self.encoder.encode(source, pts=frame.pts, force_key=force_key)
+        for pkt in packets:
+            pkt.origin, pkt.marks = self._origins.pop(pkt.pts, (None, None))
+        self._cache_pools()
+        return packets or None
+
+    def _cache_pools(self):
+        # 各路的编码器各有一个包池（encoder、encoder.<路名>），缩放器按尺寸共用
+        pools = {'encoder' + self.name[len('encode'):]: self.encoder.pool_stats()}
+        if self.scaler is not None:
+            pools['scaler.%dx%d' % self.size] = self.scaler.pool_stats()
+        self.last_pools = pools
+
+    def _log_rois(self, pts, detections):
+        boxes = []
+        for det in detections:
+            box = det[2] if len(det) == 3 else det[0] if len(det) == 2 else det
+            boxes.append([round(float(v), 1) for v in box[:4]])
+        self.roi_log.write(json.dumps({'pts': pts, 'boxes': boxes}) + '\n')
+
+    def teardown(self):
+        if self.encoder is not None:
+            for pkt in self.encoder.drain():
+                pkt.release()
+            self.encoder.stop()
+
+    def stats(self):
+        st = super().stats()
+        encoder = self.encoder
+        if encoder is not None and encoder.handle:
+            st['packet_pool'] = encoder.pool_stats()
+            st['static_blocks'] = encoder.static_blocks
+        if self.passthrough is not None:
+            st['skipped'] = self.skipped
+            st['passthrough'] = self.passthrough.stats()
+        if self.rate_control is not None:
+            st['decimated'] = self.decimated
+            st['rate_control'] = self.rate_control.stats()
+        if self.detections is not None:
+            st['replayed'] = self.detections.stats()
+        if self.size is not None:
+            st['size'] = list(self.size)
+        return st
+
+
+class PublishStage(Stage):
+    """RTMP 推流阶段：把编码包交给原生发送队列，不丢包
+
+    推流端在第一个包到来时创建（此时才知道分辨率）。原生队列拥塞丢掉参考帧后
+    置位 key_request，由编码阶段在自己的线程里请求关键帧。
+    配了 passthrough 时推流端建好后接上源的 ingest，编码包改经 Passthrough 发送。
+    配了 rate_control 时推流端建好后交给它读取发送队列的时延。
+    last_stats 缓存每个包之后的原生推流统计，指标导出读它而不是另外访问原生句柄。
+    """
+
+    def __init__(self, streamer_factory, inbox, key_request, passthrough=None, ingest=None, rate_control=None,
+                 name='publish'):
+        super().__init__(name, inbox)
+        self.streamer_factory = streamer_factory
+        self.key_request = key_request
+        self.passthrough = passthrough
+        self.ingest = ingest
+        self.rate_control = rate_control
+        self.streamer = None
+        self.last_stats = None
+        self._dropped_ref = 0
+
+    def process(self, packet):
+        try:
+            if self.streamer is None:
+                self.streamer = self.streamer_factory()
+                if self.passthrough is not None:
+                    self.passthrough.attach(self.ingest, self.streamer)
+                if self.rate_control is not None:
+                    self.rate_control.attach(self.streamer)
+            if self.passthrough is not None:
+                self.passthrough.send(packet, self.streamer)
+            else:
+                self.streamer.send(packet)
+        finally:
+            packet.release()
+        self.last_stats = self.streamer.stats()
+        dropped = self.last_stats['dropped_ref']
+        if dropped != self._dropped_ref:
+            self._dropped_ref = dropped
+            self.key_request.set()
+        return None
+
+    def teardown(self):
+        if self.rate_control is not None:
+            self.rate_control.detach()
+        if self.passthrough is not None:
+            self.passthrough.detach()
+        if self.streamer is not None:
+            self.streamer.stop()
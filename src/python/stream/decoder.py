@@ -0,0 +1,188 @@
+import ctypes
+
+import cv2
+import numpy as np
+
+from src.python.native import lib as native
+
+_BACKENDS = {
+    'auto': native.DECODER_AUTO,
+    'sophon': native.DECODER_SOPHON,
+    'software': native.DECODER_SOFTWARE,
+}
+
+
+class SurfaceRef:
+    """解码帧的一个独立句柄（roi_surface_retain），对象被回收时归还
+
+    NativeArray 视图和导出的 DLPack 张量持有它，帧在流水线里 release() 之后视图依然有效；
+    代价是最后一个视图消失之前这块解码缓冲不会回到解码器的池里。
+    """
+
+    def __init__(self, lib, handle):
+        self._lib = lib
+        self.handle = lib.roi_surface_retain(handle)
+
+    def __del__(self):
+        if self.handle:
+            self._lib.roi_surface_release(self.handle)
+            self.handle = None
+
+
+class DecodedFrame:
+    """解码输出的一帧 NV12。y / uv 是指向原生解码缓冲的 numpy 视图，release() 后失效
+
+    视图在第一次访问时才建立：帧只经过原生预处理和编码时，Python 侧不为它做任何按像素的工作。
+    需要比帧活得更久的视图（交给脚本、torch 等）用 planes()。
+    硬件解码且开启 keep_on_device 时帧只在设备内存里，y / uv 为 None，
+    下游应使用 device_y / device_uv 物理地址（见预处理与编码模块）。
+    """
+
+    def __init__(self, lib, surface):
+        self._lib = lib
+        self.handle = surface.handle
+        self.width = surface.width
+        self.height = surface.height
+        self.pts = surface.pts
+        self.seq = surface.seq
+        self.on_device = surface.memory == native.MEMORY_DEVICE
+        self.device_index = surface.device_index
+        self.device_y = surface.device_y
+        self.device_uv = surface.device_uv
+        # 原生时间戳是 CLOCK_MONOTONIC 微秒，在 Linux 上与 time.perf_counter 同一时钟
+        self.arrival = surface.arrival_us / 1e6 if surface.arrival_us else None
+        self.host_y = surface.y
+        self.host_uv = surface.uv
+        self.pitch_y = surface.pitch_y
+        self.pitch_uv = surface.pitch_uv
+        self._y = None
+        self._uv = None
+
+    @property
+    def y(self):
+        if self._y is None and self.handle and self.host_y:
+            h = self.height
+            y = native.view(self.host_y, self.pitch_y * h)
+            self._y = np.frombuffer(y, dtype=np.uint8).reshape(h, self.pitch_y)[:, :self.width]
+        return self._y
+
+    @property
+    def uv(self):
+        if self._uv is None and self.handle and self.host_uv:
+            h = self.height // 2
+            uv = native.view(self.host_uv, self.pitch_uv * h)
+            self._uv = np.frombuffer(uv, dtype=np.uint8).reshape(h, self.pitch_uv)[:, :self.width]
+        return self._uv
+
+    def planes(self):
+        """(Y, UV) 两个 NativeArray：np.asarray() 得到 (h, w) 与 (h/2, w) 的 uint8 数组（UV 交错），
+        也可以交给 np.from_dlpack / torch.from_dlpack。它们共同持有这一帧，不随 release() 失效"""
+        if not self.host_y:
+            raise ValueError('frame has no host mapping, open the decoder with keep_on_device=False')
+        ref = SurfaceRef(self._lib, self.handle)
+        w, h = self.width, self.height
+        return (native.NativeArray(self.host_y, (h, w), (self.pitch_y, 1), '|u1', ref),
+                native.NativeArray(self.host_uv, (h // 2, w), (self.pitch_uv, 1), '|u1', ref))
+
+    def to_bgr(self, dst=None):
+        """转换成 BGR（供 OpenCV 路径与显示使用）；dst 为 (h, w, 3) 的 uint8 缓冲时原地写入，否则新分配"""
+        if self.y is None:
+            raise ValueError('frame has no host mapping, open the decoder with keep_on_device=False')
+        if dst is None:
+            return cv2.cvtColorTwoPlane(self.y, self.uv, cv2.COLOR_YUV2BGR_NV12)
+        return cv2.cvtColorTwoPlane(self.y, self.uv, cv2.COLOR_YUV2BGR_NV12, dst=dst)
+
+    def release(self):
+        if self.handle:
+            self._y = None
+            self._uv = None
+            self._lib.roi_surface_release(self.handle)
+            self.handle = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.release()
+
+    def __del__(self):
+        self.release()
+
+
+class Scaler:
+    """把 DecodedFrame 缩放成 width x height 的 NV12（roi_scaler），多码率输出中较小的码流用它
+
+    输出仍是 DecodedFrame，来自缩放器自己的帧池，与源帧互不牵连，由调用方 release()。
+    同一尺寸的多个码流共用一个缩放器，原生侧串行执行，可以从多个编码线程调用。
+    源帧须有主机映射（解码器 keep_on_device=False）。
+    """
+
+    def __init__(self, width, height, pool_frames=8):
+        self.lib = native.load()
+        if self.lib is None:
+            raise RuntimeError('native pipeline library not built, run make in src/cpp')
+        self.handle = self.lib.roi_scaler_open(width, height, pool_frames)
+        if not self.handle:
+            raise RuntimeError('scaler open failed: %s' % native.last_error())
+        self.width = width & ~1
+        self.height = height & ~1
+
+    def scale(self, frame):
+        surface = native.RoiSurface()
+        if self.lib.roi_scaler_scale(self.handle, frame.handle, ctypes.byref(surface)) <= 0:
+            raise RuntimeError('scale failed: %s' % native.last_error())
+        return DecodedFrame(self.lib, surface)
+
+    def pool_stats(self):
+        st = native.RoiPoolStats()
+        self.lib.roi_scaler_get_pool_stats(self.handle, ctypes.byref(st))
+        return native.pool_stats(st)
+
+    def close(self):
+        if self.handle:
+            self.lib.roi_scaler_close(self.handle)
+            self.handle = None
+
+
+class Decoder:
+    """解码阶段：从 RtspIngest 的环形缓冲区取访问单元，在 SE5 VPU 上解码
+
+    backend 取 'auto'（优先 VPU，不可用时退回 CPU）、'sophon' 或 'software'。
+    """
+
+    def __init__(self, ingest, backend='auto', device_index=0, keep_on_device=True, queue_depth=4):
+        self.lib = native.load()
+        if self.lib is None:
+            raise RuntimeError('native pipeline library not built, run make in src/cpp')
+        self.ingest = ingest
+        self.handle = self.lib.roi_decoder_open(ingest.handle, _BACKENDS[backend], device_index,
+                                                1 if keep_on_device else 0, queue_depth)
+        if not self.handle:
+            raise RuntimeError('decoder open failed: %s' % native.last_error())
+        self._surface = native.RoiSurface()
+
+    @property
+    def backend(self):
+        return self.lib.roi_decoder_backend(self.handle).decode('utf-8')
+
+    def read(self, timeout_ms=1000):
+        """返回下一帧 DecodedFrame，超时返回 None"""
+        if self.lib.roi_decoder_read(self.handle, ctypes.byref(self._surface), timeout_ms) <= 0:
+            return None
+        return DecodedFrame(self.lib, self._surface)
+
+    def stats(self):
+        st = native.RoiDecoderStats()
+        self.lib.roi_decoder_get_stats(self.handle, ctypes.byref(st))
+        return {name: getattr(st, name) for name, _ in st._fields_}
+
+    def pool_stats(self):
+        """原生解码帧池的占用；in_use 接近 capacity 说明下游压着太多帧没有 release"""
+        st = native.RoiPoolStats()
+        self.lib.roi_decoder_get_pool_stats(self.handle, ctypes.byref(st))
+        return native.pool_stats(st)
+
+    def stop(self):
+        if self.handle:
+            self.lib.roi_decoder_close(self.handle)
+            self.handle = None
@@ -1,48 +1,104 @@
+import time
+
 import cv2
+import numpy as np
 import tkinter as tk
 from PIL import Image, ImageTk
-import threading
 
 
 class StreamDisplay:
-    def __init__(self, root, camera_stream, ai_processor):
+    """Tk 预览窗口：左边原始帧，右边画了检测框的帧
+
+    采集和推理都在流水线线程里进行，这里只在 Tk 主线程用 root.after 轮询
+    预览队列（latest-wins），所有控件更新都发生在主线程。
+    预览的 RGB 转换和 PhotoImage 开销不小，所以刷新不超过 max_fps，
+    并先按 scale 缩小再转换；两幅图共用一次缩放和颜色转换。
+    缩放、转换和画框用的缓冲以及两个 PhotoImage 都只在尺寸变化时重建，之后逐帧原地改写。
+    timer（pipeline.metrics.StageTimer）给出时记下每帧的显示耗时和显示时帧的年龄。
+    """
+
+    def __init__(self, root, preview_queue, ai_processor, max_fps=10.0, scale=0.5, timer=None):
         self.root = root
-        self.camera_stream = camera_stream
+        self.preview_queue = preview_queue
         self.ai_processor = ai_processor
+        self.interval_ms = max(1, int(1000 / max_fps)) if max_fps > 0 else 15
+        self.scale = min(max(scale, 0.05), 1.0)
+        self.timer = timer
+        self.running = False
+        self.shown = 0
+        self._last = 0.0
+        self._small = None
+        self._rgb = None
+        self._processed = None
         self.original_label = tk.Label(root)
         self.original_label.pack(side=tk.LEFT)
         self.processed_label = tk.Label(root)
         self.processed_label.pack(side=tk.RIGHT)
 
+    def start_stream(self):
+        self.running = True
+        self.root.after(self.interval_ms, self.update_frames)
+
+    def stop_stream(self):
+        self.running = False
+
     def update_frames(self):
-        while self.camera_stream.running:
-            frame = self.camera_stream.get_frame()
+        if not self.running:
+            return
+        # 跳过间隔内的轮询，队列里的旧帧会被后来的帧顶掉
+        now = time.perf_counter()
+        if (now - self._last) * 1000 >= self.interval_ms:
+            frame = self.preview_queue.get(timeout=0)
             if frame is not None:
-                # 显示原始帧
-                self.display_frame(self.original_label, frame)
-                # 处理帧
-                processed_frame = self.ai_processor.process_frame(frame)
-                # 显示处理后的帧
-                self.display_frame(self.processed_label, processed_frame)
+                self._last = now
+                try:
+                    self.show(frame)
+                    if self.timer is not None:
+                        self.timer.record(now, time.perf_counter(), frame)
+                finally:
+                    frame.release()
+        if self.preview_queue.closed:
+            self.running = False
+            return
+        self.root.after(self.interval_ms, self.update_frames)
 
-    def start_stream(self):
-        self.camera_stream.running = True
-        thread = threading.Thread(target=self.update_frames)
-        thread.daemon = True
-        thread.start()
+    def _buffers(self, image):
+        h, w = image.shape[:2]
+        size = (max(1, round(w * self.scale)), max(1, round(h * self.scale)))
+        if self._rgb is None or self._rgb.shape[:2] != (size[1], size[0]):
+            self._small = np.empty((size[1], size[0], 3), dtype=np.uint8) if self.scale < 1.0 else None
+            self._rgb = np.empty((size[1], size[0], 3), dtype=np.uint8)
+            self._processed = np.empty_like(self._rgb)
+        return size
 
-    @staticmethod
-    def display_frame(self, label, frame):
+    def show(self, frame):
+        image = frame.bgr()
+        size = self._buffers(image)
+        if self._small is not None:
+            image = cv2.resize(image, size, dst=self._small, interpolation=cv2.INTER_LINEAR)
         # OpenCV捕获的图像是BGR格式，需要转换为RGB格式
-        cv2image = cv2.cvtColor(frame, cv2.COLOR_BGR2RGB)
-        pil_image = Image.fromarray(cv2image)
-        imgtk = ImageTk.PhotoImage(image=pil_image)
-
-        # 如果label已经有图像，则更新图像，否则使用label的config方法附加图像
-        if label.imgtk:
-            label.imgtk = imgtk
-            label.configure(image=imgtk)
-        else:
-            label.imgtk = imgtk
-            label.image = imgtk  # 保留引用
-            label.configure(image=imgtk)
+        rgb = cv2.cvtColor(image, cv2.COLOR_BGR2RGB, dst=self._rgb)
+        self.display_frame(self.original_label, rgb)
+        # 原始帧也在显示，检测框画在副本上
+        processed = self._processed
+        np.copyto(processed, rgb)
+        s = self.scale
+        for class_id, confidence, box in getattr(frame, 'detections', None) or ():
+            x, y, w, h = box
+            self.ai_processor.draw_prediction(processed, class_id, confidence, round(x * s), round(y * s),
+                                              round((x + w) * s), round((y + h) * s))
+        self.display_frame(self.processed_label, processed)
+        self.shown += 1
+
+    @staticmethod
+    def display_frame(label, rgb):
+        # fromarray 直接引用 rgb 的内存，paste 把像素写进已有的 Tk 图像
+        image = Image.fromarray(rgb)
+        imgtk = getattr(label, 'imgtk', None)
+        if imgtk is not None and (imgtk.width(), imgtk.height()) == image.size:
+            imgtk.paste(image)
+            return
+        imgtk = ImageTk.PhotoImage(image=image)
+        # 保留引用，否则 PhotoImage 会被回收导致图像不显示
+        label.imgtk = imgtk
+        label.configure(image=imgtk)
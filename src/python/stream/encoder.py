@@ -0,0 +1,209 @@
+import ctypes
+
+import cv2
+import numpy as np
+
+from src.python.native import lib as native
+
+_BACKENDS = {
+    'auto': native.ENCODER_AUTO,
+    'sophon': native.ENCODER_SOPHON,
+    'x264': native.ENCODER_X264,
+    'x265': native.ENCODER_X265,
+}
+
+_CODECS = {
+    'h264': native.CODEC_H264,
+    'h265': native.CODEC_H265,
+}
+
+
+class EncodedPacket:
+    """编码输出的一个访问单元。data 指向原生编码缓冲，release() 之后失效
+
+    origin / marks 由编码阶段从来源帧带过来（见 pipeline.metrics.StageTimer），找不到来源帧时为 None。
+    """
+
+    def __init__(self, lib, packet):
+        self._lib = lib
+        self.handle = packet.handle
+        self.data = native.view(packet.data, packet.size)
+        self.pts = packet.pts
+        self.dts = packet.dts
+        self.key = bool(packet.key)
+        self.reference = bool(packet.reference)
+        self.codec = packet.codec
+        self.origin = None
+        self.marks = None
+
+    def release(self):
+        if self.handle:
+            self.data = None
+            self._lib.roi_packet_release(self.handle)
+            self.handle = None
+
+    def __del__(self):
+        self.release()
+
+
+class RoiEncoder:
+    """ROI 编码阶段：把检测框变成宏块级 QP 偏移图，交给硬件（或 x264/x265）编码器
+
+    ROI 内使用 roi_qp_delta（低 QP、高码率），其余区域使用 background_qp_delta。
+    QP 图在原生侧增量更新，只改写 ROI 归属发生变化的块。
+    smoothing 为 True 时检测框先经过原生的时域平滑层（外扩、块对齐、消失后保持、边缘平滑），
+    QP 图只在确有需要时才变化，码控不会随检测抖动来回搬运码率；参数见 set_smoothing()。
+    classes（ai.classes.ClassConfig）给出时按类别取 QP 偏移，qp_delta 为 None 的类别不作为 ROI；
+    max_rois 限制 ROI 个数，超出时按类别优先级、再按置信度保留。
+    static_background 为 True（或参数 dict，见 set_static_background()）时，ROI 之外长时间静止的块
+    改用更高的 QP，固定机位下背景几乎不再占码率。
+    """
+
+    def __init__(self, width, height, codec='h264', backend='auto', fps=25, bitrate_kbps=2000, gop=50,
+                 roi_qp_delta=-8, background_qp_delta=6, base_qp=30, device_index=0, smoothing=True,
+                 classes=None, max_rois=None, static_background=False):
+        self.lib = native.load()
+        if self.lib is None:
+            raise RuntimeError('native pipeline library not built, run make in src/cpp')
+        cfg = native.RoiEncoderConfig(
+            codec=_CODECS[codec], backend=_BACKENDS[backend], width=width, height=height, fps=fps,
+            bitrate_kbps=bitrate_kbps, gop=gop, device_index=device_index, roi_qp_delta=roi_qp_delta,
+            background_qp_delta=background_qp_delta, base_qp=base_qp)
+        self.handle = self.lib.roi_encoder_open(ctypes.byref(cfg))
+        if not self.handle:
+            raise RuntimeError('encoder open failed: %s' % native.last_error())
+        self.width = width
+        self.height = height
+        self.fps = fps
+        self.roi_qp_delta = roi_qp_delta
+        self.background_qp_delta = background_qp_delta
+        self.roi_qp_bias = 0
+        self.classes = classes
+        self.max_rois = max_rois
+        self.frame_index = 0
+        self._packet = native.RoiPacket()
+        self._boxes = (native.RoiBox * 0)()
+        self._i420 = None  # BGR 输入转换用的 I420 缓冲，复用
+        if smoothing:
+            self.set_smoothing(**(smoothing if isinstance(smoothing, dict) else {}))
+        if static_background:
+            self.set_static_background(**(static_background if isinstance(static_background, dict) else {}))
+
+    @property
+    def backend(self):
+        return self.lib.roi_encoder_backend(self.handle).decode('utf-8')
+
+    @property
+    def block_size(self):
+        return self.lib.roi_encoder_block_size(self.handle)
+
+    def update_rois(self, detections):
+        """detections 为 Processor.detect() 的输出 [(class_id, confidence, [x, y, w, h]), ...]，
+        也可以直接传 [x, y, w, h] 或 (box, qp_delta)。返回 QP 图中改变的块数"""
+        if self.classes is not None:
+            detections = self._prioritize(detections)
+        n = len(detections)
+        if len(self._boxes) < n:
+            self._boxes = (native.RoiBox * max(n, 2 * len(self._boxes)))()
+        for i, det in enumerate(detections):
+            box, qp = self._unpack(det)
+            b = self._boxes[i]
+            b.x, b.y, b.w, b.h = float(box[0]), float(box[1]), float(box[2]), float(box[3])
+            b.qp_delta = qp
+        return self.lib.roi_encoder_set_rois(self.handle, self._boxes, n)
+
+    def set_smoothing(self, enabled=True, alpha=0.4, dilate=0.15, pad_pixels=8, hold_updates=5, match_iou=0.2,
+                      shrink_margin=0.25):
+        """配置 ROI 平滑：alpha 为边缘收缩的平滑系数，dilate / pad_pixels 为每边的外扩比例和像素，
+        hold_updates 为目标消失后 ROI 保持的 update_rois 次数，shrink_margin 为收缩滞回（块宽的比例）"""
+        if not enabled:
+            self.lib.roi_encoder_set_smoothing(self.handle, None)
+            return
+        cfg = native.RoiSmoothing(alpha=alpha, dilate=dilate, pad_pixels=pad_pixels, hold_updates=hold_updates,
+                                  match_iou=match_iou, shrink_margin=shrink_margin)
+        self.lib.roi_encoder_set_smoothing(self.handle, ctypes.byref(cfg))
+
+    def set_static_background(self, enabled=True, qp_delta=12, static_seconds=2.0, threshold=3.0, sample_step=4):
+        """静止背景模式：亮度帧差连续 static_seconds 秒低于 threshold 的块按 qp_delta 编码。
+        帧差在原生侧每帧抽样计算，只需要帧有主机内存映射（设备内存的帧不更新活动图）"""
+        if not enabled:
+            self.lib.roi_encoder_set_static(self.handle, None)
+            return
+        cfg = native.RoiStaticConfig(threshold=threshold, static_frames=max(1, int(static_seconds * self.fps)),
+                                     sample_step=sample_step, qp_delta=qp_delta)
+        self.lib.roi_encoder_set_static(self.handle, ctypes.byref(cfg))
+
+    def set_qp_offsets(self, background_qp_delta, roi_qp_bias=0):
+        """码控调整背景 QP 偏移和所有 ROI 统一加的 roi_qp_bias，立即改写 QP 图（ROI 不会比背景更差）"""
+        self.lib.roi_encoder_set_qp_offsets(self.handle, int(background_qp_delta), int(roi_qp_bias))
+        self.background_qp_delta = background_qp_delta
+        self.roi_qp_bias = roi_qp_bias
+
+    @property
+    def static_blocks(self):
+        """当前按静止背景编码的块数"""
+        return self.lib.roi_encoder_static_blocks(self.handle)
+
+    def _prioritize(self, detections):
+        """去掉不作为 ROI 的类别，按优先级和置信度排序并截断到 max_rois"""
+        rois = [det for det in detections if self.classes.is_roi(det)]
+        rois.sort(key=lambda det: (self.classes.priority(det[0]), det[1]) if len(det) == 3 else (0, 0.0),
+                  reverse=True)
+        return rois[:self.max_rois] if self.max_rois else rois
+
+    def _unpack(self, det):
+        if len(det) == 3:
+            if self.classes is not None:
+                return det[2], self.classes.qp_delta(det[0])
+            return det[2], self.roi_qp_delta
+        if len(det) == 2:
+            return det[0], int(det[1])
+        return det, self.roi_qp_delta
+
+    def qp_map(self):
+        """当前 QP 偏移图的 numpy 视图（rows x cols，int8）"""
+        cols = ctypes.c_int()
+        rows = ctypes.c_int()
+        ptr = self.lib.roi_encoder_qp_map(self.handle, ctypes.byref(cols), ctypes.byref(rows))
+        return np.frombuffer(native.view(ptr, cols.value * rows.value), dtype=np.int8).reshape(rows.value, cols.value)
+
+    def encode(self, frame, pts=None, force_key=False):
+        """编码一帧并返回已产出的 EncodedPacket 列表
+
+        frame 可以是 decoder.DecodedFrame（直接使用解码缓冲，设备内存也可以）
+        或 OpenCV 的 BGR ndarray（先转成 I420）。pts 单位为 90kHz。
+        """
+        key = 1 if force_key else 0
+        if hasattr(frame, 'handle'):
+            r = self.lib.roi_encoder_encode_surface(self.handle, frame.handle, key)
+        else:
+            if pts is None:
+                pts = self.frame_index * 90000 // self.fps
+            h, w = self.height, self.width
+            if self._i420 is None:
+                self._i420 = np.empty((h * 3 // 2, w), dtype=np.uint8)
+            i420 = cv2.cvtColor(frame, cv2.COLOR_BGR2YUV_I420, dst=self._i420)
+            base = i420.ctypes.data
+            r = self.lib.roi_encoder_encode_i420(self.handle, base, base + w * h, base + w * h + (w // 2) * (h // 2),
+                                                 w, w // 2, pts, key)
+        if r < 0:
+            raise RuntimeError(native.last_error())
+        self.frame_index += 1
+        return self.drain()
+
+    def drain(self):
+        packets = []
+        while self.lib.roi_encoder_receive(self.handle, ctypes.byref(self._packet)) > 0:
+            packets.append(EncodedPacket(self.lib, self._packet))
+        return packets
+
+    def pool_stats(self):
+        """软件编码器输出包池的占用；推流队列积压时 in_use 上升，VPU 编码器为全零"""
+        st = native.RoiPoolStats()
+        self.lib.roi_encoder_get_pool_stats(self.handle, ctypes.byref(st))
+        return native.pool_stats(st)
+
+    def stop(self):
+        if self.handle:
+            self.lib.roi_encoder_close(self.handle)
+            self.handle = None
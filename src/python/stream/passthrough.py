@@ -0,0 +1,147 @@
+import ctypes
+import logging
+import threading
+import time
+
+from src.python.ai.classes import has_rois
+from src.python.native import lib as native
+
+log = logging.getLogger(__name__)
+
+_CODECS = {
+    'h264': native.CODEC_H264,
+    'h265': native.CODEC_H265,
+}
+
+
+class Passthrough:
+    """直通转封装（原生 src/cpp/rtmp/passthrough）：RTSP 的压缩 AU 不经转码直接推流
+
+    在 ingest 上登记一个消费者，原生线程把 AU 转成 FLV 交给 streamer，与编码器输出在关键帧处切换。
+    编码器的包改由 send() 发送（接口与 RtmpStreamer.send 相同），直通期间这些包被跳过。
+    必须先于 ingest 和 streamer 调用 stop()。
+    """
+
+    def __init__(self, ingest, streamer):
+        self.lib = native.load()
+        self.handle = self.lib.roi_passthrough_open(ingest.handle, streamer.handle)
+        if not self.handle:
+            raise RuntimeError('passthrough open failed: %s' % native.last_error())
+        self.streamer = streamer
+        self.requested = False
+
+    def set_mode(self, passthrough):
+        """请求直通（True）或重编码（False），在对应一路的下一个关键帧处生效"""
+        self.requested = bool(passthrough)
+        self.lib.roi_passthrough_set_mode(self.handle, native.MODE_PASSTHROUGH if passthrough else native.MODE_ENCODE)
+
+    @property
+    def active(self):
+        """源码流正在推流（编码器可以暂停）"""
+        return self.lib.roi_passthrough_active(self.handle) == native.MODE_PASSTHROUGH
+
+    @property
+    def last_pts(self):
+        """最近发出的一帧的 pts（90kHz），恢复编码时跳过不晚于它的帧"""
+        return self.lib.roi_passthrough_last_dts(self.handle)
+
+    def send(self, packets):
+        if not isinstance(packets, (list, tuple)):
+            packets = [packets]
+        queued = 0
+        for pkt in packets:
+            r = self.lib.roi_passthrough_send_packet(self.handle, pkt.handle)
+            if r < 0:
+                raise RuntimeError(self.streamer.error())
+            queued += r
+        return queued
+
+    def stats(self):
+        st = native.RoiPassthroughStats()
+        self.lib.roi_passthrough_get_stats(self.handle, ctypes.byref(st))
+        out = {name: getattr(st, name) for name, _ in st._fields_}
+        out['source_kbps'] = round(out['source_kbps'], 1)
+        out['active'] = 'passthrough' if self.active else 'encode'
+        return out
+
+    def stop(self):
+        if self.handle:
+            self.lib.roi_passthrough_close(self.handle)
+            self.handle = None
+
+
+class PassthroughPolicy:
+    """决定一路何时直通、何时 ROI 重编码
+
+    画面里连续 idle_seconds 秒没有作为 ROI 的目标（classes 中 qp_delta 为 None 的类别不算），
+    且源码率不超过 budget_kbps 时请求直通；出现目标或源码率超过 budget_kbps * exit_ratio 时立即切回。
+    切换本身在关键帧处完成（见 Passthrough）。编码阶段每帧调用 update()，据返回值决定是否编码：
+    直通推流期间编码器空闲，恢复编码时跳过已经直通发出的帧，并在第一帧上请求关键帧。
+    推流阶段经 send() 发送编码包。Passthrough 引用着源的收流缓冲区，Pipeline 停止时先 detach()，
+    之后 attach() 不再生效。
+    """
+
+    def __init__(self, budget_kbps, idle_seconds=2.0, exit_ratio=1.25, classes=None):
+        self.budget_kbps = budget_kbps
+        self.idle_seconds = idle_seconds
+        self.exit_ratio = exit_ratio
+        self.classes = classes
+        self.sink = None
+        self.enabled = True
+        self._lock = threading.Lock()
+        self._closed = False
+        self._last_roi = time.monotonic()
+        self._resume = False
+
+    def attach(self, ingest, streamer):
+        """推流端建好后由推流阶段调用"""
+        with self._lock:
+            if self._closed:
+                return
+            if ingest.codec != _CODECS[streamer.codec]:
+                log.warning('passthrough disabled: source codec differs from the %s stream', streamer.codec)
+                self.enabled = False
+                return
+            self.sink = Passthrough(ingest, streamer)
+
+    def detach(self):
+        with self._lock:
+            self._closed = True
+            sink, self.sink = self.sink, None
+            if sink is not None:
+                sink.stop()
+
+    def send(self, packet, streamer):
+        with self._lock:
+            return (self.sink or streamer).send(packet)
+
+    def update(self, detections, pts):
+        """返回 (是否编码这一帧, 是否强制关键帧)"""
+        with self._lock:
+            if self.sink is None:
+                return True, False
+            return self._update(self.sink, detections, pts)
+
+    def _update(self, sink, detections, pts):
+        now = time.monotonic()
+        if has_rois(self.classes, detections):
+            self._last_roi = now
+        kbps = sink.stats()['source_kbps']
+        if sink.requested:
+            if self._last_roi == now or kbps > self.budget_kbps * self.exit_ratio:
+                sink.set_mode(False)
+                self._resume = True
+        elif now - self._last_roi >= self.idle_seconds and 0 < kbps <= self.budget_kbps:
+            sink.set_mode(True)
+        if not sink.active:
+            return True, False
+        if sink.requested or pts <= sink.last_pts:
+            return False, False
+        force_key, self._resume = self._resume, False
+        return True, force_key
+
+    def stats(self):
+        with self._lock:
+            if self.sink is not None:
+                return self.sink.stats()
+        return {'active': 'encode' if self.enabled else 'disabled'}
@@ -0,0 +1,131 @@
+import threading
+import time
+
+from src.python.ai.classes import has_rois
+
+
+class RateController:
+    """闭环码控：按推流端的排队时延逐级压低编码码率，链路恢复后再逐级放回
+
+    时延估计为 RTMP 发送队列的 dts 跨度，加上内核发送缓冲里未确认的字节按实测发送速率排空的时间；
+    服务器的 Acknowledgement 足够频繁时，确认时延更大就取它。原生侧的数据见 RtmpStreamer.stats()。
+    时延超过 target_ms（或原生队列开始丢帧）时每 interval 秒升一级，低于 target_ms * recover_ratio
+    连续 recover_seconds 秒降一级。级别依次是：按 step 抬高背景 QP 偏移直到 max_background，
+    再抬高 ROI 的 QP（roi_qp_bias 直到 max_roi_bias），最后给背景降帧，画面里没有 ROI 的帧只编码
+    1/2 … 1/max_divisor。原生队列的丢帧和关键帧请求仍是最后的兜底。
+    编码阶段每帧调用 update()，推流阶段建好推流端后 attach()，Pipeline 停止时 detach()。
+    """
+
+    def __init__(self, target_ms=400, interval=0.5, recover_ratio=0.5, recover_seconds=3.0, step=2,
+                 max_background=24, max_roi_bias=6, max_divisor=4, classes=None):
+        self.target_ms = target_ms
+        self.interval = interval
+        self.recover_ratio = recover_ratio
+        self.recover_seconds = recover_seconds
+        self.step = max(1, int(step))
+        self.max_background = max_background
+        self.max_roi_bias = max_roi_bias
+        self.max_divisor = max(1, int(max_divisor))
+        self.classes = classes
+        self.streamer = None
+        self.level = 0
+        self.delay_ms = 0.0
+        self.raises = 0
+        self._lock = threading.Lock()
+        self._closed = False
+        self._ladder = None
+        self._applied = 0
+        self._last_check = 0.0
+        self._last_sent = None
+        self._dropped = None
+        self._dropping = False
+        self._rate = 0.0  # 字节/秒
+        self._calm_since = None
+        self._frame = 0
+
+    def attach(self, streamer):
+        """推流端建好后由推流阶段调用"""
+        with self._lock:
+            if not self._closed:
+                self.streamer = streamer
+
+    def detach(self):
+        with self._lock:
+            self._closed = True
+            self.streamer = None
+
+    def _build_ladder(self, encoder):
+        """(背景 QP 偏移, ROI 偏置, 背景降帧倍数)，第 0 级是编码器的初始配置"""
+        background = encoder.background_qp_delta
+        bias = 0
+        divisor = 1
+        ladder = [(background, bias, divisor)]
+        while background < self.max_background:
+            background = min(self.max_background, background + self.step)
+            ladder.append((background, bias, divisor))
+        while bias < self.max_roi_bias:
+            bias = min(self.max_roi_bias, bias + self.step)
+            ladder.append((background, bias, divisor))
+        while divisor < self.max_divisor:
+            divisor = min(self.max_divisor, divisor * 2)
+            ladder.append((background, bias, divisor))
+        return ladder
+
+    def update(self, encoder, detections):
+        """返回是否编码这一帧；级别变化时在这里改写编码器的 QP 图（编码线程内）"""
+        if self._ladder is None:
+            self._ladder = self._build_ladder(encoder)
+        now = time.monotonic()
+        with self._lock:
+            # 推流端在锁内读取，detach() 之后不会再访问已经关闭的句柄
+            if self.streamer is not None and now - self._last_check >= self.interval:
+                self._last_check = now
+                self._measure(self.streamer.stats(), now)
+                self._adjust(now)
+        if self.level != self._applied:
+            background, bias, _ = self._ladder[self.level]
+            encoder.set_qp_offsets(background, bias)
+            self._applied = self.level
+        divisor = self._ladder[self.level][2]
+        self._frame += 1
+        if divisor == 1 or has_rois(self.classes, detections):
+            return True
+        return self._frame % divisor == 0
+
+    def _measure(self, st, now):
+        sent = st['sent_bytes']
+        if self._last_sent is not None:
+            last, at = self._last_sent
+            if now > at:
+                rate = (sent - last) / (now - at)
+                self._rate = rate if self._rate == 0 else 0.7 * self._rate + 0.3 * rate
+        self._last_sent = (sent, now)
+        # 发送停滞时速率按 1KB/s 计，缓冲里的字节就意味着很大的时延
+        socket_ms = 1000.0 * st['socket_bytes'] / max(self._rate, 1000.0)
+        self.delay_ms = max(st['queued_ms'] + socket_ms, st['ack_delay_ms'])
+        dropped = st['dropped_nonref'] + st['dropped_ref']
+        self._dropping = self._dropped is not None and dropped > self._dropped
+        self._dropped = dropped
+
+    def _adjust(self, now):
+        if self.delay_ms > self.target_ms or self._dropping:
+            self._calm_since = None
+            if self.level < len(self._ladder) - 1:
+                self.level += 1
+                self.raises += 1
+        elif self.delay_ms < self.target_ms * self.recover_ratio:
+            if self._calm_since is None:
+                self._calm_since = now
+            elif now - self._calm_since >= self.recover_seconds and self.level > 0:
+                self.level -= 1
+                self._calm_since = now
+        else:
+            self._calm_since = None
+
+    def stats(self):
+        out = {'level': self.level, 'delay_ms': round(self.delay_ms, 1), 'send_kbps': round(self._rate * 8 / 1000, 1),
+               'raises': self.raises}
+        if self._ladder is not None:
+            background, bias, divisor = self._ladder[self.level]
+            out.update(background_qp=background, roi_qp_bias=bias, background_divisor=divisor)
+        return out
@@ -0,0 +1,83 @@
+import ctypes
+
+from src.python.native import lib as native
+
+_CODECS = {
+    'h264': native.CODEC_H264,
+    'h265': native.CODEC_H265,
+}
+
+_HEVC_MODES = {
+    'enhanced': native.HEVC_FLV_ENHANCED,
+    'legacy': native.HEVC_FLV_LEGACY,
+}
+
+
+class RtmpStreamer:
+    """RTMP 推流阶段：握手与 publish 在构造时同步完成，之后由原生事件循环线程发送
+
+    send() 只是把编码包放进有界发送队列，服务器慢时不会阻塞调用线程；
+    队列满时原生侧先丢非参考帧，放不下再丢参考帧并让绑定的编码器出关键帧。
+    hevc_mode 选择 H.265 的 FLV 封装：'enhanced'（Enhanced RTMP）或 'legacy'（CodecID=12）。
+    """
+
+    def __init__(self, url, codec='h264', width=0, height=0, fps=25, bitrate_kbps=0, timeout_ms=5000,
+                 queue_bytes=4 << 20, queue_packets=150, hevc_mode='enhanced', encoder=None):
+        self.lib = native.load()
+        if self.lib is None:
+            raise RuntimeError('native pipeline library not built, run make in src/cpp')
+        cfg = native.RoiRtmpConfig(
+            url=url.encode('utf-8'), codec=_CODECS[codec], hevc_mode=_HEVC_MODES[hevc_mode], timeout_ms=timeout_ms,
+            queue_bytes=queue_bytes, queue_packets=queue_packets, chunk_size=4096, width=width, height=height,
+            fps=fps, bitrate_kbps=bitrate_kbps)
+        self.handle = self.lib.roi_rtmp_open(ctypes.byref(cfg))
+        if not self.handle:
+            raise RuntimeError('rtmp publish %s failed: %s' % (url, native.last_error()))
+        self.url = url
+        self.codec = codec
+        self.encoder = None
+        if encoder is not None:
+            self.attach(encoder)
+
+    def attach(self, encoder):
+        """绑定 encoder.RoiEncoder：拥塞丢掉参考帧后自动请求关键帧"""
+        self.encoder = encoder
+        self.lib.roi_rtmp_attach_encoder(self.handle, encoder.handle)
+
+    @property
+    def running(self):
+        return self.handle is not None and self.lib.roi_rtmp_state(self.handle) == 1
+
+    def send(self, packets):
+        """发送 EncodedPacket（或列表），返回入队的个数；包由调用方照常 release"""
+        if not isinstance(packets, (list, tuple)):
+            packets = [packets]
+        queued = 0
+        for pkt in packets:
+            r = self.lib.roi_rtmp_send_packet(self.handle, pkt.handle)
+            if r < 0:
+                raise RuntimeError(self.error())
+            queued += r
+        return queued
+
+    def send_from_encoder(self, encoder=None):
+        """把编码器的全部输出直接交给推流端，码流不经过 Python"""
+        encoder = encoder or self.encoder
+        r = self.lib.roi_rtmp_send_from_encoder(self.handle, encoder.handle)
+        if r < 0:
+            raise RuntimeError(self.error())
+        return r
+
+    def error(self):
+        return self.lib.roi_rtmp_error(self.handle).decode('utf-8', 'replace')
+
+    def stats(self):
+        st = native.RoiRtmpStats()
+        self.lib.roi_rtmp_get_stats(self.handle, ctypes.byref(st))
+        return {name: getattr(st, name) for name, _ in native.RoiRtmpStats._fields_ if name != 'reserved'}
+
+    def stop(self):
+        if self.handle:
+            self.lib.roi_rtmp_close(self.handle)
+            self.handle = None
+            self.encoder = None
@@ -0,0 +1,165 @@
+import threading
+import unittest
+
+from src.python.ai.batching import BatchInference
+
+
+class _Processor:
+    """按输入返回可辨认结果的假检测器；gate 给出时每批 forward 都等它放行"""
+
+    classes = ['person']
+    input_sizes = [(416, 416), (608, 608)]
+
+    def __init__(self, gate=None, fail=False):
+        self.gate = gate
+        self.fail = fail
+        self.batches = []
+        self.started = threading.Event()
+
+    def detect_batch(self, frames, sizes=None):
+        self.batches.append((list(frames), sizes))
+        self.started.set()
+        if self.gate is not None:
+            self.gate.wait(2.0)
+        if self.fail:
+            raise RuntimeError('forward failed')
+        return [[(0, 0.9, [i, 0, 10, 10]), frame] for i, frame in enumerate(frames)]
+
+
+class _Frame:
+    def __init__(self):
+        self.refs = 1
+        self._lock = threading.Lock()
+
+    def retain(self):
+        with self._lock:
+            self.refs += 1
+        return self
+
+    def release(self):
+        with self._lock:
+            self.refs -= 1
+
+
+class BatchInferenceTest(unittest.TestCase):
+    def setUp(self):
+        self.batchers = []
+
+    def tearDown(self):
+        for batcher in self.batchers:
+            batcher.stop()
+
+    def _start(self, processor, **kwargs):
+        batcher = BatchInference(processor, **kwargs).start()
+        self.batchers.append(batcher)
+        return batcher
+
+    def test_results_go_back_to_their_stream(self):
+        processor = _Processor()
+        batcher = self._start(processor, max_batch=3, max_wait_ms=1000)
+        reqs = [batcher.submit(name, 'image-' + name, size) for name, size in
+                (('a', (416, 416)), ('b', None), ('c', (608, 608)))]
+        for name, req in zip('abc', reqs):
+            self.assertEqual(req.wait(1.0)[1], 'image-' + name)
+        # 凑满一批立即发出，各帧的网络输入尺寸一起交给 detect_batch
+        self.assertEqual(len(processor.batches), 1)
+        self.assertEqual(processor.batches[0], (['image-a', 'image-b', 'image-c'], [(416, 416), None, (608, 608)]))
+        self.assertEqual(batcher.stats()['frames'], 3)
+
+    def test_clients_demultiplex_across_batches(self):
+        batcher = self._start(_Processor(), max_batch=2, max_wait_ms=5)
+        clients = {name: batcher.client(name) for name in ('a', 'b', 'c')}
+        results = {}
+
+        def run(name):
+            results[name] = [clients[name].detect('%s-%d' % (name, i))[1] for i in range(5)]
+
+        threads = [threading.Thread(target=run, args=(name,)) for name in clients]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join(5.0)
+        for name in clients:
+            self.assertEqual(results[name], ['%s-%d' % (name, i) for i in range(5)])
+        self.assertEqual(batcher.stats()['frames'], 15)
+        self.assertLessEqual(max(len(frames) for frames, _ in batcher.processor.batches), 2)
+
+    def test_newer_request_supersedes_pending_one(self):
+        gate = threading.Event()
+        processor = _Processor(gate)
+        batcher = self._start(processor, max_batch=1, max_wait_ms=0)
+        busy = batcher.submit('x', 'busy')
+        processor.started.wait(1.0)
+        old = batcher.submit('a', 'old')
+        new = batcher.submit('a', 'new')
+        self.assertEqual(old.wait(0.1), [])
+        gate.set()
+        self.assertEqual(new.wait(1.0)[1], 'new')
+        self.assertEqual(busy.wait(1.0)[1], 'busy')
+        self.assertEqual(batcher.stats()['superseded'], 1)
+        self.assertNotIn('old', [frame for frames, _ in processor.batches for frame in frames])
+
+    def test_forward_error_reaches_every_request(self):
+        batcher = self._start(_Processor(fail=True), max_batch=2, max_wait_ms=1000)
+        reqs = [batcher.submit(name, name) for name in 'ab']
+        for req in reqs:
+            with self.assertRaises(RuntimeError):
+                req.wait(1.0)
+
+    def test_timeout_withdraws_pending_request(self):
+        gate = threading.Event()
+        processor = _Processor(gate)
+        batcher = self._start(processor, max_batch=1, max_wait_ms=0)
+        batcher.submit('x', 'busy')
+        processor.started.wait(1.0)
+        client = batcher.client('a')
+        client.timeout = 0.05
+        frame = _Frame()
+        # 超时以空结果返回；还没发出的请求撤下，不再进入之后的批，也不需要替调用方持有帧
+        self.assertEqual(client.detect('pending', owner=frame), [])
+        self.assertEqual(frame.refs, 1)
+        self.assertEqual(batcher.stats()['timeouts'], 1)
+        gate.set()
+        batcher.submit('y', 'after').wait(1.0)
+        self.assertNotIn('pending', [f for frames, _ in processor.batches for f in frames])
+
+    def test_timeout_in_flight_keeps_frame_until_batch_ends(self):
+        gate = threading.Event()
+        processor = _Processor(gate)
+        batcher = self._start(processor, max_batch=1, max_wait_ms=0)
+        client = batcher.client('a')
+        client.timeout = 0.05
+        frame = _Frame()
+        self.assertEqual(client.detect('in-flight', owner=frame), [])
+        self.assertEqual(frame.refs, 2)
+        self.assertEqual(batcher.stats()['timeouts'], 1)
+        # 调用方随后释放自己的引用，帧在 forward 结束前仍然有效
+        frame.release()
+        self.assertEqual(frame.refs, 1)
+        gate.set()
+        batcher.submit('b', 'next').wait(1.0)
+        self.assertEqual(frame.refs, 0)
+
+    def test_remove_and_stop_finish_waiting_requests(self):
+        gate = threading.Event()
+        processor = _Processor(gate)
+        batcher = self._start(processor, max_batch=1, max_wait_ms=0)
+        batcher.submit('x', 'busy')
+        processor.started.wait(1.0)
+        removed = batcher.submit('a', 'a')
+        batcher.remove('a')
+        self.assertEqual(removed.wait(0.1), [])
+        stopped = batcher.submit('b', 'b')
+        # stop() 先结束等待中的请求，再等正在 forward 的一批结束
+        stopper = threading.Thread(target=batcher.stop)
+        stopper.start()
+        self.assertTrue(stopped.done.wait(1.0))
+        gate.set()
+        stopper.join(2.0)
+        self.batchers.remove(batcher)
+        with self.assertRaises(RuntimeError):
+            stopped.wait(0)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,81 @@
+import threading
+import time
+import unittest
+
+from src.python.pipeline.queues import DROP_LATEST, DROP_NEVER, DROP_NEWEST, StageQueue
+
+
+class _Item:
+    def __init__(self, name):
+        self.name = name
+        self.released = 0
+
+    def release(self):
+        self.released += 1
+
+
+class StageQueueTest(unittest.TestCase):
+    def test_unknown_policy(self):
+        with self.assertRaises(ValueError):
+            StageQueue('q', 2, 'oldest')
+
+    def test_drop_latest_keeps_newest_and_releases_dropped(self):
+        q = StageQueue('infer', 2, DROP_LATEST)
+        items = [_Item(i) for i in range(5)]
+        for item in items:
+            self.assertTrue(q.put(item))
+        # latest-wins：保留最新的两项，被挤掉的三项各 release 一次
+        self.assertEqual([q.get(0), q.get(0)], items[3:])
+        self.assertEqual([item.released for item in items], [1, 1, 1, 0, 0])
+        self.assertEqual(q.drop_count, 3)
+        self.assertEqual(q.put_count, 5)
+        self.assertEqual(q.high_water, 2)
+        self.assertIsNone(q.get(0))
+
+    def test_drop_newest_rejects_without_releasing(self):
+        q = StageQueue('preview', 1, DROP_NEWEST)
+        first, second = _Item('a'), _Item('b')
+        self.assertTrue(q.put(first))
+        # 没有入队的项由调用方处理（Stage.emit 负责 release），队列不碰它
+        self.assertFalse(q.put(second))
+        self.assertEqual(second.released, 0)
+        self.assertEqual(q.drop_count, 1)
+        self.assertIs(q.get(0), first)
+
+    def test_drop_never_blocks_until_consumed(self):
+        q = StageQueue('encode', 1, DROP_NEVER)
+        self.assertTrue(q.put('a'))
+        # 带超时的 put 在队列一直满时返回 False，并计入阻塞时间
+        self.assertFalse(q.put('b', timeout=0.05))
+        self.assertGreaterEqual(q.blocked_time, 0.04)
+        self.assertEqual(q.drop_count, 0)
+
+        done = []
+        producer = threading.Thread(target=lambda: done.append(q.put('c')))
+        producer.start()
+        time.sleep(0.05)
+        self.assertEqual(done, [])
+        self.assertEqual(q.get(0), 'a')
+        producer.join(1.0)
+        self.assertEqual(done, [True])
+        self.assertEqual(q.get(0), 'c')
+
+    def test_close_wakes_producers_and_releases_leftovers(self):
+        q = StageQueue('publish', 1, DROP_NEVER)
+        left = _Item('left')
+        q.put(left)
+        result = []
+        producer = threading.Thread(target=lambda: result.append(q.put(_Item('late'))))
+        producer.start()
+        time.sleep(0.05)
+        q.close()
+        producer.join(1.0)
+        self.assertEqual(result, [False])
+        self.assertEqual(left.released, 1)
+        self.assertTrue(q.closed)
+        self.assertIsNone(q.get(0.01))
+        self.assertFalse(q.put(_Item('after')))
+
+
+if __name__ == '__main__':
+    unittest.main()